@@ -10,6 +10,11 @@
 #define EDDATAELEMENT_H
 
 #import <Cocoa/Cocoa.h>
+#import <libkern/OSAtomic.h>
+#include <pthread.h>
+#include "EDFloatVolume.h"
+#include "EDTypedVolume.h"
+#include "EDDataStatistics.h"
 
 //#ifdef __cplusplus
 //#include <itkImage.h>
@@ -54,6 +59,14 @@ enum ImageDataType {
 	IMAGE_DATA_UNKNOWN
 };
 
+/*
+ * Memory layout of the voxel data of an element (see EDFloatVolume.h).
+ */
+enum VolumeLayout {
+    LAYOUT_SLICE_MAJOR,     // col fastest, then row, slice and timestep - one 2D slice after the other
+    LAYOUT_TIME_MAJOR       // timestep fastest - the time series of each voxel is contiguous
+};
+
 enum ImagePropertyID{
     PROPID_NAME,
     PROPID_MODALITY,
@@ -75,6 +88,30 @@ enum ImagePropertyID{
 	PROPID_ORIGIN
 };
 
+/*
+ * Borrowed, read-only view on the float data of one 2D slice (no copy involved).
+ * Voxel (row r, col c) is found at data[r * rowStride + c].
+ * The data stays valid as long as token is alive. The token is autoreleased,
+ * so retain it if the view is needed beyond the current autorelease pool.
+ * Never free() data!
+ */
+typedef struct {
+    const float* data;
+    size_t rowStride;
+    id token;
+} EDSliceView;
+
+/*
+ * EDSliceView of a slice in the type it is stored in (see EDTypedVolume.h) - same rules
+ * for data and token. Voxel (row r, col c) is found at EDTypedLoad(data, type, r * rowStride + c).
+ */
+typedef struct {
+    const void* data;
+    enum EDVoxelType type;
+    size_t rowStride;
+    id token;
+} EDTypedSliceView;
+
 @interface BARTImageSize : NSObject <NSCopying> {
 	size_t rows;
 	size_t columns;
@@ -105,6 +142,15 @@ enum ImagePropertyID{
 	enum ImageType mImageType;
 	NSString *justatest;
     
+    // running statistics, maintained incrementally - see the Statistics category.
+    // Data is appended/modified on other threads than it is viewed on: mStatsLock guards
+    // mVolumeStats and mHistogram, it is only held while copying values in or out.
+    pthread_mutex_t mStatsLock;
+    volatile int32_t mGeneration;
+    EDVolumeStats* mVolumeStats;
+    size_t         mVolumeStatsCount;
+    EDHistogram*   mHistogram;
+    BOOL           mHistogramValid;
 }
 @property (retain) BARTImageSize *mImageSize;
 @property (retain) NSString *justatest;
@@ -114,6 +160,21 @@ enum ImagePropertyID{
 
 -(id)initWithDataFile:(NSString*)path andSuffix:(NSString*)suffix andDialect:(NSString*)dialect ofImageType:(enum ImageType)iType;
 
+/*
+ * Same as above, with native YES int16, uint16, uint8 and int8 data stay in that type
+ * (half or a quarter of the memory of float). Accessors convert on the fly, the typed
+ * accessors (getTypedVolume:..., getTypedSliceView:...) hand out the data as it is.
+ * Other types are promoted to float as usual.
+ */
+-(id)initWithDataFile:(NSString*)path andSuffix:(NSString*)suffix andDialect:(NSString*)dialect ofImageType:(enum ImageType)iType keepNativeType:(BOOL)native;
+
+/*
+ * Lazy alternative to initWithDataFile:... for uncompressed NIfTI files (.nii): the file
+ * is memory mapped and each slice is converted to float on its first access.
+ * Falls back to initWithDataFile:... for everything else.
+ */
+-(id)initWithMappedDataFile:(NSString*)path ofImageType:(enum ImageType)iType;
+
 -(id)initEmptyWithSize:(BARTImageSize*) imageSize ofImageType:(enum ImageType)iType;
 
 -(id)initEmptyWithSize:(BARTImageSize*) imageSize ofImageType:(enum ImageType)iType withOrientationFrom:(EDDataElement*)inputData;
@@ -129,6 +190,45 @@ enum ImagePropertyID{
 
 -(BARTImageSize*)getImageSize;
 
+/*
+ * Layout of the voxel data. Elements that don't support a choice are always LAYOUT_SLICE_MAJOR.
+ */
+-(enum VolumeLayout)getVolumeLayout;
+
+/*
+ * Converts the voxel data to layout (only supported for IMAGE_FCTDATA with a float store).
+ * All accessors keep working the same, only their speed differs: LAYOUT_TIME_MAJOR makes
+ * getTimeseriesDataAtRow:... and per-voxel analyses stream linearly through memory,
+ * at the cost of strided slice access (getSliceData:.../getSliceView:... copy the slice then).
+ * Returns NO if the layout is not supported or the conversion failed (data left as it was).
+ */
+-(BOOL)setVolumeLayout:(enum VolumeLayout)layout;
+
+/*
+ * Typed counterparts of getFloatVolume:, getFloatVolume:atTimestep: and getSliceView:atTimestep:
+ * for kernels that convert while they go. Elements with a float store describe it as
+ * ED_VOXEL_FLOAT, so these work for every element the float ones work for (and native ones).
+ */
+-(BOOL)getTypedVolume:(EDTypedVolume*)volume;
+
+-(BOOL)getTypedVolume:(EDTypedVolume*)volume atTimestep:(uint)tstep;
+
+-(EDTypedSliceView)getTypedSliceView:(uint)sliceNr atTimestep:(uint)tstep;
+
+/*
+ * getFloatVolume:atTimestep: for stores that recycle volume memory (realtime ring buffers,
+ * whose getFloatVolume:atTimestep: returns NO): *token (autoreleased, as EDSliceView.token)
+ * keeps the volume alive - retain it to read the volume beyond the current autorelease pool.
+ * *token is nil if the volume lives as long as the element.
+ */
+-(BOOL)getFloatVolume:(EDFloatVolume*)volume atTimestep:(uint)tstep token:(id*)token;
+
+/*
+ * getTypedVolume:atTimestep: with the token semantics of the above - the float store (pinned
+ * by *token if need be) or else the native one. For kernels that read whatever store there is.
+ */
+-(BOOL)getTypedVolume:(EDTypedVolume*)volume atTimestep:(uint)tstep token:(id*)token;
+
 @end
 
 
@@ -170,6 +270,28 @@ enum ImagePropertyID{
 
 -(float*)getSliceData:(uint)sliceNr atTimestep:(uint)tstep;
 
+/*
+ * Zero-copy alternative to getSliceData:atTimestep: - see EDSliceView.
+ * view.data is NULL if the slice/timestep is out of range.
+ */
+-(EDSliceView)getSliceView:(uint)sliceNr atTimestep:(uint)tstep;
+
+/*
+ * Direct access to the contiguous float store (if the element has one) for the
+ * inline accessors in EDFloatVolume.h - no message send per voxel.
+ * The buffer belongs to the element: it is valid as long as the element lives,
+ * writes go straight into the element data.
+ * Returns NO (volume untouched) if the data is not kept in such a store.
+ */
+-(BOOL)getFloatVolume:(EDFloatVolume*)volume;
+
+/*
+ * Same as getFloatVolume: restricted to the single (3D) volume at timestep tstep.
+ * Also available if the volumes are not stored back to back (realtime data), except for
+ * ring buffers - see getFloatVolume:atTimestep:token:.
+ */
+-(BOOL)getFloatVolume:(EDFloatVolume*)volume atTimestep:(uint)tstep;
+
 -(float*)getRowDataAt:(uint)row atSlice:(uint)sl atTimestep:(uint)tstep;
 
 -(void)setRowAt:(uint)row atSlice:(uint)sl	atTimestep:(uint)tstep withData:(float*)data;
@@ -192,8 +314,6 @@ enum ImagePropertyID{
 
 -(BOOL)isValid;
 
--(NSArray*)getMinMaxOfDataElement;
-
 //#ifdef __cplusplus
 //
 ///**
@@ -266,4 +386,61 @@ enum ImagePropertyID{
 
 @end
 
+
+#pragma mark -
+
+/*
+ * Running min/max and histogram of the data. Kept up to date incrementally
+ * (per voxel, row or column written, per appended volume), a volume is only rescanned
+ * if its values changed in a way that can't be followed (e.g. data written directly
+ * into the buffer of getFloatVolume:). All methods may be called from any thread.
+ */
+@interface EDDataElement (Statistics)
+
+/*
+ * Incremented on every change of the data - compare to find out whether cached
+ * values derived from the data (renderings, min/max) are outdated.
+ */
+-(NSUInteger)getGeneration;
+
+/*
+ * Global [min, max] as NSNumbers.
+ */
+-(NSArray*)getMinMaxOfDataElement;
+
+-(NSArray*)getMinMaxOfTimestep:(size_t)tstep;
+
+/*
+ * Histogram over all timesteps, range is the global min/max at the time it was built.
+ * Returns NO if the element is empty.
+ */
+-(BOOL)getHistogram:(EDHistogram*)histogram;
+
+/*
+ * Call this after writing directly into the buffer handed out by getFloatVolume:.
+ */
+-(void)invalidateStatisticsOfTimestep:(size_t)tstep;
+
+/*
+ * Bookkeeping for subclasses whenever they modify their data.
+ */
+-(void)updateStatisticsWithValue:(float)newValue replacing:(float)oldValue atTimestep:(size_t)tstep;
+
+/*
+ * Same for count voxels at once, e.g. a row or column written by setRowAt:/setColAt:.
+ */
+-(void)updateStatisticsWithValues:(const float*)newValues replacing:(const float*)oldValues count:(size_t)count atTimestep:(size_t)tstep;
+
+-(void)updateStatisticsOfAppendedTimestep:(size_t)tstep;
+
+-(void)removeStatisticsOfFirstTimestep;
+
+/*
+ * Hook for subclasses that know min/max of a timestep without going through the float
+ * data (e.g. from the raw file values of a lazily loaded element). Returns NO by default.
+ */
+-(BOOL)computeMinMaxOfTimestep:(size_t)tstep min:(float*)min max:(float*)max;
+
+@end
+
 #endif //EDDATAELEMENT_H
\ No newline at end of file
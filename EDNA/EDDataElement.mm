@@ -9,6 +9,7 @@
 #import "EDDataElement.h"
 //#import "EDDataElementVI.h"
 #import "EDDataElementIsis.h"
+#import "EDDataElementIsisMapped.h"
 #import "EDDataElementIsisRealTime.h"
 //#import <Common/itkImage.h>
 
@@ -90,6 +91,14 @@
 //    return nil;
 //}
 
+-(id)init
+{
+    if (self = [super init]) {
+        pthread_mutex_init(&self->mStatsLock, NULL);
+    }
+    return self;
+}
+
 -(id)initWithDataFile:(NSString*)path andSuffix:(NSString*)suffix andDialect:(NSString*)dialect ofImageType:(enum ImageType)iType
 {
 	NSFileManager *fm = [[NSFileManager alloc] init];
@@ -104,6 +113,30 @@
     return self;
 }
 
+-(id)initWithDataFile:(NSString*)path andSuffix:(NSString*)suffix andDialect:(NSString*)dialect ofImageType:(enum ImageType)iType keepNativeType:(BOOL)native
+{
+	NSFileManager *fm = [[NSFileManager alloc] init];
+	if ( NO == [fm fileExistsAtPath:path]){
+        [fm release];
+		NSLog(@"No file to load");
+		return nil;
+	}
+	
+    self = [[EDDataElementIsis alloc] initWithFile:path andSuffix:suffix andDialect:dialect ofImageType:iType keepNativeType:native];
+    [fm release];
+    return self;
+}
+
+-(id)initWithMappedDataFile:(NSString*)path ofImageType:(enum ImageType)iType
+{
+    EDDataElementIsisMapped* mapped = [[EDDataElementIsisMapped alloc] initWithMappedFile:path ofImageType:iType];
+    if (nil != mapped){
+        self = mapped;
+        return self;
+    }
+    return [self initWithDataFile:path andSuffix:@"" andDialect:@"" ofImageType:iType];
+}
+
 -(id)initEmptyWithSize:(BARTImageSize*)s  ofImageType:(enum ImageType)iType
 {
 	self = [[EDDataElementIsis alloc] initEmptyWithSize:s ofImageType:(enum ImageType)iType];
@@ -130,6 +163,9 @@
     if (self->mImageSize != nil) {
         [mImageSize release];
     }
+    free(self->mVolumeStats);
+    free(self->mHistogram);
+    pthread_mutex_destroy(&self->mStatsLock);
     [super dealloc];
 }
 
@@ -139,6 +175,62 @@
 	return mImageSize;
 }
 
+-(enum VolumeLayout)getVolumeLayout
+{
+    return LAYOUT_SLICE_MAJOR;
+}
+
+-(BOOL)setVolumeLayout:(enum VolumeLayout)layout
+{
+    return LAYOUT_SLICE_MAJOR == layout;
+}
+
+-(BOOL)getTypedVolume:(EDTypedVolume*)volume
+{
+    EDFloatVolume floatVolume;
+    if (NULL == volume or NO == [self getFloatVolume:&floatVolume]){
+        return NO;}
+    EDTypedVolumeFromFloat(volume, &floatVolume);
+    return YES;
+}
+
+-(BOOL)getTypedVolume:(EDTypedVolume*)volume atTimestep:(uint)tstep
+{
+    EDFloatVolume floatVolume;
+    if (NULL == volume or NO == [self getFloatVolume:&floatVolume atTimestep:tstep]){
+        return NO;}
+    EDTypedVolumeFromFloat(volume, &floatVolume);
+    return YES;
+}
+
+-(EDTypedSliceView)getTypedSliceView:(uint)sliceNr atTimestep:(uint)tstep
+{
+    EDSliceView floatView = [self getSliceView:sliceNr atTimestep:tstep];
+    EDTypedSliceView view = {floatView.data, ED_VOXEL_FLOAT, floatView.rowStride, floatView.token};
+    return view;
+}
+
+-(BOOL)getFloatVolume:(EDFloatVolume*)volume atTimestep:(uint)tstep token:(id*)token
+{
+    if (NULL == token){
+        return NO;}
+    *token = nil;
+    return [self getFloatVolume:volume atTimestep:tstep];
+}
+
+-(BOOL)getTypedVolume:(EDTypedVolume*)volume atTimestep:(uint)tstep token:(id*)token
+{
+    if (NULL == volume or NULL == token){
+        return NO;}
+    EDFloatVolume floatVolume;
+    if ([self getFloatVolume:&floatVolume atTimestep:tstep token:token]){
+        EDTypedVolumeFromFloat(volume, &floatVolume);
+        return YES;
+    }
+    *token = nil;
+    return [self getTypedVolume:volume atTimestep:tstep];
+}
+
 -(id)copyWithZone:(NSZone *)zone
 {
    //[self doesNotRecognizeSelector:_cmd];
@@ -146,3 +238,282 @@
 }
 
 @end
+
+
+/**************************************************
+ EDDataElement (Statistics)
+ **************************************************/
+
+@interface EDDataElement (StatisticsPrivateMethods)
+
+/*
+ * Entry of tstep, grown to the current number of timesteps - call with mStatsLock held,
+ * the pointer is only valid until it is released.
+ */
+-(EDVolumeStats*)statsEntryOfTimestep:(size_t)tstep;
+
+/*
+ * Copies the min/max of tstep to stats, rescanning the volume if they are outdated.
+ * Returns NO if there is no such timestep.
+ */
+-(BOOL)getValidStatsOfTimestep:(size_t)tstep into:(EDVolumeStats*)stats;
+
+-(void)scanMinMaxOfTimestep:(size_t)tstep min:(float*)min max:(float*)max;
+
+-(BOOL)buildHistogram:(EDHistogram*)histogram;
+
+@end
+
+
+@implementation EDDataElement (Statistics)
+
+-(NSUInteger)getGeneration
+{
+    return (NSUInteger) (uint32_t) self->mGeneration;
+}
+
+-(NSArray*)getMinMaxOfDataElement
+{
+    float min = 0.0f;
+    float max = 0.0f;
+    BOOL first = YES;
+    for (size_t t = 0; t < [self->mImageSize timesteps]; t++){
+        EDVolumeStats stats;
+        if (NO == [self getValidStatsOfTimestep:t into:&stats]){
+            continue;}
+        if (first or stats.min < min){
+            min = stats.min;}
+        if (first or stats.max > max){
+            max = stats.max;}
+        first = NO;
+    }
+    return [NSArray arrayWithObjects:[NSNumber numberWithFloat:min], [NSNumber numberWithFloat:max], nil];
+}
+
+-(NSArray*)getMinMaxOfTimestep:(size_t)tstep
+{
+    EDVolumeStats stats;
+    if (NO == [self getValidStatsOfTimestep:tstep into:&stats]){
+        return nil;}
+    return [NSArray arrayWithObjects:[NSNumber numberWithFloat:stats.min], [NSNumber numberWithFloat:stats.max], nil];
+}
+
+-(BOOL)getHistogram:(EDHistogram*)histogram
+{
+    pthread_mutex_lock(&self->mStatsLock);
+    BOOL valid = self->mHistogramValid;
+    if (YES == valid){
+        *histogram = *(self->mHistogram);}
+    pthread_mutex_unlock(&self->mStatsLock);
+    if (YES == valid){
+        return YES;}
+    return [self buildHistogram:histogram];
+}
+
+-(void)invalidateStatisticsOfTimestep:(size_t)tstep
+{
+    pthread_mutex_lock(&self->mStatsLock);
+    EDVolumeStats* stats = [self statsEntryOfTimestep:tstep];
+    if (NULL != stats){
+        stats->valid = 0;}
+    self->mHistogramValid = NO;
+    OSAtomicIncrement32Barrier(&self->mGeneration);
+    pthread_mutex_unlock(&self->mStatsLock);
+}
+
+-(void)updateStatisticsWithValue:(float)newValue replacing:(float)oldValue atTimestep:(size_t)tstep
+{
+    if (newValue == oldValue){
+        return;}
+    [self updateStatisticsWithValues:&newValue replacing:&oldValue count:1 atTimestep:tstep];
+}
+
+-(void)updateStatisticsWithValues:(const float*)newValues replacing:(const float*)oldValues count:(size_t)count atTimestep:(size_t)tstep
+{
+    pthread_mutex_lock(&self->mStatsLock);
+    EDVolumeStats* stats = [self statsEntryOfTimestep:tstep];
+    for (size_t i = 0; i < count; i++){
+        if (newValues[i] == oldValues[i]){
+            continue;}
+        if (NULL != stats){
+            EDVolumeStatsReplace(stats, newValues[i], oldValues[i]);}
+        if (YES == self->mHistogramValid and 0 == EDHistogramReplace(self->mHistogram, newValues[i], oldValues[i])){
+            self->mHistogramValid = NO;}
+    }
+    OSAtomicIncrement32Barrier(&self->mGeneration);
+    pthread_mutex_unlock(&self->mStatsLock);
+}
+
+-(void)updateStatisticsOfAppendedTimestep:(size_t)tstep
+{
+    pthread_mutex_lock(&self->mStatsLock);
+    EDVolumeStats* entry = [self statsEntryOfTimestep:tstep];
+    if (NULL != entry){
+        entry->valid = 0;}
+    OSAtomicIncrement32Barrier(&self->mGeneration);
+    int32_t generation = self->mGeneration;
+    BOOL histogramValid = self->mHistogramValid;
+    EDHistogram histogram;
+    if (YES == histogramValid){
+        histogram = *(self->mHistogram);}
+    pthread_mutex_unlock(&self->mStatsLock);
+    
+    EDVolumeStats stats;
+    [self getValidStatsOfTimestep:tstep into:&stats];
+    
+    if (YES == histogramValid){
+        // the new volume is added to a copy, readers keep using the histogram meanwhile
+        EDFloatVolume volume;
+        id token;
+        histogramValid = ([self getFloatVolume:&volume atTimestep:tstep token:&token]
+                          and 0 != EDHistogramAddVolume(&histogram, &volume));
+        pthread_mutex_lock(&self->mStatsLock);
+        if (YES == histogramValid and YES == self->mHistogramValid and generation == self->mGeneration){
+            *(self->mHistogram) = histogram;}
+        else {
+            self->mHistogramValid = NO;}
+        pthread_mutex_unlock(&self->mStatsLock);
+    }
+}
+
+-(void)removeStatisticsOfFirstTimestep
+{
+    pthread_mutex_lock(&self->mStatsLock);
+    if (0 < self->mVolumeStatsCount){
+        memmove(self->mVolumeStats, self->mVolumeStats + 1, (self->mVolumeStatsCount - 1) * sizeof(EDVolumeStats));
+        self->mVolumeStatsCount--;
+    }
+    // the removed voxels are not known anymore
+    self->mHistogramValid = NO;
+    OSAtomicIncrement32Barrier(&self->mGeneration);
+    pthread_mutex_unlock(&self->mStatsLock);
+}
+
+-(BOOL)computeMinMaxOfTimestep:(size_t)tstep min:(float*)min max:(float*)max
+{
+    return NO;
+}
+
+-(EDVolumeStats*)statsEntryOfTimestep:(size_t)tstep
+{
+    size_t timesteps = [self->mImageSize timesteps];
+    if (tstep >= timesteps){
+        return NULL;}
+    if (self->mVolumeStatsCount < timesteps){
+        EDVolumeStats* grown = (EDVolumeStats*) realloc(self->mVolumeStats, timesteps * sizeof(EDVolumeStats));
+        if (NULL == grown){
+            NSLog(@"Could not allocate volume statistics");
+            return NULL;
+        }
+        memset(grown + self->mVolumeStatsCount, 0, (timesteps - self->mVolumeStatsCount) * sizeof(EDVolumeStats));
+        self->mVolumeStats = grown;
+        self->mVolumeStatsCount = timesteps;
+    }
+    return &(self->mVolumeStats[tstep]);
+}
+
+-(BOOL)getValidStatsOfTimestep:(size_t)tstep into:(EDVolumeStats*)stats
+{
+    pthread_mutex_lock(&self->mStatsLock);
+    EDVolumeStats* entry = [self statsEntryOfTimestep:tstep];
+    if (NULL != entry){
+        *stats = *entry;}
+    int32_t generation = self->mGeneration;
+    pthread_mutex_unlock(&self->mStatsLock);
+    if (NULL == entry){
+        return NO;}
+    if (0 != stats->valid){
+        return YES;}
+    
+    // scanned without the lock - the result is only kept if nothing changed meanwhile
+    [self scanMinMaxOfTimestep:tstep min:&stats->min max:&stats->max];
+    stats->valid = 1;
+    pthread_mutex_lock(&self->mStatsLock);
+    if (generation == self->mGeneration){
+        entry = [self statsEntryOfTimestep:tstep];
+        if (NULL != entry){
+            *entry = *stats;}
+    }
+    pthread_mutex_unlock(&self->mStatsLock);
+    return YES;
+}
+
+-(void)scanMinMaxOfTimestep:(size_t)tstep min:(float*)min max:(float*)max
+{
+    if ([self computeMinMaxOfTimestep:tstep min:min max:max]){
+        return;}
+    
+    EDFloatVolume volume;
+    id token;
+    if ([self getFloatVolume:&volume atTimestep:tstep token:&token]){
+        EDFloatVolumeMinMax(&volume, min, max);
+        return;
+    }
+    
+    // no direct access to the data - take the slow road
+    BARTImageSize* size = self->mImageSize;
+    *min = [self getFloatVoxelValueAtRow:0 col:0 slice:0 timestep:tstep];
+    *max = *min;
+    for (size_t s = 0; s < size.slices; s++){
+        for (size_t r = 0; r < size.rows; r++){
+            for (size_t c = 0; c < size.columns; c++){
+                float val = [self getFloatVoxelValueAtRow:r col:c slice:s timestep:tstep];
+                if (val < *min){
+                    *min = val;}
+                if (val > *max){
+                    *max = val;}
+            }
+        }
+    }
+}
+
+-(BOOL)buildHistogram:(EDHistogram*)histogram
+{
+    size_t timesteps = [self->mImageSize timesteps];
+    if (0 == timesteps){
+        return NO;}
+    int32_t generation = self->mGeneration;
+    
+    NSArray* minMax = [self getMinMaxOfDataElement];
+    memset(histogram, 0, sizeof(EDHistogram));
+    histogram->min = [[minMax objectAtIndex:0] floatValue];
+    histogram->max = [[minMax objectAtIndex:1] floatValue];
+    
+    BARTImageSize* size = self->mImageSize;
+    for (size_t t = 0; t < timesteps; t++){
+        EDFloatVolume volume;
+        EDTypedVolume typedVolume;
+        id token;
+        if ([self getFloatVolume:&volume atTimestep:t token:&token]){
+            EDHistogramAddVolume(histogram, &volume);}
+        else if ([self getTypedVolume:&typedVolume atTimestep:t]){
+            EDHistogramAddTypedVolume(histogram, &typedVolume);}
+        else {
+            for (size_t s = 0; s < size.slices; s++){
+                for (size_t r = 0; r < size.rows; r++){
+                    for (size_t c = 0; c < size.columns; c++){
+                        float val = [self getFloatVoxelValueAtRow:r col:c slice:s timestep:t];
+                        histogram->counts[EDHistogramBin(histogram, val)]++;
+                    }
+                }
+            }
+            histogram->total += size.columns * size.rows * size.slices;
+        }
+    }
+    
+    // kept for the next caller unless the data changed while it was built
+    EDHistogram* kept = (EDHistogram*) malloc(sizeof(EDHistogram));
+    pthread_mutex_lock(&self->mStatsLock);
+    if (NULL != kept and generation == self->mGeneration){
+        *kept = *histogram;
+        EDHistogram* old = self->mHistogram;
+        self->mHistogram = kept;
+        kept = old;
+        self->mHistogramValid = YES;
+    }
+    pthread_mutex_unlock(&self->mStatsLock);
+    free(kept);
+    return YES;
+}
+
+@end
@@ -13,6 +13,7 @@
 #import "EDDataElement.h"
 #import "DataStorage/image.hpp"
 //#include "Adapter/itkAdapter.hpp"
+#include <vector>
 
 
 @interface EDDataElementIsis : EDDataElement {
@@ -22,6 +23,20 @@
 	//isis::data::ChunkList mChunkList;
 	std::list<isis::data::Chunk> mChunkList;
     
+    // contiguous float store - the chunks of mIsisImage are just slices aliasing into it
+    boost::shared_ptr<void> mVolumeStorage;
+    EDFloatVolume mVolume;
+    
+    // native store (data kept in the type it was loaded with): mNativeVolume.data is set instead
+    // of mVolume.data, mVolumeStorage owns the typed buffer then
+    EDTypedVolume mNativeVolume;
+    
+    // LAYOUT_TIME_MAJOR: the chunks can't alias the store, mIsisImage only keeps a copy of
+    // the first volume (geometry, properties) and the chunk properties of all slices are kept
+    // here (index timestep * slices + slice) to rebuild the chunks for writing
+    enum VolumeLayout mLayout;
+    std::vector<isis::util::PropertyMap> mChunkProps;
+    
 //    isis::adapter::itkAdapter* mITKAdapter;
 	
 }
@@ -30,6 +45,11 @@
 -(BOOL)sizeCheckRows:(NSUInteger)r Cols:(NSUInteger)c Slices:(NSUInteger)s Timesteps:(NSUInteger)t;
 -(id)initFromImage:(isis::data::Image)img ofImageType:(enum ImageType)imgType;
 
+/*
+ * Loads like initWithFile:..., with native YES int16/uint16/uint8/int8 data is not promoted to float.
+ */
+-(id)initWithFile:(NSString*)path andSuffix:(NSString*)suffix andDialect:(NSString*)dialect ofImageType:(enum ImageType)iType keepNativeType:(BOOL)native;
+
 
 @end
 
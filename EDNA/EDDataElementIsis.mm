@@ -11,6 +11,7 @@
 //#undef _GLIBCXX_DEBUG_PEDANTIC
 
 #import "EDDataElementIsis.h"
+#import "EDStorageToken.h"
 
 // ISIS includes
 #include "DataStorage/image.hpp"
@@ -18,6 +19,83 @@
 
 // C++ includes
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include <dispatch/dispatch.h>
+
+
+/*
+ * Layout conversion of the volume store, one slice per job.
+ */
+struct EDVolumeCopyJob {
+	const EDFloatVolume* src;
+	EDFloatVolume* dst;
+};
+
+static void copyVolumeSlice(void* context, size_t sl)
+{
+	EDVolumeCopyJob* job = static_cast<EDVolumeCopyJob*>(context);
+	EDFloatVolumeCopySlices(job->src, job->dst, sl, sl + 1);
+}
+
+/*
+ * Copies the slices of src (converted to T if they are not of that type) into the native store
+ * and returns slice chunks aliasing it, with the properties of the source chunks.
+ */
+template<typename T> static std::list<isis::data::Chunk> nativeChunksOf(isis::data::Image& src, const EDTypedVolume* store, const boost::shared_ptr<void>& storage)
+{
+	size_t sliceSize = store->columns * store->rows;
+	std::list<isis::data::Chunk> chList;
+	for (size_t ts = 0; ts < store->timesteps; ts++){
+		for (size_t sl = 0; sl < store->slices; sl++){
+			isis::data::Chunk srcCh = src.getChunk(0, 0, sl, ts, true);
+			T* dst = static_cast<T*>(EDTypedVolumeSlice(store, sl, ts));
+			if (isis::data::ValueArray<T>::staticID == srcCh.getTypeID()){
+				memcpy(dst, ((boost::shared_ptr<T>) srcCh.getValueArray<T>()).get(), sliceSize * sizeof(T));}
+			else {
+				isis::data::MemChunk<T> typedCh(srcCh);
+				memcpy(dst, ((boost::shared_ptr<T>) typedCh.getValueArray<T>()).get(), sliceSize * sizeof(T));
+			}
+			
+			isis::data::Chunk ch(dst, EDVolumeStoreReference(storage), store->columns, store->rows);
+			ch.join(srcCh);
+			chList.push_back(ch);
+		}
+	}
+	return chList;
+}
+
+
+@interface EDDataElementIsis (PrivateMethods)
+
+/*
+ * Copies (and converts if needed) the voxel data of src into one aligned, contiguous float buffer
+ * and replaces mIsisImage by an image whose slice chunks alias that buffer. The properties of src
+ * are kept, so writing via isis still works without any extra copy.
+ * Returns NO if the store could not be allocated (the isis chunks are used directly then).
+ */
+-(BOOL)setupVolumeStoreFrom:(isis::data::Image)src;
+
+/*
+ * Same as setupVolumeStoreFrom: keeping the type of src (mNativeVolume instead of mVolume).
+ * Returns NO (nothing changed) if src is not of a type we keep natively or the store could not be allocated.
+ */
+-(BOOL)setupNativeStoreFrom:(isis::data::Image)src;
+
+/*
+ * Slice chunk as isis sees it. In time major layout it is gathered from the store into
+ * a chunk of its own and gets the chunk properties kept in mChunkProps.
+ */
+-(isis::data::Chunk)chunkOfSlice:(size_t)sl atTimestep:(size_t)tstep;
+
+/*
+ * The whole data as slice chunked isis image (for writing) - in time major layout a copy.
+ */
+-(isis::data::Image)sliceMajorImage;
+
+@end
+
 
 @implementation EDDataElementIsis
 
@@ -25,6 +103,10 @@
 {
     if (self = [super init]) {
         self->mImageSize = nil;
+        self->mIsisImage = NULL;
+        self->mVolume.data = NULL;
+        self->mNativeVolume.data = NULL;
+        self->mLayout = LAYOUT_SLICE_MAJOR;
 //        self->mITKAdapter = NULL;
     }
     
@@ -34,6 +116,11 @@
 
 
 -(id)initWithFile:(NSString*)path andSuffix:(NSString*)suffix andDialect:(NSString*)dialect ofImageType:(enum ImageType)iType
+{
+	return [self initWithFile:path andSuffix:suffix andDialect:dialect ofImageType:iType keepNativeType:NO];
+}
+
+-(id)initWithFile:(NSString*)path andSuffix:(NSString*)suffix andDialect:(NSString*)dialect ofImageType:(enum ImageType)iType keepNativeType:(BOOL)native
 {
 	self = [self init];
     mImageSize = [[BARTImageSize alloc] init];
@@ -58,12 +145,14 @@
 	//get the type of the orig image
 	mDataTypeID = (mIsisImageList.front()).getMajorTypeID();
 	
-	// make a real copy including conversion to float
-	isis::data::MemImage<float> memImg = ((mIsisImageList.front()));
-	//splice the whatever build image to a slice-chunked one (each 2D is a single chunk - easier access later on)
-    memImg.spliceDownTo(isis::data::sliceDim);
-	// give this copy to our class element
-	mIsisImage = new isis::data::Image(memImg); 
+	if (not native or not [self setupNativeStoreFrom:mIsisImageList.front()]){
+		// make a real copy including conversion to float
+		isis::data::MemImage<float> memImg = ((mIsisImageList.front()));
+		// give this copy to our class element - as contiguous store, sliced into one chunk per 2D slice (easier access later on)
+		[self setupVolumeStoreFrom:memImg];
+	}
+	// the store holds everything now, no need to keep the loaded original around
+	mIsisImageList.clear();
 	// get our class params from the image itself
 	mImageSize.rows = mIsisImage->getNrOfRows(); // getDimSize(isis::data::colDim)
     mImageSize.columns = mIsisImage->getNrOfColumns();
@@ -104,7 +193,7 @@
             }
         }
         
-        mIsisImage = new isis::data::Image(chList);
+        [self setupVolumeStoreFrom:isis::data::Image(chList)];
     }
     return self;
 }
@@ -162,7 +251,7 @@
             }
         }
         
-        mIsisImage = new isis::data::Image(chList);
+        [self setupVolumeStoreFrom:isis::data::Image(chList)];
         NSArray *propsToCopyForComplImage = [NSArray arrayWithObjects:
                                              @"voxelsize",@"indexOrigin", nil];
         [self copyProps:propsToCopyForComplImage fromDataElement:inputData];
@@ -179,13 +268,15 @@
     if (self->mIsisImage != NULL) {
         delete self->mIsisImage;
     }
+    self->mVolume.data = NULL;
+    self->mVolumeStorage.reset();
 	[super dealloc];
 }
 
 -(id)initFromImage:(isis::data::Image) img  ofImageType:(enum ImageType)imgType
 {
 	self = [self init];
-	mIsisImage = new isis::data::Image(img);
+	[self setupVolumeStoreFrom:img];
 	mImageType = imgType;
     
     mDataTypeID = img.getMajorTypeID();
@@ -203,13 +294,21 @@
 -(short)getShortVoxelValueAtRow: (NSUInteger)r col:(NSUInteger)c slice:(NSUInteger)s timestep:(NSUInteger)t
 {	
 	//TODO we dont want to use this!!
-	return (short)mIsisImage->voxel<float>(c,r,s,t);	//else {
+	return (short)[self getFloatVoxelValueAtRow:r col:c slice:s timestep:t];
 }
 
 -(float)getFloatVoxelValueAtRow: (NSUInteger)r col:(NSUInteger)c slice:(NSUInteger)s timestep:(NSUInteger)t
 {
 	float val = 0.0;
-	if ([self sizeCheckRows:r Cols:c Slices:s Timesteps:t]){
+	if (NULL != mVolume.data){
+		if (EDFloatVolumeContains(&mVolume, c, r, s, t)){
+			val = EDFloatVolumeGet(&mVolume, c, r, s, t);}
+	}
+	else if (NULL != mNativeVolume.data){
+		if (EDTypedVolumeContains(&mNativeVolume, c, r, s, t)){
+			val = EDTypedVolumeGet(&mNativeVolume, c, r, s, t);}
+	}
+	else if ([self sizeCheckRows:r Cols:c Slices:s Timesteps:t]){
 			val = (float)mIsisImage->voxel<float>(c,r,s,t);
 		}
     return val;
@@ -217,8 +316,76 @@
 
 -(void)setVoxelValue:(NSNumber*)val atRow: (NSUInteger)r col:(NSUInteger)c slice:(NSUInteger)sl timestep:(NSUInteger)t
 {
-	if ([self sizeCheckRows:r Cols:c Slices:sl Timesteps:t]){
-		mIsisImage->voxel<float>(c,r,sl,t) = [val floatValue];}
+	float newValue = [val floatValue];
+	if (NULL != mVolume.data){
+		if (EDFloatVolumeContains(&mVolume, c, r, sl, t)){
+			float oldValue = EDFloatVolumeGet(&mVolume, c, r, sl, t);
+			EDFloatVolumeSet(&mVolume, c, r, sl, t, newValue);
+			[self updateStatisticsWithValue:newValue replacing:oldValue atTimestep:t];
+		}
+	}
+	else if (NULL != mNativeVolume.data){
+		if (EDTypedVolumeContains(&mNativeVolume, c, r, sl, t)){
+			float oldValue = EDTypedVolumeGet(&mNativeVolume, c, r, sl, t);
+			EDTypedVolumeSet(&mNativeVolume, c, r, sl, t, newValue);
+			// the value as stored (rounded to the native type)
+			[self updateStatisticsWithValue:EDTypedVolumeGet(&mNativeVolume, c, r, sl, t) replacing:oldValue atTimestep:t];
+		}
+	}
+	else if ([self sizeCheckRows:r Cols:c Slices:sl Timesteps:t]){
+		float oldValue = mIsisImage->voxel<float>(c,r,sl,t);
+		mIsisImage->voxel<float>(c,r,sl,t) = newValue;
+		[self updateStatisticsWithValue:newValue replacing:oldValue atTimestep:t];
+	}
+}
+
+-(BOOL)getFloatVolume:(EDFloatVolume*)volume
+{
+	if (NULL == mVolume.data or NULL == volume){
+		return NO;}
+	*volume = mVolume;
+	return YES;
+}
+
+-(BOOL)getFloatVolume:(EDFloatVolume*)volume atTimestep:(uint)tstep
+{
+	if (NULL == mVolume.data or NULL == volume or tstep >= mVolume.timesteps){
+		return NO;}
+	*volume = mVolume;
+	volume->data      = mVolume.data + tstep * mVolume.timeStride;
+	volume->timesteps = 1;
+	return YES;
+}
+
+-(BOOL)getTypedVolume:(EDTypedVolume*)volume
+{
+	if (NULL == mNativeVolume.data){
+		return [super getTypedVolume:volume];}
+	if (NULL == volume){
+		return NO;}
+	*volume = mNativeVolume;
+	return YES;
+}
+
+-(BOOL)getTypedVolume:(EDTypedVolume*)volume atTimestep:(uint)tstep
+{
+	if (NULL == mNativeVolume.data){
+		return [super getTypedVolume:volume atTimestep:tstep];}
+	if (NULL == volume or tstep >= mNativeVolume.timesteps){
+		return NO;}
+	*volume = mNativeVolume;
+	volume->data      = EDTypedVolumeSlice(&mNativeVolume, 0, tstep);
+	volume->timesteps = 1;
+	return YES;
+}
+
+-(BOOL)computeMinMaxOfTimestep:(size_t)tstep min:(float*)min max:(float*)max
+{
+	if (NULL == mNativeVolume.data or tstep >= mNativeVolume.timesteps){
+		return NO;}
+	EDTypedMinMax(EDTypedVolumeSlice(&mNativeVolume, 0, tstep), mNativeVolume.type,
+				  mNativeVolume.columns * mNativeVolume.rows * mNativeVolume.slices, min, max);
+	return YES;
 }
 
 -(BOOL)WriteDataElementToFile:(NSString*)path
@@ -231,45 +398,51 @@
 	//isis::data::ImageList imgList;
 	//mDataTypeID = isis::data::TypePtr<int8_t>::staticID;
 	std::list<isis::data::Image> imgList;
+	isis::data::Image img = [self sliceMajorImage];
+	if (NULL != mNativeVolume.data and img.getMajorTypeID() == mDataTypeID){
+		// native store - already of the type to write, no round trip through float
+		imgList.push_back(img);
+		return isis::data::IOFactory::write( imgList, [path cStringUsingEncoding:NSUTF8StringEncoding], [suffix cStringUsingEncoding:NSUTF8StringEncoding], [dialect cStringUsingEncoding:NSUTF8StringEncoding] );
+	}
 	switch (mDataTypeID) {
 		case isis::data::ValueArray<int8_t>::staticID:
 		{
-			imgList.push_back( isis::data::TypedImage<int8_t> (*mIsisImage));
+			imgList.push_back( isis::data::TypedImage<int8_t> (img));
 			break;
 		}
 		case isis::data::ValueArray<u_int8_t>::staticID:
 		{
-			imgList.push_back(  isis::data::TypedImage<u_int8_t> (*mIsisImage));
+			imgList.push_back(  isis::data::TypedImage<u_int8_t> (img));
 			break;
 		}
 		case isis::data::ValueArray<int16_t>::staticID:
 		{
-			imgList.push_back( isis::data::TypedImage<int16_t> (*mIsisImage));
+			imgList.push_back( isis::data::TypedImage<int16_t> (img));
 			break;
 		}
 		case isis::data::ValueArray<u_int16_t>::staticID:
 		{
-			imgList.push_back(  isis::data::TypedImage<u_int16_t> (*mIsisImage));
+			imgList.push_back(  isis::data::TypedImage<u_int16_t> (img));
 			break;
 		}
 		case isis::data::ValueArray<int32_t>::staticID:
 		{
-			imgList.push_back(  isis::data::TypedImage<int32_t> (*mIsisImage));
+			imgList.push_back(  isis::data::TypedImage<int32_t> (img));
 			break;
 		}
 		case isis::data::ValueArray<u_int32_t>::staticID:
 		{
-			imgList.push_back(  isis::data::TypedImage<u_int32_t> (*mIsisImage));
+			imgList.push_back(  isis::data::TypedImage<u_int32_t> (img));
 			break;
 		}
 		case isis::data::ValueArray<float>::staticID:
 		{
-			imgList.push_back(  isis::data::TypedImage<float> (*mIsisImage));
+			imgList.push_back(  isis::data::TypedImage<float> (img));
 			break;
 		}
 		case isis::data::ValueArray<double>::staticID:
 		{
-			imgList.push_back(  isis::data::TypedImage<double> (*mIsisImage));
+			imgList.push_back(  isis::data::TypedImage<double> (img));
 			break;
 		}
 			
@@ -429,7 +602,7 @@
     EDDataElementIsis* retElement = nil;
     if ([self sizeCheckRows:1 Cols:1 Slices:1 Timesteps:tstep]){
         for (size_t i = 0; i < mImageSize.slices; i++){
-            chList.push_back(mIsisImage->getChunk(0,0,i,tstep));
+            chList.push_back([self chunkOfSlice:i atTimestep:tstep]);
         }
     
         isis::data::Image retImg(chList);
@@ -442,6 +615,27 @@
 
 -(float*)getSliceData:(uint)sliceNr atTimestep:(uint)tstep
 {	
+	if (NULL != mVolume.data){
+		if (not [self sizeCheckRows:0 Cols:0 Slices:sliceNr Timesteps:tstep]){
+			return NULL;}
+		float* sliceData = (float*) malloc(mVolume.columns * mVolume.rows * sizeof(float));
+		const float* src = EDFloatVolumeSlice(&mVolume, sliceNr, tstep);
+		for (size_t r = 0; r < mVolume.rows; r++){
+			if (1 == mVolume.colStride){
+				memcpy(sliceData + r * mVolume.columns, src + r * mVolume.rowStride, mVolume.columns * sizeof(float));}
+			else {
+				for (size_t c = 0; c < mVolume.columns; c++){
+					sliceData[r * mVolume.columns + c] = src[r * mVolume.rowStride + c * mVolume.colStride];}}
+		}
+		return sliceData;
+	}
+	if (NULL != mNativeVolume.data){
+		if (not [self sizeCheckRows:0 Cols:0 Slices:sliceNr Timesteps:tstep]){
+			return NULL;}
+		float* sliceData = (float*) malloc(mNativeVolume.columns * mNativeVolume.rows * sizeof(float));
+		EDTypedVolumeSliceToFloat(&mNativeVolume, sliceNr, tstep, sliceData);
+		return sliceData;
+	}
 	if ([self sizeCheckRows:1 Cols:1 Slices:sliceNr Timesteps:tstep]){
 		isis::data::MemChunkNonDel<float> chSlice(mImageSize.columns, mImageSize.rows);
 		mIsisImage->getChunk(0,0, sliceNr, tstep, false).copySlice(0, 0, chSlice, 0, 0);
@@ -451,10 +645,72 @@
 
 }
 
+-(EDSliceView)getSliceView:(uint)sliceNr atTimestep:(uint)tstep
+{
+	if ([self sizeCheckRows:0 Cols:0 Slices:sliceNr Timesteps:tstep]){
+		if (NULL != mVolume.data and 1 == mVolume.colStride){
+			EDSliceView view;
+			view.data      = EDFloatVolumeSlice(&mVolume, sliceNr, tstep);
+			view.rowStride = mVolume.rowStride;
+			view.token     = [[[EDStorageToken alloc] initWithStorage:mVolumeStorage] autorelease];
+			return view;
+		}
+		if (NULL != mVolume.data or NULL != mNativeVolume.data){
+			// strided store (time major) or native type - the view gets a (converted) copy of the slice
+			float* sliceData = [self getSliceData:sliceNr atTimestep:tstep];
+			if (NULL != sliceData){
+				EDSliceView view;
+				// getSliceData packs the rows densely - mVolume is empty for native stores, take the image size
+				view.data      = sliceData;
+				view.rowStride = (ptrdiff_t) mImageSize.columns;
+				view.token     = [[[EDStorageToken alloc] initWithStorage:boost::shared_ptr<float>(sliceData, free)] autorelease];
+				return view;
+			}
+		}
+		return [EDStorageToken sliceViewOf:mIsisImage slice:sliceNr timestep:tstep];
+	}
+	EDSliceView noView = {NULL, 0, nil};
+	return noView;
+}
+
+-(EDTypedSliceView)getTypedSliceView:(uint)sliceNr atTimestep:(uint)tstep
+{
+	if (NULL == mNativeVolume.data){
+		return [super getTypedSliceView:sliceNr atTimestep:tstep];}
+	if ([self sizeCheckRows:0 Cols:0 Slices:sliceNr Timesteps:tstep]){
+		EDTypedSliceView view;
+		view.data      = EDTypedVolumeSlice(&mNativeVolume, sliceNr, tstep);
+		view.type      = mNativeVolume.type;
+		view.rowStride = mNativeVolume.rowStride;
+		view.token     = [[[EDStorageToken alloc] initWithStorage:mVolumeStorage] autorelease];
+		return view;
+	}
+	EDTypedSliceView noView = {NULL, ED_VOXEL_FLOAT, 0, nil};
+	return noView;
+}
+
 -(float*)getTimeseriesDataAtRow:(uint)row atCol:(uint)col atSlice:(uint)sl fromTimestep:(uint)tstart toTimestep:(uint)tend
 {	
 	if ([self sizeCheckRows:row Cols:col Slices:sl Timesteps:tend] and (tstart < tend) ){
 		uint nrTimesteps = tend-tstart+1;
+		if (NULL != mVolume.data){
+			float* timeseries = (float*) malloc(nrTimesteps * sizeof(float));
+			const float* src = mVolume.data + EDFloatVolumeOffset(&mVolume, col, row, sl, tstart);
+			if (1 == mVolume.timeStride){
+				// time major: one contiguous run
+				memcpy(timeseries, src, nrTimesteps * sizeof(float));
+				return timeseries;
+			}
+			for (uint i = 0; i < nrTimesteps; i++){
+				timeseries[i] = src[i * mVolume.timeStride];}
+			return timeseries;
+		}
+		if (NULL != mNativeVolume.data){
+			float* timeseries = (float*) malloc(nrTimesteps * sizeof(float));
+			EDTypedToFloat(EDTypedVoxelAt(mNativeVolume.data, mNativeVolume.type, EDTypedVolumeOffset(&mNativeVolume, col, row, sl, tstart)),
+						   mNativeVolume.type, mNativeVolume.timeStride, nrTimesteps, timeseries);
+			return timeseries;
+		}
 		isis::data::MemChunkNonDel<float> chTimeSeries(nrTimesteps, 1);
 		for (uint i = tstart; i < tend+1; i++){
 			chTimeSeries.voxel<float>(i-tstart,0) = mIsisImage->getChunk(0,0,sl,i, false).voxel<float>(col, row);}
@@ -465,6 +721,19 @@
 
 -(float*)getRowDataAt:(uint)row atSlice:(uint)sl atTimestep:(uint)tstep
 {	
+    if ([self sizeCheckRows:row Cols:0 Slices:sl Timesteps:tstep] and NULL != mVolume.data){
+		float* rowData = (float*) malloc(mVolume.columns * sizeof(float));
+		const float* src = mVolume.data + EDFloatVolumeOffset(&mVolume, 0, row, sl, tstep);
+		for (size_t i = 0; i < mVolume.columns; i++){
+			rowData[i] = src[i * mVolume.colStride];}
+		return rowData;
+	}
+	if ([self sizeCheckRows:row Cols:0 Slices:sl Timesteps:tstep] and NULL != mNativeVolume.data){
+		float* rowData = (float*) malloc(mNativeVolume.columns * sizeof(float));
+		EDTypedToFloat(EDTypedVoxelAt(mNativeVolume.data, mNativeVolume.type, EDTypedVolumeOffset(&mNativeVolume, 0, row, sl, tstep)),
+					   mNativeVolume.type, mNativeVolume.colStride, mNativeVolume.columns, rowData);
+		return rowData;
+	}
     if ([self sizeCheckRows:row Cols:1 Slices:sl Timesteps:tstep] ){
 		isis::data::MemChunkNonDel<float> rowChunk(mImageSize.columns, 1);
 		isis::data::Chunk sliceCh = mIsisImage->getChunk(0,0,sl,tstep, false);
@@ -477,6 +746,19 @@
 
 -(float*)getColDataAt:(uint)col atSlice:(uint)sl atTimestep:(uint)tstep
 {	
+	if ([self sizeCheckRows:0 Cols:col Slices:sl Timesteps:tstep] and NULL != mVolume.data){
+		float* colData = (float*) malloc(mVolume.rows * sizeof(float));
+		const float* src = mVolume.data + EDFloatVolumeOffset(&mVolume, col, 0, sl, tstep);
+		for (size_t i = 0; i < mVolume.rows; i++){
+			colData[i] = src[i * mVolume.rowStride];}
+		return colData;
+	}
+	if ([self sizeCheckRows:0 Cols:col Slices:sl Timesteps:tstep] and NULL != mNativeVolume.data){
+		float* colData = (float*) malloc(mNativeVolume.rows * sizeof(float));
+		EDTypedToFloat(EDTypedVoxelAt(mNativeVolume.data, mNativeVolume.type, EDTypedVolumeOffset(&mNativeVolume, col, 0, sl, tstep)),
+					   mNativeVolume.type, mNativeVolume.rowStride, mNativeVolume.rows, colData);
+		return colData;
+	}
 	if ([self sizeCheckRows:1 Cols:col Slices:sl Timesteps:tstep] ){
 		isis::data::MemChunkNonDel<float> colChunk(mImageSize.rows, 1);
 		isis::data::Chunk sliceCh = mIsisImage->getChunk(0,0,sl,tstep, false);
@@ -489,11 +771,34 @@
 
 -(void)setRowAt:(uint)row atSlice:(uint)sl	atTimestep:(uint)tstep withData:(float*)data
 {	
+    if ([self sizeCheckRows:row Cols:0 Slices:sl Timesteps:tstep] and NULL != mVolume.data){
+		float* dst = mVolume.data + EDFloatVolumeOffset(&mVolume, 0, row, sl, tstep);
+		float* oldData = (float*) malloc(mVolume.columns * sizeof(float));
+		for (size_t i = 0; i < mVolume.columns; i++){
+			oldData[i] = dst[i * mVolume.colStride];
+			dst[i * mVolume.colStride] = data[i];
+		}
+		[self updateStatisticsWithValues:data replacing:oldData count:mVolume.columns atTimestep:tstep];
+		free(oldData);
+		return;
+	}
+	if ([self sizeCheckRows:row Cols:0 Slices:sl Timesteps:tstep] and NULL != mNativeVolume.data){
+		void* dst = (void*) EDTypedVoxelAt(mNativeVolume.data, mNativeVolume.type, EDTypedVolumeOffset(&mNativeVolume, 0, row, sl, tstep));
+		float* values = (float*) malloc(2 * mNativeVolume.columns * sizeof(float));
+		EDTypedToFloat(dst, mNativeVolume.type, mNativeVolume.colStride, mNativeVolume.columns, values);
+		EDTypedFromFloat(data, mNativeVolume.columns, dst, mNativeVolume.type, mNativeVolume.colStride);
+		// the values as stored (rounded to the native type)
+		EDTypedToFloat(dst, mNativeVolume.type, mNativeVolume.colStride, mNativeVolume.columns, values + mNativeVolume.columns);
+		[self updateStatisticsWithValues:values + mNativeVolume.columns replacing:values count:mNativeVolume.columns atTimestep:tstep];
+		free(values);
+		return;
+	}
     if ([self sizeCheckRows:row Cols:1 Slices:sl Timesteps:tstep] ){
 		isis::data::MemChunk<float> dataToCopy(data, mImageSize.columns);
 		isis::data::Chunk sliceCh = mIsisImage->getChunk(0,0,sl,tstep, false);
 		for (uint i = 0; i < mImageSize.columns; i++){
 			sliceCh.voxel<float>(i, row, 0, 0) = dataToCopy.voxel<float>(i, 0);}
+		[self invalidateStatisticsOfTimestep:tstep];
 	}
 	return;
 	
@@ -501,11 +806,34 @@
 
 -(void)setColAt:(uint)col atSlice:(uint)sl atTimestep:(uint)tstep withData:(float*)data
 {	
+	if ([self sizeCheckRows:0 Cols:col Slices:sl Timesteps:tstep] and NULL != mVolume.data){
+		float* dst = mVolume.data + EDFloatVolumeOffset(&mVolume, col, 0, sl, tstep);
+		float* oldData = (float*) malloc(mVolume.rows * sizeof(float));
+		for (size_t i = 0; i < mVolume.rows; i++){
+			oldData[i] = dst[i * mVolume.rowStride];
+			dst[i * mVolume.rowStride] = data[i];
+		}
+		[self updateStatisticsWithValues:data replacing:oldData count:mVolume.rows atTimestep:tstep];
+		free(oldData);
+		return;
+	}
+	if ([self sizeCheckRows:0 Cols:col Slices:sl Timesteps:tstep] and NULL != mNativeVolume.data){
+		void* dst = (void*) EDTypedVoxelAt(mNativeVolume.data, mNativeVolume.type, EDTypedVolumeOffset(&mNativeVolume, col, 0, sl, tstep));
+		float* values = (float*) malloc(2 * mNativeVolume.rows * sizeof(float));
+		EDTypedToFloat(dst, mNativeVolume.type, mNativeVolume.rowStride, mNativeVolume.rows, values);
+		EDTypedFromFloat(data, mNativeVolume.rows, dst, mNativeVolume.type, mNativeVolume.rowStride);
+		// the values as stored (rounded to the native type)
+		EDTypedToFloat(dst, mNativeVolume.type, mNativeVolume.rowStride, mNativeVolume.rows, values + mNativeVolume.rows);
+		[self updateStatisticsWithValues:values + mNativeVolume.rows replacing:values count:mNativeVolume.rows atTimestep:tstep];
+		free(values);
+		return;
+	}
 	if ([self sizeCheckRows:1 Cols:col Slices:sl Timesteps:tstep] ){
 		isis::data::MemChunk<float> dataToCopy(data, mImageSize.rows);
 		isis::data::Chunk sliceCh = mIsisImage->getChunk(0,0,sl,tstep, false);
 		for (uint i = 0; i < mImageSize.rows; i++){
 			sliceCh.voxel<float>(col, i, 0, 0) = dataToCopy.voxel<float>(i, 0);}
+		[self invalidateStatisticsOfTimestep:tstep];
 	}
 	return;
 }
@@ -727,13 +1055,6 @@
 	
 }
 
--(NSArray*)getMinMaxOfDataElement
-{
-    std::pair<float, float> minMax = mIsisImage->getMinMaxAs<float>();
-    NSArray *ret = [NSArray arrayWithObjects:[NSNumber numberWithFloat:minMax.first], [NSNumber numberWithFloat:minMax.second], nil];
-    return ret;
-}
-
 //-(ITKImage::Pointer)asITKImage
 //{
 //    if (self->mITKAdapter != NULL)  {
@@ -801,6 +1122,204 @@
 //    return nil;
 //}
 
+-(BOOL)setupVolumeStoreFrom:(isis::data::Image)src
+{
+	// splice the whatever build image to a slice-chunked one (each 2D is a single chunk)
+	src.spliceDownTo(isis::data::sliceDim);
+	
+	size_t cols   = src.getNrOfColumns();
+	size_t rows   = src.getNrOfRows();
+	size_t slices = src.getNrOfSlices();
+	size_t tsteps = src.getNrOfTimesteps();
+	size_t sliceSize = cols * rows;
+	
+	void* buffer = NULL;
+	if (0 != posix_memalign(&buffer, ED_VOLUME_ALIGNMENT, sliceSize * slices * tsteps * sizeof(float))){
+		NSLog(@"Could not allocate the volume store - keeping the isis chunks");
+		if (NULL == mIsisImage){
+			mIsisImage = new isis::data::Image(src);}
+		return NO;
+	}
+	mVolumeStorage = boost::shared_ptr<void>(buffer, free);
+	EDFloatVolumeInitSliceMajor(&mVolume, static_cast<float*>(buffer), cols, rows, slices, tsteps);
+	
+	std::list<isis::data::Chunk> chList;
+	for (size_t ts = 0; ts < tsteps; ts++){
+		for (size_t sl = 0; sl < slices; sl++){
+			isis::data::Chunk srcCh = src.getChunk(0, 0, sl, ts, true);
+			float* dst = EDFloatVolumeSlice(&mVolume, sl, ts);
+			if (isis::data::ValueArray<float>::staticID == srcCh.getTypeID()){
+				memcpy(dst, ((boost::shared_ptr<float>) srcCh.getValueArray<float>()).get(), sliceSize * sizeof(float));}
+			else {
+				isis::data::MemChunk<float> floatCh(srcCh);
+				memcpy(dst, ((boost::shared_ptr<float>) floatCh.getValueArray<float>()).get(), sliceSize * sizeof(float));
+			}
+			
+			isis::data::Chunk ch(dst, EDVolumeStoreReference(mVolumeStorage), cols, rows);
+			ch.join(srcCh);
+			chList.push_back(ch);
+		}
+	}
+	
+	isis::data::Image* storeImage = new isis::data::Image(chList);
+	if (NULL != mIsisImage){
+		delete mIsisImage;}
+	mIsisImage = storeImage;
+	mNativeVolume.data = NULL;
+	mLayout = LAYOUT_SLICE_MAJOR;
+	mChunkProps.clear();
+	return YES;
+}
+
+-(BOOL)setupNativeStoreFrom:(isis::data::Image)src
+{
+	enum EDVoxelType type;
+	switch (src.getMajorTypeID()){
+		case isis::data::ValueArray<int16_t>::staticID:
+			type = ED_VOXEL_INT16;
+			break;
+		case isis::data::ValueArray<u_int16_t>::staticID:
+			type = ED_VOXEL_UINT16;
+			break;
+		case isis::data::ValueArray<u_int8_t>::staticID:
+			type = ED_VOXEL_UINT8;
+			break;
+		case isis::data::ValueArray<int8_t>::staticID:
+			type = ED_VOXEL_INT8;
+			break;
+		default:
+			// nothing to gain (or no exact representation) - float it is
+			return NO;
+	}
+	
+	src.spliceDownTo(isis::data::sliceDim);
+	size_t cols   = src.getNrOfColumns();
+	size_t rows   = src.getNrOfRows();
+	size_t slices = src.getNrOfSlices();
+	size_t tsteps = src.getNrOfTimesteps();
+	
+	void* buffer = NULL;
+	if (0 != posix_memalign(&buffer, ED_VOLUME_ALIGNMENT, cols * rows * slices * tsteps * EDVoxelTypeSize(type))){
+		NSLog(@"Could not allocate the native volume store - converting to float");
+		return NO;
+	}
+	boost::shared_ptr<void> storage(buffer, free);
+	EDTypedVolume store;
+	EDTypedVolumeInitSliceMajor(&store, buffer, type, cols, rows, slices, tsteps);
+	
+	std::list<isis::data::Chunk> chList;
+	switch (type){
+		case ED_VOXEL_INT16:
+			chList = nativeChunksOf<int16_t>(src, &store, storage);
+			break;
+		case ED_VOXEL_UINT16:
+			chList = nativeChunksOf<u_int16_t>(src, &store, storage);
+			break;
+		case ED_VOXEL_UINT8:
+			chList = nativeChunksOf<u_int8_t>(src, &store, storage);
+			break;
+		default:
+			chList = nativeChunksOf<int8_t>(src, &store, storage);
+			break;
+	}
+	
+	isis::data::Image* storeImage = new isis::data::Image(chList);
+	if (NULL != mIsisImage){
+		delete mIsisImage;}
+	mIsisImage = storeImage;
+	mVolumeStorage = storage;
+	mVolume.data = NULL;
+	mNativeVolume = store;
+	mLayout = LAYOUT_SLICE_MAJOR;
+	mChunkProps.clear();
+	return YES;
+}
+
+-(enum VolumeLayout)getVolumeLayout
+{
+	return mLayout;
+}
+
+-(BOOL)setVolumeLayout:(enum VolumeLayout)layout
+{
+	if (layout == mLayout){
+		return YES;}
+	if (IMAGE_FCTDATA != mImageType or NULL == mVolume.data){
+		return NO;}
+	
+	if (LAYOUT_SLICE_MAJOR == layout){
+		// back to slice chunks aliasing a fresh store
+		return [self setupVolumeStoreFrom:[self sliceMajorImage]];
+	}
+	
+	size_t cols   = mVolume.columns;
+	size_t rows   = mVolume.rows;
+	size_t slices = mVolume.slices;
+	size_t tsteps = mVolume.timesteps;
+	void* buffer = NULL;
+	if (0 != posix_memalign(&buffer, ED_VOLUME_ALIGNMENT, cols * rows * slices * tsteps * sizeof(float))){
+		NSLog(@"Could not allocate the time major volume store - keeping the slice major one");
+		return NO;
+	}
+	boost::shared_ptr<float> storage(static_cast<float*>(buffer), free);
+	EDFloatVolume timeMajor;
+	EDFloatVolumeInitTimeMajor(&timeMajor, storage.get(), cols, rows, slices, tsteps);
+	
+	// transpose, slices in parallel
+	EDVolumeCopyJob job = {&mVolume, &timeMajor};
+	dispatch_apply_f(slices, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), &job, copyVolumeSlice);
+	
+	// the chunks alias the old store - keep their properties and a copy of the first volume only
+	std::vector<isis::util::PropertyMap> chunkProps(slices * tsteps);
+	std::list<isis::data::Chunk> chList;
+	for (size_t ts = 0; ts < tsteps; ts++){
+		for (size_t sl = 0; sl < slices; sl++){
+			isis::data::Chunk ch = mIsisImage->getChunk(0, 0, sl, ts, true);
+			chunkProps[ts * slices + sl] = static_cast<isis::util::PropertyMap&>(ch);
+			if (0 == ts){
+				chList.push_back(isis::data::MemChunk<float>(ch));}
+		}
+	}
+	isis::data::Image* firstVolume = new isis::data::Image(chList);
+	delete mIsisImage;
+	mIsisImage = firstVolume;
+	
+	mChunkProps.swap(chunkProps);
+	mVolumeStorage = storage;
+	mVolume = timeMajor;
+	mLayout = LAYOUT_TIME_MAJOR;
+	return YES;
+}
+
+-(isis::data::Chunk)chunkOfSlice:(size_t)sl atTimestep:(size_t)tstep
+{
+	if (LAYOUT_TIME_MAJOR != mLayout){
+		return mIsisImage->getChunk(0, 0, sl, tstep, true);}
+	
+	isis::data::MemChunk<float> ch(mVolume.columns, mVolume.rows);
+	float* dst = ((boost::shared_ptr<float>) ch.getValueArray<float>()).get();
+	const float* src = EDFloatVolumeSlice(&mVolume, sl, tstep);
+	for (size_t r = 0; r < mVolume.rows; r++){
+		for (size_t c = 0; c < mVolume.columns; c++){
+			dst[r * mVolume.columns + c] = src[r * mVolume.rowStride + c * mVolume.colStride];}}
+	// current image properties first (setImageProperty: goes there), join doesn't overwrite
+	ch.join(static_cast<isis::util::PropertyMap&>(*mIsisImage));
+	ch.join(mChunkProps[tstep * mVolume.slices + sl]);
+	return ch;
+}
+
+-(isis::data::Image)sliceMajorImage
+{
+	if (LAYOUT_TIME_MAJOR != mLayout){
+		return *mIsisImage;}
+	
+	std::list<isis::data::Chunk> chList;
+	for (size_t ts = 0; ts < mVolume.timesteps; ts++){
+		for (size_t sl = 0; sl < mVolume.slices; sl++){
+			chList.push_back([self chunkOfSlice:sl atTimestep:ts]);}}
+	return isis::data::Image(chList);
+}
+
 -(enum ImageOrientation)getMainOrientation
 {
     switch (mIsisImage->getMainOrientation()){
@@ -0,0 +1,46 @@
+//
+//  EDDataElementIsisMapped.h
+//  BARTApplication
+//
+
+#ifndef EDDATAELEMENTISISMAPPED_H
+#define EDDATAELEMENTISISMAPPED_H
+
+#import <Cocoa/Cocoa.h>
+#import "EDDataElementIsis.h"
+#include "EDNifti.h"
+#include <pthread.h>
+
+/*
+ * Lazily loaded element for uncompressed NIfTI-1 files (.nii): the file is memory mapped
+ * and each slice chunk is converted into the float store on its first access.
+ * Opening costs the header only, memory is spent on the slices actually used -
+ * there is no full typed copy next to the float one.
+ *
+ * Every accessor of EDDataElementIsis works unchanged, they convert what they touch first.
+ * Accessors handing out the whole store (getFloatVolume:, writing, layout changes)
+ * convert everything, getFloatVolume:atTimestep: the volume asked for.
+ * Min/max of a timestep not touched yet is taken from the raw file values.
+ */
+@interface EDDataElementIsisMapped : EDDataElementIsis {
+    // the mapped file - unmapped as soon as all slices are converted
+    const unsigned char* mMapping;
+    size_t mMappingLength;
+    EDNiftiHeader mHeader;
+
+    // state per slice chunk (index timestep * slices + slice): not converted, converting, converted
+    unsigned char* mSliceState;
+    size_t mConvertedCount;
+    pthread_mutex_t mLoadLock;
+    pthread_cond_t mLoadDone;
+}
+
+/*
+ * Maps the file at path. Returns nil if it is no uncompressed NIfTI-1 single file in
+ * native byte order with a datatype we can convert (load it with initWithFile:... then).
+ */
+-(id)initWithMappedFile:(NSString*)path ofImageType:(enum ImageType)iType;
+
+@end
+
+#endif // EDDATAELEMENTISISMAPPED_H
@@ -0,0 +1,345 @@
+//
+//  EDDataElementIsisMapped.mm
+//  BARTApplication
+//
+
+#import "EDDataElementIsisMapped.h"
+#import "EDStorageToken.h"
+
+// C includes
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cmath>
+
+#include <dispatch/dispatch.h>
+
+enum {
+	SLICE_NOT_CONVERTED = 0,
+	SLICE_CONVERTING    = 1,
+	SLICE_CONVERTED     = 2
+};
+
+
+@interface EDDataElementIsisMapped (PrivateMethods)
+
+/*
+ * Converts slice chunk sl of timestep tstep into the store unless that happened already.
+ * Safe to call from several threads, different slices are converted in parallel.
+ */
+-(void)loadSlice:(size_t)sl atTimestep:(size_t)tstep;
+
+-(void)loadTimestep:(size_t)tstep;
+
+-(void)loadAll;
+
+@end
+
+
+/*
+ * Parallel conversion, one slice chunk per job.
+ */
+static void loadSliceChunk(void* context, size_t i)
+{
+	EDDataElementIsisMapped* element = static_cast<EDDataElementIsisMapped*>(context);
+	size_t slices = [[element getImageSize] slices];
+	[element loadSlice:i % slices atTimestep:i / slices];
+}
+
+static uint isisTypeIDOf(int niftiType)
+{
+	switch (niftiType) {
+		case ED_NIFTI_UINT8:
+			return isis::data::ValueArray<u_int8_t>::staticID;
+		case ED_NIFTI_INT8:
+			return isis::data::ValueArray<int8_t>::staticID;
+		case ED_NIFTI_INT16:
+			return isis::data::ValueArray<int16_t>::staticID;
+		case ED_NIFTI_UINT16:
+			return isis::data::ValueArray<u_int16_t>::staticID;
+		case ED_NIFTI_INT32:
+			return isis::data::ValueArray<int32_t>::staticID;
+		case ED_NIFTI_UINT32:
+			return isis::data::ValueArray<u_int32_t>::staticID;
+		case ED_NIFTI_FLOAT64:
+			return isis::data::ValueArray<double>::staticID;
+		default:
+			return isis::data::ValueArray<float>::staticID;
+	}
+}
+
+/*
+ * Column c of the NIfTI index to scanner matrix in isis (DICOM, LPS) coordinates.
+ */
+static isis::util::fvector3 scannerColumn(const EDNiftiHeader& hdr, int c)
+{
+	return isis::util::fvector3(-hdr.indexToScanner[0][c], -hdr.indexToScanner[1][c], hdr.indexToScanner[2][c]);
+}
+
+
+@implementation EDDataElementIsisMapped
+
+-(id)initWithMappedFile:(NSString*)path ofImageType:(enum ImageType)iType
+{
+	if (!(self = [self init])){
+		return nil;}
+	pthread_mutex_init(&mLoadLock, NULL);
+	pthread_cond_init(&mLoadDone, NULL);
+
+	int fd = open([path fileSystemRepresentation], O_RDONLY);
+	if (fd < 0){
+		[self release];
+		return nil;
+	}
+	struct stat fileInfo;
+	void* mapping = MAP_FAILED;
+	if (0 == fstat(fd, &fileInfo) and 0 < fileInfo.st_size){
+		mapping = mmap(NULL, (size_t) fileInfo.st_size, PROT_READ, MAP_SHARED, fd, 0);}
+	close(fd);
+	if (MAP_FAILED == mapping){
+		[self release];
+		return nil;
+	}
+	mMapping = static_cast<const unsigned char*>(mapping);
+	mMappingLength = (size_t) fileInfo.st_size;
+
+	if (not EDNiftiReadHeader(mMapping, mMappingLength, &mHeader)){
+		// compressed, foreign byte order, odd datatype... - that's isis' job
+		[self release];
+		return nil;
+	}
+
+	size_t cols   = mHeader.columns;
+	size_t rows   = mHeader.rows;
+	size_t slices = mHeader.slices;
+	size_t tsteps = mHeader.timesteps;
+
+	// the store is only touched slice by slice on conversion, untouched pages cost no memory
+	void* buffer = NULL;
+	mSliceState = static_cast<unsigned char*>(calloc(slices * tsteps, sizeof(unsigned char)));
+	if (NULL == mSliceState or 0 != posix_memalign(&buffer, ED_VOLUME_ALIGNMENT, cols * rows * slices * tsteps * sizeof(float))){
+		NSLog(@"Could not allocate the volume store of a mapped file");
+		[self release];
+		return nil;
+	}
+	mVolumeStorage = boost::shared_ptr<void>(buffer, free);
+	EDFloatVolumeInitSliceMajor(&mVolume, static_cast<float*>(buffer), cols, rows, slices, tsteps);
+
+	// geometry from the header, chunks alias the (still empty) store
+	isis::util::fvector3 voxelSize;
+	isis::util::fvector3 dirs[3];
+	for (int i = 0; i < 3; i++){
+		dirs[i] = scannerColumn(mHeader, i);
+		float len = std::sqrt(dirs[i][0] * dirs[i][0] + dirs[i][1] * dirs[i][1] + dirs[i][2] * dirs[i][2]);
+		if (0.0f < len){
+			voxelSize[i] = len;
+			dirs[i] = isis::util::fvector3(dirs[i][0] / len, dirs[i][1] / len, dirs[i][2] / len);
+		}
+		else {
+			voxelSize[i] = mHeader.voxelSize[i];
+			dirs[i] = isis::util::fvector3(0 == i, 1 == i, 2 == i);
+		}
+	}
+	isis::util::fvector3 origin = scannerColumn(mHeader, 3);
+	isis::util::fvector3 sliceStep = scannerColumn(mHeader, 2);
+
+	std::list<isis::data::Chunk> chList;
+	for (size_t ts = 0; ts < tsteps; ts++){
+		for (size_t sl = 0; sl < slices; sl++){
+			isis::data::Chunk ch(EDFloatVolumeSlice(&mVolume, sl, ts), EDVolumeStoreReference(mVolumeStorage), cols, rows);
+			ch.setPropertyAs<isis::util::fvector3>("indexOrigin", isis::util::fvector3(origin[0] + sl * sliceStep[0],
+																					   origin[1] + sl * sliceStep[1],
+																					   origin[2] + sl * sliceStep[2]));
+			ch.setPropertyAs<u_int32_t>("acquisitionNumber", sl+ts*slices);
+			ch.setPropertyAs<u_int16_t>("sequenceNumber", 1);
+			ch.setPropertyAs<isis::util::fvector3>("voxelSize", voxelSize);
+			ch.setPropertyAs<isis::util::fvector3>("rowVec", dirs[0]);
+			ch.setPropertyAs<isis::util::fvector3>("columnVec", dirs[1]);
+			ch.setPropertyAs<isis::util::fvector3>("sliceVec", dirs[2]);
+			if (0.0f < mHeader.repetitionTime){
+				ch.setPropertyAs<u_int16_t>("repetitionTime", (u_int16_t) mHeader.repetitionTime);}
+			chList.push_back(ch);
+		}
+	}
+	mIsisImage = new isis::data::Image(chList);
+
+	mImageType = iType;
+	mDataTypeID = isisTypeIDOf(mHeader.datatype);
+	mImageSize = [[BARTImageSize alloc] initWithRows:rows andCols:cols andSlices:slices andTimesteps:tsteps];
+	mRepetitionTimeInMs = (size_t) mHeader.repetitionTime;
+
+	return self;
+}
+
+-(void)dealloc
+{
+	if (NULL != mMapping){
+		munmap(const_cast<unsigned char*>(mMapping), mMappingLength);}
+	free(mSliceState);
+	pthread_cond_destroy(&mLoadDone);
+	pthread_mutex_destroy(&mLoadLock);
+	[super dealloc];
+}
+
+-(void)loadSlice:(size_t)sl atTimestep:(size_t)tstep
+{
+	if (sl >= mHeader.slices or tstep >= mHeader.timesteps){
+		return;}
+	size_t i = tstep * mHeader.slices + sl;
+	if (SLICE_CONVERTED == __atomic_load_n(&mSliceState[i], __ATOMIC_ACQUIRE)){
+		return;}
+
+	pthread_mutex_lock(&mLoadLock);
+	while (SLICE_CONVERTING == mSliceState[i]){
+		pthread_cond_wait(&mLoadDone, &mLoadLock);}
+	if (SLICE_NOT_CONVERTED == mSliceState[i]){
+		mSliceState[i] = SLICE_CONVERTING;
+		pthread_mutex_unlock(&mLoadLock);
+
+		// the chunks of a NIfTI file are in the same order as ours
+		size_t sliceSize = mHeader.columns * mHeader.rows;
+		EDNiftiConvert(mMapping + mHeader.voxOffset + i * sliceSize * mHeader.bytesPerVoxel, mHeader.datatype,
+					   sliceSize, mHeader.slope, mHeader.inter, EDFloatVolumeSlice(&mVolume, sl, tstep));
+
+		pthread_mutex_lock(&mLoadLock);
+		__atomic_store_n(&mSliceState[i], (unsigned char) SLICE_CONVERTED, __ATOMIC_RELEASE);
+		mConvertedCount++;
+		if (mConvertedCount == mHeader.slices * mHeader.timesteps){
+			// everything is in the store now
+			munmap(const_cast<unsigned char*>(mMapping), mMappingLength);
+			mMapping = NULL;
+		}
+		pthread_cond_broadcast(&mLoadDone);
+	}
+	pthread_mutex_unlock(&mLoadLock);
+}
+
+-(void)loadTimestep:(size_t)tstep
+{
+	for (size_t sl = 0; sl < mHeader.slices; sl++){
+		[self loadSlice:sl atTimestep:tstep];}
+}
+
+-(void)loadAll
+{
+	if (NULL == mMapping){
+		return;}
+	dispatch_apply_f(mHeader.slices * mHeader.timesteps, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), self, loadSliceChunk);
+}
+
+-(BOOL)computeMinMaxOfTimestep:(size_t)tstep min:(float*)min max:(float*)max
+{
+	if (tstep >= mHeader.timesteps){
+		return NO;}
+	BOOL fromFile = NO;
+	pthread_mutex_lock(&mLoadLock);
+	if (NULL != mMapping){
+		// raw values are only valid as long as nothing of the timestep went to the store (and maybe got changed there)
+		fromFile = YES;
+		for (size_t sl = 0; fromFile and sl < mHeader.slices; sl++){
+			fromFile = (SLICE_NOT_CONVERTED == mSliceState[tstep * mHeader.slices + sl]);}
+	}
+	if (fromFile){
+		size_t volumeSize = mHeader.columns * mHeader.rows * mHeader.slices;
+		EDNiftiMinMax(mMapping + mHeader.voxOffset + tstep * volumeSize * mHeader.bytesPerVoxel, mHeader.datatype,
+					  volumeSize, mHeader.slope, mHeader.inter, min, max);
+	}
+	pthread_mutex_unlock(&mLoadLock);
+	return fromFile;
+}
+
+-(float)getFloatVoxelValueAtRow: (NSUInteger)r col:(NSUInteger)c slice:(NSUInteger)s timestep:(NSUInteger)t
+{
+	[self loadSlice:s atTimestep:t];
+	return [super getFloatVoxelValueAtRow:r col:c slice:s timestep:t];
+}
+
+-(void)setVoxelValue:(NSNumber*)val atRow: (NSUInteger)r col:(NSUInteger)c slice:(NSUInteger)sl timestep:(NSUInteger)t
+{
+	[self loadSlice:sl atTimestep:t];
+	[super setVoxelValue:val atRow:r col:c slice:sl timestep:t];
+}
+
+-(BOOL)getFloatVolume:(EDFloatVolume*)volume
+{
+	[self loadAll];
+	return [super getFloatVolume:volume];
+}
+
+-(BOOL)getFloatVolume:(EDFloatVolume*)volume atTimestep:(uint)tstep
+{
+	[self loadTimestep:tstep];
+	return [super getFloatVolume:volume atTimestep:tstep];
+}
+
+-(BOOL)WriteDataElementToFile:(NSString*)path withOverwritingSuffix:(NSString*)suffix andDialect:(NSString*)dialect
+{
+	[self loadAll];
+	return [super WriteDataElementToFile:path withOverwritingSuffix:suffix andDialect:dialect];
+}
+
+-(EDDataElement*)getDataAtTimeStep:(size_t)tstep
+{
+	[self loadTimestep:tstep];
+	return [super getDataAtTimeStep:tstep];
+}
+
+-(float*)getSliceData:(uint)sliceNr atTimestep:(uint)tstep
+{
+	[self loadSlice:sliceNr atTimestep:tstep];
+	return [super getSliceData:sliceNr atTimestep:tstep];
+}
+
+-(EDSliceView)getSliceView:(uint)sliceNr atTimestep:(uint)tstep
+{
+	[self loadSlice:sliceNr atTimestep:tstep];
+	return [super getSliceView:sliceNr atTimestep:tstep];
+}
+
+-(float*)getTimeseriesDataAtRow:(uint)row atCol:(uint)col atSlice:(uint)sl fromTimestep:(uint)tstart toTimestep:(uint)tend
+{
+	for (uint t = tstart; t <= tend and t < mHeader.timesteps; t++){
+		[self loadSlice:sl atTimestep:t];}
+	return [super getTimeseriesDataAtRow:row atCol:col atSlice:sl fromTimestep:tstart toTimestep:tend];
+}
+
+-(float*)getRowDataAt:(uint)row atSlice:(uint)sl atTimestep:(uint)tstep
+{
+	[self loadSlice:sl atTimestep:tstep];
+	return [super getRowDataAt:row atSlice:sl atTimestep:tstep];
+}
+
+-(void)setRowAt:(uint)row atSlice:(uint)sl atTimestep:(uint)tstep withData:(float*)data
+{
+	[self loadSlice:sl atTimestep:tstep];
+	[super setRowAt:row atSlice:sl atTimestep:tstep withData:data];
+}
+
+-(float*)getColDataAt:(uint)col atSlice:(uint)sl atTimestep:(uint)tstep
+{
+	[self loadSlice:sl atTimestep:tstep];
+	return [super getColDataAt:col atSlice:sl atTimestep:tstep];
+}
+
+-(void)setColAt:(uint)col atSlice:(uint)sl atTimestep:(uint)tstep withData:(float*)data
+{
+	[self loadSlice:sl atTimestep:tstep];
+	[super setColAt:col atSlice:sl atTimestep:tstep withData:data];
+}
+
+-(BOOL)setVolumeLayout:(enum VolumeLayout)layout
+{
+	// the conversion reads the whole store
+	if (layout != mLayout){
+		[self loadAll];}
+	return [super setVolumeLayout:layout];
+}
+
+-(void)appendVolume:(EDDataElementIsis*)nextVolume
+{
+	[self loadAll];
+	[super appendVolume:nextVolume];
+}
+
+@end
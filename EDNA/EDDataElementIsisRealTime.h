@@ -8,18 +8,68 @@
 
 #import <Cocoa/Cocoa.h>
 #import "EDDataElement.h"
+#import "EDDataElementWriter.h"
 #import "DataStorage/image.hpp"
-#include <map.h>
-#include "EDIsisImage.h"
+#include <vector>
+#include <pthread.h>
 
 @interface EDDataElementIsisRealTime : EDDataElement {
-	//isis::data::Image mIsisImage;
-	map<size_t, std::vector<boost::shared_ptr<isis::data::Chunk> > > mAllDataMap;
-	EDIsisImage *mIsisImage;
-    //size_t mRepetitionNumber;
+	// one contiguous float volume per slot - allocated once, never copied or moved on append
+	std::vector<boost::shared_ptr<float> > mVolumeSlots;
+	// chunk properties of each slice of the volume held in a slot (needed for writing)
+	std::vector<std::vector<isis::util::PropertyMap> > mSliceProps;
 	isis::util::PropertyMap mPropMapImage;
+	size_t mMaxTimesteps;
+	BOOL mIsRingBuffer;
+	size_t mFirstSlot;
+	size_t mAppendedVolumes;
+	// ring buffer: slot the next volume is filled into before it replaces the oldest one
+	boost::shared_ptr<float> mSpareSlot;
+	// guards mVolumeSlots, mSliceProps, mFirstSlot and publishing mImageSize.timesteps -
+	// volumes are appended on the pipeline thread while views read them
+	pthread_mutex_t mSlotLock;
+	// stream every appended volume goes to (nil if not streaming)
+	EDDataElementWriter* mStreamWriter;
+	NSString* mStreamPath;
 }
 
+/*
+ * Limits the store to maxTimesteps volumes (0 means unbounded, the default).
+ * If ring is YES the store works as sliding window: when full, the oldest volume is
+ * overwritten, so timestep 0 is always the oldest volume still held. Otherwise
+ * volumes arriving after the store is full are dropped.
+ * The ring buffer keeps one spare volume: a new volume is filled in there and then
+ * replaces the oldest one, whose memory becomes the next spare unless somebody still
+ * holds a token on it (slice views, getFloatVolume:atTimestep:token:, chunks being written).
+ * Call this before the first volume is appended.
+ */
+-(void)setMaxTimesteps:(size_t)maxTimesteps asRingBuffer:(BOOL)ring;
+
+/*
+ * Appends all timesteps of img. Costs one copy of the new volume, earlier volumes are not touched.
+ */
 -(void)appendVolume:(isis::data::Image)img;
 
+/*
+ * Number of volumes appended so far - in ring buffer mode this differs from the
+ * number of timesteps held as soon as the window starts to slide.
+ */
+-(size_t)getNrOfAppendedVolumes;
+
+/*
+ * From now on each appended volume is also written to the .nii file at path, by writer in the
+ * background: the file is created with the first volume, every following one is appended
+ * (constant cost per volume, no copy - see EDDataElementWriter). The header always matches
+ * the volumes written so far, a run that stops unexpectedly leaves a valid file.
+ * In ring buffer mode the file gets all volumes, not only the ones still held.
+ * Volumes appended before are not written.
+ */
+-(void)startStreamingToFile:(NSString*)path withWriter:(EDDataElementWriter*)writer;
+
+/*
+ * Closes the stream (handler may be nil, see EDDataElementWriter#closeStream:completion:).
+ * Does nothing (handler not called) if the element is not streaming.
+ */
+-(void)stopStreamingWithCompletion:(EDWriteCompletionHandler)handler;
+
 @end
@@ -8,109 +8,169 @@
 
 #import "EDDataElementIsisRealTime.h"
 #import "EDDataElementIsis.h"
+#import "EDStorageToken.h"
 #import "DataStorage/io_factory.hpp"
 #import <algorithm>
 #include <vector>
 #include <iostream>
+#include <stdlib.h>
 
 
 @interface EDDataElementIsisRealTime (PrivateMethods)
 
 -(BOOL)sizeCheckRows:(uint)r Cols:(uint)c Slices:(uint)s Timesteps:(uint)t;
 
+-(void)storeVolume:(isis::data::Image&)img atTimestep:(size_t)ts;
+
+-(size_t)slotOfTimestep:(size_t)tstep;
+
+/*
+ * Reference on the slot holding tstep (empty if out of range) - taken under the slot lock, so
+ * the slot can neither be recycled by the ring buffer nor move while the caller holds it.
+ * vol (may be NULL) is set to the volume.
+ */
+-(boost::shared_ptr<float>)slotAtTimestep:(size_t)tstep volume:(EDFloatVolume*)vol;
+
+-(isis::data::Chunk)chunkOfSlice:(size_t)sl atTimestep:(size_t)tstep;
+
 @end
 
+/*
+ * One aligned buffer for a single volume of the store, empty pointer if out of memory.
+ */
+static boost::shared_ptr<float> allocateVolumeSlot(size_t nrVoxels)
+{
+	void* buffer = NULL;
+	if (0 != posix_memalign(&buffer, ED_VOLUME_ALIGNMENT, nrVoxels * sizeof(float))){
+		return boost::shared_ptr<float>();}
+	return boost::shared_ptr<float>(static_cast<float*>(buffer), free);
+}
+
 @implementation EDDataElementIsisRealTime
 
 
+-(id)init
+{
+	if (self = [super init]) {
+		mImagePropertiesMap = nil;
+		mMaxTimesteps = 0;
+		mIsRingBuffer = NO;
+		mFirstSlot = 0;
+		mAppendedVolumes = 0;
+		mStreamWriter = nil;
+		mStreamPath = nil;
+		pthread_mutex_init(&mSlotLock, NULL);
+	}
+	return self;
+}
 
 -(id)initWithFile:(NSString*)path andSuffix:(NSString*)suffix andDialect:(NSString*)dialect ofImageType:(enum ImageType)iType
 {
-	self = [super init];
-    //mRepetitionNumber = 0;
-	mImagePropertiesMap = nil;
+	self = [self init];
+	mImageSize = [[BARTImageSize alloc] init];
 	//set the type of the image
 	mImageType = iType;
 		
 	// the most important thing - load with isis factory
 	std::list<isis::data::Image> images = isis::data::IOFactory::load( [path cStringUsingEncoding:NSUTF8StringEncoding], [suffix cStringUsingEncoding:NSUTF8StringEncoding], [dialect cStringUsingEncoding:NSUTF8StringEncoding]);
-	
+	if (images.empty()){
+		NSLog(@"Could not load %@", path);
+		return self;
+	}
 	// that's unusual - take the first one, warn the user
     if (1 < images.size()) {
         NSLog(@"hmmm, several pics in one image");
 	}
-	// make a real copy including conversion to float
-	isis::data::MemImage<float> memImg = images.front();
-	
-	//get the type of the orig image
-	mDataTypeID = memImg.getChunkAt(0).getTypeID();
-	
 	
-	// give this copy to our class element
-    isis::data::Image anImage = memImg; 
-	//splice the whatever build image to a slice-chunked one (each 2D is a single chunk - easier access later on)
-    anImage.spliceDownTo(isis::data::sliceDim);
-	// get our class params from the image itself
-	mImageSize.rows = anImage.getNrOfRows(); // getDimSize(isis::data::colDim)
-    mImageSize.columns = anImage.getNrOfColumns();
-    mImageSize.slices = anImage.getNrOfSlices();
-    mImageSize.timesteps = anImage.getNrOfTimesteps();
-    mRepetitionTimeInMs = anImage.getPropertyAs<u_int16_t>("repetitionTime");
+	// each timestep goes into its own slot, just as if it was received volume by volume
+	[self appendVolume:images.front()];
+    mRepetitionTimeInMs = mPropMapImage.getPropertyAs<u_int16_t>("repetitionTime");
 	
 	return self;
 }
 
 -(id)initEmptyWithSize:(BARTImageSize*) imageSize ofImageType:(enum ImageType)iType
 {
-    self = [super init];
-    //mRepetitionNumber = 0;
-	//mAllDataMap.clear();
+    self = [self init];
 	mImageType = iType;
 	mImageSize = [imageSize copy];
-    mIsisImage = nil;
 	return self;
 	
 }
 
 -(void)dealloc
 {
-    if (nil != mIsisImage){
-        delete mIsisImage;}
-
-    [mImageSize release];
+	[self stopStreamingWithCompletion:nil];
+	mVolumeSlots.clear();
+	mSliceProps.clear();
+	mSpareSlot.reset();
+	pthread_mutex_destroy(&mSlotLock);
 	
     [super dealloc];
 }
 
+-(void)setMaxTimesteps:(size_t)maxTimesteps asRingBuffer:(BOOL)ring
+{
+	if (0 != mAppendedVolumes){
+		NSLog(@"Realtime store already in use - capacity not changed");
+		return;
+	}
+	mMaxTimesteps = maxTimesteps;
+	mIsRingBuffer = (0 != maxTimesteps) ? ring : NO;
+	if (0 != maxTimesteps){
+		pthread_mutex_lock(&mSlotLock);
+		mVolumeSlots.reserve(maxTimesteps);
+		mSliceProps.reserve(maxTimesteps);
+		pthread_mutex_unlock(&mSlotLock);
+	}
+}
+
+-(size_t)getNrOfAppendedVolumes
+{
+	return mAppendedVolumes;
+}
+
+-(void)startStreamingToFile:(NSString*)path withWriter:(EDDataElementWriter*)writer
+{
+	[self stopStreamingWithCompletion:nil];
+	mStreamWriter = [writer retain];
+	mStreamPath = [path copy];
+}
+
+-(void)stopStreamingWithCompletion:(EDWriteCompletionHandler)handler
+{
+	if (nil == mStreamWriter){
+		return;}
+	[mStreamWriter closeStream:mStreamPath completion:handler];
+	[mStreamWriter release];
+	[mStreamPath release];
+	mStreamWriter = nil;
+	mStreamPath = nil;
+}
+
 -(short)getShortVoxelValueAtRow: (int)r col:(int)c slice:(int)sl timestep:(int)t
 {
-   // std::vector<boost::shared_ptr<isis::data::Chunk> > vecSlices = mAllDataMap[t];
-//    boost::shared_ptr<isis::data::Chunk> ptrChunk = vecSlices[sl];
-//    
-	return (short)mIsisImage->voxel<float>(c,r,sl,t);
+	return (short)[self getFloatVoxelValueAtRow:r col:c slice:sl timestep:t];
 }
 
 -(float)getFloatVoxelValueAtRow: (int)r col:(int)c slice:(int)sl timestep:(int)t
 {
-	//std::vector<boost::shared_ptr<isis::data::Chunk> > vecSlices = mAllDataMap[t];
-//    boost::shared_ptr<isis::data::Chunk> ptrChunk = vecSlices[sl];
-//    
-	return (float)mIsisImage->voxel<float>(c,r,sl,t);
-    
+	EDFloatVolume vol;
+	boost::shared_ptr<float> slot = [self slotAtTimestep:t volume:&vol];
+	if (NULL != slot.get() and EDFloatVolumeContains(&vol, c, r, sl, 0)){
+		return EDFloatVolumeGet(&vol, c, r, sl, 0);}
+	return 0.0;
 }
 
 -(void)setVoxelValue:(NSNumber*)val atRow: (NSUInteger)r col:(NSUInteger)c slice:(NSUInteger)sl timestep:(NSUInteger)t
 {
-   // if (mAllDataMap.size() >= t){
-//        std::vector<boost::shared_ptr<isis::data::Chunk> > vecSlices = mAllDataMap[t];
-//        if (vecSlices.size() >= sl){
-//            boost::shared_ptr<isis::data::Chunk> ptrChunk = vecSlices[sl];
-//            if (mImageSize.rows >= r && mImageSize.columns >= c) {
-                mIsisImage->voxel<float>(c,r,sl,t) = [val floatValue];
-//            }
-//        }
-//    }
-    
+	EDFloatVolume vol;
+	boost::shared_ptr<float> slot = [self slotAtTimestep:t volume:&vol];
+	if (NULL != slot.get() and EDFloatVolumeContains(&vol, c, r, sl, 0)){
+		float oldValue = EDFloatVolumeGet(&vol, c, r, sl, 0);
+		EDFloatVolumeSet(&vol, c, r, sl, 0, [val floatValue]);
+		[self updateStatisticsWithValue:[val floatValue] replacing:oldValue atTimestep:t];
+	}
 }
 
 
@@ -122,35 +182,17 @@
 
 -(BOOL)WriteDataElementToFile:(NSString*)path withOverwritingSuffix:(NSString*)suffix andDialect:(NSString*)dialect
 {
-    //std::map<size_t, std::vector<boost::shared_ptr<isis::data::Chunk> > >::iterator itMap;
-//    std::vector<boost::shared_ptr<isis::data::Chunk> >::iterator itVector;
-//    std::list<isis::data::Chunk> chunkList;
-//    for (itMap = mAllDataMap.begin(); itMap != mAllDataMap.end() ; itMap++) {
-//        for (itVector=(*itMap).second.begin(); itVector != (*itMap).second.end(); itVector++) {
-//            
-//			//TODO: INCLUDE THIS WHEN PROBLEM WITH ACQ NR IS CLEAR
-//			//(*itVector)->join(mPropMapImage);
-//			//std::cout << mPropMapImage.print(std::cout) << std::endl;
-//			//isis::util::PropertyMap propsOfChunk = isis::util::PropertyMap(**itVector);
-//			//std::cout << propsOfChunk.print(std::cout) << std::endl;
-//			chunkList.push_back(*(*itVector));
-//        }
-//        
-//    }
-	
-	mIsisImage->prepareToWrite();
-	std::list<isis::data::Chunk> chList;
-	std::vector<isis::data::Chunk> chVector = mIsisImage->copyChunksToVector();
-	std::vector<isis::data::Chunk> ::iterator itVector;
-	for (itVector = chVector.begin(); itVector != chVector.end(); itVector++) {
-		//(**itVector).join(*mIsisImage);
-		chList.push_back(*itVector);
+	if (0 == mImageSize.timesteps){
+		NSLog(@"Nothing to write - no volume received so far");
+		return NO;
 	}
-	//std::copy(chVector.begin(), chVector.end(), chList.end())
-    NSLog(@"ChunkList size: %lu", chList.size());
+	// the chunks alias the store, nothing is copied until the image is written
+	std::list<isis::data::Chunk> chList;
+	for (size_t ts = 0; ts < mImageSize.timesteps; ts++){
+		for (size_t sl = 0; sl < mImageSize.slices; sl++){
+			chList.push_back([self chunkOfSlice:sl atTimestep:ts]);}}
+	
     isis::data::Image img(chList);
-    NSLog(@"ChunkList size: %lu", chList.size());
-   	
 	return isis::data::IOFactory::write(img, [path cStringUsingEncoding:NSUTF8StringEncoding], 
                                  [suffix cStringUsingEncoding:NSUTF8StringEncoding], 
                                  [dialect cStringUsingEncoding:NSUTF8StringEncoding]);
@@ -176,7 +218,7 @@
 //	
 	switch (key) {
         case PROPID_NAME:
-			ret = [[[NSString alloc ] initWithCString:(mIsisImage->getPropertyAs<std::string>("GLM/name")).c_str() encoding:NSUTF8StringEncoding] autorelease];
+			ret = [[[NSString alloc ] initWithCString:(mPropMapImage.getPropertyAs<std::string>("GLM/name")).c_str() encoding:NSUTF8StringEncoding] autorelease];
 			break;
         case PROPID_MODALITY:
             
@@ -185,7 +227,7 @@
         case PROPID_DF:
             break;
         case PROPID_PATIENT:
-			ret = [[[NSString alloc ] initWithCString:(mIsisImage->getPropertyAs<std::string>("subjectName")).c_str() encoding:NSUTF8StringEncoding] autorelease];
+			ret = [[[NSString alloc ] initWithCString:(mPropMapImage.getPropertyAs<std::string>("subjectName")).c_str() encoding:NSUTF8StringEncoding] autorelease];
 			break;
         case PROPID_VOXEL:
             break;
@@ -204,22 +246,22 @@
         case PROPID_BETA:
             break;
 		case PROPID_READVEC:
-			ret = [[[NSArray alloc] initWithObjects:[NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("rowVec")[0]], [NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("rowVec")[1]], [NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("rowVec")[2]], nil ] autorelease];
+			ret = [[[NSArray alloc] initWithObjects:[NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("rowVec")[0]], [NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("rowVec")[1]], [NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("rowVec")[2]], nil ] autorelease];
 			break;
 		case PROPID_PHASEVEC:
-			ret = [[[NSArray alloc] initWithObjects:[NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("columnVec")[0]], [NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("columnVec")[1]], [NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("columnVec")[2]], nil ] autorelease];
+			ret = [[[NSArray alloc] initWithObjects:[NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("columnVec")[0]], [NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("columnVec")[1]], [NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("columnVec")[2]], nil ] autorelease];
 			break;
 		case PROPID_SLICEVEC:
-			ret = [[[NSArray alloc] initWithObjects:[NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("sliceVec")[0]], [NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("sliceVec")[1]], [NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("sliceVec")[2]], nil ] autorelease];
+			ret = [[[NSArray alloc] initWithObjects:[NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("sliceVec")[0]], [NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("sliceVec")[1]], [NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("sliceVec")[2]], nil ] autorelease];
 			break;
 		case PROPID_SEQNR:
 			ret = [NSNumber numberWithUnsignedShort:1];
 			break;
 		case PROPID_VOXELSIZE:
-			ret = [[[NSArray alloc] initWithObjects:[NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("voxelSize")[0]], [NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("voxelSize")[1]], [NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("voxelSize")[2]], nil ] autorelease];
+			ret = [[[NSArray alloc] initWithObjects:[NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("voxelSize")[0]], [NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("voxelSize")[1]], [NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("voxelSize")[2]], nil ] autorelease];
 			break;
 		case PROPID_ORIGIN:
-			ret = [[[NSArray alloc] initWithObjects:[NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("indexOrigin")[0]], [NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("indexOrigin")[1]], [NSNumber numberWithFloat:mIsisImage->getPropertyAs<isis::util::fvector3>("indexOrigin")[2]], nil ] autorelease];
+			ret = [[[NSArray alloc] initWithObjects:[NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("indexOrigin")[0]], [NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("indexOrigin")[1]], [NSNumber numberWithFloat:mPropMapImage.getPropertyAs<isis::util::fvector3>("indexOrigin")[2]], nil ] autorelease];
 			break;
         default:
             break;
@@ -236,37 +278,129 @@
 
 -(float*)getSliceData:(uint)sliceNr atTimestep:(uint)tstep
 {
-    if ([self sizeCheckRows:1 Cols:1 Slices:sliceNr Timesteps:tstep]){
-		isis::data::MemChunkNonDel<float> chSlice(mImageSize.columns, mImageSize.rows);
-		mIsisImage->getChunk(0,0, sliceNr, tstep, false).copySlice(0, 0, chSlice, 0, 0);
-		return (( boost::shared_ptr<float> ) chSlice.getValueArray<float>()).get();
+	EDSliceView view = [self getSliceView:sliceNr atTimestep:tstep];
+	if (NULL == view.data){
+		return NULL;}
+	float* sliceData = (float*) malloc(mImageSize.columns * mImageSize.rows * sizeof(float));
+	memcpy(sliceData, view.data, mImageSize.columns * mImageSize.rows * sizeof(float));
+	return sliceData;
+}
+
+-(EDSliceView)getSliceView:(uint)sliceNr atTimestep:(uint)tstep
+{
+	EDSliceView view = {NULL, 0, nil};
+	boost::shared_ptr<float> slot = [self slotAtTimestep:tstep volume:NULL];
+	if (NULL != slot.get() and sliceNr < mImageSize.slices){
+		// the token keeps the slot alive (and out of the ring buffer's reach) even if the window moves on meanwhile
+		view.data      = slot.get() + sliceNr * mImageSize.columns * mImageSize.rows;
+		view.rowStride = mImageSize.columns;
+		view.token     = [[[EDStorageToken alloc] initWithStorage:slot] autorelease];
 	}
-	return NULL;	
+	return view;
+}
+
+-(BOOL)getFloatVolume:(EDFloatVolume*)volume
+{
+	// volumes are kept in slots of their own, there's no contiguous 4D store
+	return NO;
+}
+
+-(BOOL)getFloatVolume:(EDFloatVolume*)volume atTimestep:(uint)tstep
+{
+	// the ring buffer recycles the memory of the oldest volume - without a token
+	// on the slot the volume could be overwritten while it is read
+	if (NULL == volume or YES == mIsRingBuffer){
+		return NO;}
+	EDFloatVolume vol;
+	boost::shared_ptr<float> slot = [self slotAtTimestep:tstep volume:&vol];
+	if (NULL == slot.get()){
+		return NO;}
+	*volume = vol;
+	return YES;
+}
+
+-(BOOL)getFloatVolume:(EDFloatVolume*)volume atTimestep:(uint)tstep token:(id*)token
+{
+	if (NULL == volume or NULL == token){
+		return NO;}
+	EDFloatVolume vol;
+	boost::shared_ptr<float> slot = [self slotAtTimestep:tstep volume:&vol];
+	if (NULL == slot.get()){
+		return NO;}
+	*token = [[[EDStorageToken alloc] initWithStorage:slot] autorelease];
+	*volume = vol;
+	return YES;
 }
 
 -(float*)getRowDataAt:(uint)row atSlice:(uint)sl atTimestep:(uint)tstep
 {
-	return nil;
+	EDFloatVolume vol;
+	boost::shared_ptr<float> slot = [self slotAtTimestep:tstep volume:&vol];
+	if (NULL != slot.get() and EDFloatVolumeContains(&vol, 0, row, sl, 0)){
+		float* rowData = (float*) malloc(vol.columns * sizeof(float));
+		memcpy(rowData, vol.data + EDFloatVolumeOffset(&vol, 0, row, sl, 0), vol.columns * sizeof(float));
+		return rowData;
+	}
+	return NULL;
 }
 
 -(void)setRowAt:(uint)row atSlice:(uint)sl	atTimestep:(uint)tstep withData:(float*)data
 {
-	
+	EDFloatVolume vol;
+	boost::shared_ptr<float> slot = [self slotAtTimestep:tstep volume:&vol];
+	if (NULL != slot.get() and EDFloatVolumeContains(&vol, 0, row, sl, 0)){
+		float* dst = vol.data + EDFloatVolumeOffset(&vol, 0, row, sl, 0);
+		float* oldData = (float*) malloc(vol.columns * sizeof(float));
+		memcpy(oldData, dst, vol.columns * sizeof(float));
+		memcpy(dst, data, vol.columns * sizeof(float));
+		[self updateStatisticsWithValues:data replacing:oldData count:vol.columns atTimestep:tstep];
+		free(oldData);
+	}
 }
 
--(float*)getColDataAt:(uint)row atSlice:(uint)sl atTimestep:(uint)tstep
+-(float*)getColDataAt:(uint)col atSlice:(uint)sl atTimestep:(uint)tstep
 {
-	return nil;
+	EDFloatVolume vol;
+	boost::shared_ptr<float> slot = [self slotAtTimestep:tstep volume:&vol];
+	if (NULL != slot.get() and EDFloatVolumeContains(&vol, col, 0, sl, 0)){
+		float* colData = (float*) malloc(vol.rows * sizeof(float));
+		const float* src = vol.data + EDFloatVolumeOffset(&vol, col, 0, sl, 0);
+		for (size_t i = 0; i < vol.rows; i++){
+			colData[i] = src[i * vol.rowStride];}
+		return colData;
+	}
+	return NULL;
 }
 
 -(void)setColAt:(uint)col atSlice:(uint)sl atTimestep:(uint)tstep withData:(float*)data
 {
-	
+	EDFloatVolume vol;
+	boost::shared_ptr<float> slot = [self slotAtTimestep:tstep volume:&vol];
+	if (NULL != slot.get() and EDFloatVolumeContains(&vol, col, 0, sl, 0)){
+		float* dst = vol.data + EDFloatVolumeOffset(&vol, col, 0, sl, 0);
+		float* oldData = (float*) malloc(vol.rows * sizeof(float));
+		for (size_t i = 0; i < vol.rows; i++){
+			oldData[i] = dst[i * vol.rowStride];
+			dst[i * vol.rowStride] = data[i];
+		}
+		[self updateStatisticsWithValues:data replacing:oldData count:vol.rows atTimestep:tstep];
+		free(oldData);
+	}
 }
 
 -(float*)getTimeseriesDataAtRow:(uint)row atCol:(uint)col atSlice:(uint)sl fromTimestep:(uint)tstart toTimestep:(uint)tend
 {
-	return nil;
+	if ([self sizeCheckRows:row Cols:col Slices:sl Timesteps:tend] and (tstart < tend) ){
+		uint nrTimesteps = tend-tstart+1;
+		size_t offset = (sl * mImageSize.rows + row) * mImageSize.columns + col;
+		float* timeseries = (float*) malloc(nrTimesteps * sizeof(float));
+		pthread_mutex_lock(&mSlotLock);
+		for (uint i = 0; i < nrTimesteps; i++){
+			timeseries[i] = mVolumeSlots[[self slotOfTimestep:tstart+i]].get()[offset];}
+		pthread_mutex_unlock(&mSlotLock);
+		return timeseries;
+	}
+	return NULL;
 }
 
 -(void)print
@@ -297,13 +431,13 @@
 			or [[str lowercaseString] isEqualToString:@"voxelsize"]
 			or [[str lowercaseString] isEqualToString:@"voxelgap"])
 		{
-			isis::util::fvector3 prop = mIsisImage->getPropertyAs<isis::util::fvector3>([str  cStringUsingEncoding:NSISOLatin1StringEncoding]);
+			isis::util::fvector3 prop = mPropMapImage.getPropertyAs<isis::util::fvector3>([str  cStringUsingEncoding:NSISOLatin1StringEncoding]);
 			NSArray* ret = [[[NSArray alloc] initWithObjects:[NSNumber numberWithFloat:prop[0]], [NSNumber numberWithFloat:prop[1]], [NSNumber numberWithFloat:prop[2]], nil ] autorelease];
 			[propValues addObject:ret];
 		}
 		else if( [[str lowercaseString] isEqualToString:@"acquisitionnumber"]) //type is u_int32_t
 		{
-			u_int32_t prop = mIsisImage->getPropertyAs<u_int32_t>([str  cStringUsingEncoding:NSISOLatin1StringEncoding]);
+			u_int32_t prop = mPropMapImage.getPropertyAs<u_int32_t>([str  cStringUsingEncoding:NSISOLatin1StringEncoding]);
 			NSNumber* ret = [NSNumber numberWithUnsignedLong:prop];
 			[propValues addObject:ret];
 		}
@@ -314,22 +448,22 @@
 				 or   [[str lowercaseString] isEqualToString:@"flipangle"]
 				 or   [[str lowercaseString] isEqualToString:@"numberofaverages"] )
 		{
-			u_int16_t prop = mIsisImage->getPropertyAs<u_int16_t>([str  cStringUsingEncoding:NSISOLatin1StringEncoding ]);
+			u_int16_t prop = mPropMapImage.getPropertyAs<u_int16_t>([str  cStringUsingEncoding:NSISOLatin1StringEncoding ]);
 			NSNumber* ret = [NSNumber numberWithUnsignedInt:prop];
 			[propValues addObject:ret];
 		}
 		else if ( [[str lowercaseString] isEqualToString:@"echotime"]	 // type is float
 				 or   [[str lowercaseString] isEqualToString:@"acquisitiontime"] )
 		{
-			float prop = mIsisImage->getPropertyAs<float>([str  cStringUsingEncoding:NSISOLatin1StringEncoding]);
+			float prop = mPropMapImage.getPropertyAs<float>([str  cStringUsingEncoding:NSISOLatin1StringEncoding]);
 			NSNumber* ret = [NSNumber numberWithFloat:prop];
 			[propValues addObject:ret];
 		}
 		else									// everything else is interpreted as string (conversion by isis)
 		{
 			std::string prop = "";
-			if (mIsisImage->hasProperty([str cStringUsingEncoding:NSISOLatin1StringEncoding])){
-				prop = mIsisImage->getPropertyAs<std::string>([str  cStringUsingEncoding:NSISOLatin1StringEncoding]);}
+			if (mPropMapImage.hasProperty([str cStringUsingEncoding:NSISOLatin1StringEncoding])){
+				prop = mPropMapImage.getPropertyAs<std::string>([str  cStringUsingEncoding:NSISOLatin1StringEncoding]);}
 			NSString* ret = [NSString stringWithCString:prop.c_str() encoding:NSISOLatin1StringEncoding];
 			[propValues addObject:ret];
 		}
@@ -358,14 +492,14 @@
 			if (YES == [[propDict valueForKey:str] isKindOfClass:[NSArray class]]){
 				for (NSUInteger i = 0; i < [[propDict valueForKey:str] count]; i++){
 					prop[i] = [[[propDict valueForKey:str] objectAtIndex:i] floatValue];}
-				mIsisImage->setPropertyAs<isis::util::fvector3>([str cStringUsingEncoding:NSISOLatin1StringEncoding], prop);
+				mPropMapImage.setPropertyAs<isis::util::fvector3>([str cStringUsingEncoding:NSISOLatin1StringEncoding], prop);
 			}
 		}
 		else if( [[str lowercaseString] isEqualToString:@"acquisitionnumber"]) //type is u_int32_t
 		{
 			if (YES == [[propDict valueForKey:str] isKindOfClass:[NSNumber class]]){
 				u_int32_t prop = [[propDict valueForKey:str] unsignedLongValue];
-				mIsisImage->setPropertyAs<u_int32_t>([str  cStringUsingEncoding:NSISOLatin1StringEncoding], prop);}
+				mPropMapImage.setPropertyAs<u_int32_t>([str  cStringUsingEncoding:NSISOLatin1StringEncoding], prop);}
 		}
 		else if ( [[str lowercaseString] isEqualToString:@"repetitiontime"] // type is u_int16_t
 				 or   [[str lowercaseString] isEqualToString:@"sequencenumber"]
@@ -376,21 +510,21 @@
 		{
 			if (YES == [[propDict valueForKey:str] isKindOfClass:[NSNumber class]]){
 				u_int16_t prop = [[propDict valueForKey:str] unsignedIntValue];
-				mIsisImage->setPropertyAs<u_int16_t>([str  cStringUsingEncoding:NSISOLatin1StringEncoding], prop);}
+				mPropMapImage.setPropertyAs<u_int16_t>([str  cStringUsingEncoding:NSISOLatin1StringEncoding], prop);}
 		}
 		else if ( [[str lowercaseString] isEqualToString:@"echotime"]  // type is float
 				 or   [[str lowercaseString] isEqualToString:@"acquisitiontime"] )
 		{
 			if (YES == [[propDict valueForKey:str] isKindOfClass:[NSNumber class]]){
 				float prop = [[propDict valueForKey:str] floatValue];
-				mIsisImage->setPropertyAs<float>([str  cStringUsingEncoding:NSISOLatin1StringEncoding], prop);}
+				mPropMapImage.setPropertyAs<float>([str  cStringUsingEncoding:NSISOLatin1StringEncoding], prop);}
 		}
 		else									// everything else is interpreted as string (conversion by isis)
  		{
 			if (YES == [[propDict valueForKey:str] isKindOfClass:[NSString class]]){
 				std::string prop = [[propDict valueForKey:str]  cStringUsingEncoding:NSISOLatin1StringEncoding];
 				NSLog(@"%s", prop.c_str());
-				mIsisImage->setPropertyAs<std::string>([str  cStringUsingEncoding:NSISOLatin1StringEncoding], prop.c_str());}
+				mPropMapImage.setPropertyAs<std::string>([str  cStringUsingEncoding:NSISOLatin1StringEncoding], prop.c_str());}
 		}
 	} 
 	
@@ -399,35 +533,36 @@
 
 -(void)appendVolume:(isis::data::Image)img
 {
-    if (nil == mIsisImage)
+	if (0 == img.getNrOfTimesteps()){
+		return;}
+	// one chunk per 2D slice, so each slice can be copied (and converted) in one go
+	img.spliceDownTo(isis::data::sliceDim);
+	
+    if (0 == mAppendedVolumes)
     {
+		// the first volume defines the geometry of the whole store
         mImageSize.rows = img.getNrOfRows();
         mImageSize.columns = img.getNrOfColumns();
         mImageSize.slices = img.getNrOfSlices();
-        mImageSize.timesteps = 1;
+        mImageSize.timesteps = 0;
 		mDataTypeID = img.getMajorTypeID();
-		mIsisImage = new EDIsisImage(img);
-    }
-    else {
-        if ((mImageSize.rows == img.getNrOfRows())
-            && (mImageSize.columns == img.getNrOfColumns())
-            && (mImageSize.slices == img.getNrOfSlices()))
-        {
-            mImageSize.timesteps += 1;
-            mIsisImage->appendVolume(img);
-            
-        }
-        else {
-            NSLog(@"Size of appended Volume does not match all other volumes");
-            return;
-        }
+		mPropMapImage = static_cast<isis::util::PropertyMap&>(img);
     }
-
+    else if ((mImageSize.rows != img.getNrOfRows())
+			 or (mImageSize.columns != img.getNrOfColumns())
+			 or (mImageSize.slices != img.getNrOfSlices()))
+	{
+		NSLog(@"Size of appended Volume does not match all other volumes");
+		return;
+	}
+	
+	for (size_t ts = 0; ts < img.getNrOfTimesteps(); ts++){
+		[self storeVolume:img atTimestep:ts];}
 }
 
 -(BOOL)isEmpty
 {
-	return mIsisImage->isEmpty();
+	return (0 == mImageSize.timesteps);
 }
 
 -(BOOL)sizeCheckRows:(uint)r Cols:(uint)c Slices:(uint)s Timesteps:(uint)t
@@ -441,37 +576,113 @@
     
 }
 
+-(void)storeVolume:(isis::data::Image&)img atTimestep:(size_t)ts
+{
+	size_t sliceSize = mImageSize.columns * mImageSize.rows;
+	BOOL isFull = (0 != mMaxTimesteps and mImageSize.timesteps >= mMaxTimesteps);
+	if (isFull and NO == mIsRingBuffer){
+		NSLog(@"Realtime store is full (%lu volumes) - dropping volume", mMaxTimesteps);
+		return;
+	}
+	
+	// the volume goes into a slot nobody can see yet, it is published (timestep count last) when complete
+	boost::shared_ptr<float> slot;
+	if (isFull){
+		slot.swap(mSpareSlot);}
+	if (NULL == slot.get()){
+		slot = allocateVolumeSlot(sliceSize * mImageSize.slices);}
+	if (NULL == slot.get()){
+		NSLog(@"Could not allocate a realtime volume - dropping volume");
+		return;
+	}
+	
+	std::vector<isis::util::PropertyMap> sliceProps(mImageSize.slices);
+	float* dst = slot.get();
+	for (size_t sl = 0; sl < mImageSize.slices; sl++){
+		isis::data::Chunk srcCh = img.getChunk(0, 0, sl, ts, true);
+		if (isis::data::ValueArray<float>::staticID == srcCh.getTypeID()){
+			memcpy(dst + sl * sliceSize, ((boost::shared_ptr<float>) srcCh.getValueArray<float>()).get(), sliceSize * sizeof(float));}
+		else {
+			isis::data::MemChunk<float> floatCh(srcCh);
+			memcpy(dst + sl * sliceSize, ((boost::shared_ptr<float>) floatCh.getValueArray<float>()).get(), sliceSize * sizeof(float));
+		}
+		sliceProps[sl] = static_cast<isis::util::PropertyMap&>(srcCh);
+	}
+	
+	pthread_mutex_lock(&mSlotLock);
+	if (isFull){
+		// the new volume takes the place of the oldest one, the window moves on by one
+		boost::shared_ptr<float> oldest = mVolumeSlots[mFirstSlot];
+		mVolumeSlots[mFirstSlot] = slot;
+		mSliceProps[mFirstSlot].swap(sliceProps);
+		mFirstSlot = (mFirstSlot + 1) % mVolumeSlots.size();
+		pthread_mutex_unlock(&mSlotLock);
+		// out of the store now - reused for the next volume unless somebody still looks at it
+		// (tokens of views and volumes, chunks being written)
+		if (oldest.unique()){
+			mSpareSlot = oldest;}
+		[self removeStatisticsOfFirstTimestep];
+	}
+	else {
+		mVolumeSlots.push_back(slot);
+		mSliceProps.push_back(sliceProps);
+		mImageSize.timesteps += 1;
+		pthread_mutex_unlock(&mSlotLock);
+	}
+	mAppendedVolumes++;
+	[self updateStatisticsOfAppendedTimestep:mImageSize.timesteps - 1];
+	if (nil != mStreamWriter){
+		// the newest volume is the last timestep, in ring buffer mode as well
+		[mStreamWriter appendTimestep:mImageSize.timesteps - 1 ofDataElement:self toStream:mStreamPath];}
+}
+
+-(size_t)slotOfTimestep:(size_t)tstep
+{
+	return (mFirstSlot + tstep) % mVolumeSlots.size();
+}
+
+-(boost::shared_ptr<float>)slotAtTimestep:(size_t)tstep volume:(EDFloatVolume*)vol
+{
+	boost::shared_ptr<float> slot;
+	pthread_mutex_lock(&mSlotLock);
+	if (tstep < mImageSize.timesteps){
+		slot = mVolumeSlots[[self slotOfTimestep:tstep]];}
+	pthread_mutex_unlock(&mSlotLock);
+	if (NULL != vol and NULL != slot.get()){
+		EDFloatVolumeInitSliceMajor(vol, slot.get(), mImageSize.columns, mImageSize.rows, mImageSize.slices, 1);}
+	return slot;
+}
+
+-(isis::data::Chunk)chunkOfSlice:(size_t)sl atTimestep:(size_t)tstep
+{
+	pthread_mutex_lock(&mSlotLock);
+	size_t slot = [self slotOfTimestep:tstep];
+	boost::shared_ptr<float> storage = mVolumeSlots[slot];
+	isis::util::PropertyMap props = mSliceProps[slot][sl];
+	pthread_mutex_unlock(&mSlotLock);
+	
+	float* sliceData = storage.get() + sl * mImageSize.columns * mImageSize.rows;
+	isis::data::Chunk ch(sliceData, EDVolumeStoreReference(storage), mImageSize.columns, mImageSize.rows);
+	ch.join(props);
+	return ch;
+}
 
 
 //MH FIXME: added, Important: this returns a EDDataElementIsis!!!!
 -(EDDataElement*)getDataAtTimeStep:(size_t)tstep
 {
-    std::list<isis::data::Chunk> chList;
-    BARTImageSize *s = [[BARTImageSize alloc] initWithRows:mImageSize.rows andCols:mImageSize.columns andSlices:mImageSize.slices andTimesteps:1];
-    
     EDDataElementIsis* retElement = nil;
-    if ([self sizeCheckRows:1 Cols:1 Slices:1 Timesteps:tstep]){
+    if ([self sizeCheckRows:0 Cols:0 Slices:0 Timesteps:tstep]){
+		std::list<isis::data::Chunk> chList;
         for (size_t i = 0; i < mImageSize.slices; i++){
-            chList.push_back(mIsisImage->getChunk(0,0,i,tstep));
+            chList.push_back([self chunkOfSlice:i atTimestep:tstep]);
         }
         
         isis::data::Image retImg(chList);
         retElement = [[[EDDataElementIsis alloc] initFromImage:retImg ofImageType:IMAGE_FCTDATA] autorelease];
     }
     
-    [s release];
     return retElement;
 }
 
-
-
-
--(NSArray*)getMinMaxOfDataElement
-{
-
-    std::pair<float, float> minMax = mIsisImage->getMinMaxAs<float>();
-    NSArray *ret = [NSArray arrayWithObjects:[NSNumber numberWithFloat:minMax.first], [NSNumber numberWithFloat:minMax.second], nil];
-    return ret;
-}
-
 @end
@@ -11,15 +11,72 @@
 #import "Cocoa/Cocoa.h"
 
 #import "EDDataElementIsisRealTime.h"
+#import "EDRealTimeSource.h"
+#include "EDRealTimeQueue.h"
+#include "EDStageCounters.h"
 
-@interface EDDataElementRealTimeLoader : NSObject  
+@class EDDataElementWriter;
+
+/*
+ * A volume travelling through the pipeline. image == NULL marks the end of the stream.
+ */
+struct EDRealTimeItem {
+	isis::data::Image *image;
+	uint64_t receivedAt;
+	uint64_t enqueuedAt;
+	BOOL isOfInterest;
+	EDRealTimeItem() : image(NULL), receivedAt(0), enqueuedAt(0), isOfInterest(NO) {}
+};
+
+enum EDRealTimeStage {
+	STAGE_RECEIVE,
+	STAGE_CLASSIFY,
+	STAGE_APPEND,
+	STAGE_COUNT
+};
+
+@interface EDDataElementRealTimeLoader : NSObject
 {
 	EDDataElementIsisRealTime *mDataElementInterest;
 	EDDataElementIsisRealTime *mDataElementRest;
+	// writes the results off the pipeline threads
+	EDDataElementWriter *mWriter;
 	NSMutableArray *arrayLoadedDataElements;
-	
+
+	id<EDRealTimeSource> mSource;
+	// receive -> decode/classify -> append, each stage on a thread of its own
+	EDRealTimeQueue<EDRealTimeItem> *mReceivedQueue;
+	EDRealTimeQueue<EDRealTimeItem> *mClassifiedQueue;
+	dispatch_semaphore_t mPipelineDone;
+	// guarded by mStageLock (EDStageRecord & co.)
+	EDStageCounters mStageCounters[STAGE_COUNT];
+	pthread_mutex_t mStageLock;
 }
 
+/*
+ * Reads from the scanner (tcpip).
+ */
+-(id)init;
+
+/*
+ * Reads from any other source, e.g. EDRealTimeFileReplaySource for offline tests.
+ */
+-(id)initWithSource:(id<EDRealTimeSource>)source;
+
+/*
+ * Runs the receive stage on the calling thread, decode/classify and append run on threads of their own.
+ * Returns when the source is exhausted (or the calling thread was cancelled) and all received volumes are appended.
+ */
 -(void)startRealTimeInputOfImageType;
 
-@end
\ No newline at end of file
+/*
+ * Per stage ("receive", "classify", "append") dictionaries with volume count, mean/max processing time,
+ * mean time waiting in the input queue and time blocked by a full output queue (all in ms).
+ * The append stage additionally reports the latency from reception to append.
+ * Can be called from any thread while the pipeline runs.
+ */
+-(NSDictionary*)getStageStatistics;
+
+-(EDDataElementIsisRealTime*)getDataElementOfInterest;
+
+@end
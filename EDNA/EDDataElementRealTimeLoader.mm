@@ -13,11 +13,21 @@
 #import "EDDataElementIsis.h"
 //#import "BARTNotifications.h"
 #import "EDDataElementRealTimeLoader.h"
+#import "EDDataElementWriter.h"
+
+// number of volumes each queue can buffer - the receive queue is the one absorbing slow appends/writes
+static const size_t RECEIVED_QUEUE_CAPACITY   = 64;
+static const size_t CLASSIFIED_QUEUE_CAPACITY = 16;
+// the volumes not of interest go to disk as they come, memory only keeps a sliding window of the latest ones
+static const size_t REST_WINDOW_TIMESTEPS     = 64;
 
 @interface EDDataElementRealTimeLoader ()
 
--(void)loadNextVolumeOfImageType:(enum ImageType)imgType;
--(BOOL)isImage:(isis::data::Image)img ofImageType:(enum ImageType)imgType;
+-(void)receiveNextVolumes;
+-(void)runClassifyStage;
+-(void)runAppendStage;
+-(void)finishRealTimeInput;
+-(BOOL)isImage:(const isis::data::Image&)img ofImageType:(enum ImageType)imgType;
 @end
 
 
@@ -25,10 +35,24 @@
 
 -(id)init
 {
-	//self = [super init];
-	//arrayLoadedDataElements = [[NSMutableArray alloc] initWithCapacity:1];
-	//[arrayLoadedDataElements autorelease];
-	mDataElementInterest = nil;
+	EDRealTimeTCPIPSource *scanner = [[EDRealTimeTCPIPSource alloc] init];
+	self = [self initWithSource:scanner];
+	[scanner release];
+	return self;
+}
+
+-(id)initWithSource:(id<EDRealTimeSource>)source
+{
+	if (self = [super init]) {
+		mDataElementInterest = nil;
+		mDataElementRest = nil;
+		mSource = [source retain];
+		mWriter = [[EDDataElementWriter alloc] init];
+		mReceivedQueue = NULL;
+		mClassifiedQueue = NULL;
+		memset(mStageCounters, 0, sizeof(mStageCounters));
+		pthread_mutex_init(&mStageLock, NULL);
+	}
 	return self;
 }
 
@@ -36,16 +60,37 @@
 {
 	NSLog(@"startRealTimeInputOfImageType START");
 	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
-	
+	isis::data::enableLog<isis::util::DefaultMsgPrint>( isis::warning );
+
     BARTImageSize *sz = [[BARTImageSize alloc] init];
+	[mDataElementInterest release];
+	[mDataElementRest release];
 	mDataElementInterest = [[EDDataElementIsisRealTime alloc] initEmptyWithSize:sz ofImageType:IMAGE_MOCO];
 	mDataElementRest = [[EDDataElementIsisRealTime alloc] initEmptyWithSize:sz ofImageType:IMAGE_FCTDATA];
     [sz release];
-	
+	[mDataElementRest setMaxTimesteps:REST_WINDOW_TIMESTEPS asRingBuffer:YES];
+	[mDataElementRest startStreamingToFile:@"/tmp/TheNotUsedDataElement.nii" withWriter:mWriter];
+
+	EDStageReset(&mStageLock, mStageCounters, STAGE_COUNT);
+	mReceivedQueue = new EDRealTimeQueue<EDRealTimeItem>(RECEIVED_QUEUE_CAPACITY);
+	mClassifiedQueue = new EDRealTimeQueue<EDRealTimeItem>(CLASSIFIED_QUEUE_CAPACITY);
+	mPipelineDone = dispatch_semaphore_create(0);
+	[NSThread detachNewThreadSelector:@selector(runClassifyStage) toTarget:self withObject:nil];
+	[NSThread detachNewThreadSelector:@selector(runAppendStage) toTarget:self withObject:nil];
+
 	[[NSThread currentThread] setThreadPriority:1.0];
 	while (![[NSThread currentThread] isCancelled]) {
-		[self loadNextVolumeOfImageType:IMAGE_MOCO];
+		[self receiveNextVolumes];
 	}
+
+	// end of stream - wait for the other stages to work off what's queued
+	mReceivedQueue->push(EDRealTimeItem());
+	dispatch_semaphore_wait(mPipelineDone, DISPATCH_TIME_FOREVER);
+	dispatch_release(mPipelineDone);
+	delete mReceivedQueue;
+	delete mClassifiedQueue;
+	mReceivedQueue = NULL;
+	mClassifiedQueue = NULL;
 	NSLog(@"startRealTimeInputOfImageType END");
 
 	[pool drain];
@@ -55,57 +100,150 @@
 {
     [mDataElementInterest release];
     [mDataElementRest release];
+	[mSource release];
+	[mWriter release];
+	pthread_mutex_destroy(&mStageLock);
     [super dealloc];
 }
 
+-(EDDataElementIsisRealTime*)getDataElementOfInterest
+{
+	return mDataElementInterest;
+}
 
--(void)loadNextVolumeOfImageType:(enum ImageType)imgType
+-(NSDictionary*)getStageStatistics
 {
-	isis::data::enableLog<isis::util::DefaultMsgPrint>( isis::warning );
-	
-    NSLog(@"loadNextVolumeOfImageType START");
+	mach_timebase_info_data_t timebase;
+	mach_timebase_info(&timebase);
+	double toMs = (double) timebase.numer / (double) timebase.denom / 1.0e6;
+
+	NSArray *stageNames = [NSArray arrayWithObjects:@"receive", @"classify", @"append", nil];
+	NSMutableDictionary *stats = [NSMutableDictionary dictionaryWithCapacity:STAGE_COUNT];
+	// the stage threads keep counting - take all stages at once
+	EDStageCounters counters[STAGE_COUNT];
+	EDStageSnapshot(&mStageLock, mStageCounters, STAGE_COUNT, counters);
+	for (NSUInteger i = 0; i < STAGE_COUNT; i++){
+		EDStageCounters c = counters[i];
+		double n = (0 < c.volumes) ? (double) c.volumes : 1.0;
+		NSMutableDictionary *stage = [NSMutableDictionary dictionaryWithObjectsAndKeys:
+									  [NSNumber numberWithUnsignedLongLong:c.volumes], @"volumes",
+									  [NSNumber numberWithDouble:c.processingTime * toMs / n], @"meanProcessingMs",
+									  [NSNumber numberWithDouble:c.maxProcessingTime * toMs], @"maxProcessingMs",
+									  [NSNumber numberWithDouble:c.queueTime * toMs / n], @"meanQueueWaitMs",
+									  [NSNumber numberWithDouble:c.blockedTime * toMs], @"blockedMs",
+									  nil];
+		if (STAGE_APPEND == i){
+			[stage setObject:[NSNumber numberWithDouble:c.totalLatency * toMs / n] forKey:@"meanLatencyMs"];
+			[stage setObject:[NSNumber numberWithDouble:c.maxTotalLatency * toMs] forKey:@"maxLatencyMs"];
+		}
+		[stats setObject:stage forKey:[stageNames objectAtIndex:i]];
+	}
+	return stats;
+}
+
+
+-(void)receiveNextVolumes
+{
+	uint64_t start = mach_absolute_time();
+	std::list<isis::data::Image> tempList = [mSource receiveNextImages];
+	uint64_t received = mach_absolute_time();
 
-	std::list<isis::data::Image> tempList = isis::data::IOFactory::load("", ".tcpip", "");
-    
     if (0 == tempList.size() && (YES == [[NSThread currentThread] isExecuting])){
         [[NSThread currentThread] cancel];
         NSLog(@"cancel thread now");
-        if (1 < [mDataElementInterest getImageSize].timesteps){
-//            [[NSNotificationCenter defaultCenter] postNotificationName:BARTScannerSentTerminusNotification object:mDataElementInterest];
-            NSLog(@"Should have sent BARTScannerSentTerminusNotification");
-        }
-        else{
-//            [[NSNotificationCenter defaultCenter] postNotificationName:BARTScannerSentTerminusNotification object:nil];
-            NSLog(@"Should have sent BARTScannerSentTerminusNotification");
-        }
-		
-        //TODO : decide by isEmpty()
-        if (1 < [mDataElementRest getImageSize].timesteps){
-            [mDataElementRest WriteDataElementToFile:@"/tmp/TheNotUsedDataElement.nii"];
-        }
         return;
     }
-	
+
+	// processing time of this stage includes waiting for the scanner
+	EDStageRecord(&mStageLock, &mStageCounters[STAGE_RECEIVE], start, start, received, start);
     std::list<isis::data::Image>::const_iterator it ;
     for (it = tempList.begin(); it != tempList.end(); it++) {
-		if (TRUE == [self isImage:*it ofImageType:imgType]){
-            [mDataElementInterest appendVolume:*it];
+		EDRealTimeItem item;
+		item.image = new isis::data::Image(*it);
+		item.receivedAt = received;
+		item.enqueuedAt = mach_absolute_time();
+		mReceivedQueue->push(item);
+    }
+	EDStageSetBlockedTime(&mStageLock, &mStageCounters[STAGE_RECEIVE], mReceivedQueue->blockedTime());
+}
+
+-(void)runClassifyStage
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	BOOL endOfStream = NO;
+	while (NO == endOfStream) {
+		EDRealTimeItem item = mReceivedQueue->pop();
+		endOfStream = (NULL == item.image);
+		if (NO == endOfStream){
+			uint64_t start = mach_absolute_time();
+			// decode to float here, so appending is nothing but a copy
+			if (isis::data::ValueArray<float>::staticID != item.image->getMajorTypeID()){
+				isis::data::Image *floatImage = new isis::data::Image(isis::data::MemImage<float>(*item.image));
+				delete item.image;
+				item.image = floatImage;
+			}
+			item.isOfInterest = [self isImage:*item.image ofImageType:IMAGE_MOCO];
+			uint64_t end = mach_absolute_time();
+			EDStageRecord(&mStageLock, &mStageCounters[STAGE_CLASSIFY], item.enqueuedAt, start, end, item.receivedAt);
+			item.enqueuedAt = end;
+		}
+		mClassifiedQueue->push(item);
+		EDStageSetBlockedTime(&mStageLock, &mStageCounters[STAGE_CLASSIFY], mClassifiedQueue->blockedTime());
+	}
+	[pool drain];
+}
+
+-(void)runAppendStage
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	[[NSThread currentThread] setThreadPriority:0.5];
+	while (true) {
+		EDRealTimeItem item = mClassifiedQueue->pop();
+		if (NULL == item.image){
+			break;}
+
+		NSAutoreleasePool *volumePool = [[NSAutoreleasePool alloc] init];
+		uint64_t start = mach_absolute_time();
+		if (YES == item.isOfInterest){
+            [mDataElementInterest appendVolume:*item.image];
 //			[[NSNotificationCenter defaultCenter] postNotificationName:BARTDidLoadNextDataNotification object:mDataElementInterest];
             NSLog(@"Should have sent BARTDidLoadNextDataNotification");
-			
         }
 		else {
 			// TODO what to do with other data
-			[mDataElementRest appendVolume:*it];
+			[mDataElementRest appendVolume:*item.image];
         }
+		delete item.image;
+		EDStageRecord(&mStageLock, &mStageCounters[STAGE_APPEND], item.enqueuedAt, start, mach_absolute_time(), item.receivedAt);
+		[volumePool drain];
+	}
 
-		
-    }
-	
+	[self finishRealTimeInput];
+	dispatch_semaphore_signal(mPipelineDone);
+	[pool drain];
+}
+
+-(void)finishRealTimeInput
+{
+	if (1 < [mDataElementInterest getImageSize].timesteps){
+//		[[NSNotificationCenter defaultCenter] postNotificationName:BARTScannerSentTerminusNotification object:mDataElementInterest];
+		NSLog(@"Should have sent BARTScannerSentTerminusNotification");
+	}
+	else{
+//		[[NSNotificationCenter defaultCenter] postNotificationName:BARTScannerSentTerminusNotification object:nil];
+		NSLog(@"Should have sent BARTScannerSentTerminusNotification");
+	}
+
+	// the volumes were streamed to disk as they arrived - nothing left but closing the file
+	[mDataElementRest stopStreamingWithCompletion:^(NSString *path, BOOL success){
+		if (NO == success){
+			NSLog(@"Could not write %@", path);}
+	}];
+	[mWriter waitUntilDone];
 }
 
 
--(BOOL)isImage:(isis::data::Image)img ofImageType:(enum ImageType)imgType
+-(BOOL)isImage:(const isis::data::Image&)img ofImageType:(enum ImageType)imgType
 {
 	std::string seqDescr;
 	u_int16_t segNr = img.getPropertyAs<u_int16_t>("sequenceNumber");
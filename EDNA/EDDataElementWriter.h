@@ -0,0 +1,87 @@
+//
+//  EDDataElementWriter.h
+//  BARTApplication
+//
+
+#ifndef EDDATAELEMENTWRITER_H
+#define EDDATAELEMENTWRITER_H
+
+#import <Cocoa/Cocoa.h>
+#import "EDDataElement.h"
+
+// number of write jobs queued before writing blocks the caller
+static const size_t ED_WRITER_DEFAULT_CAPACITY = 16;
+
+/*
+ * Called on the writer's I/O thread when a write job is done - dispatch to the main queue for UI work.
+ */
+typedef void (^EDWriteCompletionHandler)(NSString* path, BOOL success);
+
+/*
+ * Writes data elements to NIfTI-1 files (.nii) on a background I/O thread.
+ *
+ * Each write takes a snapshot of the volumes on the calling thread - the slice views
+ * (getTypedSliceView:atTimestep:) with their tokens, no voxel is copied - and queues it.
+ * The tokens keep the memory alive until it is written, even if the element is released
+ * or a realtime ring buffer moves on meanwhile. Voxels changed in place before the job ran
+ * are written with their new value.
+ * Data is written in the type it is stored in (native int16 stores stay int16).
+ *
+ * The queue is bounded: if capacity jobs are waiting, the caller blocks until one is done
+ * (see getBlockedTime). Jobs run one after another in the order they were queued.
+ *
+ * Streams write a file incrementally: each appendTimestep:... adds one volume to the open
+ * file and updates the number of timesteps in the header (a constant two byte write), so
+ * the file is a valid image of all volumes appended so far, even if the run is aborted.
+ * closeStream:... closes the file.
+ *
+ * Queued jobs do not retain the writer: releasing it does not wait for them, they finish
+ * on the I/O thread. Call waitUntilDone where the files have to be complete.
+ */
+@interface EDDataElementWriter : NSObject {
+	dispatch_queue_t mQueue;
+	dispatch_semaphore_t mFreeSlots;
+	volatile int64_t mBlockedTime;
+	// path -> open stream, only touched on mQueue
+	NSMutableDictionary* mStreams;
+}
+
+-(id)init;
+
+-(id)initWithCapacity:(size_t)capacity;
+
+/*
+ * Queues writing all timesteps of element to path. Paths not ending in .nii are handed to
+ * WriteDataElementToFile: on the calling thread (isis decides about the format), handler
+ * is called on the calling thread then.
+ * Returns NO (handler not called) if the element has no data to write.
+ */
+-(BOOL)writeDataElement:(EDDataElement*)element toFile:(NSString*)path completion:(EDWriteCompletionHandler)handler;
+
+/*
+ * Queues appending timestep tstep of element to the stream writing path. The first append
+ * creates the file (overwriting an existing one) with the geometry and voxel type of
+ * element, later volumes must match it.
+ * Returns NO if the timestep could not be snapshotted.
+ */
+-(BOOL)appendTimestep:(size_t)tstep ofDataElement:(EDDataElement*)element toStream:(NSString*)path;
+
+/*
+ * Queues closing the stream writing path.
+ * handler (may be nil) gets NO if any append to the stream failed, YES if nothing was appended.
+ */
+-(void)closeStream:(NSString*)path completion:(EDWriteCompletionHandler)handler;
+
+/*
+ * Blocks until all jobs queued so far are done.
+ */
+-(void)waitUntilDone;
+
+/*
+ * Mach absolute time units callers were blocked by a full queue.
+ */
+-(uint64_t)getBlockedTime;
+
+@end
+
+#endif // EDDATAELEMENTWRITER_H
@@ -0,0 +1,426 @@
+//
+//  EDDataElementWriter.mm
+//  BARTApplication
+//
+
+#import "EDDataElementWriter.h"
+#include "EDNifti.h"
+#include "EDTypedVolume.h"
+#import <libkern/OSAtomic.h>
+#import <mach/mach_time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+
+
+static int EDNiftiDatatypeOf(enum EDVoxelType type)
+{
+	switch (type) {
+		case ED_VOXEL_INT16:
+			return ED_NIFTI_INT16;
+		case ED_VOXEL_UINT16:
+			return ED_NIFTI_UINT16;
+		case ED_VOXEL_UINT8:
+			return ED_NIFTI_UINT8;
+		case ED_VOXEL_INT8:
+			return ED_NIFTI_INT8;
+		default:
+			return ED_NIFTI_FLOAT32;
+	}
+}
+
+/*
+ * Writes all length bytes (or fails).
+ */
+static BOOL EDWriteAll(int fd, const void* bytes, size_t length)
+{
+	const char* next = static_cast<const char*>(bytes);
+	while (0 < length){
+		ssize_t written = write(fd, next, length);
+		if (written < 0){
+			if (EINTR == errno){
+				continue;}
+			return NO;
+		}
+		next += written;
+		length -= (size_t) written;
+	}
+	return YES;
+}
+
+/*
+ * Sets dim[4] of the .nii file open as fd - two bytes, whatever the size of the file.
+ */
+static BOOL EDPatchTimesteps(int fd, size_t timesteps)
+{
+	int16_t dim = (int16_t) std::min<size_t>(timesteps, 32767);
+	return sizeof(dim) == pwrite(fd, &dim, sizeof(dim), ED_NIFTI_TIMESTEPS_OFFSET);
+}
+
+/*
+ * vec[0..2] of a fvector3 property as returned by getProps:, fallback if it is missing or zero.
+ */
+static void EDVectorOfProp(NSDictionary* props, NSString* key, const float fallback[3], float vec[3])
+{
+	NSArray* values = [props objectForKey:key];
+	BOOL isZero = YES;
+	for (NSUInteger i = 0; i < 3; i++){
+		vec[i] = ([values isKindOfClass:[NSArray class]] and i < [values count]) ? [[values objectAtIndex:i] floatValue] : 0.0f;
+		isZero = isZero and (0.0f == vec[i]);
+	}
+	if (isZero){
+		memcpy(vec, fallback, 3 * sizeof(float));}
+}
+
+/*
+ * NIfTI geometry of element: isis orientation (DICOM, LPS) to sform (RAS).
+ */
+static void EDNiftiGeometryOf(EDDataElement* element, EDNiftiHeader* hdr)
+{
+	NSArray* keys = [NSArray arrayWithObjects:@"indexOrigin", @"rowVec", @"columnVec", @"sliceVec", @"voxelSize", @"repetitionTime", nil];
+	NSDictionary* props = [element getProps:keys];
+	static const float unitVecs[3][3] = {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}};
+	static const float noVec[3] = {0.0f, 0.0f, 0.0f};
+	static const float unitSize[3] = {1.0f, 1.0f, 1.0f};
+
+	float voxelSize[3];
+	float origin[3];
+	EDVectorOfProp(props, @"voxelSize", unitSize, voxelSize);
+	EDVectorOfProp(props, @"indexOrigin", noVec, origin);
+	NSString* dirKeys[3] = {@"rowVec", @"columnVec", @"sliceVec"};
+	for (int c = 0; c < 3; c++){
+		float dir[3];
+		EDVectorOfProp(props, dirKeys[c], unitVecs[c], dir);
+		hdr->voxelSize[c] = voxelSize[c];
+		hdr->indexToScanner[0][c] = -dir[0] * voxelSize[c];
+		hdr->indexToScanner[1][c] = -dir[1] * voxelSize[c];
+		hdr->indexToScanner[2][c] =  dir[2] * voxelSize[c];
+	}
+	hdr->indexToScanner[0][3] = -origin[0];
+	hdr->indexToScanner[1][3] = -origin[1];
+	hdr->indexToScanner[2][3] =  origin[2];
+
+	id repetitionTime = [props objectForKey:@"repetitionTime"];
+	hdr->repetitionTime = [repetitionTime isKindOfClass:[NSNumber class]] ? [repetitionTime floatValue] : 0.0f;
+}
+
+
+/*
+ * Timesteps of an element as slice views - the tokens keep the memory alive, nothing is copied.
+ */
+@interface EDVolumeSnapshot : NSObject {
+@public
+	EDNiftiHeader mHeader;
+	EDTypedSliceView* mViews;
+	size_t mViewCount;
+}
+
+-(id)initWithDataElement:(EDDataElement*)element fromTimestep:(size_t)first count:(size_t)count;
+
+-(BOOL)writeTo:(int)fd;
+
+@end
+
+@implementation EDVolumeSnapshot
+
+-(id)initWithDataElement:(EDDataElement*)element fromTimestep:(size_t)first count:(size_t)count
+{
+	if (!(self = [super init])){
+		return nil;}
+	mViews = NULL;
+	mViewCount = 0;
+
+	BARTImageSize* size = [element getImageSize];
+	if (0 == count or first + count > size.timesteps or 0 == size.slices){
+		[self release];
+		return nil;
+	}
+	mViews = static_cast<EDTypedSliceView*>(calloc(count * size.slices, sizeof(EDTypedSliceView)));
+	if (NULL == mViews){
+		[self release];
+		return nil;
+	}
+	for (size_t ts = first; ts < first + count; ts++){
+		for (size_t sl = 0; sl < size.slices; sl++){
+			EDTypedSliceView view = [element getTypedSliceView:(uint) sl atTimestep:(uint) ts];
+			if (NULL == view.data or (0 < mViewCount and view.type != mViews[0].type)){
+				[self release];
+				return nil;
+			}
+			[view.token retain];
+			mViews[mViewCount++] = view;
+		}
+	}
+
+	memset(&mHeader, 0, sizeof(mHeader));
+	mHeader.columns = size.columns;
+	mHeader.rows = size.rows;
+	mHeader.slices = size.slices;
+	mHeader.timesteps = count;
+	mHeader.datatype = EDNiftiDatatypeOf(mViews[0].type);
+	mHeader.bytesPerVoxel = EDVoxelTypeSize(mViews[0].type);
+	EDNiftiGeometryOf(element, &mHeader);
+	return self;
+}
+
+-(void)dealloc
+{
+	for (size_t i = 0; i < mViewCount; i++){
+		[mViews[i].token release];}
+	free(mViews);
+	[super dealloc];
+}
+
+-(BOOL)writeTo:(int)fd
+{
+	size_t rowBytes = mHeader.columns * mHeader.bytesPerVoxel;
+	for (size_t i = 0; i < mViewCount; i++){
+		const EDTypedSliceView& view = mViews[i];
+		if (view.rowStride == mHeader.columns){
+			if (not EDWriteAll(fd, view.data, mHeader.rows * rowBytes)){
+				return NO;}
+			continue;
+		}
+		for (size_t r = 0; r < mHeader.rows; r++){
+			if (not EDWriteAll(fd, EDTypedVoxelAt(view.data, view.type, (ptrdiff_t) (r * view.rowStride)), rowBytes)){
+				return NO;}
+		}
+	}
+	return YES;
+}
+
+@end
+
+
+/*
+ * A file written volume by volume.
+ */
+@interface EDNiftiStreamFile : NSObject {
+@public
+	int mFd;
+	EDNiftiHeader mHeader;
+	size_t mVolumes;
+	BOOL mFailed;
+}
+@end
+
+@implementation EDNiftiStreamFile
+
+-(id)init
+{
+	if (self = [super init]){
+		mFd = -1;
+		mVolumes = 0;
+		mFailed = NO;
+	}
+	return self;
+}
+
+-(void)dealloc
+{
+	if (0 <= mFd){
+		close(mFd);}
+	[super dealloc];
+}
+
+@end
+
+
+/*
+ * Closes stream, the header gets the number of volumes written. Runs on the writer's queue.
+ */
+static BOOL EDFinishStream(EDNiftiStreamFile* stream)
+{
+	if (stream->mFd < 0){
+		return NO;}
+	BOOL success = not stream->mFailed;
+	if (0 < stream->mVolumes){
+		success = EDPatchTimesteps(stream->mFd, stream->mVolumes) and success;}
+	success = (0 == close(stream->mFd)) and success;
+	stream->mFd = -1;
+	return success;
+}
+
+/*
+ * Appends snapshot to the stream writing path, creates it on the first volume.
+ * Runs on the writer's queue - streams is all the state it touches, so queued jobs
+ * never keep the writer itself alive.
+ */
+static void EDAppendSnapshot(NSMutableDictionary* streams, EDVolumeSnapshot* snapshot, NSString* path)
+{
+	EDNiftiStreamFile* stream = [streams objectForKey:path];
+	if (nil == stream){
+		// first volume - create the file, the header claims one timestep until closed
+		stream = [[[EDNiftiStreamFile alloc] init] autorelease];
+		[streams setObject:stream forKey:path];
+		stream->mHeader = snapshot->mHeader;
+		unsigned char header[ED_NIFTI_DATA_OFFSET];
+		stream->mFd = open([path fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (stream->mFd < 0 or not EDNiftiWriteHeader(&stream->mHeader, header) or not EDWriteAll(stream->mFd, header, ED_NIFTI_DATA_OFFSET)){
+			NSLog(@"Could not create %@: %s", path, strerror(errno));
+			stream->mFailed = YES;
+		}
+	}
+	if (YES == stream->mFailed){
+		return;}
+
+	const EDNiftiHeader& hdr = snapshot->mHeader;
+	if (hdr.columns != stream->mHeader.columns or hdr.rows != stream->mHeader.rows
+		or hdr.slices != stream->mHeader.slices or hdr.datatype != stream->mHeader.datatype){
+		NSLog(@"Volume does not match the volumes written to %@ - not appended", path);
+		stream->mFailed = YES;
+		return;
+	}
+	if (32767 <= stream->mVolumes){
+		NSLog(@"%@ holds the maximum number of timesteps - not appended", path);
+		stream->mFailed = YES;
+		return;
+	}
+	// the header follows each volume, so the file is complete whenever the run stops
+	if (NO == [snapshot writeTo:stream->mFd] or NO == EDPatchTimesteps(stream->mFd, stream->mVolumes + 1)){
+		NSLog(@"Could not append to %@: %s", path, strerror(errno));
+		stream->mFailed = YES;
+		return;
+	}
+	stream->mVolumes++;
+}
+
+
+@interface EDDataElementWriter (PrivateMethods)
+
+/*
+ * Runs job on the I/O queue, blocks while the queue is full.
+ */
+-(void)enqueue:(dispatch_block_t)job;
+
+@end
+
+
+@implementation EDDataElementWriter
+
+-(id)init
+{
+	return [self initWithCapacity:ED_WRITER_DEFAULT_CAPACITY];
+}
+
+-(id)initWithCapacity:(size_t)capacity
+{
+	if (self = [super init]) {
+		mQueue = dispatch_queue_create("de.cbs.mpg.bart.EDNA.dataElementWriter", NULL);
+		dispatch_set_target_queue(mQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+		mFreeSlots = dispatch_semaphore_create((long) ((0 < capacity) ? capacity : 1));
+		mBlockedTime = 0;
+		mStreams = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+-(void)dealloc
+{
+	// does not wait: jobs still queued hold the streams and the semaphore, not the writer.
+	// Streams nobody closed are closed after them - at least leave valid files behind.
+	NSMutableDictionary* streams = mStreams;
+	dispatch_async(mQueue, ^{
+		for (EDNiftiStreamFile* stream in [streams allValues]){
+			EDFinishStream(stream);}
+		[streams removeAllObjects];
+	});
+	[mStreams release];
+	dispatch_release(mFreeSlots);
+	dispatch_release(mQueue);
+	[super dealloc];
+}
+
+-(void)enqueue:(dispatch_block_t)job
+{
+	if (0 != dispatch_semaphore_wait(mFreeSlots, DISPATCH_TIME_NOW)){
+		uint64_t start = mach_absolute_time();
+		dispatch_semaphore_wait(mFreeSlots, DISPATCH_TIME_FOREVER);
+		OSAtomicAdd64Barrier((int64_t) (mach_absolute_time() - start), &mBlockedTime);
+	}
+	dispatch_semaphore_t freeSlots = mFreeSlots;
+	dispatch_retain(freeSlots);
+	dispatch_async(mQueue, ^{
+		NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+		job();
+		[pool drain];
+		dispatch_semaphore_signal(freeSlots);
+		dispatch_release(freeSlots);
+	});
+}
+
+-(BOOL)writeDataElement:(EDDataElement*)element toFile:(NSString*)path completion:(EDWriteCompletionHandler)handler
+{
+	if (NO == [[[path pathExtension] lowercaseString] isEqualToString:@"nii"]){
+		BOOL success = [element WriteDataElementToFile:path];
+		if (nil != handler){
+			handler(path, success);}
+		return YES;
+	}
+
+	EDVolumeSnapshot* snapshot = [[EDVolumeSnapshot alloc] initWithDataElement:element fromTimestep:0 count:[element getImageSize].timesteps];
+	if (nil == snapshot){
+		NSLog(@"Nothing to write to %@", path);
+		return NO;
+	}
+	NSString* file = [[path copy] autorelease];
+	[self enqueue:^{
+		unsigned char header[ED_NIFTI_DATA_OFFSET];
+		BOOL success = NO;
+		int fd = open([file fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (0 <= fd){
+			success = EDNiftiWriteHeader(&snapshot->mHeader, header)
+					  and EDWriteAll(fd, header, ED_NIFTI_DATA_OFFSET)
+					  and [snapshot writeTo:fd];
+			success = (0 == close(fd)) and success;
+		}
+		if (NO == success){
+			NSLog(@"Could not write %@: %s", file, strerror(errno));}
+		[snapshot release];
+		if (nil != handler){
+			handler(file, success);}
+	}];
+	return YES;
+}
+
+-(BOOL)appendTimestep:(size_t)tstep ofDataElement:(EDDataElement*)element toStream:(NSString*)path
+{
+	EDVolumeSnapshot* snapshot = [[EDVolumeSnapshot alloc] initWithDataElement:element fromTimestep:tstep count:1];
+	if (nil == snapshot){
+		NSLog(@"Could not append timestep %lu to %@", tstep, path);
+		return NO;
+	}
+	NSString* file = [[path copy] autorelease];
+	NSMutableDictionary* streams = mStreams;
+	[self enqueue:^{
+		EDAppendSnapshot(streams, snapshot, file);
+		[snapshot release];
+	}];
+	return YES;
+}
+
+-(void)closeStream:(NSString*)path completion:(EDWriteCompletionHandler)handler
+{
+	NSString* file = [[path copy] autorelease];
+	NSMutableDictionary* streams = mStreams;
+	[self enqueue:^{
+		EDNiftiStreamFile* stream = [streams objectForKey:file];
+		BOOL success = (nil == stream) or EDFinishStream(stream);
+		[streams removeObjectForKey:file];
+		if (nil != handler){
+			handler(file, success);}
+	}];
+}
+
+-(void)waitUntilDone
+{
+	dispatch_sync(mQueue, ^{});
+}
+
+-(uint64_t)getBlockedTime
+{
+	return (uint64_t) mBlockedTime;
+}
+
+@end
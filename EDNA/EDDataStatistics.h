@@ -0,0 +1,171 @@
+//
+//  EDDataStatistics.h
+//  BARTApplication
+//
+
+#ifndef EDDATASTATISTICS_H
+#define EDDATASTATISTICS_H
+
+#include <stddef.h>
+#include "EDFloatVolume.h"
+#include "EDTypedVolume.h"
+
+// Number of bins of the value histogram kept by each EDDataElement.
+#define ED_HISTOGRAM_BINS 256
+
+/*
+ * Min/max of one volume (timestep). valid == 0 means it needs to be rescanned.
+ */
+typedef struct {
+    float min;
+    float max;
+    int   valid;
+} EDVolumeStats;
+
+/*
+ * Value histogram with ED_HISTOGRAM_BINS equally sized bins covering [min, max].
+ */
+typedef struct {
+    float  min;
+    float  max;
+    size_t total;
+    size_t counts[ED_HISTOGRAM_BINS];
+} EDHistogram;
+
+static inline int EDHistogramCovers(const EDHistogram* h, float val)
+{
+    return val >= h->min && val <= h->max;
+}
+
+/*
+ * Bin of val - only meaningful if EDHistogramCovers(h, val).
+ */
+static inline size_t EDHistogramBin(const EDHistogram* h, float val)
+{
+    if (h->max <= h->min) {
+        return 0;
+    }
+    size_t bin = (size_t) ((val - h->min) / (h->max - h->min) * ED_HISTOGRAM_BINS);
+    return (bin < ED_HISTOGRAM_BINS) ? bin : ED_HISTOGRAM_BINS - 1;
+}
+
+/*
+ * Accounts for one voxel of the volume s describes changing from oldValue to newValue.
+ * If an extreme value is gone only a rescan can tell the new one - s is marked invalid then.
+ */
+static inline void EDVolumeStatsReplace(EDVolumeStats* s, float newValue, float oldValue)
+{
+    if (0 == s->valid || newValue == oldValue) {
+        return;
+    }
+    if ((oldValue <= s->min && newValue > oldValue) || (oldValue >= s->max && newValue < oldValue)) {
+        s->valid = 0;
+        return;
+    }
+    s->min = (newValue < s->min) ? newValue : s->min;
+    s->max = (newValue > s->max) ? newValue : s->max;
+}
+
+/*
+ * Moves one voxel from the bin of oldValue to the bin of newValue.
+ * Returns 0 (h unchanged) if either value is outside the histogram range.
+ */
+static inline int EDHistogramReplace(EDHistogram* h, float newValue, float oldValue)
+{
+    if (!EDHistogramCovers(h, newValue) || !EDHistogramCovers(h, oldValue)) {
+        return 0;
+    }
+    h->counts[EDHistogramBin(h, oldValue)]--;
+    h->counts[EDHistogramBin(h, newValue)]++;
+    return 1;
+}
+
+/*
+ * Min/max over all voxels of v (all timesteps it describes).
+ * Runs linearly through memory if the voxels are stored densely.
+ */
+static inline void EDFloatVolumeMinMax(const EDFloatVolume* v, float* min, float* max)
+{
+    size_t nrVoxels = EDFloatVolumeVoxelCount(v);
+    if (0 == nrVoxels) {
+        *min = 0.0f;
+        *max = 0.0f;
+        return;
+    }
+    float lo = v->data[0];
+    float hi = lo;
+    if (1 == v->colStride && (ptrdiff_t) v->columns == v->rowStride
+        && (ptrdiff_t) (v->columns * v->rows) == v->sliceStride
+        && (1 == v->timesteps || (ptrdiff_t) (v->columns * v->rows * v->slices) == v->timeStride)) {
+        for (size_t i = 1; i < nrVoxels; i++) {
+            float val = v->data[i];
+            lo = (val < lo) ? val : lo;
+            hi = (val > hi) ? val : hi;
+        }
+    } else {
+        for (size_t t = 0; t < v->timesteps; t++) {
+            for (size_t s = 0; s < v->slices; s++) {
+                for (size_t r = 0; r < v->rows; r++) {
+                    for (size_t c = 0; c < v->columns; c++) {
+                        float val = EDFloatVolumeGet(v, c, r, s, t);
+                        lo = (val < lo) ? val : lo;
+                        hi = (val > hi) ? val : hi;
+                    }
+                }
+            }
+        }
+    }
+    *min = lo;
+    *max = hi;
+}
+
+/*
+ * Adds all voxels of v to h. Returns 0 (h unchanged) if any voxel is outside the histogram range.
+ */
+static inline int EDHistogramAddVolume(EDHistogram* h, const EDFloatVolume* v)
+{
+    float lo, hi;
+    EDFloatVolumeMinMax(v, &lo, &hi);
+    if (!EDHistogramCovers(h, lo) || !EDHistogramCovers(h, hi)) {
+        return 0;
+    }
+    for (size_t t = 0; t < v->timesteps; t++) {
+        for (size_t s = 0; s < v->slices; s++) {
+            for (size_t r = 0; r < v->rows; r++) {
+                for (size_t c = 0; c < v->columns; c++) {
+                    h->counts[EDHistogramBin(h, EDFloatVolumeGet(v, c, r, s, t))]++;
+                }
+            }
+        }
+    }
+    h->total += EDFloatVolumeVoxelCount(v);
+    return 1;
+}
+
+/*
+ * EDHistogramAddVolume for a typed volume, rows are converted in blocks on the way.
+ * Voxels outside the histogram range go to the first/last bin.
+ */
+#define ED_HISTOGRAM_BLOCK 256
+
+static inline void EDHistogramAddTypedVolume(EDHistogram* h, const EDTypedVolume* v)
+{
+    float block[ED_HISTOGRAM_BLOCK];
+    for (size_t t = 0; t < v->timesteps; t++) {
+        for (size_t s = 0; s < v->slices; s++) {
+            for (size_t r = 0; r < v->rows; r++) {
+                for (size_t c0 = 0; c0 < v->columns; c0 += ED_HISTOGRAM_BLOCK) {
+                    size_t n = (c0 + ED_HISTOGRAM_BLOCK < v->columns) ? ED_HISTOGRAM_BLOCK : v->columns - c0;
+                    EDTypedToFloat(EDTypedVoxelAt(v->data, v->type, EDTypedVolumeOffset(v, c0, r, s, t)), v->type,
+                                   v->colStride, n, block);
+                    for (size_t i = 0; i < n; i++) {
+                        h->counts[EDHistogramBin(h, (block[i] < h->min) ? h->min : block[i])]++;
+                    }
+                }
+            }
+        }
+    }
+    h->total += v->columns * v->rows * v->slices * v->timesteps;
+}
+
+#endif // EDDATASTATISTICS_H
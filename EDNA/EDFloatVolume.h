@@ -0,0 +1,136 @@
+//
+//  EDFloatVolume.h
+//  BARTApplication
+//
+
+#ifndef EDFLOATVOLUME_H
+#define EDFLOATVOLUME_H
+
+#include <stddef.h>
+
+/*
+ * Description of a contiguous (up to) 4D float voxel buffer with precomputed strides.
+ * Plain C on purpose: usable from Objective-C, Objective-C++ and C++ alike.
+ *
+ * Voxel (col c, row r, slice s, timestep t) is located at
+ *   data[c * colStride + r * rowStride + s * sliceStride + t * timeStride]
+ * Strides are given in number of floats (not bytes).
+ */
+typedef struct {
+    float*    data;
+    size_t    columns;
+    size_t    rows;
+    size_t    slices;
+    size_t    timesteps;
+    ptrdiff_t colStride;
+    ptrdiff_t rowStride;
+    ptrdiff_t sliceStride;
+    ptrdiff_t timeStride;
+} EDFloatVolume;
+
+// Alignment (bytes) of the buffers allocated for volume stores.
+#define ED_VOLUME_ALIGNMENT 64
+
+/*
+ * Fills in the strides for the default layout: col fastest, then row, slice and timestep.
+ */
+static inline void EDFloatVolumeInitSliceMajor(EDFloatVolume* v, float* data, size_t cols, size_t rows, size_t slices, size_t timesteps)
+{
+    v->data        = data;
+    v->columns     = cols;
+    v->rows        = rows;
+    v->slices      = slices;
+    v->timesteps   = timesteps;
+    v->colStride   = 1;
+    v->rowStride   = (ptrdiff_t) cols;
+    v->sliceStride = (ptrdiff_t) (cols * rows);
+    v->timeStride  = (ptrdiff_t) (cols * rows * slices);
+}
+
+/*
+ * Strides for the time major layout: timestep fastest, then col, row and slice -
+ * the time series of each voxel is contiguous.
+ */
+static inline void EDFloatVolumeInitTimeMajor(EDFloatVolume* v, float* data, size_t cols, size_t rows, size_t slices, size_t timesteps)
+{
+    v->data        = data;
+    v->columns     = cols;
+    v->rows        = rows;
+    v->slices      = slices;
+    v->timesteps   = timesteps;
+    v->timeStride  = 1;
+    v->colStride   = (ptrdiff_t) timesteps;
+    v->rowStride   = (ptrdiff_t) (timesteps * cols);
+    v->sliceStride = (ptrdiff_t) (timesteps * cols * rows);
+}
+
+static inline size_t EDFloatVolumeVoxelCount(const EDFloatVolume* v)
+{
+    return v->columns * v->rows * v->slices * v->timesteps;
+}
+
+static inline int EDFloatVolumeContains(const EDFloatVolume* v, size_t c, size_t r, size_t s, size_t t)
+{
+    return c < v->columns && r < v->rows && s < v->slices && t < v->timesteps;
+}
+
+static inline ptrdiff_t EDFloatVolumeOffset(const EDFloatVolume* v, size_t c, size_t r, size_t s, size_t t)
+{
+    return (ptrdiff_t) c * v->colStride
+         + (ptrdiff_t) r * v->rowStride
+         + (ptrdiff_t) s * v->sliceStride
+         + (ptrdiff_t) t * v->timeStride;
+}
+
+/*
+ * Unchecked voxel access - use EDFloatVolumeContains if indices are not known to be valid.
+ */
+static inline float EDFloatVolumeGet(const EDFloatVolume* v, size_t c, size_t r, size_t s, size_t t)
+{
+    return v->data[EDFloatVolumeOffset(v, c, r, s, t)];
+}
+
+static inline void EDFloatVolumeSet(EDFloatVolume* v, size_t c, size_t r, size_t s, size_t t, float val)
+{
+    v->data[EDFloatVolumeOffset(v, c, r, s, t)] = val;
+}
+
+/*
+ * Pointer to voxel (0, 0, s, t). Rows of that slice follow with rowStride.
+ */
+static inline float* EDFloatVolumeSlice(const EDFloatVolume* v, size_t s, size_t t)
+{
+    return v->data + (ptrdiff_t) s * v->sliceStride + (ptrdiff_t) t * v->timeStride;
+}
+
+/*
+ * Copies slices [firstSlice, endSlice) of all timesteps from src to dst, both of the same
+ * size but of any layout. Col and timestep are walked in tiles, so a transposition
+ * (e.g. slice major -> time major) reads and writes whole cache lines on both sides.
+ * Slices are independent, so ranges of them can be copied in parallel.
+ */
+#define ED_COPY_TILE 16
+
+static inline void EDFloatVolumeCopySlices(const EDFloatVolume* src, EDFloatVolume* dst, size_t firstSlice, size_t endSlice)
+{
+    for (size_t s = firstSlice; s < endSlice; s++) {
+        for (size_t r = 0; r < src->rows; r++) {
+            const float* srcLine = src->data + EDFloatVolumeOffset(src, 0, r, s, 0);
+            float* dstLine = dst->data + EDFloatVolumeOffset(dst, 0, r, s, 0);
+            for (size_t c0 = 0; c0 < src->columns; c0 += ED_COPY_TILE) {
+                size_t c1 = (c0 + ED_COPY_TILE < src->columns) ? c0 + ED_COPY_TILE : src->columns;
+                for (size_t t0 = 0; t0 < src->timesteps; t0 += ED_COPY_TILE) {
+                    size_t t1 = (t0 + ED_COPY_TILE < src->timesteps) ? t0 + ED_COPY_TILE : src->timesteps;
+                    for (size_t c = c0; c < c1; c++) {
+                        for (size_t t = t0; t < t1; t++) {
+                            dstLine[(ptrdiff_t) c * dst->colStride + (ptrdiff_t) t * dst->timeStride] =
+                                srcLine[(ptrdiff_t) c * src->colStride + (ptrdiff_t) t * src->timeStride];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif // EDFLOATVOLUME_H
@@ -0,0 +1,343 @@
+//
+//  EDNifti.h
+//  BARTApplication
+//
+
+#ifndef EDNIFTI_H
+#define EDNIFTI_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Minimal NIfTI-1 support for mapping uncompressed single file (.nii) images:
+ * the header fields needed to locate, convert and orient the voxel data.
+ * Everything else (compressed files, .hdr/.img pairs, foreign byte order) is left to isis.
+ * Writing goes the other way round: header fields to the 352 bytes preceding the voxel data.
+ */
+
+// NIfTI-1 datatype codes
+#define ED_NIFTI_UINT8    2
+#define ED_NIFTI_INT16    4
+#define ED_NIFTI_INT32    8
+#define ED_NIFTI_FLOAT32  16
+#define ED_NIFTI_FLOAT64  64
+#define ED_NIFTI_INT8     256
+#define ED_NIFTI_UINT16   512
+#define ED_NIFTI_UINT32   768
+
+#define ED_NIFTI_HEADER_SIZE 348
+// header plus the (empty) extension flag - where written voxel data starts
+#define ED_NIFTI_DATA_OFFSET 352
+// dim[4], the number of timesteps
+#define ED_NIFTI_TIMESTEPS_OFFSET 48
+
+typedef struct {
+    size_t columns;
+    size_t rows;
+    size_t slices;
+    size_t timesteps;
+    int    datatype;
+    size_t bytesPerVoxel;
+    size_t voxOffset;
+    // value = raw * slope + inter (slope == 0: no scaling)
+    float  slope;
+    float  inter;
+    // voxel size (mm) and repetition time (ms)
+    float  voxelSize[3];
+    float  repetitionTime;
+    // voxel index (i, j, k) -> scanner position (mm, RAS): column c of the matrix is the
+    // step of index c, column 3 the position of voxel (0, 0, 0)
+    float  indexToScanner[3][4];
+} EDNiftiHeader;
+
+static inline size_t EDNiftiBytesPerVoxel(int datatype)
+{
+    switch (datatype) {
+        case ED_NIFTI_UINT8:
+        case ED_NIFTI_INT8:
+            return 1;
+        case ED_NIFTI_INT16:
+        case ED_NIFTI_UINT16:
+            return 2;
+        case ED_NIFTI_INT32:
+        case ED_NIFTI_UINT32:
+        case ED_NIFTI_FLOAT32:
+            return 4;
+        case ED_NIFTI_FLOAT64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+static inline int16_t EDNiftiShortAt(const unsigned char* bytes, size_t offset)
+{
+    int16_t val;
+    memcpy(&val, bytes + offset, sizeof(val));
+    return val;
+}
+
+static inline float EDNiftiFloatAt(const unsigned char* bytes, size_t offset)
+{
+    float val;
+    memcpy(&val, bytes + offset, sizeof(val));
+    return val;
+}
+
+/*
+ * Parses the header of a mapped .nii file of length bytes.
+ * Returns 0 if it is no NIfTI-1 single file in native byte order, the datatype is not
+ * supported, the data is not aligned to its voxel size or does not fit into the file.
+ */
+static inline int EDNiftiReadHeader(const unsigned char* bytes, size_t length, EDNiftiHeader* hdr)
+{
+    if (length < ED_NIFTI_HEADER_SIZE + 4) {
+        return 0;
+    }
+    int32_t sizeofHdr;
+    memcpy(&sizeofHdr, bytes, sizeof(sizeofHdr));
+    if (ED_NIFTI_HEADER_SIZE != sizeofHdr || 0 != memcmp(bytes + 344, "n+1", 4)) {
+        return 0;
+    }
+
+    int16_t dim[8];
+    for (int i = 0; i < 8; i++) {
+        dim[i] = EDNiftiShortAt(bytes, 40 + 2 * i);
+    }
+    if (dim[0] < 1 || dim[0] > 4) {
+        return 0;
+    }
+    size_t sizes[4] = {1, 1, 1, 1};
+    for (int i = 1; i <= dim[0]; i++) {
+        if (dim[i] < 1) {
+            return 0;
+        }
+        sizes[i - 1] = (size_t) dim[i];
+    }
+    hdr->columns   = sizes[0];
+    hdr->rows      = sizes[1];
+    hdr->slices    = sizes[2];
+    hdr->timesteps = sizes[3];
+
+    hdr->datatype      = EDNiftiShortAt(bytes, 70);
+    hdr->bytesPerVoxel = EDNiftiBytesPerVoxel(hdr->datatype);
+    float voxOffset    = EDNiftiFloatAt(bytes, 108);
+    if (0 == hdr->bytesPerVoxel || voxOffset < ED_NIFTI_HEADER_SIZE) {
+        return 0;
+    }
+    hdr->voxOffset = (size_t) voxOffset;
+    size_t dataSize = hdr->columns * hdr->rows * hdr->slices * hdr->timesteps * hdr->bytesPerVoxel;
+    if (0 != hdr->voxOffset % hdr->bytesPerVoxel || hdr->voxOffset + dataSize > length) {
+        return 0;
+    }
+
+    hdr->slope = EDNiftiFloatAt(bytes, 112);
+    hdr->inter = EDNiftiFloatAt(bytes, 116);
+    if (!isfinite(hdr->slope) || !isfinite(hdr->inter)) {
+        hdr->slope = 0.0f;
+        hdr->inter = 0.0f;
+    }
+
+    float pixdim[8];
+    for (int i = 0; i < 8; i++) {
+        pixdim[i] = EDNiftiFloatAt(bytes, 76 + 4 * i);
+    }
+    unsigned char units = bytes[123];
+    float spaceScale = ((units & 0x07) == 1) ? 1000.0f : (((units & 0x07) == 3) ? 0.001f : 1.0f);
+    float timeScale  = ((units & 0x38) == 16) ? 1.0f : (((units & 0x38) == 24) ? 0.001f : 1000.0f);
+    for (int i = 0; i < 3; i++) {
+        hdr->voxelSize[i] = ((pixdim[i + 1] > 0.0f) ? pixdim[i + 1] : 1.0f) * spaceScale;
+    }
+    hdr->repetitionTime = (pixdim[4] > 0.0f) ? pixdim[4] * timeScale : 0.0f;
+
+    int16_t qformCode = EDNiftiShortAt(bytes, 252);
+    int16_t sformCode = EDNiftiShortAt(bytes, 254);
+    if (sformCode > 0) {
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 4; c++) {
+                hdr->indexToScanner[r][c] = EDNiftiFloatAt(bytes, 280 + 16 * r + 4 * c) * spaceScale;
+            }
+        }
+    } else if (qformCode > 0) {
+        // quaternion (b, c, d) with a = sqrt(1 - b^2 - c^2 - d^2), qfac = pixdim[0]
+        double b = EDNiftiFloatAt(bytes, 256);
+        double c = EDNiftiFloatAt(bytes, 260);
+        double d = EDNiftiFloatAt(bytes, 264);
+        double a = 1.0 - (b * b + c * c + d * d);
+        if (a < 1.e-7) {
+            a = 1.0 / sqrt(b * b + c * c + d * d);
+            b *= a;
+            c *= a;
+            d *= a;
+            a = 0.0;
+        } else {
+            a = sqrt(a);
+        }
+        double qfac = (pixdim[0] < 0.0f) ? -1.0 : 1.0;
+        double R[3][3] = {
+            {a * a + b * b - c * c - d * d, 2 * b * c - 2 * a * d,         2 * b * d + 2 * a * c},
+            {2 * b * c + 2 * a * d,         a * a + c * c - b * b - d * d, 2 * c * d - 2 * a * b},
+            {2 * b * d - 2 * a * c,         2 * c * d + 2 * a * b,         a * a + d * d - c * c - b * b}
+        };
+        for (int r = 0; r < 3; r++) {
+            hdr->indexToScanner[r][0] = (float) (R[r][0] * hdr->voxelSize[0]);
+            hdr->indexToScanner[r][1] = (float) (R[r][1] * hdr->voxelSize[1]);
+            hdr->indexToScanner[r][2] = (float) (R[r][2] * hdr->voxelSize[2] * qfac);
+            hdr->indexToScanner[r][3] = EDNiftiFloatAt(bytes, 268 + 4 * r) * spaceScale;
+        }
+    } else {
+        // no orientation given - plain voxel grid
+        memset(hdr->indexToScanner, 0, sizeof(hdr->indexToScanner));
+        for (int r = 0; r < 3; r++) {
+            hdr->indexToScanner[r][r] = hdr->voxelSize[r];
+        }
+    }
+    return 1;
+}
+
+/*
+ * Converts n raw values of datatype to float, applying slope/inter.
+ */
+#define ED_NIFTI_CONVERT_LOOP(TYPE) \
+    { \
+        const TYPE* in = (const TYPE*) src; \
+        if (0.0f == slope) { \
+            for (size_t i = 0; i < n; i++) { dst[i] = (float) in[i]; } \
+        } else { \
+            for (size_t i = 0; i < n; i++) { dst[i] = (float) in[i] * slope + inter; } \
+        } \
+    }
+
+static inline void EDNiftiConvert(const void* src, int datatype, size_t n, float slope, float inter, float* dst)
+{
+    switch (datatype) {
+        case ED_NIFTI_UINT8:   ED_NIFTI_CONVERT_LOOP(uint8_t);  break;
+        case ED_NIFTI_INT8:    ED_NIFTI_CONVERT_LOOP(int8_t);   break;
+        case ED_NIFTI_INT16:   ED_NIFTI_CONVERT_LOOP(int16_t);  break;
+        case ED_NIFTI_UINT16:  ED_NIFTI_CONVERT_LOOP(uint16_t); break;
+        case ED_NIFTI_INT32:   ED_NIFTI_CONVERT_LOOP(int32_t);  break;
+        case ED_NIFTI_UINT32:  ED_NIFTI_CONVERT_LOOP(uint32_t); break;
+        case ED_NIFTI_FLOAT32: ED_NIFTI_CONVERT_LOOP(float);    break;
+        case ED_NIFTI_FLOAT64: ED_NIFTI_CONVERT_LOOP(double);   break;
+        default:
+            memset(dst, 0, n * sizeof(float));
+            break;
+    }
+}
+
+/*
+ * Min/max of n raw values of datatype after applying slope/inter - without converting them.
+ */
+#define ED_NIFTI_MINMAX_LOOP(TYPE) \
+    { \
+        const TYPE* in = (const TYPE*) src; \
+        TYPE lo = in[0]; \
+        TYPE hi = in[0]; \
+        for (size_t i = 1; i < n; i++) { \
+            lo = (in[i] < lo) ? in[i] : lo; \
+            hi = (in[i] > hi) ? in[i] : hi; \
+        } \
+        rawMin = (double) lo; \
+        rawMax = (double) hi; \
+    }
+
+static inline void EDNiftiMinMax(const void* src, int datatype, size_t n, float slope, float inter, float* min, float* max)
+{
+    double rawMin = 0.0;
+    double rawMax = 0.0;
+    if (0 < n) {
+        switch (datatype) {
+            case ED_NIFTI_UINT8:   ED_NIFTI_MINMAX_LOOP(uint8_t);  break;
+            case ED_NIFTI_INT8:    ED_NIFTI_MINMAX_LOOP(int8_t);   break;
+            case ED_NIFTI_INT16:   ED_NIFTI_MINMAX_LOOP(int16_t);  break;
+            case ED_NIFTI_UINT16:  ED_NIFTI_MINMAX_LOOP(uint16_t); break;
+            case ED_NIFTI_INT32:   ED_NIFTI_MINMAX_LOOP(int32_t);  break;
+            case ED_NIFTI_UINT32:  ED_NIFTI_MINMAX_LOOP(uint32_t); break;
+            case ED_NIFTI_FLOAT32: ED_NIFTI_MINMAX_LOOP(float);    break;
+            case ED_NIFTI_FLOAT64: ED_NIFTI_MINMAX_LOOP(double);   break;
+            default:
+                break;
+        }
+    }
+    float lo = (float) rawMin;
+    float hi = (float) rawMax;
+    if (0.0f != slope) {
+        lo = (float) rawMin * slope + inter;
+        hi = (float) rawMax * slope + inter;
+        if (slope < 0.0f) {
+            float tmp = lo;
+            lo = hi;
+            hi = tmp;
+        }
+    }
+    *min = lo;
+    *max = hi;
+}
+
+static inline void EDNiftiPutShort(unsigned char* bytes, size_t offset, int16_t val)
+{
+    memcpy(bytes + offset, &val, sizeof(val));
+}
+
+static inline void EDNiftiPutFloat(unsigned char* bytes, size_t offset, float val)
+{
+    memcpy(bytes + offset, &val, sizeof(val));
+}
+
+/*
+ * Fills the ED_NIFTI_DATA_OFFSET bytes preceding the voxel data of a .nii file (native
+ * byte order, 4D, no scaling) from hdr. voxOffset, bytesPerVoxel, slope and inter of hdr are ignored,
+ * indexToScanner is written as sform (scanner coordinates), voxel size in mm and repetition time in ms.
+ * Returns 0 if the sizes don't fit into the header.
+ */
+static inline int EDNiftiWriteHeader(const EDNiftiHeader* hdr, unsigned char* bytes)
+{
+    size_t sizes[4] = {hdr->columns, hdr->rows, hdr->slices, hdr->timesteps};
+    size_t bitpix = EDNiftiBytesPerVoxel(hdr->datatype) * 8;
+    for (int i = 0; i < 4; i++) {
+        if (0 == sizes[i] || 32767 < sizes[i]) {
+            return 0;
+        }
+    }
+    if (0 == bitpix) {
+        return 0;
+    }
+
+    memset(bytes, 0, ED_NIFTI_DATA_OFFSET);
+    int32_t sizeofHdr = ED_NIFTI_HEADER_SIZE;
+    memcpy(bytes, &sizeofHdr, sizeof(sizeofHdr));
+    bytes[38] = 'r';
+
+    EDNiftiPutShort(bytes, 40, 4);
+    for (int i = 0; i < 4; i++) {
+        EDNiftiPutShort(bytes, 42 + 2 * i, (int16_t) sizes[i]);
+    }
+    for (int i = 5; i < 8; i++) {
+        EDNiftiPutShort(bytes, 40 + 2 * i, 1);
+    }
+    EDNiftiPutShort(bytes, 70, (int16_t) hdr->datatype);
+    EDNiftiPutShort(bytes, 72, (int16_t) bitpix);
+
+    EDNiftiPutFloat(bytes, 76, 1.0f);
+    for (int i = 0; i < 3; i++) {
+        EDNiftiPutFloat(bytes, 80 + 4 * i, hdr->voxelSize[i]);
+    }
+    EDNiftiPutFloat(bytes, 92, hdr->repetitionTime);
+    EDNiftiPutFloat(bytes, 108, (float) ED_NIFTI_DATA_OFFSET);
+    // mm and ms
+    bytes[123] = 2 | 16;
+
+    EDNiftiPutShort(bytes, 254, 1);
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            EDNiftiPutFloat(bytes, 280 + 16 * r + 4 * c, hdr->indexToScanner[r][c]);
+        }
+    }
+    memcpy(bytes + 344, "n+1", 4);
+    return 1;
+}
+
+#endif // EDNIFTI_H
@@ -0,0 +1,102 @@
+//
+//  EDROITimeseries.h
+//  BARTApplication
+//
+
+#ifndef EDROITIMESERIES_H
+#define EDROITIMESERIES_H
+
+#import <Cocoa/Cocoa.h>
+#import "EDDataElement.h"
+
+/*
+ * Memory layout of an N x T matrix of ROI time courses (N voxels, T timesteps).
+ */
+enum TimeseriesLayout {
+    TIMESERIES_VOXEL_MAJOR,     // one row per voxel: value (voxel v, timestep t) at [v * T + t]
+    TIMESERIES_TIME_MAJOR       // one row per timestep: value (voxel v, timestep t) at [t * N + v]
+};
+
+/*
+ * Time courses of all voxels of a ROI, extracted in one pass over the data
+ * instead of one getTimeseriesDataAtRow:... call per voxel.
+ *
+ * Voxels are taken in storage order (col fastest, then row and slice), the order
+ * of the rows/columns of all matrices returned.
+ *
+ * Incremental mode for realtime data: each call of update adds the values of the
+ * volumes appended since the last call (the ROI mean and median time course are
+ * kept up to date on the way), volumes seen before are not touched again.
+ */
+@interface EDROITimeseries : NSObject {
+    EDDataElement* mData;
+
+    // ROI voxels as linear indices of one volume (col fastest), ascending
+    size_t* mVoxelIndices;
+    size_t  mVoxelCount;
+
+    // offsets of the voxels for the strides they were computed for
+    ptrdiff_t* mOffsets;
+    ptrdiff_t  mOffsetStrides[3];
+
+    // incremental mode - values are time major (N per timestep)
+    float* mValues;
+    float* mMean;
+    float* mMedian;
+    float* mScratch;
+    size_t mTimesteps;
+    size_t mCapacity;
+    size_t mSeenVolumes;
+}
+
+/*
+ * ROI voxels are all voxels of the first timestep of mask different from 0.
+ * Returns nil if mask does not match columns, rows and slices of data.
+ */
+-(id)initWithData:(EDDataElement*)data mask:(EDDataElement*)mask;
+
+-(size_t)getNrOfVoxels;
+
+/*
+ * Time courses of all ROI voxels for timesteps tstart..tend (inclusive) as N x T matrix.
+ * Returns NULL for an invalid range. The caller has to free() the result.
+ */
+-(float*)getTimeseriesFromTimestep:(uint)tstart toTimestep:(uint)tend withLayout:(enum TimeseriesLayout)layout;
+
+/*
+ * Mean (median) over all ROI voxels per timestep tstart..tend (inclusive), T values.
+ * Returns NULL for an invalid range. The caller has to free() the result.
+ */
+-(float*)getMeanTimeseriesFromTimestep:(uint)tstart toTimestep:(uint)tend;
+
+-(float*)getMedianTimeseriesFromTimestep:(uint)tstart toTimestep:(uint)tend;
+
+/*
+ * Incremental mode: extracts the volumes appended to the data since the last call
+ * (all volumes on the first call). In ring buffer mode volumes that were already
+ * overwritten are skipped. Returns the number of timesteps added.
+ */
+-(size_t)update;
+
+/*
+ * Number of timesteps collected by update so far.
+ */
+-(size_t)getNrOfTimesteps;
+
+/*
+ * Collected values, time major (getNrOfTimesteps x getNrOfVoxels). Owned by the
+ * receiver and valid until the next call of update.
+ */
+-(const float*)getValues;
+
+/*
+ * Mean (median) over the ROI per collected timestep (getNrOfTimesteps values).
+ * Owned by the receiver and valid until the next call of update.
+ */
+-(const float*)getMeanTimeseries;
+
+-(const float*)getMedianTimeseries;
+
+@end
+
+#endif // EDROITIMESERIES_H
@@ -0,0 +1,341 @@
+//
+//  EDROITimeseries.mm
+//  BARTApplication
+//
+
+#import "EDROITimeseries.h"
+#import "EDDataElementIsisRealTime.h"
+#include "EDTimeseries.h"
+
+// Number of values gathered at once when reducing to the mean/median time course.
+static const size_t REDUCTION_BLOCK_VALUES = 1 << 20;
+
+@interface EDROITimeseries (PrivateMethods)
+
+/*
+ * Writes the value of ROI voxel i at timestep tstart + t to dst[i * voxelStride + t * timeStride].
+ */
+-(BOOL)gatherFromTimestep:(size_t)tstart count:(size_t)nt into:(float*)dst voxelStride:(ptrdiff_t)voxelStride timeStride:(ptrdiff_t)timeStride;
+
+/*
+ * Offsets of the ROI voxels within a volume of the strides given.
+ */
+-(const ptrdiff_t*)offsetsFor:(const EDFloatVolume*)volume;
+
+-(BOOL)isValidRangeFrom:(uint)tstart to:(uint)tend;
+
+/*
+ * Mean (median == YES) over the ROI per timestep, processed in blocks of timesteps.
+ */
+-(float*)reduceFromTimestep:(uint)tstart toTimestep:(uint)tend median:(BOOL)median;
+
+-(BOOL)reserveTimesteps:(size_t)nrTimesteps;
+
+@end
+
+
+@implementation EDROITimeseries
+
+-(id)initWithData:(EDDataElement*)data mask:(EDDataElement*)mask
+{
+    if (self = [super init]) {
+        BARTImageSize* dataSize = [data getImageSize];
+        BARTImageSize* maskSize = [mask getImageSize];
+        if (nil == data or nil == mask
+            or dataSize.columns != maskSize.columns
+            or dataSize.rows    != maskSize.rows
+            or dataSize.slices  != maskSize.slices
+            or 0 == maskSize.timesteps){
+            NSLog(@"EDROITimeseries: mask does not match the data");
+            [self release];
+            return nil;
+        }
+        mData = [data retain];
+
+        size_t cols = maskSize.columns;
+        size_t rows = maskSize.rows;
+        size_t voxels = cols * rows * maskSize.slices;
+        mVoxelIndices = (size_t*) malloc((voxels > 0 ? voxels : 1) * sizeof(size_t));
+        if (NULL == mVoxelIndices){
+            [self release];
+            return nil;
+        }
+
+        EDFloatVolume maskVolume;
+        if ([mask getFloatVolume:&maskVolume atTimestep:0]){
+            for (size_t sl = 0; sl < maskVolume.slices; sl++){
+                for (size_t r = 0; r < maskVolume.rows; r++){
+                    for (size_t c = 0; c < maskVolume.columns; c++){
+                        if (0.0f != EDFloatVolumeGet(&maskVolume, c, r, sl, 0)){
+                            mVoxelIndices[mVoxelCount++] = (sl * rows + r) * cols + c;}}}}
+        }
+        else {
+            for (size_t sl = 0; sl < maskSize.slices; sl++){
+                EDSliceView view = [mask getSliceView:(uint) sl atTimestep:0];
+                if (NULL == view.data){
+                    [self release];
+                    return nil;
+                }
+                for (size_t r = 0; r < rows; r++){
+                    for (size_t c = 0; c < cols; c++){
+                        if (0.0f != view.data[r * view.rowStride + c]){
+                            mVoxelIndices[mVoxelCount++] = (sl * rows + r) * cols + c;}}}
+            }
+        }
+
+        mOffsets = (ptrdiff_t*) malloc((mVoxelCount > 0 ? mVoxelCount : 1) * sizeof(ptrdiff_t));
+        mScratch = (float*) malloc((mVoxelCount > 0 ? mVoxelCount : 1) * sizeof(float));
+        if (NULL == mOffsets or NULL == mScratch){
+            [self release];
+            return nil;
+        }
+        // no strides known yet
+        mOffsetStrides[0] = 0;
+        mOffsetStrides[1] = 0;
+        mOffsetStrides[2] = 0;
+    }
+    return self;
+}
+
+-(void)dealloc
+{
+    [mData release];
+    free(mVoxelIndices);
+    free(mOffsets);
+    free(mValues);
+    free(mMean);
+    free(mMedian);
+    free(mScratch);
+    [super dealloc];
+}
+
+-(size_t)getNrOfVoxels
+{
+    return mVoxelCount;
+}
+
+
+#pragma mark Batch extraction
+
+-(float*)getTimeseriesFromTimestep:(uint)tstart toTimestep:(uint)tend withLayout:(enum TimeseriesLayout)layout
+{
+    if (not [self isValidRangeFrom:tstart to:tend]){
+        return NULL;}
+    size_t nrTimesteps = tend - tstart + 1;
+    float* matrix = (float*) malloc((mVoxelCount * nrTimesteps > 0 ? mVoxelCount * nrTimesteps : 1) * sizeof(float));
+    if (NULL == matrix){
+        NSLog(@"EDROITimeseries: could not allocate %lu x %lu values", mVoxelCount, nrTimesteps);
+        return NULL;
+    }
+
+    BOOL gathered;
+    if (TIMESERIES_TIME_MAJOR == layout){
+        gathered = [self gatherFromTimestep:tstart count:nrTimesteps into:matrix voxelStride:1 timeStride:(ptrdiff_t) mVoxelCount];}
+    else {
+        gathered = [self gatherFromTimestep:tstart count:nrTimesteps into:matrix voxelStride:(ptrdiff_t) nrTimesteps timeStride:1];}
+    if (not gathered){
+        free(matrix);
+        return NULL;
+    }
+    return matrix;
+}
+
+-(float*)getMeanTimeseriesFromTimestep:(uint)tstart toTimestep:(uint)tend
+{
+    return [self reduceFromTimestep:tstart toTimestep:tend median:NO];
+}
+
+-(float*)getMedianTimeseriesFromTimestep:(uint)tstart toTimestep:(uint)tend
+{
+    return [self reduceFromTimestep:tstart toTimestep:tend median:YES];
+}
+
+-(float*)reduceFromTimestep:(uint)tstart toTimestep:(uint)tend median:(BOOL)median
+{
+    if (not [self isValidRangeFrom:tstart to:tend]){
+        return NULL;}
+    size_t nrTimesteps = tend - tstart + 1;
+    size_t blockTimesteps = (mVoxelCount > 0) ? REDUCTION_BLOCK_VALUES / mVoxelCount : nrTimesteps;
+    blockTimesteps = (blockTimesteps < 1) ? 1 : ((blockTimesteps > nrTimesteps) ? nrTimesteps : blockTimesteps);
+
+    float* result = (float*) malloc(nrTimesteps * sizeof(float));
+    float* block  = (float*) malloc((mVoxelCount * blockTimesteps > 0 ? mVoxelCount * blockTimesteps : 1) * sizeof(float));
+    if (NULL == result or NULL == block){
+        free(result);
+        free(block);
+        return NULL;
+    }
+
+    for (size_t first = 0; first < nrTimesteps; first += blockTimesteps){
+        size_t count = (nrTimesteps - first < blockTimesteps) ? nrTimesteps - first : blockTimesteps;
+        // time major, so each timestep is reduced over contiguous values
+        if (not [self gatherFromTimestep:tstart + first count:count into:block voxelStride:1 timeStride:(ptrdiff_t) mVoxelCount]){
+            free(result);
+            free(block);
+            return NULL;
+        }
+        for (size_t t = 0; t < count; t++){
+            float* values = block + t * mVoxelCount;
+            result[first + t] = median ? EDMedianOf(values, mVoxelCount) : EDMeanOf(values, mVoxelCount);
+        }
+    }
+    free(block);
+    return result;
+}
+
+
+#pragma mark Incremental mode
+
+-(size_t)update
+{
+    size_t heldTimesteps = [[mData getImageSize] timesteps];
+    size_t appendedVolumes = heldTimesteps;
+    if ([mData isKindOfClass:[EDDataElementIsisRealTime class]]){
+        appendedVolumes = [(EDDataElementIsisRealTime*) mData getNrOfAppendedVolumes];}
+    if (appendedVolumes <= mSeenVolumes){
+        return 0;}
+
+    // the newest volumes are the last ones held, older ones may already be gone (ring buffer)
+    size_t newVolumes = appendedVolumes - mSeenVolumes;
+    size_t first = (newVolumes < heldTimesteps) ? heldTimesteps - newVolumes : 0;
+    size_t count = heldTimesteps - first;
+    if (not [self reserveTimesteps:mTimesteps + count]){
+        NSLog(@"EDROITimeseries: could not allocate memory for %lu timesteps", mTimesteps + count);
+        return 0;
+    }
+    if (not [self gatherFromTimestep:first count:count into:mValues + mTimesteps * mVoxelCount
+                         voxelStride:1 timeStride:(ptrdiff_t) mVoxelCount]){
+        return 0;
+    }
+    for (size_t t = mTimesteps; t < mTimesteps + count; t++){
+        const float* values = mValues + t * mVoxelCount;
+        mMean[t] = EDMeanOf(values, mVoxelCount);
+        memcpy(mScratch, values, mVoxelCount * sizeof(float));
+        mMedian[t] = EDMedianOf(mScratch, mVoxelCount);
+    }
+    mTimesteps  += count;
+    mSeenVolumes = appendedVolumes;
+    return count;
+}
+
+-(size_t)getNrOfTimesteps
+{
+    return mTimesteps;
+}
+
+-(const float*)getValues
+{
+    return mValues;
+}
+
+-(const float*)getMeanTimeseries
+{
+    return mMean;
+}
+
+-(const float*)getMedianTimeseries
+{
+    return mMedian;
+}
+
+-(BOOL)reserveTimesteps:(size_t)nrTimesteps
+{
+    if (nrTimesteps <= mCapacity){
+        return YES;}
+    size_t capacity = (mCapacity > 0) ? mCapacity : 64;
+    while (capacity < nrTimesteps){
+        capacity *= 2;}
+
+    float* values = (float*) realloc(mValues, (mVoxelCount > 0 ? mVoxelCount : 1) * capacity * sizeof(float));
+    if (NULL == values){
+        return NO;}
+    mValues = values;
+    float* mean = (float*) realloc(mMean, capacity * sizeof(float));
+    if (NULL == mean){
+        return NO;}
+    mMean = mean;
+    float* median = (float*) realloc(mMedian, capacity * sizeof(float));
+    if (NULL == median){
+        return NO;}
+    mMedian = median;
+    mCapacity = capacity;
+    return YES;
+}
+
+
+#pragma mark Gathering
+
+-(BOOL)isValidRangeFrom:(uint)tstart to:(uint)tend
+{
+    return tstart <= tend and tend < [[mData getImageSize] timesteps];
+}
+
+-(const ptrdiff_t*)offsetsFor:(const EDFloatVolume*)volume
+{
+    if (volume->colStride != mOffsetStrides[0] or volume->rowStride != mOffsetStrides[1]
+        or volume->sliceStride != mOffsetStrides[2]){
+        size_t sliceSize = volume->columns * volume->rows;
+        for (size_t i = 0; i < mVoxelCount; i++){
+            size_t idx = mVoxelIndices[i];
+            mOffsets[i] = EDFloatVolumeOffset(volume, idx % volume->columns, (idx % sliceSize) / volume->columns, idx / sliceSize, 0);
+        }
+        mOffsetStrides[0] = volume->colStride;
+        mOffsetStrides[1] = volume->rowStride;
+        mOffsetStrides[2] = volume->sliceStride;
+    }
+    return mOffsets;
+}
+
+-(BOOL)gatherFromTimestep:(size_t)tstart count:(size_t)nt into:(float*)dst voxelStride:(ptrdiff_t)voxelStride timeStride:(ptrdiff_t)timeStride
+{
+    // one contiguous 4D store: a single pass in storage order
+    EDFloatVolume volume;
+    if ([mData getFloatVolume:&volume] and tstart + nt <= volume.timesteps){
+        EDGatherTimeseries(&volume, [self offsetsFor:&volume], mVoxelCount, tstart, nt, dst, voxelStride, timeStride);
+        return YES;
+    }
+
+    // native (non float) store: same single pass, converted on the way
+    EDTypedVolume typedVolume;
+    if ([mData getTypedVolume:&typedVolume] and ED_VOXEL_FLOAT != typedVolume.type and tstart + nt <= typedVolume.timesteps){
+        EDFloatVolume shape = {NULL, typedVolume.columns, typedVolume.rows, typedVolume.slices, typedVolume.timesteps,
+                               typedVolume.colStride, typedVolume.rowStride, typedVolume.sliceStride, typedVolume.timeStride};
+        EDGatherTypedTimeseries(&typedVolume, [self offsetsFor:&shape], mVoxelCount, tstart, nt, dst, voxelStride, timeStride);
+        return YES;
+    }
+
+    BARTImageSize* size = [mData getImageSize];
+    size_t sliceSize = size.columns * size.rows;
+    for (size_t t = 0; t < nt; t++){
+        float* out = dst + (ptrdiff_t) t * timeStride;
+        // volumes of their own (realtime data)
+        id token;
+        if ([mData getFloatVolume:&volume atTimestep:(uint) (tstart + t) token:&token]){
+            EDGatherTimeseries(&volume, [self offsetsFor:&volume], mVoxelCount, 0, 1, out, voxelStride, 0);
+            continue;
+        }
+
+        // no float store: slice by slice through views
+        NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+        EDSliceView view = {NULL, 0, nil};
+        size_t currentSlice = size.slices;
+        for (size_t i = 0; i < mVoxelCount; i++){
+            size_t idx = mVoxelIndices[i];
+            size_t sl  = idx / sliceSize;
+            if (sl != currentSlice){
+                view = [mData getSliceView:(uint) sl atTimestep:(uint) (tstart + t)];
+                currentSlice = sl;
+                if (NULL == view.data){
+                    [pool drain];
+                    return NO;
+                }
+            }
+            size_t inSlice = idx % sliceSize;
+            out[(ptrdiff_t) i * voxelStride] = view.data[(inSlice / size.columns) * view.rowStride + inSlice % size.columns];
+        }
+        [pool drain];
+    }
+    return YES;
+}
+
+@end
@@ -0,0 +1,103 @@
+/*
+ *  EDRealTimeQueue.h
+ *  BARTApplication
+ *
+ */
+
+#ifndef EDREALTIMEQUEUE_H
+#define EDREALTIMEQUEUE_H
+
+#include <vector>
+#include <stdint.h>
+#include <libkern/OSAtomic.h>
+#include <dispatch/dispatch.h>
+#include <mach/mach_time.h>
+
+/*
+ * Bounded single producer / single consumer queue connecting two stages of the realtime pipeline.
+ * Enqueue and dequeue don't take a lock: the producer only moves mTail, the consumer only mHead,
+ * memory barriers publish the slot content before the index. Two counting semaphores provide the
+ * blocking: a full queue blocks the producer (backpressure), an empty one the consumer.
+ * Exactly one thread may push and exactly one thread may pop.
+ */
+template<typename T> class EDRealTimeQueue {
+
+public:
+	EDRealTimeQueue(size_t capacity) : mSlots(capacity), mCapacity(capacity), mHead(0), mTail(0), mBlockedTime(0)
+	{
+		mFreeSlots = dispatch_semaphore_create(capacity);
+		mUsedSlots = dispatch_semaphore_create(0);
+	}
+
+	virtual ~EDRealTimeQueue()
+	{
+		dispatch_release(mFreeSlots);
+		dispatch_release(mUsedSlots);
+	}
+
+	/*
+	 * Blocks as long as the queue is full. The time spent waiting is accumulated (see blockedTime).
+	 */
+	void push(const T &item)
+	{
+		if (0 != dispatch_semaphore_wait(mFreeSlots, DISPATCH_TIME_NOW)){
+			uint64_t start = mach_absolute_time();
+			dispatch_semaphore_wait(mFreeSlots, DISPATCH_TIME_FOREVER);
+			mBlockedTime += mach_absolute_time() - start;
+		}
+		mSlots[mTail % mCapacity] = item;
+		OSMemoryBarrier();
+		mTail++;
+		dispatch_semaphore_signal(mUsedSlots);
+	}
+
+	/*
+	 * Blocks until an item is available.
+	 */
+	T pop()
+	{
+		dispatch_semaphore_wait(mUsedSlots, DISPATCH_TIME_FOREVER);
+		OSMemoryBarrier();
+		T item = mSlots[mHead % mCapacity];
+		mSlots[mHead % mCapacity] = T();
+		OSMemoryBarrier();
+		mHead++;
+		dispatch_semaphore_signal(mFreeSlots);
+		return item;
+	}
+
+	/*
+	 * Snapshot only - exact for the calling stage, approximate for everybody else.
+	 */
+	size_t size() const
+	{
+		return mTail - mHead;
+	}
+
+	size_t capacity() const
+	{
+		return mCapacity;
+	}
+
+	/*
+	 * Mach absolute time units the producer was blocked by a full queue.
+	 */
+	uint64_t blockedTime() const
+	{
+		return mBlockedTime;
+	}
+
+private:
+	EDRealTimeQueue(const EDRealTimeQueue&);
+	EDRealTimeQueue& operator=(const EDRealTimeQueue&);
+
+	std::vector<T> mSlots;
+	const size_t mCapacity;
+	volatile size_t mHead;
+	volatile size_t mTail;
+	volatile uint64_t mBlockedTime;
+	dispatch_semaphore_t mFreeSlots;
+	dispatch_semaphore_t mUsedSlots;
+};
+
+#endif // EDREALTIMEQUEUE_H
@@ -0,0 +1,53 @@
+//
+//  EDRealTimeSource.h
+//  BARTApplication
+//
+
+#ifndef EDREALTIMESOURCE_H
+#define EDREALTIMESOURCE_H
+
+#import <Cocoa/Cocoa.h>
+#import "DataStorage/image.hpp"
+#include <list>
+
+/*
+ * Where the realtime loader gets its volumes from.
+ */
+@protocol EDRealTimeSource <NSObject>
+
+/*
+ * Blocks until the next image(s) arrived. An empty list means the source is exhausted
+ * (scanner sent its terminus, replay is over).
+ */
+-(std::list<isis::data::Image>)receiveNextImages;
+
+@end
+
+
+/*
+ * The scanner feed - isis tcpip plugin.
+ */
+@interface EDRealTimeTCPIPSource : NSObject <EDRealTimeSource>
+
+@end
+
+
+/*
+ * Stands in for the scanner: loads the given files one after the other and
+ * delivers their content volume by volume, one volume per repetition time.
+ * With a repetition time of 0 the volumes are delivered as fast as possible (benchmarking).
+ */
+@interface EDRealTimeFileReplaySource : NSObject <EDRealTimeSource> {
+	NSArray *mFiles;
+	NSTimeInterval mRepetitionTime;
+	NSUInteger mNextFile;
+	size_t mNextTimestep;
+	std::list<isis::data::Image> mCurrentImage;
+	NSDate *mNextDelivery;
+}
+
+-(id)initWithFiles:(NSArray*)paths repetitionTime:(NSTimeInterval)tr;
+
+@end
+
+#endif // EDREALTIMESOURCE_H
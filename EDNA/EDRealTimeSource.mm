@@ -0,0 +1,81 @@
+//
+//  EDRealTimeSource.mm
+//  BARTApplication
+//
+
+#import "EDRealTimeSource.h"
+#import "DataStorage/io_factory.hpp"
+
+
+@implementation EDRealTimeTCPIPSource
+
+-(std::list<isis::data::Image>)receiveNextImages
+{
+	return isis::data::IOFactory::load("", ".tcpip", "");
+}
+
+@end
+
+
+@implementation EDRealTimeFileReplaySource
+
+-(id)initWithFiles:(NSArray*)paths repetitionTime:(NSTimeInterval)tr
+{
+	if (self = [super init]) {
+		mFiles = [paths copy];
+		mRepetitionTime = tr;
+		mNextFile = 0;
+		mNextTimestep = 0;
+		mNextDelivery = nil;
+	}
+	return self;
+}
+
+-(void)dealloc
+{
+	[mFiles release];
+	[mNextDelivery release];
+	[super dealloc];
+}
+
+-(std::list<isis::data::Image>)receiveNextImages
+{
+	std::list<isis::data::Image> volumes;
+
+	// next file if the current one is used up (or could not be loaded)
+	while (mCurrentImage.empty() or mNextTimestep >= mCurrentImage.front().getNrOfTimesteps()){
+		mCurrentImage.clear();
+		mNextTimestep = 0;
+		if (mNextFile >= [mFiles count]){
+			return volumes;}
+
+		NSString *path = [mFiles objectAtIndex:mNextFile++];
+		std::list<isis::data::Image> images = isis::data::IOFactory::load([path cStringUsingEncoding:NSUTF8StringEncoding], "", "");
+		if (images.empty()){
+			NSLog(@"Replay: could not load %@ - skipped", path);
+			continue;
+		}
+		mCurrentImage.push_back(images.front());
+		mCurrentImage.front().spliceDownTo(isis::data::sliceDim);
+	}
+
+	// one volume out of the (4D) image, just like the scanner sends it
+	isis::data::Image &img = mCurrentImage.front();
+	std::list<isis::data::Chunk> chList;
+	for (size_t sl = 0; sl < img.getNrOfSlices(); sl++){
+		chList.push_back(img.getChunk(0, 0, sl, mNextTimestep, true));}
+	mNextTimestep++;
+
+	// keep the pace of the scanner
+	if (0.0 < mRepetitionTime){
+		if (nil != mNextDelivery){
+			[NSThread sleepUntilDate:mNextDelivery];}
+		[mNextDelivery release];
+		mNextDelivery = [[NSDate alloc] initWithTimeIntervalSinceNow:mRepetitionTime];
+	}
+
+	volumes.push_back(isis::data::Image(chList));
+	return volumes;
+}
+
+@end
@@ -0,0 +1,80 @@
+//
+//  EDStageCounters.h
+//  BARTApplication
+//
+
+#ifndef EDSTAGECOUNTERS_H
+#define EDSTAGECOUNTERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+/*
+ * Counters of one stage of the realtime pipeline, all times in mach absolute time units.
+ * Written by the owning stage thread, read by whoever asks for statistics - both only
+ * with the lock shared by all stages held (the functions below), so a snapshot is
+ * consistent across stages.
+ * Plain C, so the locking can be checked without the pipeline (tests/stage_counters_check.c).
+ */
+typedef struct {
+    uint64_t volumes;
+    uint64_t processingTime;
+    uint64_t maxProcessingTime;
+    uint64_t queueTime;
+    uint64_t blockedTime;
+    uint64_t totalLatency;
+    uint64_t maxTotalLatency;
+} EDStageCounters;
+
+/*
+ * Accounts a volume that was enqueued at enqueuedAt, processed from start to end and
+ * received (entered the pipeline) at receivedAt.
+ */
+static inline void EDStageRecord(pthread_mutex_t* lock, EDStageCounters* counters,
+                                 uint64_t enqueuedAt, uint64_t start, uint64_t end, uint64_t receivedAt)
+{
+    pthread_mutex_lock(lock);
+    counters->volumes++;
+    counters->processingTime += end - start;
+    if (end - start > counters->maxProcessingTime) {
+        counters->maxProcessingTime = end - start;
+    }
+    counters->queueTime += start - enqueuedAt;
+    counters->totalLatency += end - receivedAt;
+    if (end - receivedAt > counters->maxTotalLatency) {
+        counters->maxTotalLatency = end - receivedAt;
+    }
+    pthread_mutex_unlock(lock);
+}
+
+/*
+ * Sets the time the stage was blocked by its full output queue (a running total).
+ */
+static inline void EDStageSetBlockedTime(pthread_mutex_t* lock, EDStageCounters* counters, uint64_t blockedTime)
+{
+    pthread_mutex_lock(lock);
+    counters->blockedTime = blockedTime;
+    pthread_mutex_unlock(lock);
+}
+
+/*
+ * Copies count counters to snapshot in one go.
+ */
+static inline void EDStageSnapshot(pthread_mutex_t* lock, const EDStageCounters* counters, size_t count,
+                                   EDStageCounters* snapshot)
+{
+    pthread_mutex_lock(lock);
+    memcpy(snapshot, counters, count * sizeof(EDStageCounters));
+    pthread_mutex_unlock(lock);
+}
+
+static inline void EDStageReset(pthread_mutex_t* lock, EDStageCounters* counters, size_t count)
+{
+    pthread_mutex_lock(lock);
+    memset(counters, 0, count * sizeof(EDStageCounters));
+    pthread_mutex_unlock(lock);
+}
+
+#endif // EDSTAGECOUNTERS_H
@@ -0,0 +1,44 @@
+//
+//  EDStorageToken.h
+//  BARTApplication
+//
+
+#ifndef EDSTORAGETOKEN_H
+#define EDSTORAGETOKEN_H
+
+#import <Cocoa/Cocoa.h>
+#import "EDDataElement.h"
+#import "DataStorage/image.hpp"
+
+/*
+ * Deleter for isis chunks aliasing a part of a volume store. The memory belongs to the
+ * store, each chunk only holds a reference on it (so it's freed together with the last chunk or token).
+ * Works for chunks of any voxel type (the owner is type erased, float and native stores alike).
+ */
+struct EDVolumeStoreReference {
+    boost::shared_ptr<void> mStorage;
+    EDVolumeStoreReference(const boost::shared_ptr<void> &storage) : mStorage(storage) {}
+    template<typename T> void operator()(T*) { mStorage.reset(); }
+};
+
+/*
+ * Lifetime token handed out with borrowed views (EDSliceView).
+ * As long as the token lives the storage it references (of whatever voxel type) is not
+ * deallocated, even if the data element the view was taken from is gone already.
+ */
+@interface EDStorageToken : NSObject {
+    boost::shared_ptr<void> mStorage;
+}
+
+-(id)initWithStorage:(boost::shared_ptr<void>)storage;
+
+/*
+ * Creates a view on slice sl at timestep t of a (preferably slice-chunked) isis image.
+ * If the slice is a float 2D chunk of its own (what spliceDownTo(sliceDim) gives us) the chunk
+ * memory is shared, otherwise the slice is converted once and the view points to that copy.
+ */
++(EDSliceView)sliceViewOf:(isis::data::Image*)image slice:(size_t)sl timestep:(size_t)t;
+
+@end
+
+#endif // EDSTORAGETOKEN_H
@@ -0,0 +1,61 @@
+//
+//  EDStorageToken.mm
+//  BARTApplication
+//
+
+#import "EDStorageToken.h"
+
+@implementation EDStorageToken
+
+-(id)initWithStorage:(boost::shared_ptr<void>)storage
+{
+    if (self = [super init]) {
+        mStorage = storage;
+    }
+    return self;
+}
+
+-(void)dealloc
+{
+    mStorage.reset();
+    [super dealloc];
+}
+
++(EDSliceView)sliceViewOf:(isis::data::Image*)image slice:(size_t)sl timestep:(size_t)t
+{
+    EDSliceView view = {NULL, 0, nil};
+    if (NULL == image){
+        return view;
+    }
+
+    size_t cols = image->getNrOfColumns();
+    size_t rows = image->getNrOfRows();
+
+    isis::data::Chunk chSlice = image->getChunk(0, 0, sl, t, false);
+    boost::shared_ptr<float> storage;
+    if (1 == chSlice.getNrOfSlices() and 1 == chSlice.getNrOfTimesteps()){
+        if (isis::data::ValueArray<float>::staticID == chSlice.getTypeID()){
+            // the usual case - loaded data is converted to float and sliced already, so just share the chunk
+            storage = (boost::shared_ptr<float>) chSlice.getValueArray<float>();
+        }
+        else {
+            isis::data::MemChunk<float> floatSlice(chSlice);
+            storage = (boost::shared_ptr<float>) floatSlice.getValueArray<float>();
+        }
+    }
+    else {
+        // chunk spans more than this slice - fall back to a copy of the slice
+        isis::data::MemChunk<float> floatSlice(cols, rows);
+        for (size_t r = 0; r < rows; r++){
+            for (size_t c = 0; c < cols; c++){
+                floatSlice.voxel<float>(c, r) = image->voxel<float>(c, r, sl, t);}}
+        storage = (boost::shared_ptr<float>) floatSlice.getValueArray<float>();
+    }
+
+    view.data      = storage.get();
+    view.rowStride = cols;
+    view.token     = [[[EDStorageToken alloc] initWithStorage:storage] autorelease];
+    return view;
+}
+
+@end
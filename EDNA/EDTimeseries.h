@@ -0,0 +1,134 @@
+//
+//  EDTimeseries.h
+//  BARTApplication
+//
+
+#ifndef EDTIMESERIES_H
+#define EDTIMESERIES_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include "EDFloatVolume.h"
+#include "EDTypedVolume.h"
+
+/*
+ * Copies the time courses of n voxels for timesteps [tstart, tstart + nt) of v into
+ * dst[i * voxelStride + t * timeStride] (voxel i at v->data[offsets[i] + t * v->timeStride]).
+ * Visits the source in the order it is stored: timestep by timestep for the usual
+ * (slice major) layout, voxel by voxel if the timesteps of a voxel lie closer
+ * together than its neighbouring columns.
+ */
+static inline void EDGatherTimeseries(const EDFloatVolume* v, const ptrdiff_t* offsets, size_t n,
+                                      size_t tstart, size_t nt,
+                                      float* dst, ptrdiff_t voxelStride, ptrdiff_t timeStride)
+{
+    ptrdiff_t srcTimeStride = v->timeStride;
+    const float* base = v->data + (ptrdiff_t) tstart * srcTimeStride;
+    if (nt > 1 && labs((long) srcTimeStride) < labs((long) v->colStride)) {
+        for (size_t i = 0; i < n; i++) {
+            const float* src = base + offsets[i];
+            float* out = dst + (ptrdiff_t) i * voxelStride;
+            for (size_t t = 0; t < nt; t++) {
+                out[(ptrdiff_t) t * timeStride] = src[(ptrdiff_t) t * srcTimeStride];
+            }
+        }
+    } else {
+        for (size_t t = 0; t < nt; t++) {
+            const float* src = base + (ptrdiff_t) t * srcTimeStride;
+            float* out = dst + (ptrdiff_t) t * timeStride;
+            for (size_t i = 0; i < n; i++) {
+                out[(ptrdiff_t) i * voxelStride] = src[offsets[i]];
+            }
+        }
+    }
+}
+
+/*
+ * EDGatherTimeseries for a typed store, converting to float on the way.
+ * Offsets are given in voxels of v, timestep by timestep (native stores are slice major).
+ */
+static inline void EDGatherTypedTimeseries(const EDTypedVolume* v, const ptrdiff_t* offsets, size_t n,
+                                           size_t tstart, size_t nt,
+                                           float* dst, ptrdiff_t voxelStride, ptrdiff_t timeStride)
+{
+    for (size_t t = 0; t < nt; t++) {
+        const void* src = EDTypedVoxelAt(v->data, v->type, (ptrdiff_t) (tstart + t) * v->timeStride);
+        float* out = dst + (ptrdiff_t) t * timeStride;
+        for (size_t i = 0; i < n; i++) {
+            out[(ptrdiff_t) i * voxelStride] = EDTypedLoad(src, v->type, offsets[i]);
+        }
+    }
+}
+
+/*
+ * Mean of n values (accumulated in double precision), 0 for n == 0.
+ */
+static inline float EDMeanOf(const float* values, size_t n)
+{
+    if (0 == n) {
+        return 0.0f;
+    }
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sum += values[i];
+    }
+    return (float) (sum / n);
+}
+
+/*
+ * k-th smallest of n values (quickselect, expected linear time). Reorders values!
+ */
+static inline float EDSelectNth(float* values, size_t n, size_t k)
+{
+    size_t lo = 0;
+    size_t hi = n - 1;
+    while (lo < hi) {
+        float pivot = values[lo + (hi - lo) / 2];
+        size_t i = lo;
+        size_t j = hi;
+        while (i <= j) {
+            while (values[i] < pivot) i++;
+            while (values[j] > pivot) j--;
+            if (i <= j) {
+                float tmp = values[i];
+                values[i] = values[j];
+                values[j] = tmp;
+                i++;
+                if (0 == j) {
+                    break;
+                }
+                j--;
+            }
+        }
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            break;
+        }
+    }
+    return values[k];
+}
+
+/*
+ * Median of n values (mean of the two middle ones for even n), 0 for n == 0. Reorders values!
+ */
+static inline float EDMedianOf(float* values, size_t n)
+{
+    if (0 == n) {
+        return 0.0f;
+    }
+    float upper = EDSelectNth(values, n, n / 2);
+    if (n % 2 == 1) {
+        return upper;
+    }
+    // after the selection all values below n / 2 are <= upper, the largest of them is the lower middle
+    float lower = values[0];
+    for (size_t i = 1; i < n / 2; i++) {
+        lower = (values[i] > lower) ? values[i] : lower;
+    }
+    return 0.5f * (lower + upper);
+}
+
+#endif // EDTIMESERIES_H
@@ -0,0 +1,265 @@
+//
+//  EDTypedVolume.h
+//  BARTApplication
+//
+
+#ifndef EDTYPEDVOLUME_H
+#define EDTYPEDVOLUME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include "EDFloatVolume.h"
+
+/*
+ * Voxel types a volume store can be kept in. Everything else is promoted to float.
+ */
+enum EDVoxelType {
+    ED_VOXEL_FLOAT,
+    ED_VOXEL_INT16,
+    ED_VOXEL_UINT16,
+    ED_VOXEL_UINT8,
+    ED_VOXEL_INT8
+};
+
+static inline size_t EDVoxelTypeSize(enum EDVoxelType type)
+{
+    switch (type) {
+        case ED_VOXEL_INT16:
+        case ED_VOXEL_UINT16:
+            return 2;
+        case ED_VOXEL_UINT8:
+        case ED_VOXEL_INT8:
+            return 1;
+        default:
+            return sizeof(float);
+    }
+}
+
+/*
+ * Same as EDFloatVolume for a store of voxels of any EDVoxelType.
+ * Strides are given in number of voxels (not bytes).
+ */
+typedef struct {
+    void*            data;
+    enum EDVoxelType type;
+    size_t           columns;
+    size_t           rows;
+    size_t           slices;
+    size_t           timesteps;
+    ptrdiff_t        colStride;
+    ptrdiff_t        rowStride;
+    ptrdiff_t        sliceStride;
+    ptrdiff_t        timeStride;
+} EDTypedVolume;
+
+static inline void EDTypedVolumeInitSliceMajor(EDTypedVolume* v, void* data, enum EDVoxelType type,
+                                               size_t cols, size_t rows, size_t slices, size_t timesteps)
+{
+    v->data        = data;
+    v->type        = type;
+    v->columns     = cols;
+    v->rows        = rows;
+    v->slices      = slices;
+    v->timesteps   = timesteps;
+    v->colStride   = 1;
+    v->rowStride   = (ptrdiff_t) cols;
+    v->sliceStride = (ptrdiff_t) (cols * rows);
+    v->timeStride  = (ptrdiff_t) (cols * rows * slices);
+}
+
+/*
+ * Describes a float volume as typed one (sharing its data and strides).
+ */
+static inline void EDTypedVolumeFromFloat(EDTypedVolume* v, const EDFloatVolume* f)
+{
+    v->data        = f->data;
+    v->type        = ED_VOXEL_FLOAT;
+    v->columns     = f->columns;
+    v->rows        = f->rows;
+    v->slices      = f->slices;
+    v->timesteps   = f->timesteps;
+    v->colStride   = f->colStride;
+    v->rowStride   = f->rowStride;
+    v->sliceStride = f->sliceStride;
+    v->timeStride  = f->timeStride;
+}
+
+static inline int EDTypedVolumeContains(const EDTypedVolume* v, size_t c, size_t r, size_t s, size_t t)
+{
+    return c < v->columns && r < v->rows && s < v->slices && t < v->timesteps;
+}
+
+static inline ptrdiff_t EDTypedVolumeOffset(const EDTypedVolume* v, size_t c, size_t r, size_t s, size_t t)
+{
+    return (ptrdiff_t) c * v->colStride
+         + (ptrdiff_t) r * v->rowStride
+         + (ptrdiff_t) s * v->sliceStride
+         + (ptrdiff_t) t * v->timeStride;
+}
+
+/*
+ * Address of the voxel offset voxels behind base.
+ */
+static inline const void* EDTypedVoxelAt(const void* base, enum EDVoxelType type, ptrdiff_t offset)
+{
+    return (const char*) base + offset * (ptrdiff_t) EDVoxelTypeSize(type);
+}
+
+static inline float EDTypedLoad(const void* base, enum EDVoxelType type, ptrdiff_t i)
+{
+    switch (type) {
+        case ED_VOXEL_INT16:  return (float) ((const int16_t*) base)[i];
+        case ED_VOXEL_UINT16: return (float) ((const uint16_t*) base)[i];
+        case ED_VOXEL_UINT8:  return (float) ((const uint8_t*) base)[i];
+        case ED_VOXEL_INT8:   return (float) ((const int8_t*) base)[i];
+        default:              return ((const float*) base)[i];
+    }
+}
+
+/*
+ * Stores val rounded to the nearest value representable in type (saturated).
+ */
+#define ED_TYPED_STORE(TYPE, LO, HI) \
+    { \
+        float r = rintf(val); \
+        ((TYPE*) base)[i] = (TYPE) ((r < (LO)) ? (LO) : ((r > (HI)) ? (HI) : r)); \
+    }
+
+static inline void EDTypedStore(void* base, enum EDVoxelType type, ptrdiff_t i, float val)
+{
+    switch (type) {
+        case ED_VOXEL_INT16:  ED_TYPED_STORE(int16_t, -32768.0f, 32767.0f); break;
+        case ED_VOXEL_UINT16: ED_TYPED_STORE(uint16_t, 0.0f, 65535.0f);     break;
+        case ED_VOXEL_UINT8:  ED_TYPED_STORE(uint8_t, 0.0f, 255.0f);        break;
+        case ED_VOXEL_INT8:   ED_TYPED_STORE(int8_t, -128.0f, 127.0f);      break;
+        default:              ((float*) base)[i] = val;                     break;
+    }
+}
+
+/*
+ * Unchecked voxel access - use EDTypedVolumeContains if indices are not known to be valid.
+ */
+static inline float EDTypedVolumeGet(const EDTypedVolume* v, size_t c, size_t r, size_t s, size_t t)
+{
+    return EDTypedLoad(v->data, v->type, EDTypedVolumeOffset(v, c, r, s, t));
+}
+
+static inline void EDTypedVolumeSet(EDTypedVolume* v, size_t c, size_t r, size_t s, size_t t, float val)
+{
+    EDTypedStore(v->data, v->type, EDTypedVolumeOffset(v, c, r, s, t), val);
+}
+
+/*
+ * Pointer to voxel (0, 0, s, t). Rows of that slice follow with rowStride.
+ */
+static inline void* EDTypedVolumeSlice(const EDTypedVolume* v, size_t s, size_t t)
+{
+    return (void*) EDTypedVoxelAt(v->data, v->type, (ptrdiff_t) s * v->sliceStride + (ptrdiff_t) t * v->timeStride);
+}
+
+/*
+ * dst[i] = src[i * srcStride] converted to float, i in [0, count).
+ * One loop per type, so the compiler can vectorise the conversion of dense rows.
+ */
+#define ED_TYPED_TO_FLOAT_LOOP(TYPE) \
+    { \
+        const TYPE* in = (const TYPE*) src; \
+        if (1 == srcStride) { \
+            for (size_t i = 0; i < count; i++) { dst[i] = (float) in[i]; } \
+        } else { \
+            for (size_t i = 0; i < count; i++) { dst[i] = (float) in[(ptrdiff_t) i * srcStride]; } \
+        } \
+    }
+
+static inline void EDTypedToFloat(const void* src, enum EDVoxelType type, ptrdiff_t srcStride, size_t count, float* dst)
+{
+    switch (type) {
+        case ED_VOXEL_INT16:  ED_TYPED_TO_FLOAT_LOOP(int16_t);  break;
+        case ED_VOXEL_UINT16: ED_TYPED_TO_FLOAT_LOOP(uint16_t); break;
+        case ED_VOXEL_UINT8:  ED_TYPED_TO_FLOAT_LOOP(uint8_t);  break;
+        case ED_VOXEL_INT8:   ED_TYPED_TO_FLOAT_LOOP(int8_t);   break;
+        default:              ED_TYPED_TO_FLOAT_LOOP(float);    break;
+    }
+}
+
+/*
+ * Copies slice s of timestep t, converted to float, to dst (columns * rows floats).
+ * The rows of the copy are packed densely - returns its row stride (columns).
+ */
+static inline ptrdiff_t EDTypedVolumeSliceToFloat(const EDTypedVolume* v, size_t s, size_t t, float* dst)
+{
+    const void* src = EDTypedVolumeSlice(v, s, t);
+    for (size_t r = 0; r < v->rows; r++) {
+        EDTypedToFloat(EDTypedVoxelAt(src, v->type, (ptrdiff_t) r * v->rowStride), v->type,
+                       v->colStride, v->columns, dst + r * v->columns);
+    }
+    return (ptrdiff_t) v->columns;
+}
+
+/*
+ * dst[i * dstStride] = src[i] rounded/saturated to type, i in [0, count).
+ */
+static inline void EDTypedFromFloat(const float* src, size_t count, void* dst, enum EDVoxelType type, ptrdiff_t dstStride)
+{
+    for (size_t i = 0; i < count; i++) {
+        EDTypedStore(dst, type, (ptrdiff_t) i * dstStride, src[i]);
+    }
+}
+
+/*
+ * Min/max of count densely stored voxels (0/0 for count == 0).
+ */
+#define ED_TYPED_MINMAX_LOOP(TYPE) \
+    { \
+        const TYPE* in = (const TYPE*) src; \
+        TYPE lo = in[0]; \
+        TYPE hi = in[0]; \
+        for (size_t i = 1; i < count; i++) { \
+            lo = (in[i] < lo) ? in[i] : lo; \
+            hi = (in[i] > hi) ? in[i] : hi; \
+        } \
+        *min = (float) lo; \
+        *max = (float) hi; \
+    }
+
+static inline void EDTypedMinMax(const void* src, enum EDVoxelType type, size_t count, float* min, float* max)
+{
+    if (0 == count) {
+        *min = 0.0f;
+        *max = 0.0f;
+        return;
+    }
+    switch (type) {
+        case ED_VOXEL_INT16:  ED_TYPED_MINMAX_LOOP(int16_t);  break;
+        case ED_VOXEL_UINT16: ED_TYPED_MINMAX_LOOP(uint16_t); break;
+        case ED_VOXEL_UINT8:  ED_TYPED_MINMAX_LOOP(uint8_t);  break;
+        case ED_VOXEL_INT8:   ED_TYPED_MINMAX_LOOP(int8_t);   break;
+        default:              ED_TYPED_MINMAX_LOOP(float);    break;
+    }
+}
+
+#ifdef __cplusplus
+
+/*
+ * Compile time mapping of C++ voxel types to EDVoxelType, for templated kernels:
+ * EDVoxelTypeOf<int16_t>::value == ED_VOXEL_INT16. Not defined for unsupported types.
+ */
+template<typename T> struct EDVoxelTypeOf;
+template<> struct EDVoxelTypeOf<float>    { static const enum EDVoxelType value = ED_VOXEL_FLOAT; };
+template<> struct EDVoxelTypeOf<int16_t>  { static const enum EDVoxelType value = ED_VOXEL_INT16; };
+template<> struct EDVoxelTypeOf<uint16_t> { static const enum EDVoxelType value = ED_VOXEL_UINT16; };
+template<> struct EDVoxelTypeOf<uint8_t>  { static const enum EDVoxelType value = ED_VOXEL_UINT8; };
+template<> struct EDVoxelTypeOf<int8_t>   { static const enum EDVoxelType value = ED_VOXEL_INT8; };
+
+/*
+ * Typed voxel pointer of a volume of known type T.
+ */
+template<typename T> static inline T* EDTypedVolumeData(const EDTypedVolume* v)
+{
+    return (EDVoxelTypeOf<T>::value == v->type) ? static_cast<T*>(v->data) : NULL;
+}
+
+#endif // __cplusplus
+
+#endif // EDTYPEDVOLUME_H
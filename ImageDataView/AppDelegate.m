@@ -9,6 +9,7 @@
 #import "AppDelegate.h"
 #import "BAImageDataViewController.h"
 #import "BAROIController.h"
+#import "BADataElementLoader.h"
 
 #import "EDDataElement.h"
 
@@ -39,18 +40,16 @@
 //                                                             andDialect:@"" 
 //                                                            ofImageType:IMAGE_ANADATA];
     
-    EDDataElement* background = [[EDDataElement alloc] initWithDataFile:@"/Users/olli/test/reg3d_test_scansoliver/14265.5c_fun_sagittal_64x64.nii" 
-                                                              andSuffix:@"" 
-                                                             andDialect:@"" 
-                                                            ofImageType:IMAGE_FCTDATA];
-    
-    EDDataElement* image = [[EDDataElement alloc] initWithDataFile:@"/Users/olli/test/reg3d_test_scansoliver/14265.5c_fun_sagittal_64x64.nii" 
-                                                         andSuffix:@"" 
-                                                        andDialect:@"" 
-                                                       ofImageType:IMAGE_FCTDATA];
-    
-    [imageDataViewController setBackgroundImage:background];
-    [imageDataViewController addOverlayImage:image withID:@"funData"];
+    // Both files are loaded in parallel and show up in the view as soon as they are there
+    // (the loader keeps itself alive until it is done)
+    BADataElementLoader* loader = [[BADataElementLoader alloc] initWithViewController:imageDataViewController
+                                                                   maxConcurrentLoads:DEFAULT_CONCURRENT_LOADS];
+    [loader loadBackgroundFile:@"/Users/olli/test/reg3d_test_scansoliver/14265.5c_fun_sagittal_64x64.nii" 
+                   ofImageType:IMAGE_FCTDATA];
+    [loader loadOverlayFile:@"/Users/olli/test/reg3d_test_scansoliver/14265.5c_fun_sagittal_64x64.nii" 
+                ofImageType:IMAGE_FCTDATA
+                     withID:@"funData"];
+    [loader release];
     
     // For ROI testing purposes
     [[imageDataViewController getROIController] addROI:@"TestROI"];
@@ -59,8 +58,6 @@
     [[imageDataViewController getROIController] removeROI:@"ROI2"];
     
 //    [imageDataViewController release];
-//    [image release];
-//    [background release];
 }
 
 @end
@@ -31,6 +31,11 @@
     /** Background image. Usually anatomical data or an anatomical reference image. */
     NSImage* mBackgroundImage;
     
+    /** Opacity the selection, foreground and background image are composited with. */
+    float mSelectionAlpha;
+    float mForegroundAlpha;
+    float mBackgroundAlpha;
+    
 }
 
 /** Sets selection, foreground and background image in one function call.
@@ -43,6 +48,18 @@
               on:(NSImage*)foreground
               on:(NSImage*)background;
 
+/** Sets the opacity each image is composited with (usually the getCompositeAlpha of the
+ * BADataElementRenderer that rendered it). Takes effect when the next image is set.
+ * Default: 1 for all images.
+ *
+ * \param selection  Opacity of the selection image in [0, 1].
+ * \param foreground Opacity of the foreground image in [0, 1].
+ * \param background Opacity of the background image in [0, 1].
+ */
+-(void)setAlphas:(float)selection
+              on:(float)foreground
+              on:(float)background;
+
 /** Sets the selection NSImage.
  * The selection image marks selected voxels (e.g. ROI) in the view.
  *
@@ -74,4 +91,16 @@
 -(NSImage*)createCompositeImage:(NSImage*)foreground
                              on:(NSImage*)background;
 
+/** Creates a new image being the composite of all layers, blended in a single pass
+ * (source over, no interpolation). Layers of a different (bitmap) size than the first
+ * one are scaled to cover it.
+ *
+ * \param layers NSImage objects to composite, bottom (usually the background) first.
+ *               All of them are composited fully opaque.
+ * \return       A new NSImage of the (bitmap and display) size of the first layer.
+ *               MEMORY MANAGEMENT: Caller is responsible for releasing the created NSImage object!
+ *               Nil if layers is empty or the images could not be composited.
+ */
+-(NSImage*)createCompositeImageOf:(NSArray*)layers;
+
 @end
@@ -10,6 +10,7 @@
 
 #import "BAImageSliceSelector.h"
 #import "BADataElementRenderer.h"
+#import "BACompositeKernels.h"
 
 
 
@@ -28,6 +29,31 @@
  */
 -(NSImage*)getTopmostImage;
 
+/** Composites images as createCompositeImageOf: does, each with its own opacity.
+ *
+ * \param layers NSImage objects to composite, bottom (usually the background) first.
+ * \param alphas Opacity of each layer.
+ * \return       A new NSImage (to be released by the caller), nil on failure.
+ */
+-(NSImage*)createCompositeImageOf:(NSArray*)layers
+                           alphas:(const float*)alphas;
+
+/** Describes the pixels of an NSImage as a composite layer.
+ * The premultiplied RGBA8 bitmap of the image (as created by BADataElementRenderer) is
+ * used in place. Images without such a bitmap are drawn into a buffer of their pixel size.
+ *
+ * \param layer  Layer description to fill in.
+ * \param image  Source NSImage. Has to stay alive while the layer is in use.
+ * \param alpha  Opacity of the layer.
+ * \param buffer Set to the buffer the image was drawn into (to be freed by the caller),
+ *               NULL if the bitmap of the image is used.
+ * \return       YES on success.
+ */
+-(BOOL)fillLayer:(BACompositeLayer*)layer
+            from:(NSImage*)image
+           alpha:(float)alpha
+          buffer:(uint8_t**)buffer;
+
 @end
 
 
@@ -39,6 +65,9 @@
     if (self = [super initWithFrame:frame]) {
         self->mBackgroundImage = nil;
         self->mForegroundImage = nil;
+        self->mSelectionAlpha  = 1.0f;
+        self->mForegroundAlpha = 1.0f;
+        self->mBackgroundAlpha = 1.0f;
     }
     
     return self;
@@ -91,6 +120,15 @@
     [self updateSetImage];
 }
 
+-(void)setAlphas:(float)selection
+              on:(float)foreground
+              on:(float)background
+{
+    self->mSelectionAlpha  = selection;
+    self->mForegroundAlpha = foreground;
+    self->mBackgroundAlpha = background;
+}
+
 -(void)setSelectionImage:(NSImage*)newImage
 {
     if (self->mSelectionImage != nil) [self->mSelectionImage release];
@@ -144,97 +182,172 @@
         if (foreground == nil) {
             return [background copy];
         } else {
-            // Both arguments are not nil, actually draw composite
-            NSImage* drawArea = [background copy];
-            
-            // Determine actual (bitmap) sizes for drawing purposes
-            // http://borkware.com/quickies/one?topic=NSImage
-            NSArray* imageReps;
-            NSImageRep* imageRep;
-            
-            NSSize bgSize;
-            imageReps = [background representations];
-            imageRep  = [imageReps objectAtIndex:0];
-            bgSize.width  = [imageRep pixelsWide];
-            bgSize.height = [imageRep pixelsHigh];
-            
-            NSSize fgSize;
-            imageReps = [foreground representations];
-            imageRep  = [imageReps objectAtIndex:0];
-            fgSize.width  = [imageRep pixelsWide];
-            fgSize.height = [imageRep pixelsHigh];
-            
-            // Set actual (bitmap) representation sizes
-            [drawArea setSize:bgSize];
-            [foreground setSize:fgSize];
-            
-            // Use NSImage composite
-            // http://www.bdunagan.com/2010/01/25/cocoa-tip-nsimage-composites/
-            [drawArea lockFocus];
-            
-            [[NSGraphicsContext currentContext] setImageInterpolation:NSImageInterpolationNone];
-            [foreground drawInRect:NSMakeRect(0, 0, bgSize.width, bgSize.height)
-                          fromRect:NSZeroRect
-                         operation:NSCompositeSourceOver
-                          fraction:1.0];
-            
-            [drawArea unlockFocus];
-            
-            // Restore size
-            [drawArea setSize:[background size]];
-            
-            return drawArea;
+            return [self createCompositeImageOf:[NSArray arrayWithObjects:background, foreground, nil]];
         }
     }
 }
 
--(void)updateSetImage
+-(NSImage*)createCompositeImageOf:(NSArray*)layers
 {
-    // All three images present.
-    if (self->mSelectionImage != nil && self->mForegroundImage != nil && self->mBackgroundImage != nil) {
-        NSImage* composite  = [self createCompositeImage:self->mSelectionImage
-                                                      on:self->mForegroundImage];
-        NSImage* composite2 = [self createCompositeImage:composite
-                                                      on:self->mBackgroundImage];
-        [self setImage:composite2];
-        [composite2 release];
-        [composite  release];
-        return;
+    NSUInteger count = [layers count];
+    float* alphas = malloc(count * sizeof(float));
+    for (NSUInteger i = 0; i < count; i++) {
+        alphas[i] = 1.0f;
+    }
+    
+    NSImage* composite = [self createCompositeImageOf:layers alphas:alphas];
+    free(alphas);
+    
+    return composite;
+}
+
+-(NSImage*)createCompositeImageOf:(NSArray*)layers
+                           alphas:(const float*)alphas
+{
+    NSUInteger count = [layers count];
+    if (count == 0) {
+        return nil;
+    }
+    
+    BACompositeLayer* compositeLayers = calloc(count, sizeof(BACompositeLayer));
+    uint8_t**         buffers         = calloc(count, sizeof(uint8_t*));
+    for (NSUInteger i = 0; i < count; i++) {
+        [self fillLayer:&compositeLayers[i] from:[layers objectAtIndex:i] alpha:alphas[i] buffer:&buffers[i]];
+    }
+    
+    // The bottom layer determines the (bitmap) size, all other layers are scaled to it
+    size_t width  = compositeLayers[0].width;
+    size_t height = compositeLayers[0].height;
+    uint8_t* pixels = malloc(width * height * 4);
+    BOOL composited = pixels != NULL
+                   && BACompositeLayers(compositeLayers, count, pixels, width, height, width * 4);
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        free(buffers[i]);
     }
+    free(buffers);
+    free(compositeLayers);
     
-    // Single image.
-    if (self->mSelectionImage != nil && self->mForegroundImage == nil && self->mBackgroundImage == nil) {
-        return [self setImage:self->mSelectionImage];
+    if (!composited || width == 0 || height == 0) {
+        NSLog(@"BABrainImageView: could not composite %lu images of size %lux%lu", count, width, height);
+        free(pixels);
+        return nil;
     }
-    if (self->mSelectionImage == nil && self->mForegroundImage != nil && self->mBackgroundImage == nil) {
-        return [self setImage:self->mForegroundImage];
+    
+    NSData* pixelData = [NSData dataWithBytesNoCopy:pixels
+                                             length:width * height * 4
+                                       freeWhenDone:YES];
+    CGDataProviderRef provider   = CGDataProviderCreateWithCFData((CFDataRef) pixelData);
+    CGColorSpaceRef   colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGImageRef        cgImage    = CGImageCreate(width, height, 8, 32, width * 4,
+                                                 colorSpace, kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big, provider,
+                                                 NULL, false, kCGRenderingIntentDefault);
+    
+    NSImage* composite = [[NSImage alloc] initWithCGImage:cgImage
+                                                     size:[[layers objectAtIndex:0] size]];
+    
+    CGImageRelease(cgImage);
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
+    
+    return composite;
+}
+
+-(BOOL)fillLayer:(BACompositeLayer*)layer
+            from:(NSImage*)image
+           alpha:(float)alpha
+          buffer:(uint8_t**)buffer
+{
+    memset(layer, 0, sizeof(BACompositeLayer));
+    *buffer = NULL;
+    layer->alpha = alpha;
+    
+    // Rendered images carry their bitmap: composite its pixels directly
+    for (NSImageRep* rep in [image representations]) {
+        if (![rep isKindOfClass:[NSBitmapImageRep class]]) {
+            continue;
+        }
+        NSBitmapImageRep* bitmap = (NSBitmapImageRep*) rep;
+        NSBitmapFormat    format = [bitmap bitmapFormat];
+        if ([bitmap bitsPerSample] == 8
+            && [bitmap samplesPerPixel] == 4
+            && [bitmap hasAlpha]
+            && ![bitmap isPlanar]
+            && (format & (NSAlphaFirstBitmapFormat | NSAlphaNonpremultipliedBitmapFormat | NSFloatingPointSamplesBitmapFormat)) == 0) {
+            layer->pixels   = [bitmap bitmapData];
+            layer->width    = [bitmap pixelsWide];
+            layer->height   = [bitmap pixelsHigh];
+            layer->rowBytes = [bitmap bytesPerRow];
+            
+            return layer->pixels != NULL;
+        }
     }
-    if (self->mSelectionImage == nil && self->mForegroundImage == nil && self->mBackgroundImage != nil) {
-        return [self setImage:self->mBackgroundImage];
+    
+    CGImageRef cgImage = [image CGImageForProposedRect:NULL context:nil hints:nil];
+    if (cgImage == NULL) {
+        return NO;
     }
     
-    // Two images.
-    NSImage* fg = nil;
-    NSImage* bg = nil;
-    if (self->mSelectionImage != nil && self->mForegroundImage != nil && self->mBackgroundImage == nil) {
-        fg = self->mSelectionImage;
-        bg = self->mForegroundImage;
+    size_t width  = CGImageGetWidth(cgImage);
+    size_t height = CGImageGetHeight(cgImage);
+    uint8_t* pixels = calloc(width * height, 4);
+    if (pixels == NULL) {
+        return NO;
     }
-    if (self->mSelectionImage == nil && self->mForegroundImage != nil && self->mBackgroundImage != nil) {
-        fg = self->mForegroundImage;
-        bg = self->mBackgroundImage;
+    
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef    context    = CGBitmapContextCreate(pixels, width, height, 8, width * 4, colorSpace,
+                                                       kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+    CGColorSpaceRelease(colorSpace);
+    if (context == NULL) {
+        free(pixels);
+        return NO;
     }
-    if (self->mSelectionImage != nil && self->mForegroundImage == nil && self->mBackgroundImage != nil) {
-        fg = self->mSelectionImage;
-        bg = self->mBackgroundImage;
+    
+    CGContextSetInterpolationQuality(context, kCGInterpolationNone);
+    CGContextDrawImage(context, CGRectMake(0.0, 0.0, width, height), cgImage);
+    CGContextRelease(context);
+    
+    *buffer = pixels;
+    layer->pixels   = pixels;
+    layer->width    = width;
+    layer->height   = height;
+    layer->rowBytes = width * 4;
+    
+    return YES;
+}
+
+-(void)updateSetImage
+{
+    // Bottom to top
+    NSMutableArray* layers = [NSMutableArray arrayWithCapacity:3];
+    float alphas[3];
+    if (self->mBackgroundImage != nil) {
+        alphas[[layers count]] = self->mBackgroundAlpha;
+        [layers addObject:self->mBackgroundImage];
+    }
+    if (self->mForegroundImage != nil) {
+        alphas[[layers count]] = self->mForegroundAlpha;
+        [layers addObject:self->mForegroundImage];
+    }
+    if (self->mSelectionImage  != nil) {
+        alphas[[layers count]] = self->mSelectionAlpha;
+        [layers addObject:self->mSelectionImage];
     }
     
-    if (fg != nil && bg != nil) {
-        NSImage* composite = [self createCompositeImage:fg
-                                                     on:bg];
-        [self setImage:(NSImage*) composite];
-        [composite release];
+    if ([layers count] == 0) {
+        return;
     }
+    
+    // Single opaque image.
+    if ([layers count] == 1 && alphas[0] >= 1.0f) {
+        return [self setImage:[layers objectAtIndex:0]];
+    }
+    
+    // Two or three (or a translucent) images, blended in one pass.
+    NSImage* composite = [self createCompositeImageOf:layers alphas:alphas];
+    [self setImage:composite];
+    [composite release];
 }
 
 -(NSImage*)getTopmostImage
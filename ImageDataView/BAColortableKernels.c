@@ -0,0 +1,294 @@
+//
+//  BAColortableKernels.c
+//  ImageDataView
+//
+
+#include "BAColortableKernels.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BA_COLORTABLE_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BA_COLORTABLE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BA_COLORTABLE_NEON 1
+#endif
+
+/** Highest LUT index. */
+static const float LUT_SCALE = (float) (BA_COLORTABLE_LUT_SIZE - 1);
+
+
+// ################
+// # LUT building #
+// ################
+
+typedef struct {
+    float r, g, b, a;
+} BAColor;
+
+static const BAColor TRANSPARENT = {0.0f, 0.0f, 0.0f, 0.0f};
+
+/** Colortable sampled at pixel coordinate x (pixel centers at i + 0.5), linear interpolation,
+ *  clamped to the edges - what a CISampler on the table image returned. */
+static BAColor sampleTable(const BAColortableParams* params, float x)
+{
+    if (params->colors == NULL || params->colorCount == 0) {
+        return TRANSPARENT;
+    }
+
+    float  t     = x - 0.5f;
+    float  first = floorf(t);
+    float  frac  = t - first;
+    long   last  = (long) params->colorCount - 1;
+    long   i0    = (long) first;
+    long   i1    = i0 + 1;
+    i0 = (i0 < 0) ? 0 : ((i0 > last) ? last : i0);
+    i1 = (i1 < 0) ? 0 : ((i1 > last) ? last : i1);
+
+    const float* c0 = params->colors + i0 * 4;
+    const float* c1 = params->colors + i1 * 4;
+    BAColor color = { c0[0] + (c1[0] - c0[0]) * frac
+                    , c0[1] + (c1[1] - c0[1]) * frac
+                    , c0[2] + (c1[2] - c0[2]) * frac
+                    , c0[3] + (c1[3] - c0[3]) * frac };
+    return color;
+}
+
+/** getCTValue of the kernels: table samples are premultiplied, the kernels work unpremultiplied. */
+static BAColor tableValue(const BAColortableParams* params, float x)
+{
+    BAColor color = sampleTable(params, x);
+    if (color.a > 0.0f) {
+        color.r /= color.a;
+        color.g /= color.a;
+        color.b /= color.a;
+    }
+    return color;
+}
+
+/** Table position of value in the domain [min, max] (0 for an empty domain). */
+static float domainIndex(float value, float min, float max)
+{
+    return (max > min) ? 255.0f / (max - min) * (value - min) : 0.0f;
+}
+
+static BAColor mapValue(const BAColortableParams* params, float value)
+{
+    float min = params->min;
+    float max = params->max;
+    BAColor pix = TRANSPARENT;
+
+    switch (params->mode) {
+        case COLORTABLE_MODE_SIGNED:
+            // for negative values
+            if (value <= max - 0.5f && value > min) {
+                pix = tableValue(params, 255.0f * (value / 0.5f) + 256.0f);
+            }
+            // for positive values
+            if (value <= max && value > min + 0.5f) {
+                pix = tableValue(params, 255.0f * ((value - 0.5f) / 0.5f));
+            }
+            break;
+        case COLORTABLE_MODE_CLAMPED:
+            if (value >= max) {
+                pix = tableValue(params, 255.0f);
+            } else if (value > min) {
+                pix = tableValue(params, domainIndex(value, min, max));
+            } else {
+                pix = tableValue(params, 0.0f);
+            }
+            pix.a = 1.0f;
+            break;
+        case COLORTABLE_MODE_THRESHOLD:
+            if (value >= min && value <= max) {
+                pix   = tableValue(params, domainIndex(value, min, max));
+                pix.a = 1.0f;
+            }
+            break;
+        case COLORTABLE_MODE_TWO_DOMAINS:
+            if (value >= params->min2 && value <= params->max2) {
+                pix   = tableValue(params, domainIndex(value, params->min2, params->max2));
+                pix.a = 1.0f;
+            }
+            if (value >= min && value <= max) {
+                pix   = tableValue(params, domainIndex(value, min, max));
+                pix.a = 1.0f;
+            }
+            break;
+        default:
+            // COLORTABLE_MODE_SELECTION
+            pix   = tableValue(params, 0.0f);
+            pix.a = (value <= min) ? 0.0f : 0.4f;
+            break;
+    }
+
+    return pix;
+}
+
+/** Premultiplied channel value in [0, 255]. Colors are clamped to alpha to keep the pixel valid. */
+static uint8_t toByte(float channel, float alpha)
+{
+    float value = channel * alpha;
+    value = (value > 0.0f) ? value : 0.0f;
+    value = (value < alpha) ? value : alpha;
+    return (uint8_t) (value * 255.0f + 0.5f);
+}
+
+void BAColortableBuildLUT(BAColortableLUT* lut, const BAColortableParams* params)
+{
+    // FNV-1a over the entries
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < BA_COLORTABLE_LUT_SIZE; i++) {
+        BAColor pix = mapValue(params, (float) i / LUT_SCALE);
+        float alpha = (pix.a > 0.0f) ? ((pix.a < 1.0f) ? pix.a : 1.0f) : 0.0f;
+
+        uint8_t rgba[4] = { toByte(pix.r, alpha)
+                          , toByte(pix.g, alpha)
+                          , toByte(pix.b, alpha)
+                          , (uint8_t) (alpha * 255.0f + 0.5f) };
+        memcpy(&lut->entries[i], rgba, sizeof(rgba));
+
+        for (int c = 0; c < 4; c++) {
+            hash = (hash ^ rgba[c]) * 1099511628211ULL;
+        }
+    }
+
+    lut->hash = (hash != 0) ? hash : 1;
+}
+
+
+// ###########
+// # Mapping #
+// ###########
+
+static inline uint32_t mapVoxel(const BAColortableLUT* lut, float val, float min, float invRange)
+{
+    float normalized = (val - min) * invRange;
+    normalized = (normalized > 0.0f) ? normalized : 0.0f;
+    normalized = (normalized < 1.0f) ? normalized : 1.0f;
+    return lut->entries[(size_t) (normalized * LUT_SCALE + 0.5f)];
+}
+
+void BAColortableMapRowScalar(const BAColortableLUT* lut,
+                              const float* src, ptrdiff_t srcStride, size_t count,
+                              uint32_t* dst, ptrdiff_t dstStride,
+                              float min, float invRange)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[(ptrdiff_t) i * dstStride] = mapVoxel(lut, src[(ptrdiff_t) i * srcStride], min, invRange);
+    }
+}
+
+#if BA_COLORTABLE_AVX2
+
+static size_t mapContiguous(const BAColortableLUT* lut, const float* src, int reversed, size_t count,
+                            uint32_t* dst, float min, float invRange)
+{
+    __m256  vMin   = _mm256_set1_ps(min);
+    __m256  vInv   = _mm256_set1_ps(invRange);
+    __m256  vScale = _mm256_set1_ps(LUT_SCALE);
+    __m256  vHalf  = _mm256_set1_ps(0.5f);
+    __m256  vOne   = _mm256_set1_ps(1.0f);
+    __m256i vReverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 v;
+        if (reversed) {
+            v = _mm256_permutevar8x32_ps(_mm256_loadu_ps(src - i - 7), vReverse);
+        } else {
+            v = _mm256_loadu_ps(src + i);
+        }
+        v = _mm256_mul_ps(_mm256_sub_ps(v, vMin), vInv);
+        v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), vOne);
+        __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, vScale), vHalf));
+        _mm256_storeu_si256((__m256i*) (dst + i), _mm256_i32gather_epi32((const int*) lut->entries, index, 4));
+    }
+    return i;
+}
+
+#elif BA_COLORTABLE_SSE2
+
+static size_t mapContiguous(const BAColortableLUT* lut, const float* src, int reversed, size_t count,
+                            uint32_t* dst, float min, float invRange)
+{
+    __m128 vMin   = _mm_set1_ps(min);
+    __m128 vInv   = _mm_set1_ps(invRange);
+    __m128 vScale = _mm_set1_ps(LUT_SCALE);
+    __m128 vHalf  = _mm_set1_ps(0.5f);
+    __m128 vOne   = _mm_set1_ps(1.0f);
+    int32_t index[4];
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 v;
+        if (reversed) {
+            v = _mm_loadu_ps(src - i - 3);
+            v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+        } else {
+            v = _mm_loadu_ps(src + i);
+        }
+        v = _mm_mul_ps(_mm_sub_ps(v, vMin), vInv);
+        v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), vOne);
+        _mm_storeu_si128((__m128i*) index, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, vScale), vHalf)));
+        // No gather in SSE2, the table (16 KB) stays in L1 anyway
+        dst[i]     = lut->entries[index[0]];
+        dst[i + 1] = lut->entries[index[1]];
+        dst[i + 2] = lut->entries[index[2]];
+        dst[i + 3] = lut->entries[index[3]];
+    }
+    return i;
+}
+
+#elif BA_COLORTABLE_NEON
+
+static size_t mapContiguous(const BAColortableLUT* lut, const float* src, int reversed, size_t count,
+                            uint32_t* dst, float min, float invRange)
+{
+    float32x4_t vMin   = vdupq_n_f32(min);
+    float32x4_t vInv   = vdupq_n_f32(invRange);
+    float32x4_t vScale = vdupq_n_f32(LUT_SCALE);
+    float32x4_t vHalf  = vdupq_n_f32(0.5f);
+    float32x4_t vOne   = vdupq_n_f32(1.0f);
+    uint32_t index[4];
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t v;
+        if (reversed) {
+            v = vrev64q_f32(vld1q_f32(src - i - 3));
+            v = vcombine_f32(vget_high_f32(v), vget_low_f32(v));
+        } else {
+            v = vld1q_f32(src + i);
+        }
+        v = vmulq_f32(vsubq_f32(v, vMin), vInv);
+        v = vminq_f32(vmaxq_f32(v, vdupq_n_f32(0.0f)), vOne);
+        vst1q_u32(index, vcvtq_u32_f32(vaddq_f32(vmulq_f32(v, vScale), vHalf)));
+        dst[i]     = lut->entries[index[0]];
+        dst[i + 1] = lut->entries[index[1]];
+        dst[i + 2] = lut->entries[index[2]];
+        dst[i + 3] = lut->entries[index[3]];
+    }
+    return i;
+}
+
+#endif
+
+void BAColortableMapRow(const BAColortableLUT* lut,
+                        const float* src, ptrdiff_t srcStride, size_t count,
+                        uint32_t* dst, ptrdiff_t dstStride,
+                        float min, float invRange)
+{
+    size_t done = 0;
+#if BA_COLORTABLE_AVX2 || BA_COLORTABLE_SSE2 || BA_COLORTABLE_NEON
+    if (1 == dstStride && (1 == srcStride || -1 == srcStride)) {
+        int reversed = (-1 == srcStride);
+        done = mapContiguous(lut, src, reversed, count, dst, min, invRange);
+    }
+#endif
+    BAColortableMapRowScalar(lut, src + (ptrdiff_t) done * srcStride, srcStride, count - done,
+                             dst + (ptrdiff_t) done * dstStride, dstStride, min, invRange);
+}
@@ -0,0 +1,71 @@
+//
+//  BAColortableKernels.h
+//  ImageDataView
+//
+
+#ifndef ImageDataView_BAColortableKernels_h
+#define ImageDataView_BAColortableKernels_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of entries of a BAColortableLUT (resolution of the normalised value range [0, 1]). */
+#define BA_COLORTABLE_LUT_SIZE 4096
+
+/** Mappings of the colortable kernels in ColorMappingFilter.cikernel (same order). */
+enum BAColortableMode {
+    /** colorMappingFilterOne: upper half of the table for (min + 0.5, max], lower half for (min, max - 0.5]. */
+      COLORTABLE_MODE_SIGNED
+    /** colorMappingFilterTwo: table spread over [min, max], values outside clamped to its ends, opaque. */
+    , COLORTABLE_MODE_CLAMPED
+    /** colorMappingFilterThree: table spread over [min, max], transparent outside. */
+    , COLORTABLE_MODE_THRESHOLD
+    /** colorMappingFilterFour: like COLORTABLE_MODE_THRESHOLD for [min, max] and [min2, max2], the first domain wins. */
+    , COLORTABLE_MODE_TWO_DOMAINS
+    /** colorMappingFilterFive: first table color at 40% opacity for values above min (ROI selection). */
+    , COLORTABLE_MODE_SELECTION
+};
+
+/** Everything a BAColortableLUT is built from. */
+typedef struct {
+    enum BAColortableMode mode;
+    /** Colortable: colorCount RGBA float colors. */
+    const float* colors;
+    size_t       colorCount;
+    /** Domain bounds in normalised values (min2/max2 only used by COLORTABLE_MODE_TWO_DOMAINS). */
+    float        min;
+    float        max;
+    float        min2;
+    float        max2;
+} BAColortableParams;
+
+/** Precomputed mapping of normalised values to premultiplied RGBA8 colors. */
+typedef struct {
+    /** Color of the value i / (BA_COLORTABLE_LUT_SIZE - 1), bytes in R, G, B, A memory order. */
+    uint32_t entries[BA_COLORTABLE_LUT_SIZE];
+    /** Hash of entries, identifies the mapping (e.g. in cache keys). Never 0. */
+    uint64_t hash;
+} BAColortableLUT;
+
+/** Evaluates the mapping described by params for every entry of lut.
+ *  Colortable colors are sampled with linear interpolation like the CIKernel samplers did. */
+void BAColortableBuildLUT(BAColortableLUT* lut, const BAColortableParams* params);
+
+/** Maps count voxels to colors: v = (src[i * srcStride] - min) * invRange clamped to [0, 1],
+ *  dst[i * dstStride] = lut->entries[round(v * (BA_COLORTABLE_LUT_SIZE - 1))].
+ *
+ * Same stride conventions as BARenderGrayToRGBA: srcStride == +/-1 and dstStride == 1
+ * is vectorised (AVX2, SSE2 or NEON), everything else runs through the scalar loop.
+ */
+void BAColortableMapRow(const BAColortableLUT* lut,
+                        const float* src, ptrdiff_t srcStride, size_t count,
+                        uint32_t* dst, ptrdiff_t dstStride,
+                        float min, float invRange);
+
+/** Plain C reference implementation of BAColortableMapRow (no SIMD). */
+void BAColortableMapRowScalar(const BAColortableLUT* lut,
+                              const float* src, ptrdiff_t srcStride, size_t count,
+                              uint32_t* dst, ptrdiff_t dstStride,
+                              float min, float invRange);
+
+#endif
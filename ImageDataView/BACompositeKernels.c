@@ -0,0 +1,175 @@
+//
+//  BACompositeKernels.c
+//  ImageDataView
+//
+
+#include "BACompositeKernels.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BA_COMPOSITE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BA_COMPOSITE_NEON 1
+#endif
+
+
+/** x / 255 rounded, exact for x in [0, 255 * 255]. */
+static inline unsigned int div255(unsigned int x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+void BACompositeRowOverScalar(const uint8_t* src, size_t count, unsigned int alpha, uint8_t* dst)
+{
+    for (size_t i = 0; i < count; i++) {
+        unsigned int sa  = div255(src[3] * alpha);
+        unsigned int inv = 255 - sa;
+        dst[0] = (uint8_t) (div255(src[0] * alpha) + div255(dst[0] * inv));
+        dst[1] = (uint8_t) (div255(src[1] * alpha) + div255(dst[1] * inv));
+        dst[2] = (uint8_t) (div255(src[2] * alpha) + div255(dst[2] * inv));
+        dst[3] = (uint8_t) (sa                     + div255(dst[3] * inv));
+        src += 4;
+        dst += 4;
+    }
+}
+
+#if BA_COMPOSITE_SSE2
+
+/** x / 255 rounded for 8 unsigned 16 bit lanes in [0, 255 * 255]. */
+static inline __m128i div255x8(__m128i x)
+{
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/** Two pixels (8 lanes) of source over. */
+static inline __m128i over2(__m128i s, __m128i d, __m128i vAlpha)
+{
+    s = div255x8(_mm_mullo_epi16(s, vAlpha));
+    __m128i sa  = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), sa);
+    return _mm_add_epi16(s, div255x8(_mm_mullo_epi16(d, inv)));
+}
+
+static size_t rowOverContiguous(const uint8_t* src, size_t count, unsigned int alpha, uint8_t* dst)
+{
+    __m128i zero   = _mm_setzero_si128();
+    __m128i vAlpha = _mm_set1_epi16((short) alpha);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*) (src + i * 4));
+        __m128i d = _mm_loadu_si128((const __m128i*) (dst + i * 4));
+        __m128i lo = over2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), vAlpha);
+        __m128i hi = over2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), vAlpha);
+        _mm_storeu_si128((__m128i*) (dst + i * 4), _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+#elif BA_COMPOSITE_NEON
+
+/** x / 255 rounded for 8 unsigned 16 bit lanes in [0, 255 * 255], narrowed to 8 bit. */
+static inline uint8x8_t div255x8(uint16x8_t x)
+{
+    x = vaddq_u16(x, vdupq_n_u16(128));
+    return vshrn_n_u16(vsraq_n_u16(x, x, 8), 8);
+}
+
+static size_t rowOverContiguous(const uint8_t* src, size_t count, unsigned int alpha, uint8_t* dst)
+{
+    uint8x8_t vAlpha = vdup_n_u8((uint8_t) alpha);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // De-interleaving loads give one register per channel
+        uint8x8x4_t s = vld4_u8(src + i * 4);
+        uint8x8x4_t d = vld4_u8(dst + i * 4);
+        uint8x8_t sa  = div255x8(vmull_u8(s.val[3], vAlpha));
+        uint8x8_t inv = vmvn_u8(sa);
+        for (int c = 0; c < 3; c++) {
+            d.val[c] = vadd_u8(div255x8(vmull_u8(s.val[c], vAlpha)), div255x8(vmull_u8(d.val[c], inv)));
+        }
+        d.val[3] = vadd_u8(sa, div255x8(vmull_u8(d.val[3], inv)));
+        vst4_u8(dst + i * 4, d);
+    }
+    return i;
+}
+
+#endif
+
+void BACompositeRowOver(const uint8_t* src, size_t count, unsigned int alpha, uint8_t* dst)
+{
+    if (alpha > 255) {
+        alpha = 255;
+    }
+
+    size_t done = 0;
+#if BA_COMPOSITE_SSE2 || BA_COMPOSITE_NEON
+    done = rowOverContiguous(src, count, alpha, dst);
+#endif
+    BACompositeRowOverScalar(src + done * 4, count - done, alpha, dst + done * 4);
+}
+
+int BACompositeLayers(const BACompositeLayer* layers, size_t count,
+                      uint8_t* dst, size_t width, size_t height, size_t dstRowBytes)
+{
+    if (width == 0 || height == 0) {
+        return 1;
+    }
+
+    // Source column of every target column for each layer that needs scaling
+    size_t*  columnMap = malloc(count * width * sizeof(size_t));
+    uint8_t* scaledRow = malloc(width * 4);
+    if (columnMap == NULL || scaledRow == NULL) {
+        free(columnMap);
+        free(scaledRow);
+        return 0;
+    }
+    for (size_t l = 0; l < count; l++) {
+        for (size_t x = 0; x < width; x++) {
+            columnMap[l * width + x] = x * layers[l].width / width;
+        }
+    }
+
+    for (size_t y = 0; y < height; y++) {
+        uint8_t* dstRow = dst + y * dstRowBytes;
+        memset(dstRow, 0, width * 4);
+
+        for (size_t l = 0; l < count; l++) {
+            const BACompositeLayer* layer = &layers[l];
+            if (layer->pixels == NULL || layer->width == 0 || layer->height == 0) {
+                continue;
+            }
+            float opacity = layer->alpha;
+            opacity = (opacity < 0.0f) ? 0.0f : ((opacity > 1.0f) ? 1.0f : opacity);
+            unsigned int alpha = (unsigned int) (opacity * 255.0f + 0.5f);
+            if (alpha == 0) {
+                continue;
+            }
+
+            const uint8_t* srcRow = layer->pixels + (y * layer->height / height) * layer->rowBytes;
+            if (layer->width != width) {
+                const size_t* map = columnMap + l * width;
+                for (size_t x = 0; x < width; x++) {
+                    memcpy(scaledRow + x * 4, srcRow + map[x] * 4, 4);
+                }
+                srcRow = scaledRow;
+            }
+
+            if (l == 0 && alpha == 255) {
+                // Source over transparent black is the source itself
+                memcpy(dstRow, srcRow, width * 4);
+            } else {
+                BACompositeRowOver(srcRow, width, alpha, dstRow);
+            }
+        }
+    }
+
+    free(columnMap);
+    free(scaledRow);
+    return 1;
+}
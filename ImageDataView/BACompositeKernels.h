@@ -0,0 +1,56 @@
+//
+//  BACompositeKernels.h
+//  ImageDataView
+//
+
+#ifndef ImageDataView_BACompositeKernels_h
+#define ImageDataView_BACompositeKernels_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** A layer (image) passed to BACompositeLayers. */
+typedef struct {
+    /** Premultiplied RGBA pixels, 8 bit per channel, first row is the top row. */
+    const uint8_t* pixels;
+    size_t width;
+    size_t height;
+    /** Distance between the starts of two rows in bytes. */
+    size_t rowBytes;
+    /** Opacity the whole layer is scaled by, [0, 1]. */
+    float  alpha;
+} BACompositeLayer;
+
+/** Blends count premultiplied RGBA8 pixels of src over dst (source over):
+ *
+ * s = src * alpha / 255, dst = s + dst * (255 - s.a) / 255 (per channel, exactly rounded).
+ *
+ * Vectorised (SSE2 or NEON - whatever the target is compiled for).
+ *
+ * \param src   Source pixels (4 bytes each).
+ * \param count Number of pixels.
+ * \param alpha Opacity of src in [0, 255].
+ * \param dst   Target pixels, blended in place.
+ */
+void BACompositeRowOver(const uint8_t* src, size_t count, unsigned int alpha, uint8_t* dst);
+
+/** Plain C reference implementation of BACompositeRowOver (no SIMD). */
+void BACompositeRowOverScalar(const uint8_t* src, size_t count, unsigned int alpha, uint8_t* dst);
+
+/** Composites layers bottom (layers[0]) to top into dst in a single pass over dst:
+ *  every target row is blended from all layers before the next one is touched.
+ *  Layers of a different size than the target are scaled (nearest neighbour, i.e. no
+ *  interpolation) to cover the whole target.
+ *
+ * \param layers      Layers to composite, bottom first.
+ * \param count       Number of layers.
+ * \param dst         Target buffer (premultiplied RGBA8), starts out transparent.
+ * \param width       Target width in pixels.
+ * \param height      Target height in pixels.
+ * \param dstRowBytes Distance between the starts of two target rows in bytes.
+ * \return            0 if temporary buffers could not be allocated, 1 otherwise.
+ */
+int BACompositeLayers(const BACompositeLayer* layers, size_t count,
+                      uint8_t* dst, size_t width, size_t height, size_t dstRowBytes);
+
+#endif
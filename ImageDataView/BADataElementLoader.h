@@ -0,0 +1,126 @@
+//
+//  BADataElementLoader.h
+//  ImageDataView
+//
+
+#import <Foundation/Foundation.h>
+#import "EDDataElement.h"
+
+@class BAImageDataViewController;
+@class BADataElementLoader;
+
+/** Default number of files decoded at the same time. */
+static const NSUInteger DEFAULT_CONCURRENT_LOADS = 4;
+
+/**
+ * Progress notifications of a BADataElementLoader. All methods are optional and
+ * called on the main thread.
+ */
+@protocol BADataElementLoaderDelegate <NSObject>
+@optional
+
+/** A file started loading.
+ *
+ * \param loader The loader.
+ * \param path   Path of the file.
+ * \param bytes  Size of the file in bytes. */
+-(void)loader:(BADataElementLoader*)loader didStartFile:(NSString*)path bytes:(unsigned long long)bytes;
+
+/** A file was loaded and its element was handed to the view controller.
+ *
+ * \param loader  The loader.
+ * \param path    Path of the file.
+ * \param element The loaded EDDataElement. */
+-(void)loader:(BADataElementLoader*)loader didLoadFile:(NSString*)path element:(EDDataElement*)element;
+
+/** A file could not be loaded.
+ *
+ * \param loader The loader.
+ * \param path   Path of the file. */
+-(void)loader:(BADataElementLoader*)loader didFailFile:(NSString*)path;
+
+/** All files added so far are done (loaded, failed or cancelled).
+ *
+ * \param loader The loader. */
+-(void)loaderDidFinish:(BADataElementLoader*)loader;
+
+@end
+
+/**
+ * Loads EDDataElements from files in the background, several files in parallel.
+ *
+ * Each file added starts loading right away on a concurrent queue, at most
+ * maxConcurrentLoads of them at the same time (decoding is memory hungry).
+ * As soon as a file is loaded its element is handed to the view controller on
+ * the main thread - as background image or as overlay with the given ID - so the
+ * view fills while the remaining files are still loading.
+ * Uncompressed NIfTI files are opened memory mapped (\see{EDDataElement#initWithMappedDataFile:ofImageType:}),
+ * all other formats are decoded completely.
+ *
+ * cancel drops all files not handed to the view controller yet. A decode already
+ * running can not be interrupted, its element is released when it is done.
+ *
+ * The loader retains itself while files are loading. All methods are meant to be
+ * called from the main thread.
+ */
+@interface BADataElementLoader : NSObject {
+
+    /** View controller the loaded elements are handed to (not retained). */
+    BAImageDataViewController* mViewController;
+    /** Delegate receiving the progress notifications (not retained). */
+    id<BADataElementLoaderDelegate> mDelegate;
+
+    /** Concurrent queue the files are loaded on. */
+    dispatch_queue_t     mQueue;
+    /** Limits the number of files decoded at the same time. */
+    dispatch_semaphore_t mSlots;
+    /** Incremented by cancel, jobs of older generations drop their files. */
+    volatile int64_t     mEpoch;
+
+    /** Files added but not done yet. */
+    NSUInteger           mPendingFiles;
+    /** Sizes of all files added / of the files done (in bytes). */
+    unsigned long long   mTotalBytes;
+    unsigned long long   mLoadedBytes;
+}
+
+/** Delegate receiving the progress notifications (not retained). */
+@property (assign) id<BADataElementLoaderDelegate> delegate;
+
+/** Initializer.
+ *
+ * \param controller         View controller the loaded elements are handed to (not retained,
+ *                           call cancel before it goes away).
+ * \param maxConcurrentLoads Number of files decoded at the same time (at least 1). */
+-(id)initWithViewController:(BAImageDataViewController*)controller
+         maxConcurrentLoads:(NSUInteger)maxConcurrentLoads;
+
+/** Loads a file and sets it as background image once it is loaded.
+ *
+ * \param path  Path of the file.
+ * \param iType Image type of the data. */
+-(void)loadBackgroundFile:(NSString*)path
+              ofImageType:(enum ImageType)iType;
+
+/** Loads a file and adds it as overlay once it is loaded.
+ *
+ * \param path       Path of the file.
+ * \param iType      Image type of the data.
+ * \param identifier ID of the overlay, \see{BAImageDataViewController#addOverlayImage:withID:}. */
+-(void)loadOverlayFile:(NSString*)path
+           ofImageType:(enum ImageType)iType
+                withID:(NSString*)identifier;
+
+/** Drops all files not handed to the view controller yet. */
+-(void)cancel;
+
+/** Number of files added but not done yet. */
+-(NSUInteger)getPendingFileCount;
+
+/** Sizes (in bytes) of all files added since the loader was idle the last time. */
+-(unsigned long long)getTotalBytes;
+
+/** Sizes (in bytes) of those of them already done. */
+-(unsigned long long)getLoadedBytes;
+
+@end
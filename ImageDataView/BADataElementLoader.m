@@ -0,0 +1,231 @@
+//
+//  BADataElementLoader.m
+//  ImageDataView
+//
+
+#import "BADataElementLoader.h"
+
+#import <libkern/OSAtomic.h>
+#import "BAImageDataViewController.h"
+
+
+// ###############################
+// # Private method declarations #
+// ###############################
+
+@interface BADataElementLoader (__privateMethods__)
+
+/**
+ * Queues a file for loading.
+ *
+ * \param path       Path of the file.
+ * \param iType      Image type of the data.
+ * \param identifier Overlay ID, nil for the background image.
+ */
+-(void)loadFile:(NSString*)path
+    ofImageType:(enum ImageType)iType
+         withID:(NSString*)identifier;
+
+/** Main thread part of a job starting to load a file. */
+-(void)startedFile:(NSString*)path
+             bytes:(unsigned long long)bytes
+             epoch:(int64_t)epoch;
+
+/**
+ * Main thread part of a job being done with a file: hands the element to the
+ * view controller unless the job was cancelled meanwhile.
+ *
+ * \param path       Path of the file.
+ * \param identifier Overlay ID, nil for the background image.
+ * \param element    Loaded element, nil if loading failed or the job was cancelled.
+ * \param bytes      Size of the file.
+ * \param epoch      Epoch the job was started in.
+ */
+-(void)finishedFile:(NSString*)path
+             withID:(NSString*)identifier
+            element:(EDDataElement*)element
+              bytes:(unsigned long long)bytes
+              epoch:(int64_t)epoch;
+
+@end
+
+
+// ##################
+// # Implementation #
+// ##################
+
+@implementation BADataElementLoader
+
+@synthesize delegate = mDelegate;
+
+-(id)initWithViewController:(BAImageDataViewController*)controller
+         maxConcurrentLoads:(NSUInteger)maxConcurrentLoads
+{
+    if (self = [super init]) {
+        self->mViewController = controller;
+        self->mDelegate       = nil;
+        // Serial queue handing the files out to the global queue, it is the only one blocking on the slots
+        self->mQueue          = dispatch_queue_create("de.cbs.mpg.bart.ImageDataView.dataElementLoader", NULL);
+        self->mSlots          = dispatch_semaphore_create((long) MAX(maxConcurrentLoads, 1));
+        self->mEpoch          = 0;
+
+        self->mPendingFiles = 0;
+        self->mTotalBytes   = 0;
+        self->mLoadedBytes  = 0;
+    }
+
+    return self;
+}
+
+-(void)dealloc
+{
+    // Running jobs retain the loader, nothing is left on the queues here
+    dispatch_release(self->mSlots);
+    dispatch_release(self->mQueue);
+
+    [super dealloc];
+}
+
+-(void)loadBackgroundFile:(NSString*)path
+              ofImageType:(enum ImageType)iType
+{
+    [self loadFile:path ofImageType:iType withID:nil];
+}
+
+-(void)loadOverlayFile:(NSString*)path
+           ofImageType:(enum ImageType)iType
+                withID:(NSString*)identifier
+{
+    if (identifier == nil) {
+        NSLog(@"BADataElementLoader: no overlay ID given for %@", path);
+        return;
+    }
+    [self loadFile:path ofImageType:iType withID:identifier];
+}
+
+-(void)loadFile:(NSString*)path
+    ofImageType:(enum ImageType)iType
+         withID:(NSString*)identifier
+{
+    if (self->mPendingFiles == 0) {
+        self->mTotalBytes  = 0;
+        self->mLoadedBytes = 0;
+    }
+    self->mPendingFiles++;
+
+    int64_t epoch = self->mEpoch;
+    volatile int64_t* currentEpoch = &self->mEpoch;
+    dispatch_semaphore_t slots = self->mSlots;
+    NSString* file = [[path copy] autorelease];
+    NSString* overlayID = [[identifier copy] autorelease];
+
+    dispatch_async(self->mQueue, ^{
+        BOOL cancelled = (*currentEpoch != epoch);
+        if (!cancelled) {
+            dispatch_semaphore_wait(slots, DISPATCH_TIME_FOREVER);
+            if (*currentEpoch != epoch) {
+                // Cancelled while waiting for a slot
+                dispatch_semaphore_signal(slots);
+                cancelled = YES;
+            }
+        }
+        if (cancelled) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self finishedFile:file withID:overlayID element:nil bytes:0 epoch:epoch];
+            });
+            return;
+        }
+
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+
+            NSDictionary* attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:file error:NULL];
+            unsigned long long bytes = [attributes fileSize];
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self startedFile:file bytes:bytes epoch:epoch];
+            });
+
+            EDDataElement* element = nil;
+            if (attributes == nil) {
+                NSLog(@"BADataElementLoader: could not open %@", file);
+            } else if (*currentEpoch == epoch) {
+                element = [[EDDataElement alloc] initWithMappedDataFile:file ofImageType:iType];
+            }
+
+            [pool drain];
+            dispatch_semaphore_signal(slots);
+
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [self finishedFile:file withID:overlayID element:element bytes:bytes epoch:epoch];
+                [element release];
+            });
+        });
+    });
+}
+
+-(void)cancel
+{
+    OSAtomicIncrement64Barrier(&self->mEpoch);
+}
+
+-(void)startedFile:(NSString*)path
+             bytes:(unsigned long long)bytes
+             epoch:(int64_t)epoch
+{
+    if (epoch != self->mEpoch) {
+        return;
+    }
+    self->mTotalBytes += bytes;
+
+    if ([self->mDelegate respondsToSelector:@selector(loader:didStartFile:bytes:)]) {
+        [self->mDelegate loader:self didStartFile:path bytes:bytes];
+    }
+}
+
+-(void)finishedFile:(NSString*)path
+             withID:(NSString*)identifier
+            element:(EDDataElement*)element
+              bytes:(unsigned long long)bytes
+              epoch:(int64_t)epoch
+{
+    self->mPendingFiles--;
+
+    // cancel runs on this thread, so nothing gets handed over after it returned
+    if (epoch == self->mEpoch) {
+        self->mLoadedBytes += bytes;
+
+        if (element != nil) {
+            if (identifier == nil) {
+                [self->mViewController setBackgroundImage:element];
+            } else {
+                [self->mViewController addOverlayImage:element withID:identifier];
+            }
+            if ([self->mDelegate respondsToSelector:@selector(loader:didLoadFile:element:)]) {
+                [self->mDelegate loader:self didLoadFile:path element:element];
+            }
+        } else if ([self->mDelegate respondsToSelector:@selector(loader:didFailFile:)]) {
+            [self->mDelegate loader:self didFailFile:path];
+        }
+    }
+
+    if (self->mPendingFiles == 0 && [self->mDelegate respondsToSelector:@selector(loaderDidFinish:)]) {
+        [self->mDelegate loaderDidFinish:self];
+    }
+}
+
+-(NSUInteger)getPendingFileCount
+{
+    return self->mPendingFiles;
+}
+
+-(unsigned long long)getTotalBytes
+{
+    return self->mTotalBytes;
+}
+
+-(unsigned long long)getLoadedBytes
+{
+    return self->mLoadedBytes;
+}
+
+@end
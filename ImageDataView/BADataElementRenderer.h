@@ -8,6 +8,10 @@
 
 #import <Foundation/Foundation.h>
 #import "EDDataElement.h"
+#import "BARenderKernels.h"
+#import "BAReorientedVolumeCache.h"
+
+@class BARenderCache;
 
 @class BAImageFilter;
 @class BAImageSliceSelector;
@@ -23,6 +27,8 @@
     EDDataElement* mImage;
     /** Min and max value of \see{BAImageDataViewController#mImage} cached for performance reasons. */
     NSArray*       mImageMinMax;
+    /** Generation of \see{BAImageDataViewController#mImage} mImageMinMax was fetched at. */
+    NSUInteger     mImageGeneration;
     /** Voxel gap  of \see{BAImageDataViewController#mImage}. */
     NSArray*       mVoxelGap;
     /** Voxel size of \see{BAImageDataViewController#mImage}. */
@@ -56,6 +62,12 @@
     BAImageFilter* mImageFilter;
     /** Alpha channel of the resulting image. */
     float          mAlpha;
+    /** Pixel format of the raw rendered image (\see{BADataElementRenderer#mRenderCache}). */
+    enum BARenderFormat mRenderFormat;
+    /** Lookup table of mImageFilter if it is applied while rendering, NULL otherwise. */
+    BAColortableLUT* mColortableLUT;
+    /** Parameter revision of mImageFilter mColortableLUT was built for. */
+    NSUInteger     mColortableRevision;
     
     /** Filter that decides which slices to render in the multi slice grid. */
     BAImageSliceSelector* mRelevantSliceFilter;
@@ -88,6 +100,25 @@
     /** Size of the multi slice grid. */
     NSSize mGridSize;
     
+    /** Transposed copies of mImage for target orientations differing from the main orientation. */
+    BAReorientedVolumeCache* mReorientedCache;
+    /** Flag telling whether to render reoriented images from mReorientedCache. */
+    BOOL mUseReorientedCache;
+    /** Layout needed for the last rendered target orientation (REORIENT_LAYOUT_COUNT if none). */
+    enum ReorientedLayout mLastLayout;
+    
+    /** LRU cache of raw rendered images by data generation, orientation, slice, timestep, flips and grid size. */
+    BARenderCache* mTileCache;
+    
+    /** 
+     * Size, generation and slice views of mImage at mCurrentTimestep, taken by
+     * \see{BADataElementRenderer#copyForPrefetchingAtTimestep:} on the thread of the original renderer.
+     * nil unless this renderer is such a copy, which renders from it without calling into mImage.
+     */
+    BAReorientedVolumeSource* mSnapshot;
+    /** Layout of mSnapshot for mTargetOrientation, determined (together with mFlipMask) when it was taken. */
+    enum ReorientedLayout mSnapshotLayout;
+    
 }
 
 /** Rendered EDDataElement as NSImage. Ready for display. KVO compliant. */
@@ -140,16 +171,48 @@
 
 /** Sets the filter to apply to the image after it is rendered 
  *  but before it is converted (wrapped) to an NSImage.
+ *  Colortable filters providing a lookup table (\see{BAImageFilter#fillColortableLUT:})
+ *  are applied while rendering instead: voxels are mapped to RGBA8 colors directly.
  *
  * \param filter BAImageFilter to apply to the rendered image. */
 -(void)setImageFilter:(BAImageFilter*)filter;
 
 /** Sets the alpha channel value of the rendered image.
+ *  Luminance images are composited with it (\see{getCompositeAlpha}).
  *
  * \param alpha Float alpha channel value of the rendered image.
  */
 -(void)setAlpha:(float)alpha;
 
+/** Sets the pixel format the raw image is rendered to before filters are applied.
+ * The luminance formats take 1/4 (float), 1/8 (16 bit) or 1/16 (8 bit) of the memory of
+ * RENDER_FORMAT_RGBA_FLOAT; their alpha is applied when the image is composited.
+ * 8 and 16 bit formats clamp the normalised voxel values to [0, 1] - use float
+ * for images whose filters need the full value resolution (e.g. colortables).
+ * Default: RENDER_FORMAT_LUMINANCE_FLOAT.
+ *
+ * \param format Render format to use.
+ */
+-(void)setRenderFormat:(enum BARenderFormat)format;
+
+/** Enables/disables rendering of orthogonal views from transposed copies of the data.
+ * With the cache each rendered slice is read from one contiguous plane instead of being
+ * gathered from all source slices, at the cost of one volume copy per used orientation.
+ * Copies are (re)built in the background after setData:/setTimestep: and lazily on render.
+ * Default: YES.
+ *
+ * \param useCache YES to use the cache, NO to render directly from the EDDataElement.
+ */
+-(void)setUseReorientedCache:(BOOL)useCache;
+
+/** Sets the upper bound of the memory used by previously rendered images kept for reuse
+ * (revisiting a slice/timestep/orientation then only costs a lookup).
+ * Default: DEFAULT_RENDER_CACHE_BYTES. Pass 0 to disable the cache.
+ *
+ * \param bytes Memory limit in bytes.
+ */
+-(void)setRenderCacheByteLimit:(size_t)bytes;
+
 /** # Getters. # */
 -(EDDataElement*)getDataElement;
 -(NSArray*)getDataMinMax;
@@ -158,6 +221,15 @@
 -(uint)getCurrentTimestep;
 -(BAImageFilter*)getImageFilter;
 -(float)getAlpha;
+/** Opacity the rendered image has to be composited with: getAlpha for images rendered in a
+ *  luminance format without filter, 1 if the alpha is part of the rendered pixels
+ *  (RENDER_FORMAT_RGBA_FLOAT) or defined by the image filter. */
+-(float)getCompositeAlpha;
+-(enum BARenderFormat)getRenderFormat;
+/** Counters of the rendered image cache, \see{BARenderCache#getStatistics}. */
+-(NSDictionary*)getRenderCacheStatistics;
+/** Number of timesteps of the rendered EDDataElement (updated by setTimestep: as realtime data grows). */
+-(size_t)getTimestepCount;
 
 /** Renders the set EDDataElement (#mImage) to an autoreleased NSImage respecting 
  *  previously set parameters like slice/timestep numbers or the grid size.
@@ -176,6 +248,54 @@
  */
 -(NSImage*)renderImage:(BOOL)force;
 
+/**
+ * Creates a renderer for rendering other slices of the same data in the background.
+ * The copy has the data, slice, timestep, orientation, grid size, render format and alpha
+ * of this renderer and shares its caches (rendered images and transposed volumes),
+ * so images it renders are found by this renderer. Its own state is independent, 
+ * i.e. it may be used on another thread (one at a time).
+ * Size, generation and slice views of the data are snapshotted by this method: prerender
+ * and setSlice: of the copy only read the snapshot, never the EDDataElement. Other setters
+ * must not be called on the copy.
+ * The image filter is shared as well: renderImage: of the copy must only be called
+ * on the thread this renderer is used on, prerender may be called anywhere.
+ *
+ * \return Retained renderer.
+ */
+-(BADataElementRenderer*)copyForPrefetching;
+
+/**
+ * Same as BADataElementRenderer#copyForPrefetching for another timestep of the data.
+ * Must be called on the thread this renderer is used on.
+ *
+ * \param tstep Timestep the copy renders, less than getTimestepCount.
+ * \return      Retained renderer.
+ */
+-(BADataElementRenderer*)copyForPrefetchingAtTimestep:(uint)tstep;
+
+/**
+ * Renders the raw (unfiltered) image for the current settings into the shared
+ * rendered image cache, unless it is cached already. No NSImage is created.
+ * A following renderImage:NO only applies the image filter.
+ *
+ * \return NO if there is no data to render.
+ */
+-(BOOL)prerender;
+
+/**
+ * Takes over an image a copy (\see{copyForPrefetching}) rendered and filtered for the
+ * current settings of this renderer: the copy's raw image becomes this renderer's and
+ * image is set as renderedImage (KVO notifications are sent), nothing is rendered or
+ * filtered again.
+ * Must be called on the thread this renderer is used on.
+ *
+ * \param image Image returned by renderImage:NO of copy.
+ * \param copy  Copy of this renderer, prerendered.
+ * \return      NO (nothing taken over) if the copy was rendered for other settings.
+ */
+-(BOOL)adoptImage:(NSImage*)image
+       renderedBy:(BADataElementRenderer*)copy;
+
 /**
  * Converts a point (e.g. a mouse click location) in the target (render) image space
  * to a 4D location (x, y, slice, timestep) in the source data space (EDDataElement).
@@ -12,6 +12,9 @@
 #import "BAImageFilter.h"
 #import "BAImageSliceSelector.h"
 #import "BADataVoxel.h"
+#import "BARenderKernels.h"
+#import "BAReorientedVolumeCache.h"
+#import "BARenderCache.h"
 
 
 // #############
@@ -23,6 +26,9 @@ const NSUInteger MASK_X_FLIP  = 1 << 0;
 const NSUInteger MASK_Y_FLIP  = 1 << 1;
 const NSUInteger MASK_Z_FLIP  = 1 << 2;
 
+/** Grid tile without a slice to show. */
+static const size_t EMPTY_TILE = SIZE_MAX;
+
 
 // ###############################
 // # Private method declarations #
@@ -37,6 +43,13 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
  * \param image EDDataElement whose properties are queried.
  */
 -(void)fetchPropsIfUpdated:(EDDataElement*)image;
+/**
+ * Refetches the cached min/max of image if image is new or its data changed
+ * since the last fetch (generation counter of EDDataElement).
+ *
+ * \param image EDDataElement whose min/max is queried.
+ */
+-(void)fetchMinMaxIfUpdated:(EDDataElement*)image;
 /**
  * Updates slice indices of slices to be shown in the multi slice grid
  * (selected by \{BAImageDataViewController#mRelevantSliceFilter}).
@@ -89,26 +102,150 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
  */
 -(CIImage*)renderTurnUpRotateRightImage;
 
+/**
+ * Renders mImage (unfiltered) according to the current slice, timestep, orientation and grid size
+ * or takes it from mTileCache if it was rendered before.
+ *
+ * \param force Render even if the image is in mTileCache.
+ * \return      Retained CIImage.
+ */
+-(CIImage*)renderRawImage:(BOOL)force;
+
+/**
+ * Determines how mImage is reoriented to mTargetOrientation and sets mFlipMask accordingly.
+ * Queries mImage, so it must be called on the thread owning this renderer.
+ *
+ * \return Layout of the transposed copy to render from, REORIENT_LAYOUT_COUNT if none is needed.
+ */
+-(enum ReorientedLayout)determineLayout;
+
+/**
+ * Size of the data to render: of mSnapshot (one timestep) if there is one, of mImage otherwise.
+ *
+ * \return Autoreleased BARTImageSize.
+ */
+-(BARTImageSize*)sourceSize;
+
+/**
+ * View on a source slice at mCurrentTimestep, taken from mSnapshot if there is one.
+ *
+ * \param sliceNr Source slice index.
+ * \return        View on the slice, data is NULL if there is no such slice.
+ *                Valid as long as the current autorelease pool (mSnapshot: as this renderer).
+ */
+-(EDTypedSliceView)sourceSlice:(uint)sliceNr;
+
+/**
+ * Renders mImage with the render method matching layout
+ * (from its transposed copy in mReorientedCache if possible).
+ *
+ * \param layout Reorientation needed for the target orientation, REORIENT_LAYOUT_COUNT if none.
+ * \return       Retained CIImage.
+ */
+-(CIImage*)renderLayout:(enum ReorientedLayout)layout;
+
+/**
+ * Rebuilds mColortableLUT if the parameters of mImageFilter changed (sets mNeedToRender then).
+ * Frees it if mImageFilter cannot be applied through a lookup table.
+ * Reads the filter parameters, so it must be called on the thread owning this renderer.
+ */
+-(void)updateColortable;
+
+/**
+ * Pixel format of the raw rendered image: RENDER_FORMAT_COLORTABLE_RGBA8 if mImageFilter
+ * is applied while rendering (mColortableLUT), mRenderFormat otherwise.
+ */
+-(enum BARenderFormat)targetFormat;
+
+/**
+ * Key of the current raw rendered image in mTileCache.
+ * Only valid once mFlipMask is determined for the current data and target orientation.
+ */
+-(BARenderCacheKey)currentRenderCacheKey;
+
+/**
+ * Renders a volume whose slices are the target slices, i.e. no reorientation is needed:
+ * rows and columns of the target image are rows and columns of the slices
+ * (flips of the target image applied).
+ * Used by renderIdenticalImage (the EDDataElement itself) and for transposed copies
+ * of the EDDataElement from mReorientedCache.
+ *
+ * \param planes Volume of target slices, NULL for the EDDataElement mImage at the current timestep.
+ * \return       Retained CIImage.
+ */
+-(CIImage*)renderPlanesOf:(const EDFloatVolume*)planes;
+
+/**
+ * Renders the EDDataElement mImage from its transposed copy in mReorientedCache.
+ *
+ * \param layout Layout of the copy, corresponding to the render method that would be used otherwise.
+ * \return       Retained CIImage, nil if the cache is disabled or the copy could not be built.
+ */
+-(CIImage*)renderCachedLayout:(enum ReorientedLayout)layout;
+
+/**
+ * Starts building the transposed copy of the current timestep in the background
+ * if the last rendered target orientation needed one (see renderCachedLayout:).
+ */
+-(void)prepareReorientedVolume;
+
+/**
+ * View on a single plane of a volume of target slices (see renderPlanesOf:).
+ *
+ * \param planeNr Plane (target slice) index.
+ * \param planes  Volume of target slices, NULL for the EDDataElement mImage at the current timestep.
+ * \return        View on the plane, data is NULL if there is no such plane.
+ */
+-(EDTypedSliceView)viewOfPlane:(uint)planeNr 
+                       in:(const EDFloatVolume*)planes;
+
+/**
+ * Utility method for the multi slice render methods.
+ * Maps each grid tile to the slice (row/column, depending on the orientation) it shows.
+ * The slice index is taken from mRelevantSlices, in reverse order if flipped.
+ *
+ * \param tileCount Number of tiles in the grid.
+ * \param flipped   Whether the z-axis of the target image is flipped.
+ * \return          Malloc'ed array of tileCount slice indices, EMPTY_TILE for unused tiles.
+ *                  Needs to be freed by the caller.
+ */
+-(size_t*)tileSlicesOf:(size_t)tileCount 
+               flipped:(BOOL)flipped;
+
+/**
+ * Utility method for the multi slice render methods.
+ * Fetches the views on all source slices of the current timestep up front,
+ * so the tile jobs only have to deal with plain memory.
+ *
+ * \param slices  Number of source slices.
+ * \param flipped Whether to store the views in reverse slice order.
+ * \return        Malloc'ed array of slice views. Needs to be freed by the caller,
+ *                the views are valid as long as the current autorelease pool.
+ */
+-(EDTypedSliceView*)sliceViewsOf:(size_t)slices
+                    flipped:(BOOL)flipped;
+
 /**
  * Utility method for the render methods.
- * Constructs a CIImage object from a float vector. The vector is not freed in the process!
+ * Constructs a CIImage object from a filled render target. 
+ * The CIImage takes over the target's pixel buffer (no copy), so the caller must not free it.
+ *
+ * Luminance targets are wrapped as gray images without color management, 
+ * Core Image expands them to (v, v, v, 1) on its own.
  *
- * \param data Float array containing all needed bytes for all channels.
- * \param len  Length of the data float array.
- * \param bpr  Bytes per row in the resulting image. 
- *             This has to respect the size of the data type (float) as well as the number of channels.
- * \param w    Width  of the target CIImage in pixels.
- * \param h    Height of the target CIImage in pixels.
- * \return     Autoreleased CIImage rendering the float data.
+ * \param target Render target whose data was malloc'ed and is completely filled.
+ * \param w      Width  of the target CIImage in pixels.
+ * \param h      Height of the target CIImage in pixels.
+ * \return       Retained CIImage rendering the pixel data.
  */
--(CIImage*)imageFromFloat:(float*)data 
-                   length:(size_t)len 
-              bytesPerRow:(size_t)bpr
-                    width:(size_t)w
-                   height:(size_t)h;
+-(CIImage*)imageFromRenderTarget:(BARenderTarget)target
+                           width:(size_t)w
+                          height:(size_t)h;
 
 /**
  * Creates a NSImage from a CIImage.
+ * The NSImage keeps the NSBitmapImageRep the CIImage is rendered to, so its pixels can be
+ * composited without drawing the image again.
  *
  * \param ciImage     Source image.
  * \return            NSImage created from the source image.
@@ -155,6 +292,16 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
         self->mNeedToRender = YES;
         self->mImageFilter  = nil;
         self->mAlpha        = MAX_ALPHA;
+        self->mRenderFormat = RENDER_FORMAT_LUMINANCE_FLOAT;
+        self->mColortableLUT = NULL;
+        self->mColortableRevision = 0;
+        
+        self->mReorientedCache    = [[BAReorientedVolumeCache alloc] init];
+        self->mUseReorientedCache = YES;
+        self->mLastLayout         = REORIENT_LAYOUT_COUNT;
+        self->mTileCache          = [[BARenderCache alloc] init];
+        self->mSnapshot           = nil;
+        self->mSnapshotLayout     = REORIENT_LAYOUT_COUNT;
         
         self->mRelevantSliceFilter = [[BAImageSliceSelector alloc] init];
         self->mRelevantSlices = nil;
@@ -203,10 +350,15 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
     
     if (self->mRenderCache != nil) [self->mRenderCache release];
     if (self->mImageFilter != nil) [self->mImageFilter release];
+    free(self->mColortableLUT);
     
     if (self->mRelevantSliceFilter != nil) [self->mRelevantSliceFilter release];
     if (self->mRelevantSlices      != nil) [self->mRelevantSlices      release];
     
+    [self->mReorientedCache release];
+    [self->mTileCache release];
+    [self->mSnapshot release];
+    
     [self->renderedImage release];
     
     [super dealloc];
@@ -221,6 +373,11 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
          slice:(uint)sliceNr
       timestep:(uint)tstep
 {
+    if (elem != self->mImage) {
+        // Keys only hold the element's address, which might be reused by a new element
+        [self->mTileCache clear];
+    }
+    
     if (self->mImage != nil) {
         [self->mImage release];
     }
@@ -232,6 +389,8 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
         }
         self->mImage = nil;
         
+        [self->mReorientedCache clear];
+        
     } else {
         [self fetchPropsIfUpdated:elem];
         
@@ -261,13 +420,43 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
 
 -(void)setTimestep:(uint)tstep
 {
+    if (self->mImage != nil) {
+        // Realtime data grows while being displayed
+        self->mTimestepCount = [self->mImage getImageSize].timesteps;
+    }
     if (tstep < self->mTimestepCount) {
         self->mCurrentTimestep = tstep;
     }
     
+    [self prepareReorientedVolume];
+    
     self->mNeedToRender = YES;
 }
 
+-(void)setUseReorientedCache:(BOOL)useCache
+{
+    self->mUseReorientedCache = useCache;
+    if (!useCache) {
+        [self->mReorientedCache clear];
+    }
+}
+
+-(void)setRenderCacheByteLimit:(size_t)bytes
+{
+    [self->mTileCache setByteLimit:bytes];
+}
+
+-(void)prepareReorientedVolume
+{
+    if (self->mUseReorientedCache
+        && self->mImage != nil
+        && self->mLastLayout < REORIENT_LAYOUT_COUNT) {
+        [self->mReorientedCache prepareVolumeOf:self->mImage
+                                     atTimestep:self->mCurrentTimestep
+                                         layout:self->mLastLayout];
+    }
+}
+
 -(void)setGridSize:(NSSize)size
 {
     self->mGridSize = size;
@@ -305,6 +494,11 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
     } else {
         self->mImageFilter = nil;
     }
+    
+    // The raw image is colortable mapped while rendering if the filter supports it
+    free(self->mColortableLUT);
+    self->mColortableLUT = NULL;
+    self->mNeedToRender  = YES;
 }
 
 -(void)setAlpha:(float)alpha
@@ -320,12 +514,48 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
     self->mNeedToRender = YES;
 }
 
+-(void)setRenderFormat:(enum BARenderFormat)format
+{
+    if (format != self->mRenderFormat) {
+        self->mRenderFormat = format;
+        self->mNeedToRender = YES;
+    }
+}
+
+-(void)updateColortable
+{
+    if (self->mImageFilter == nil) {
+        return;
+    }
+    
+    NSUInteger revision = [self->mImageFilter getRevision];
+    if (self->mColortableLUT != NULL && revision == self->mColortableRevision) {
+        return;
+    }
+    
+    BAColortableLUT* lut = (self->mColortableLUT != NULL) ? self->mColortableLUT : malloc(sizeof(BAColortableLUT));
+    if (lut == NULL || ![self->mImageFilter fillColortableLUT:lut]) {
+        free(lut);
+        self->mColortableLUT = NULL;
+        return;
+    }
+    
+    self->mColortableLUT      = lut;
+    self->mColortableRevision = revision;
+    self->mNeedToRender       = YES;
+    [self->mImageFilter releaseCachedImages];
+}
+
+-(enum BARenderFormat)targetFormat
+{
+    return (self->mColortableLUT != NULL) ? RENDER_FORMAT_COLORTABLE_RGBA8 : self->mRenderFormat;
+}
+
 
 -(void)fetchPropsIfUpdated:(EDDataElement*)image
 {
     if (self->mImage != image) {
-        if (self->mImageMinMax != nil) [self->mImageMinMax release];
-        self->mImageMinMax = [[image getMinMaxOfDataElement] retain];
+        [self fetchMinMaxIfUpdated:image];
         
         self->mMainOrientation = [image getMainOrientation];
         
@@ -354,6 +584,16 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
     }
 }
 
+-(void)fetchMinMaxIfUpdated:(EDDataElement*)image
+{
+    if (self->mImage != image || self->mImageGeneration != [image getGeneration]) {
+        if (self->mImageMinMax != nil) [self->mImageMinMax release];
+        self->mImageMinMax = [[image getMinMaxOfDataElement] retain];
+        self->mImageGeneration = [image getGeneration];
+        self->mNeedToRender = YES;
+    }
+}
+
 -(void)fetchRelevantSlices:(EDDataElement*)image
 {
     if (self->mRelevantSlices != nil) [self->mRelevantSlices release];
@@ -397,6 +637,119 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
     return self->mAlpha;
 }
 
+-(float)getCompositeAlpha
+{
+    if (self->mImageFilter != nil || self->mRenderFormat == RENDER_FORMAT_RGBA_FLOAT) {
+        // Part of the rendered pixels (RGBA float) or defined by the filter
+        return MAX_ALPHA;
+    }
+    
+    return self->mAlpha;
+}
+
+-(enum BARenderFormat)getRenderFormat
+{
+    return self->mRenderFormat;
+}
+
+-(size_t)getTimestepCount
+{
+    return self->mTimestepCount;
+}
+
+-(NSDictionary*)getRenderCacheStatistics
+{
+    return [self->mTileCache getStatistics];
+}
+
+
+-(BADataElementRenderer*)copyForPrefetching
+{
+    return [self copyForPrefetchingAtTimestep:self->mCurrentTimestep];
+}
+
+-(BADataElementRenderer*)copyForPrefetchingAtTimestep:(uint)tstep
+{
+    BADataElementRenderer* copy = [[BADataElementRenderer alloc] initWithSliceSelector:self->mRelevantSliceFilter];
+    copy->mTargetOrientation = self->mTargetOrientation;
+    copy->mGridSize          = self->mGridSize;
+    copy->mRenderFormat      = self->mRenderFormat;
+    copy->mAlpha             = self->mAlpha;
+    // Shared, the filter must only be applied (renderImage:) on the thread owning this renderer
+    [copy setImageFilter:self->mImageFilter];
+    [self updateColortable];
+    if (self->mColortableLUT != NULL) {
+        copy->mColortableLUT = malloc(sizeof(BAColortableLUT));
+        memcpy(copy->mColortableLUT, self->mColortableLUT, sizeof(BAColortableLUT));
+        copy->mColortableRevision = self->mColortableRevision;
+    }
+    [copy setData:self->mImage slice:self->mCurrentSlice timestep:tstep];
+    copy->mLastLayout        = self->mLastLayout;
+    
+    // Everything the copy renders from, so prerender never calls into the data element
+    if (self->mImage != nil) {
+        copy->mSnapshot = [[BAReorientedVolumeSource alloc] initWithElement:self->mImage
+                                                                 atTimestep:copy->mCurrentTimestep];
+        copy->mSnapshotLayout = [copy determineLayout];
+        if (copy->mSnapshot != nil) {
+            copy->mImageGeneration = copy->mSnapshot->generation;
+        }
+    }
+    
+    // Share the caches only now, setData: would have cleared them
+    [copy->mTileCache release];
+    copy->mTileCache = [self->mTileCache retain];
+    [copy->mReorientedCache release];
+    copy->mReorientedCache = [self->mReorientedCache retain];
+    
+    return copy;
+}
+
+-(BOOL)prerender
+{
+    if (self->mImage == nil || self->mSnapshot == nil) {
+        return NO;
+    }
+    
+    // Min/max were fetched by setData:, the data is read from mSnapshot only
+    // Keep the image so renderImage: of this renderer only needs to apply the filter
+    if (self->mRenderCache != nil) [self->mRenderCache release];
+    self->mRenderCache  = [self renderRawImage:NO];
+    self->mNeedToRender = NO;
+    
+    return YES;
+}
+
+-(BOOL)adoptImage:(NSImage*)image
+       renderedBy:(BADataElementRenderer*)copy
+{
+    if (copy == nil || copy->mRenderCache == nil) {
+        return NO;
+    }
+    
+    [self fetchMinMaxIfUpdated:self->mImage];
+    [self updateColortable];
+    
+    // The flips follow from data and orientation (both part of the key), take the copy's
+    // as this renderer may not have rendered the current settings yet
+    NSUInteger flipMask = self->mFlipMask;
+    self->mFlipMask = copy->mFlipMask;
+    BARenderCacheKey key     = [self currentRenderCacheKey];
+    BARenderCacheKey copyKey = [copy currentRenderCacheKey];
+    if (memcmp(&key, &copyKey, sizeof(BARenderCacheKey)) != 0) {
+        self->mFlipMask = flipMask;
+        return NO;
+    }
+    
+    [copy->mRenderCache retain];
+    [self->mRenderCache release];
+    self->mRenderCache  = copy->mRenderCache;
+    self->mLastLayout   = copy->mLastLayout;
+    self->mNeedToRender = NO;
+    [self setRenderedImage:image];
+    
+    return YES;
+}
 
 -(NSImage*)renderImage:(BOOL)force
 {
@@ -405,62 +758,11 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
         return nil;
     }
     
+    [self fetchMinMaxIfUpdated:self->mImage];
+    [self updateColortable];
+    
     if (self->mNeedToRender || force) {
-        enum ImageDimension* dims = [self->mRelevantSliceFilter getDimensionsFrom:self->mImage
-                                                                        alignedTo:self->mTargetOrientation];
-        
-        NSUInteger* relevantComps = [self->mRelevantSliceFilter getRowColVectorMainComponents:[self->mImage getMainOrientation]];
-        float rowOrientComponent = [[self->mRowVec objectAtIndex:relevantComps[0]] floatValue];
-        float colOrientComponent = [[self->mColumnVec objectAtIndex:relevantComps[1]] floatValue];
-    //    NSLog(@"Row/col components of row/col-vecs: (%f, %f)", rowOrientComponent, colOrientComponent);
-        
-        BOOL flipX = rowOrientComponent < ROW_FLIP_THRESHOLD; // x flip in source space
-        BOOL flipY;                                           // y flip in source space
-        if (relevantComps[1] == 2) {
-            // y-axis is top-down in dicom images, while scanner z-axis is bottom-up in coronal images
-            flipY = colOrientComponent > COL_FLIP_THRESHOLD; 
-        } else {
-            flipY = colOrientComponent < COL_FLIP_THRESHOLD;
-        }
-        free(relevantComps);
-        
-        self->mFlipMask = MASK_NO_FLIP;                       // flips in target space
-        CIImage* renderedSlices;
-        switch (dims[0]) {
-            case DIM_SLICE:
-                switch (dims[1]) {
-                    case DIM_HEIGHT:
-                        self->mFlipMask = flipY << 1 | flipX << 2;
-                        renderedSlices = [self renderTurnLeftImage];
-                        break;
-                    default:
-                        self->mFlipMask = flipX << 1 | flipY << 2;
-                        renderedSlices = [self renderTurnUpRotateRightImage];
-                        break;
-                }
-                break;
-            case DIM_HEIGHT:
-                if (dims[1] == DIM_SLICE) {
-                    self->mFlipMask = flipY << 0 | MASK_Y_FLIP | flipX << 2;
-                    renderedSlices = [self renderTurnLeftRotateRightImage];
-                }
-                break;
-            default:
-                // DIM_WIDTH
-                switch (dims[1]) {
-                    case DIM_SLICE:
-                        self->mFlipMask = flipX << 0 | MASK_Y_FLIP | flipY << 2;
-                        renderedSlices = [self renderTurnUpImage];
-                        break;
-                    default:
-                        self->mFlipMask = flipX << 0 | flipY << 1;
-                        renderedSlices = [self renderIdenticalImage];
-                        break;
-                }
-                break;
-        }
-        
-        free(dims);
+        CIImage* renderedSlices = [self renderRawImage:force];
         
         if (self->mRenderCache != nil) 
             [self->mRenderCache release];
@@ -469,17 +771,23 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
         [renderedSlices release];
     }
     
-    CIImage* ciImage = [self->mRenderCache copy];
+    CIImage* ciImage = nil;
     
-    // Apply filter
-    if (self->mImageFilter != nil) {
-        ciImage = [self->mImageFilter apply:ciImage];
+    // Apply filter (unless it was applied while rendering)
+    BOOL filterApplied = self->mImageFilter != nil && self->mColortableLUT == NULL;
+    if (filterApplied) {
+        // Pass the cached image itself: the filter reuses its output as long as
+        // the image object and the filter parameters stay the same
+        ciImage = [self->mImageFilter apply:self->mRenderCache];
+    } else {
+        // The alpha of luminance images is applied when compositing (getCompositeAlpha)
+        ciImage = [self->mRenderCache copy];
     }
     
     NSImage* image = [self ciImageToNSImage:ciImage];
     
-    if (self->mImageFilter == nil && ciImage != nil) {
-        // If CIFilter based image filter is active, this caused a BadAccess
+    if (!filterApplied && ciImage != nil) {
+        // Filter output is autoreleased
         [ciImage release];
     }
     
@@ -494,12 +802,142 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
     return image;
 }
 
+-(CIImage*)renderRawImage:(BOOL)force
+{
+    // Copies determined their layout with the snapshot
+    enum ReorientedLayout layout = (self->mSnapshot != nil) ? self->mSnapshotLayout : [self determineLayout];
+    
+    BARenderCacheKey key = [self currentRenderCacheKey];
+    CIImage* renderedSlices = (force) ? nil : [[self->mTileCache imageForKey:key] retain];
+    if (renderedSlices == nil) {
+        renderedSlices = [self renderLayout:layout];
+        CGSize renderedSize = [renderedSlices extent].size;
+        [self->mTileCache setImage:renderedSlices
+                            forKey:key
+                             bytes:(size_t) renderedSize.width * (size_t) renderedSize.height
+                                   * BARenderFormatBytesPerPixel([self targetFormat])];
+    }
+    
+    return renderedSlices;
+}
+
+-(enum ReorientedLayout)determineLayout
+{
+    enum ImageDimension* dims = [self->mRelevantSliceFilter getDimensionsFrom:self->mImage
+                                                                    alignedTo:self->mTargetOrientation];
+    
+    NSUInteger* relevantComps = [self->mRelevantSliceFilter getRowColVectorMainComponents:[self->mImage getMainOrientation]];
+    float rowOrientComponent = [[self->mRowVec objectAtIndex:relevantComps[0]] floatValue];
+    float colOrientComponent = [[self->mColumnVec objectAtIndex:relevantComps[1]] floatValue];
+//    NSLog(@"Row/col components of row/col-vecs: (%f, %f)", rowOrientComponent, colOrientComponent);
+    
+    BOOL flipX = rowOrientComponent < ROW_FLIP_THRESHOLD; // x flip in source space
+    BOOL flipY;                                           // y flip in source space
+    if (relevantComps[1] == 2) {
+        // y-axis is top-down in dicom images, while scanner z-axis is bottom-up in coronal images
+        flipY = colOrientComponent > COL_FLIP_THRESHOLD; 
+    } else {
+        flipY = colOrientComponent < COL_FLIP_THRESHOLD;
+    }
+    free(relevantComps);
+    
+    self->mFlipMask = MASK_NO_FLIP;                       // flips in target space
+    enum ReorientedLayout layout = REORIENT_LAYOUT_COUNT; // identical orientation
+    switch (dims[0]) {
+        case DIM_SLICE:
+            switch (dims[1]) {
+                case DIM_HEIGHT:
+                    self->mFlipMask = flipY << 1 | flipX << 2;
+                    layout = REORIENT_TURN_LEFT;
+                    break;
+                default:
+                    self->mFlipMask = flipX << 1 | flipY << 2;
+                    layout = REORIENT_TURN_UP_ROTATE_RIGHT;
+                    break;
+            }
+            break;
+        case DIM_HEIGHT:
+            if (dims[1] == DIM_SLICE) {
+                self->mFlipMask = flipY << 0 | MASK_Y_FLIP | flipX << 2;
+                layout = REORIENT_TURN_LEFT_ROTATE_RIGHT;
+            }
+            break;
+        default:
+            // DIM_WIDTH
+            switch (dims[1]) {
+                case DIM_SLICE:
+                    self->mFlipMask = flipX << 0 | MASK_Y_FLIP | flipY << 2;
+                    layout = REORIENT_TURN_UP;
+                    break;
+                default:
+                    self->mFlipMask = flipX << 0 | flipY << 1;
+                    break;
+            }
+            break;
+    }
+    
+    free(dims);
+    
+    return layout;
+}
+
+-(CIImage*)renderLayout:(enum ReorientedLayout)layout
+{
+    self->mLastLayout = layout;
+    if (layout == REORIENT_LAYOUT_COUNT) {
+        return [self renderIdenticalImage];
+    }
+    
+    CIImage* renderedSlices = [self renderCachedLayout:layout];
+    if (renderedSlices != nil) {
+        return renderedSlices;
+    }
+    
+    switch (layout) {
+        case REORIENT_TURN_UP:
+            return [self renderTurnUpImage];
+        case REORIENT_TURN_LEFT_ROTATE_RIGHT:
+            return [self renderTurnLeftRotateRightImage];
+        case REORIENT_TURN_LEFT:
+            return [self renderTurnLeftImage];
+        default:
+            return [self renderTurnUpRotateRightImage];
+    }
+}
+
+-(BARenderCacheKey)currentRenderCacheKey
+{
+    BARenderCacheKey key = BARenderCacheKeyMake();
+    key.element     = self->mImage;
+    key.generation  = self->mImageGeneration;
+    key.orientation = self->mTargetOrientation;
+    key.timestep    = self->mCurrentTimestep;
+    key.flipMask    = self->mFlipMask;
+    key.gridWidth   = (uint) self->mGridSize.width;
+    key.gridHeight  = (uint) self->mGridSize.height;
+    key.format      = [self targetFormat];
+    key.colortable  = (self->mColortableLUT != NULL) ? self->mColortableLUT->hash : 0;
+    if (key.gridWidth == 1 && key.gridHeight == 1) {
+        key.slice   = self->mCurrentSlice;
+    }
+    if (key.format == RENDER_FORMAT_RGBA_FLOAT) {
+        key.alpha   = self->mAlpha;
+    }
+    
+    return key;
+}
+
 -(CIImage*)renderIdenticalImage
 {
-    BARTImageSize* imageSize = [self->mImage getImageSize];
+    return [self renderPlanesOf:NULL];
+}
+
+-(CIImage*)renderPlanesOf:(const EDFloatVolume*)planes
+{
+    BARTImageSize* imageSize = [self sourceSize];
     
-    size_t rows       = imageSize.rows;
-    size_t cols       = imageSize.columns;
+    size_t rows       = (planes != NULL) ? planes->rows    : imageSize.rows;
+    size_t cols       = (planes != NULL) ? planes->columns : imageSize.columns;
     size_t gridWidth  = self->mGridSize.width;
     size_t gridHeight = self->mGridSize.height;
     
@@ -511,9 +949,8 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
     * rows 
     * gridWidth
     * gridHeight
-    * NUMBER_OF_CHANNELS
-    * sizeof(float);
-    float* renderImageData = malloc(renderImageDataLength);
+    * BARenderFormatBytesPerPixel([self targetFormat]);
+    BARenderTarget renderTarget = {malloc(renderImageDataLength), [self targetFormat], self->mAlpha, self->mColortableLUT};
     
     float min = [[self->mImageMinMax objectAtIndex:0] floatValue];
     float max = [[self->mImageMinMax objectAtIndex:1] floatValue];
@@ -522,7 +959,7 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
         min = 0.0f;
         if (max == 0.0f) max = FLT_MAX;
     }
-    float normalized = 0.0f;
+    float invRange = 1.0f / (max - min);
     
     if (   gridWidth == 1
         && gridHeight == 1) {
@@ -533,80 +970,58 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
             sliceNr = self->mSliceCount - self->mCurrentSlice - 1;
         }
         
-        float* sliceData = [self->mImage getSliceData:sliceNr
-                                           atTimestep:self->mCurrentTimestep];
+        EDTypedSliceView sliceView = [self viewOfPlane:sliceNr in:planes];
+        const void* sliceData = sliceView.data;
         
         size_t srcRow;
-        size_t srcCol;
-        int targetIndex = 0;
-        for (int row = 0; row < rows; row++) {
-            for (int col = 0; col < cols; col++) {
-                srcRow = (flipY) ? rows - row - 1 : row;
-                srcCol = (flipX) ? cols - col - 1 : col;
-                normalized = (sliceData[srcRow * cols + srcCol] - min) / (max - min);
-                renderImageData[targetIndex++] = normalized;
-                renderImageData[targetIndex++] = normalized;
-                renderImageData[targetIndex++] = normalized;
-                renderImageData[targetIndex++] = self->mAlpha;
+        for (size_t row = 0; row < rows; row++) {
+            if (sliceData == NULL) {
+                BARenderFillRow(&renderTarget, row * cols, 1, cols);
+                continue;
             }
+            srcRow = (flipY) ? rows - row - 1 : row;
+            const void* srcRowData = EDTypedVoxelAt(sliceData, sliceView.type, srcRow * sliceView.rowStride);
+            BARenderTypedRow(&renderTarget, row * cols, 1,
+                             (flipX) ? EDTypedVoxelAt(srcRowData, sliceView.type, cols - 1) : srcRowData, sliceView.type, (flipX) ? -1 : 1, cols,
+                             min, invRange);
         }
         
-        free(sliceData);
-        
     } else {
-        // Many slice view
-        // TODO: much space for parallelization here
+        // Many slice view: one job per grid tile, each tile writes a disjoint region of renderTarget
+        size_t tileCount  = gridWidth * gridHeight;
+        size_t* tileSlices = [self tileSlicesOf:tileCount flipped:flipZ];
+        EDTypedSliceView* tileViews = malloc(tileCount * sizeof(EDTypedSliceView));
+        for (size_t tile = 0; tile < tileCount; tile++) {
+            EDTypedSliceView emptyView = {NULL, ED_VOXEL_FLOAT, 0, nil};
+            tileViews[tile] = (tileSlices[tile] == EMPTY_TILE) ? emptyView
+                                                               : [self viewOfPlane:(uint) tileSlices[tile] in:planes];
+        }
         
-        NSInteger sliceIndex = (flipZ) ? ([self->mRelevantSlices count] - 1) : 0;
-        for (int gridRow = 0; gridRow < gridHeight; gridRow++) {
-            for (int gridCol = 0; gridCol < gridWidth; gridCol++) {
-                
-                uint sliceNr   = 0;
-                float* sliceData = NULL;
-                if (sliceIndex >= 0
-                    && sliceIndex < [self->mRelevantSlices count]) {
-                    sliceNr   = [[self->mRelevantSlices objectAtIndex:sliceIndex] intValue]; //gridRow * gridWidth + gridCol;
-                    sliceData = [self->mImage getSliceData:sliceNr
-                                                atTimestep:self->mCurrentTimestep];
-                    if (flipZ) {
-                        sliceIndex--;
-                    } else {
-                        sliceIndex++;
-                    }
-                }
-                
-                if (sliceData != NULL) {
-                    
-                    size_t sliceOffset = ((gridRow * gridWidth * cols * rows) + gridCol * cols) * NUMBER_OF_CHANNELS;
-                    //                    NSLog(@"SliceNr: %ld, sliceOffset: %ld (rows: %ld, cols: %ld", sliceNr, sliceOffset, rows, cols);
-                    
-                    size_t srcRow;
-                    size_t srcCol;
-                    for (size_t row = 0; row < rows; row++) {
-                        for (size_t col = 0; col < cols; col++) {
-                            srcRow = (flipY) ? (rows - row - 1) : row;
-                            srcCol = (flipX) ? (cols - col - 1) : col;
-                            normalized = (sliceData[srcRow * cols + srcCol] - min) / (max - min);
-                            renderImageData[sliceOffset + (row * gridWidth * cols + col) * NUMBER_OF_CHANNELS]     = normalized;
-                            renderImageData[sliceOffset + (row * gridWidth * cols + col) * NUMBER_OF_CHANNELS + 1] = normalized;
-                            renderImageData[sliceOffset + (row * gridWidth * cols + col) * NUMBER_OF_CHANNELS + 2] = normalized;
-                            renderImageData[sliceOffset + (row * gridWidth * cols + col) * NUMBER_OF_CHANNELS + 3] = self->mAlpha;
-                        }
-                        
-                    }
-                    
-                    free(sliceData);
+        dispatch_apply(tileCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t tile) {
+            size_t sliceOffset = ((tile / gridWidth) * gridWidth * cols * rows) + (tile % gridWidth) * cols;
+            const void* sliceData = tileViews[tile].data;
+            
+            size_t srcRow;
+            for (size_t row = 0; row < rows; row++) {
+                if (sliceData == NULL) {
+                    BARenderFillRow(&renderTarget, sliceOffset + row * gridWidth * cols, 1, cols);
+                    continue;
                 }
+                srcRow = (flipY) ? (rows - row - 1) : row;
+                const void* srcRowData = EDTypedVoxelAt(sliceData, tileViews[tile].type, srcRow * tileViews[tile].rowStride);
+                BARenderTypedRow(&renderTarget, sliceOffset + row * gridWidth * cols, 1,
+                                 (flipX) ? EDTypedVoxelAt(srcRowData, tileViews[tile].type, cols - 1) : srcRowData, tileViews[tile].type, (flipX) ? -1 : 1, cols,
+                                 min, invRange);
             }
-        }
+        });
+        
+        free(tileViews);
+        free(tileSlices);
     }
     
-    CIImage* ciImage = [self imageFromFloat:renderImageData 
-                                     length:renderImageDataLength 
-                                bytesPerRow:gridWidth * cols * NUMBER_OF_CHANNELS * sizeof(float)
-                                      width:gridWidth * cols 
-                                     height:gridHeight * rows];
-    free(renderImageData);
+    CIImage* ciImage = [self imageFromRenderTarget:renderTarget
+                                           width:gridWidth * cols
+                                          height:gridHeight * rows];
     
     return ciImage;
 }
@@ -615,7 +1030,7 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
 {
     // TODO: too much c&p from renderIdenticalImage ;)
     
-    BARTImageSize* imageSize = [self->mImage getImageSize];
+    BARTImageSize* imageSize = [self sourceSize];
     
     //    size_t rows       = imageSize.rows;
     size_t cols       = imageSize.columns;
@@ -631,9 +1046,8 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
     * slices 
     * gridWidth
     * gridHeight
-    * NUMBER_OF_CHANNELS
-    * sizeof(float);
-    float* renderImageData = malloc(renderImageDataLength);
+    * BARenderFormatBytesPerPixel([self targetFormat]);
+    BARenderTarget renderTarget = {malloc(renderImageDataLength), [self targetFormat], self->mAlpha, self->mColortableLUT};
     
     float min = [[self->mImageMinMax objectAtIndex:0] floatValue];
     float max = [[self->mImageMinMax objectAtIndex:1] floatValue];
@@ -642,76 +1056,52 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
         min = 0.0f;
         if (max == 0.0f) max = FLT_MAX;
     }
-    float normalized = 0.0f;
+    float invRange = 1.0f / (max - min);
     
     size_t srcSliceNr = 0;
     if (   gridWidth == 1
         && gridHeight == 1) {
         // Single slice view
         
-        int renderIndex = 0;
         int tarSliceNr = (flipZ) ? (self->mSliceCount - self->mCurrentSlice - 1) : self->mCurrentSlice;
         for (size_t slice = 0; slice < slices; slice++) {
             
             srcSliceNr = (flipY) ? slices - slice - 1 : slice;
-            float* sliceData = [self->mImage getSliceData:(uint) srcSliceNr
-                                               atTimestep:self->mCurrentTimestep];
-            size_t srcCol;
-            for (size_t col = 0; col < cols; col++) {
-                srcCol = (flipX) ? cols - col - 1 : col;
-                normalized = (sliceData[tarSliceNr * cols + srcCol] - min) / (max - min);
-                renderImageData[renderIndex++] = normalized;
-                renderImageData[renderIndex++] = normalized;
-                renderImageData[renderIndex++] = normalized;
-                renderImageData[renderIndex++] = self->mAlpha;
-            }
-            
-            free(sliceData);
+            EDTypedSliceView sliceView = [self sourceSlice:(uint) srcSliceNr];
+            const void* srcRowData = EDTypedVoxelAt(sliceView.data, sliceView.type, tarSliceNr * sliceView.rowStride);
+            BARenderTypedRow(&renderTarget, slice * cols, 1,
+                             (flipX) ? EDTypedVoxelAt(srcRowData, sliceView.type, cols - 1) : srcRowData, sliceView.type, (flipX) ? -1 : 1, cols,
+                             min, invRange);
         }
         
     } else {
-        // Many slice view
-        // TODO: much space for parallelization here
+        // Many slice view: one job per grid tile, each tile writes a disjoint region of renderTarget
+        size_t tileCount  = gridWidth * gridHeight;
+        size_t* tileSlices = [self tileSlicesOf:tileCount flipped:flipZ];
+        EDTypedSliceView* sliceViews = [self sliceViewsOf:slices flipped:flipY];
         
-        size_t renderIndex = 0;
-        size_t flippedGridIndex;
-        NSUInteger relevantSlicesCount = [self->mRelevantSlices count];
-        for (int slice = 0; slice < slices; slice++) {
-            srcSliceNr = (flipY) ? slices - slice - 1 : slice;
-            float* sliceData = [self->mImage getSliceData:(uint) srcSliceNr
-                                               atTimestep:self->mCurrentTimestep];
-            
-            size_t srcCol;
-            for (size_t col = 0; col < cols; col++) {
-                srcCol = (flipX) ? cols - col - 1 : col;
-                
-                for (int gridIndex = 0; gridIndex < gridWidth * gridHeight; gridIndex++) {
-                    if (gridIndex < relevantSlicesCount) {
-                        flippedGridIndex = (flipZ) ? relevantSlicesCount - gridIndex - 1 : gridIndex;
-                        size_t relevantRow = [[self->mRelevantSlices objectAtIndex:flippedGridIndex] intValue];
-                        normalized = (sliceData[relevantRow * cols + srcCol] - min) / (max - min);
-                    } else {
-                        normalized = 0.0f;
-                    }
-                    
-                    renderIndex = ((gridIndex / gridWidth) * gridWidth * slices * cols + (gridIndex % gridWidth) * cols + (slice * gridWidth * cols + col)) * NUMBER_OF_CHANNELS;
-                    renderImageData[renderIndex++] = normalized;
-                    renderImageData[renderIndex++] = normalized;
-                    renderImageData[renderIndex++] = normalized;
-                    renderImageData[renderIndex]   = self->mAlpha;
+        dispatch_apply(tileCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t tile) {
+            size_t renderIndex;
+            for (size_t slice = 0; slice < slices; slice++) {
+                renderIndex = (tile / gridWidth) * gridWidth * slices * cols + (tile % gridWidth) * cols + slice * gridWidth * cols;
+                if (tileSlices[tile] != EMPTY_TILE) {
+                    const void* srcRowData = EDTypedVoxelAt(sliceViews[slice].data, sliceViews[slice].type, tileSlices[tile] * sliceViews[slice].rowStride);
+                    BARenderTypedRow(&renderTarget, renderIndex, 1,
+                                     (flipX) ? EDTypedVoxelAt(srcRowData, sliceViews[slice].type, cols - 1) : srcRowData, sliceViews[slice].type, (flipX) ? -1 : 1, cols,
+                                     min, invRange);
+                } else {
+                    BARenderFillRow(&renderTarget, renderIndex, 1, cols);
                 }
             }
-            
-            free(sliceData);
-        }
+        });
+        
+        free(sliceViews);
+        free(tileSlices);
     }
     
-    CIImage* ciImage = [self imageFromFloat:renderImageData 
-                                     length:renderImageDataLength 
-                                bytesPerRow:gridWidth * cols * NUMBER_OF_CHANNELS * sizeof(float)
-                                      width:gridWidth * cols 
-                                     height:gridHeight * slices];
-    free(renderImageData);
+    CIImage* ciImage = [self imageFromRenderTarget:renderTarget
+                                           width:gridWidth * cols
+                                          height:gridHeight * slices];
     
     return ciImage;
 }
@@ -720,7 +1110,7 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
 {
     // TODO: too much c&p from renderIdenticalImage ;)
     
-    BARTImageSize* imageSize = [self->mImage getImageSize];
+    BARTImageSize* imageSize = [self sourceSize];
     
     size_t rows       = imageSize.rows;
     size_t cols       = imageSize.columns;
@@ -736,9 +1126,8 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
                                     * slices 
                                     * gridWidth
                                     * gridHeight
-                                    * NUMBER_OF_CHANNELS
-                                    * sizeof(float);
-    float* renderImageData = malloc(renderImageDataLength);
+                                    * BARenderFormatBytesPerPixel([self targetFormat]);
+    BARenderTarget renderTarget = {malloc(renderImageDataLength), [self targetFormat], self->mAlpha, self->mColortableLUT};
     
     float min = [[self->mImageMinMax objectAtIndex:0] floatValue];
     float max = [[self->mImageMinMax objectAtIndex:1] floatValue];
@@ -747,81 +1136,57 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
         min = 0.0f;
         if (max == 0.0f) max = FLT_MAX;
     }
-    float normalized = 0.0f;
+    float invRange = 1.0f / (max - min);
     
     size_t srcSliceNr;
     if (   gridWidth == 1
         && gridHeight == 1) {
         // Single slice view
-        int renderIndex = 0;
+        int tarSliceNr = (flipZ) ? self->mSliceCount - self->mCurrentSlice - 1 : self->mCurrentSlice;
         for (size_t slice = 0; slice < slices; slice++) {
             srcSliceNr = (flipY) ? slices - slice - 1 : slice;
-            float* sliceData = [self->mImage getSliceData:(uint) srcSliceNr
-                                               atTimestep:self->mCurrentTimestep];
-            
-            int tarSliceNr = (flipZ) ? self->mSliceCount - self->mCurrentSlice - 1 : self->mCurrentSlice;
-            size_t srcRow;
-            for (size_t row = 0; row < rows; row++) {
-                srcRow = (flipX) ? rows - row - 1 : row;
-                normalized = (sliceData[srcRow * cols + tarSliceNr] - min) / (max - min);
-                renderImageData[renderIndex++] = normalized;
-                renderImageData[renderIndex++] = normalized;
-                renderImageData[renderIndex++] = normalized;
-                renderImageData[renderIndex++] = self->mAlpha;
-            }
-            
-            free(sliceData);
+            EDTypedSliceView sliceView = [self sourceSlice:(uint) srcSliceNr];
+            const void* srcColData = EDTypedVoxelAt(sliceView.data, sliceView.type, tarSliceNr);
+            ptrdiff_t srcStride = (ptrdiff_t) sliceView.rowStride;
+            BARenderTypedRow(&renderTarget, slice * rows, 1,
+                             (flipX) ? EDTypedVoxelAt(srcColData, sliceView.type, (rows - 1) * srcStride) : srcColData, sliceView.type, (flipX) ? -srcStride : srcStride, rows,
+                             min, invRange);
         }
         
     } else {
-        // Many slice view
-        // TODO: much space for parallelization here
+        // Many slice view: one job per grid tile, each tile writes a disjoint region of renderTarget
+        size_t tileCount  = gridWidth * gridHeight;
+        size_t* tileSlices = [self tileSlicesOf:tileCount flipped:flipZ];
+        EDTypedSliceView* sliceViews = [self sliceViewsOf:slices flipped:flipY];
         
-        size_t renderIndex = 0;
-        NSUInteger relevantSlicesCount = [self->mRelevantSlices count];
-        for (int slice = 0; slice < slices; slice++) {
-            srcSliceNr = (flipY) ? slices - slice - 1 : slice;
-            float* sliceData = [self->mImage getSliceData:(uint) srcSliceNr
-                                               atTimestep:self->mCurrentTimestep];
-            
-            size_t srcRow;
-            for (size_t row = 0; row < rows; row++) {
+        dispatch_apply(tileCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t tile) {
+            size_t renderIndex;
+            for (size_t slice = 0; slice < slices; slice++) {
+                // a tile equals one column of data in the original axial slice data,
                 // the column number in the target (sagittal) image equals the row number in the source (axial) data
-                srcRow = (flipX) ? rows - row - 1 : row;
-                
-                size_t flippedGridIndex;
-                for (int gridIndex = 0; gridIndex < gridWidth * gridHeight; gridIndex++) {
-                    // gridIndex equals one column of data in the original axial slice data
-                    
-                    if (gridIndex < relevantSlicesCount) {
-                        flippedGridIndex = (flipZ) ? relevantSlicesCount - gridIndex - 1 : gridIndex;
-                        size_t relevantCol = [[self->mRelevantSlices objectAtIndex:flippedGridIndex] intValue];
-                        normalized = (sliceData[srcRow * cols + relevantCol] - min) / (max - min);
-                    } else {
-                        normalized = 0.0f;
-                    }
-                    // ((gridRow * gridWidth * cols * rows) + gridCol * cols)
-                    renderIndex = ((gridIndex / gridWidth) * gridWidth * rows * slices 
-                                   + (gridIndex % gridWidth) * rows 
-                                   + (slice * gridWidth * rows + row)
-                                   ) * NUMBER_OF_CHANNELS;
-                    renderImageData[renderIndex++] = normalized;
-                    renderImageData[renderIndex++] = normalized;
-                    renderImageData[renderIndex++] = normalized;
-                    renderImageData[renderIndex]   = self->mAlpha;
+                renderIndex = ((tile / gridWidth) * gridWidth * rows * slices 
+                               + (tile % gridWidth) * rows 
+                               + slice * gridWidth * rows
+                               );
+                if (tileSlices[tile] != EMPTY_TILE) {
+                    ptrdiff_t srcStride = (ptrdiff_t) sliceViews[slice].rowStride;
+                    const void* srcColData = EDTypedVoxelAt(sliceViews[slice].data, sliceViews[slice].type, tileSlices[tile]);
+                    BARenderTypedRow(&renderTarget, renderIndex, 1,
+                                     (flipX) ? EDTypedVoxelAt(srcColData, sliceViews[slice].type, (rows - 1) * srcStride) : srcColData, sliceViews[slice].type, (flipX) ? -srcStride : srcStride, rows,
+                                     min, invRange);
+                } else {
+                    BARenderFillRow(&renderTarget, renderIndex, 1, rows);
                 }
             }
-            
-            free(sliceData);
-        }
+        });
+        
+        free(sliceViews);
+        free(tileSlices);
     }
     
-    CIImage* ciImage = [self imageFromFloat:renderImageData 
-                                     length:renderImageDataLength 
-                                bytesPerRow:gridWidth * rows * NUMBER_OF_CHANNELS * sizeof(float)
-                                      width:gridWidth * rows
-                                     height:gridHeight * slices];
-    free(renderImageData);
+    CIImage* ciImage = [self imageFromRenderTarget:renderTarget
+                                           width:gridWidth * rows
+                                          height:gridHeight * slices];
     
     return ciImage;
 }
@@ -830,7 +1195,7 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
 {
     // TODO: too much c&p from renderIdenticalImage ;)
     
-    BARTImageSize* imageSize = [self->mImage getImageSize];
+    BARTImageSize* imageSize = [self sourceSize];
     
     size_t rows       = imageSize.rows;
     size_t cols       = imageSize.columns;
@@ -846,9 +1211,8 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
     * rows 
     * gridWidth
     * gridHeight
-    * NUMBER_OF_CHANNELS
-    * sizeof(float);
-    float* renderImageData = malloc(renderImageDataLength);
+    * BARenderFormatBytesPerPixel([self targetFormat]);
+    BARenderTarget renderTarget = {malloc(renderImageDataLength), [self targetFormat], self->mAlpha, self->mColortableLUT};
     
     float min = [[self->mImageMinMax objectAtIndex:0] floatValue];
     float max = [[self->mImageMinMax objectAtIndex:1] floatValue];
@@ -857,77 +1221,58 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
         min = 0.0f;
         if (max == 0.0f) max = FLT_MAX;
     }
-    float normalized = 0.0f;
+    float invRange = 1.0f / (max - min);
     
     size_t srcSliceNr;
-    size_t srcRow;
     if (   gridWidth == 1
         && gridHeight == 1) {
         // Single slice view
         
-        size_t renderIndex = 0;
         int tarSliceNr = (flipZ) ? (self->mSliceCount - self->mCurrentSlice - 1) : self->mCurrentSlice;
         for (int slice = 0; slice < slices; slice++) {
             
             srcSliceNr = (flipX) ? slices - slice - 1 : slice;
-            float* sliceData = [self->mImage getSliceData:(uint) srcSliceNr
-                                               atTimestep:self->mCurrentTimestep];
-            
-            for (int row = 0; row < rows; row++) {
-                srcRow = (flipY) ? rows - row - 1 : row;
-                normalized  = (sliceData[srcRow * cols + tarSliceNr] - min) / (max - min);
-                renderIndex = (row * slices + slice) * NUMBER_OF_CHANNELS;
-                renderImageData[renderIndex++] = normalized;
-                renderImageData[renderIndex++] = normalized;
-                renderImageData[renderIndex++] = normalized;
-                renderImageData[renderIndex] = self->mAlpha;
-            }
-            
-            free(sliceData);
+            EDTypedSliceView sliceView = [self sourceSlice:(uint) srcSliceNr];
+            const void* srcColData = EDTypedVoxelAt(sliceView.data, sliceView.type, tarSliceNr);
+            ptrdiff_t srcStride = (ptrdiff_t) sliceView.rowStride;
+            // each source slice becomes one column of the target image
+            BARenderTypedRow(&renderTarget, slice, slices,
+                             (flipY) ? EDTypedVoxelAt(srcColData, sliceView.type, (rows - 1) * srcStride) : srcColData, sliceView.type, (flipY) ? -srcStride : srcStride, rows,
+                             min, invRange);
         }
         
     } else {
-        // Many slice view
-        // TODO: much space for parallelization here
+        // Many slice view: one job per grid tile, each tile writes a disjoint set of columns of renderTarget
+        size_t tileCount  = gridWidth * gridHeight;
+        size_t* tileSlices = [self tileSlicesOf:tileCount flipped:flipZ];
+        EDTypedSliceView* sliceViews = [self sliceViewsOf:slices flipped:flipX];
         
-        size_t renderIndex = 0;
-        NSUInteger relevantSlicesCount = [self->mRelevantSlices count];
-        size_t flippedGridIndex;
-        for (int slice = 0; slice < slices; slice++) {
-            srcSliceNr = (flipX) ? slices - slice - 1 : slice;
-            float* sliceData = [self->mImage getSliceData:(uint) srcSliceNr
-                                               atTimestep:self->mCurrentTimestep];
-            
-            for (int gridIndex = 0; gridIndex < gridWidth * gridHeight; gridIndex++) {
-                if (gridIndex < relevantSlicesCount) {
-                    flippedGridIndex = (flipZ) ? relevantSlicesCount - gridIndex - 1 : gridIndex;
-                    size_t relevantCol = [[self->mRelevantSlices objectAtIndex:flippedGridIndex] intValue];
-                    
-                    for (int row = 0; row < rows; row++) {
-                        srcRow = (flipY) ? rows - row - 1 : row;
-                        normalized = (sliceData[srcRow * cols + relevantCol] - min) / (max - min);
-                        renderIndex = ((gridIndex / gridWidth) * gridWidth * slices * rows // Grid row
-                                       + (gridIndex % gridWidth) * slices                  // Grid col
-                                       + (row * gridWidth * slices + slice)                // Position in grid tile
-                                       ) * NUMBER_OF_CHANNELS;
-                        renderImageData[renderIndex++] = normalized;
-                        renderImageData[renderIndex++] = normalized;
-                        renderImageData[renderIndex++] = normalized;
-                        renderImageData[renderIndex]   = self->mAlpha;
-                    }
+        dispatch_apply(tileCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t tile) {
+            size_t renderIndex;
+            for (size_t slice = 0; slice < slices; slice++) {
+                renderIndex = ((tile / gridWidth) * gridWidth * slices * rows // Grid row
+                               + (tile % gridWidth) * slices                  // Grid col
+                               + slice                                        // Column in grid tile
+                               );
+                if (tileSlices[tile] != EMPTY_TILE) {
+                    ptrdiff_t srcStride = (ptrdiff_t) sliceViews[slice].rowStride;
+                    const void* srcColData = EDTypedVoxelAt(sliceViews[slice].data, sliceViews[slice].type, tileSlices[tile]);
+                    BARenderTypedRow(&renderTarget, renderIndex, gridWidth * slices,
+                                     (flipY) ? EDTypedVoxelAt(srcColData, sliceViews[slice].type, (rows - 1) * srcStride) : srcColData, sliceViews[slice].type, (flipY) ? -srcStride : srcStride, rows,
+                                     min, invRange);
+                } else {
+                    BARenderFillRow(&renderTarget, renderIndex, gridWidth * slices, rows);
                 }
             }
-            
-            free(sliceData);
-        }
+        });
+        
+        free(sliceViews);
+        free(tileSlices);
     }
     
-    CIImage* ciImage = [self imageFromFloat:renderImageData 
-                                     length:renderImageDataLength 
-                                bytesPerRow:gridWidth * slices * NUMBER_OF_CHANNELS * sizeof(float)
-                                      width:gridWidth * slices 
-                                     height:gridHeight * rows];
-    free(renderImageData);
+    CIImage* ciImage = [self imageFromRenderTarget:renderTarget
+                                           width:gridWidth * slices
+                                          height:gridHeight * rows];
     
     return ciImage;
 }
@@ -936,7 +1281,7 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
 {
     // TODO: too much c&p from renderIdenticalImage ;)
     
-    BARTImageSize* imageSize = [self->mImage getImageSize];
+    BARTImageSize* imageSize = [self sourceSize];
     
     //    size_t rows       = imageSize.rows;
     size_t cols       = imageSize.columns;
@@ -952,9 +1297,8 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
                                     * cols
                                     * gridWidth
                                     * gridHeight
-                                    * NUMBER_OF_CHANNELS
-                                    * sizeof(float);
-    float* renderImageData = malloc(renderImageDataLength);
+                                    * BARenderFormatBytesPerPixel([self targetFormat]);
+    BARenderTarget renderTarget = {malloc(renderImageDataLength), [self targetFormat], self->mAlpha, self->mColortableLUT};
     
     float min = [[self->mImageMinMax objectAtIndex:0] floatValue];
     float max = [[self->mImageMinMax objectAtIndex:1] floatValue];
@@ -963,98 +1307,209 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
         min = 0.0f;
         if (max == 0.0f) max = FLT_MAX;
     }
-    float normalized = 0.0f;
+    float invRange = 1.0f / (max - min);
     
     size_t srcSliceNr;
-    size_t srcCol;
     if (   gridWidth == 1
         && gridHeight == 1) {
         // Single slice view
         
-        size_t renderIndex;
         int tarSliceNr = (flipZ) ? (self->mSliceCount - self->mCurrentSlice - 1) : self->mCurrentSlice;
         for (int slice = 0; slice < slices; slice++) {
             
             srcSliceNr = (flipX) ? slices - slice - 1 : slice;
-            float* sliceData = [self->mImage getSliceData:(uint) srcSliceNr
-                                               atTimestep:self->mCurrentTimestep];
-            
-            for (int col = 0; col < cols; col++) {
-                srcCol = (flipY) ? cols - col - 1 : col;
-                normalized  = (sliceData[tarSliceNr * cols + srcCol] - min) / (max - min);
-                renderIndex = (col * slices + slice) * NUMBER_OF_CHANNELS;
-                renderImageData[renderIndex++] = normalized;
-                renderImageData[renderIndex++] = normalized;
-                renderImageData[renderIndex++] = normalized;
-                renderImageData[renderIndex] = self->mAlpha;
-            }
-            
-            free(sliceData);
+            EDTypedSliceView sliceView = [self sourceSlice:(uint) srcSliceNr];
+            const void* srcRowData = EDTypedVoxelAt(sliceView.data, sliceView.type, tarSliceNr * sliceView.rowStride);
+            // each source slice becomes one column of the target image
+            BARenderTypedRow(&renderTarget, slice, slices,
+                             (flipY) ? EDTypedVoxelAt(srcRowData, sliceView.type, cols - 1) : srcRowData, sliceView.type, (flipY) ? -1 : 1, cols,
+                             min, invRange);
         }
         
     } else {
-        // Many slice view
-        // TODO: much space for parallelization here
+        // Many slice view: one job per grid tile, each tile writes a disjoint set of columns of renderTarget
+        size_t tileCount  = gridWidth * gridHeight;
+        size_t* tileSlices = [self tileSlicesOf:tileCount flipped:flipZ];
+        EDTypedSliceView* sliceViews = [self sliceViewsOf:slices flipped:flipX];
         
-        size_t renderIndex = 0;
-        NSUInteger relevantSlicesCount = [self->mRelevantSlices count];
-        size_t flippedGridIndex;
-        for (int slice = 0; slice < slices; slice++) {
-            srcSliceNr = (flipX) ? slices - slice - 1 : slice;
-            float* sliceData = [self->mImage getSliceData:(uint) srcSliceNr
-                                               atTimestep:self->mCurrentTimestep];
-            
-            for (int gridIndex = 0; gridIndex < gridWidth * gridHeight; gridIndex++) {
-                if (gridIndex < relevantSlicesCount) {
-                    flippedGridIndex = (flipZ) ? relevantSlicesCount - gridIndex - 1 : gridIndex;
-                    size_t relevantRow = [[self->mRelevantSlices objectAtIndex:flippedGridIndex] intValue];
-                    
-                    for (int col = 0; col < cols; col++) {
-                        srcCol = (flipY) ? cols - col - 1: col; 
-                        normalized = (sliceData[relevantRow * cols + srcCol] - min) / (max - min);
-                        renderIndex = ((gridIndex / gridWidth) * gridWidth * slices * cols // Grid row
-                                       + (gridIndex % gridWidth) * slices                  // Grid col
-                                       + (col * gridWidth * slices + slice)                // Position in grid tile
-                                       ) * NUMBER_OF_CHANNELS;
-                        renderImageData[renderIndex++] = normalized;
-                        renderImageData[renderIndex++] = normalized;
-                        renderImageData[renderIndex++] = normalized;
-                        renderImageData[renderIndex]   = self->mAlpha;
-                    }
+        dispatch_apply(tileCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t tile) {
+            size_t renderIndex;
+            for (size_t slice = 0; slice < slices; slice++) {
+                renderIndex = ((tile / gridWidth) * gridWidth * slices * cols // Grid row
+                               + (tile % gridWidth) * slices                  // Grid col
+                               + slice                                        // Column in grid tile
+                               );
+                if (tileSlices[tile] != EMPTY_TILE) {
+                    const void* srcRowData = EDTypedVoxelAt(sliceViews[slice].data, sliceViews[slice].type, tileSlices[tile] * sliceViews[slice].rowStride);
+                    BARenderTypedRow(&renderTarget, renderIndex, gridWidth * slices,
+                                     (flipY) ? EDTypedVoxelAt(srcRowData, sliceViews[slice].type, cols - 1) : srcRowData, sliceViews[slice].type, (flipY) ? -1 : 1, cols,
+                                     min, invRange);
+                } else {
+                    BARenderFillRow(&renderTarget, renderIndex, gridWidth * slices, cols);
                 }
             }
-            
-            free(sliceData);
-        }
+        });
+        
+        free(sliceViews);
+        free(tileSlices);
     }
     
-    CIImage* ciImage = [self imageFromFloat:renderImageData 
-                                     length:renderImageDataLength 
-                                bytesPerRow:gridWidth * slices * NUMBER_OF_CHANNELS * sizeof(float)
-                                      width:gridWidth * slices 
-                                     height:gridHeight * cols];
-    free(renderImageData);
+    CIImage* ciImage = [self imageFromRenderTarget:renderTarget
+                                           width:gridWidth * slices
+                                          height:gridHeight * cols];
     
     return ciImage;
 }
 
--(CIImage*)imageFromFloat:(float*)data 
-                   length:(size_t)len 
-              bytesPerRow:(size_t)bpr
-                    width:(size_t)w
-                   height:(size_t)h
+-(BARTImageSize*)sourceSize
 {
-    NSSize ciImageSize;
-    ciImageSize.width  = w;
-    ciImageSize.height = h;
-//    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
-    CIImage* ciImage = [[CIImage alloc] initWithBitmapData:[NSData dataWithBytes:data
-                                                                          length:len]
-                                               bytesPerRow:bpr
-                                                      size:ciImageSize 
-                                                    format:kCIFormatRGBAf
-                                                colorSpace:nil]; //colorSpace];
-//    CGColorSpaceRelease(colorSpace);
+    if (self->mSnapshot == nil) {
+        return [self->mImage getImageSize];
+    }
+    
+    return [[[BARTImageSize alloc] initWithRows:self->mSnapshot->rows
+                                        andCols:self->mSnapshot->cols
+                                      andSlices:self->mSnapshot->slices
+                                   andTimesteps:1] autorelease];
+}
+
+-(EDTypedSliceView)sourceSlice:(uint)sliceNr
+{
+    if (self->mSnapshot == nil) {
+        return [self->mImage getTypedSliceView:sliceNr
+                                    atTimestep:self->mCurrentTimestep];
+    }
+    
+    EDTypedSliceView view = {NULL, ED_VOXEL_FLOAT, 0, nil};
+    if (sliceNr < self->mSnapshot->slices) {
+        view = self->mSnapshot->views[sliceNr];
+    }
+    return view;
+}
+
+-(EDTypedSliceView)viewOfPlane:(uint)planeNr 
+                       in:(const EDFloatVolume*)planes
+{
+    if (planes == NULL) {
+        return [self sourceSlice:planeNr];
+    }
+    
+    EDTypedSliceView view = {NULL, ED_VOXEL_FLOAT, 0, nil};
+    if (planeNr < planes->slices) {
+        view.data      = EDFloatVolumeSlice(planes, planeNr, 0);
+        view.rowStride = (size_t) planes->rowStride;
+    }
+    return view;
+}
+
+-(CIImage*)renderCachedLayout:(enum ReorientedLayout)layout
+{
+    if (!self->mUseReorientedCache) {
+        return nil;
+    }
+    
+    EDFloatVolume planes;
+    id planesToken = (self->mSnapshot != nil) ? [self->mReorientedCache getVolume:&planes
+                                                                             from:self->mSnapshot
+                                                                           layout:layout]
+                                              : [self->mReorientedCache getVolume:&planes
+                                                                               of:self->mImage
+                                                                       atTimestep:self->mCurrentTimestep
+                                                                           layout:layout];
+    if (planesToken == nil) {
+        return nil;
+    }
+    
+    return [self renderPlanesOf:&planes];
+}
+
+-(size_t*)tileSlicesOf:(size_t)tileCount 
+               flipped:(BOOL)flipped
+{
+    size_t* tileSlices = malloc(tileCount * sizeof(size_t));
+    NSUInteger relevantSlicesCount = [self->mRelevantSlices count];
+    
+    for (size_t tile = 0; tile < tileCount; tile++) {
+        if (tile < relevantSlicesCount) {
+            size_t flippedIndex = (flipped) ? relevantSlicesCount - tile - 1 : tile;
+            tileSlices[tile] = [[self->mRelevantSlices objectAtIndex:flippedIndex] intValue];
+        } else {
+            tileSlices[tile] = EMPTY_TILE;
+        }
+    }
+    
+    return tileSlices;
+}
+
+-(EDTypedSliceView*)sliceViewsOf:(size_t)slices
+                    flipped:(BOOL)flipped
+{
+    EDTypedSliceView* sliceViews = malloc(slices * sizeof(EDTypedSliceView));
+    
+    for (size_t slice = 0; slice < slices; slice++) {
+        size_t srcSliceNr = (flipped) ? slices - slice - 1 : slice;
+        sliceViews[slice] = [self sourceSlice:(uint) srcSliceNr];
+    }
+    
+    return sliceViews;
+}
+
+-(CIImage*)imageFromRenderTarget:(BARenderTarget)target
+                           width:(size_t)w
+                          height:(size_t)h
+{
+    size_t bytesPerPixel = BARenderFormatBytesPerPixel(target.format);
+    NSData* pixels = [NSData dataWithBytesNoCopy:target.data
+                                          length:w * h * bytesPerPixel
+                                    freeWhenDone:YES];
+    
+    if (target.format == RENDER_FORMAT_RGBA_FLOAT) {
+        NSSize ciImageSize;
+        ciImageSize.width  = w;
+        ciImageSize.height = h;
+        return [[CIImage alloc] initWithBitmapData:pixels
+                                       bytesPerRow:w * bytesPerPixel
+                                              size:ciImageSize
+                                            format:kCIFormatRGBAf
+                                        colorSpace:nil];
+    }
+    
+    if (target.format == RENDER_FORMAT_COLORTABLE_RGBA8) {
+        // Colors of the colortable are device RGB, as the CIImage the filters sample them from
+        CGDataProviderRef provider   = CGDataProviderCreateWithCFData((CFDataRef) pixels);
+        CGColorSpaceRef   colorSpace = CGColorSpaceCreateDeviceRGB();
+        CGImageRef        cgImage    = CGImageCreate(w, h, 8, 32, w * bytesPerPixel, colorSpace,
+                                                     kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big, provider,
+                                                     NULL, false, kCGRenderingIntentDefault);
+        CIImage* ciImage = [[CIImage alloc] initWithCGImage:cgImage];
+        
+        CGImageRelease(cgImage);
+        CGColorSpaceRelease(colorSpace);
+        CGDataProviderRelease(provider);
+        
+        return ciImage;
+    }
+    
+    CGBitmapInfo bitmapInfo = kCGImageAlphaNone;
+    if (target.format == RENDER_FORMAT_LUMINANCE_FLOAT) {
+        bitmapInfo |= kCGBitmapFloatComponents | kCGBitmapByteOrder32Host;
+    } else if (target.format == RENDER_FORMAT_LUMINANCE_16) {
+        bitmapInfo |= kCGBitmapByteOrder16Host;
+    }
+    
+    CGDataProviderRef provider   = CGDataProviderCreateWithCFData((CFDataRef) pixels);
+    CGColorSpaceRef   colorSpace = CGColorSpaceCreateDeviceGray();
+    CGImageRef        cgImage    = CGImageCreate(w, h,
+                                                 bytesPerPixel * 8, bytesPerPixel * 8, w * bytesPerPixel,
+                                                 colorSpace, bitmapInfo, provider,
+                                                 NULL, false, kCGRenderingIntentDefault);
+    // Same as colorSpace:nil for RGBA: values are passed through unchanged
+    NSDictionary* options = [NSDictionary dictionaryWithObject:[NSNull null] forKey:kCIImageColorSpace];
+    CIImage* ciImage = [[CIImage alloc] initWithCGImage:cgImage options:options];
+    
+    CGImageRelease(cgImage);
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
     
     return ciImage;
 }
@@ -1063,10 +1518,9 @@ const NSUInteger MASK_Z_FLIP  = 1 << 2;
 {
     NSSize ciImageSize = [ciImage extent].size;
     NSBitmapImageRep* imageRep = [[[NSBitmapImageRep alloc] initWithCIImage:ciImage] autorelease];
-    CGImageRef        cgImage = imageRep.CGImage;
     
-    NSImage*          nsImage = [[[NSImage alloc] initWithCGImage:cgImage 
-                                                             size:ciImageSize] autorelease];
+    NSImage*          nsImage = [[[NSImage alloc] initWithSize:ciImageSize] autorelease];
+    [nsImage addRepresentation:imageRep];
     
     return nsImage;
 }
@@ -14,6 +14,8 @@
 @class BADataElementRenderer;
 @class BABrainImageView;
 @class BAImageSliceSelector;
+@class BARenderPrefetcher;
+@class BARenderScheduler;
 
 /**
  * Controller for an ImageDataView.
@@ -41,6 +43,12 @@
     
     /** Size of the multi slice grid. */
     NSSize mGridSize;
+    
+    /** Renders the next slices/timesteps of all three renderers in the background. */
+    BARenderPrefetcher* mPrefetcher;
+    
+    /** Renders the view images off the main thread, coalescing bursts of updates. */
+    BARenderScheduler* mRenderScheduler;
 }
 
 /** Custom NSView providing overlay functionality. */
@@ -60,6 +68,14 @@
 -(IBAction)setGridSize:(id)sender;
 -(IBAction)selectSlice:(id)sender;
 
+/** Shows all images at timestep tstep (e.g. when new realtime data arrived).
+ *
+ * \param tstep Timestep to show. */
+-(void)selectTimestep:(uint)tstep;
+
+/** Frame counters and input-to-pixel latency of the view, \see{BARenderScheduler#getStatistics}. */
+-(NSDictionary*)getRenderStatistics;
+
 
 
 // ###########################################
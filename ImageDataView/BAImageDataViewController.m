@@ -13,6 +13,8 @@
 
 #import "BAImageSliceSelector.h"
 #import "BADataElementRenderer.h"
+#import "BARenderPrefetcher.h"
+#import "BARenderScheduler.h"
 
 #import "BASingleDomainColortableFilter.h"
 #import "BATwoDomainColortableFilter.h"
@@ -70,11 +72,20 @@ static const unsigned int KEY_UP_ARROW   = 126;
 @interface BAImageDataViewController (__privateMethods__)
 
 /**
- * Renders back- and foreground and passes the image objects to the view
- * class for display.
+ * Requests rendering of back- and foreground in the background and updates the
+ * slice selectors. The images are passed to the view by presentFrame: when ready.
  */
 -(void)updateViewImages;
 
+/**
+ * Passes the images of a rendered frame to the view class for display.
+ * Called by mRenderScheduler on the main thread.
+ *
+ * \param renderers Copies of the background, overlay and selection renderer (in this
+ *                  order) the frame was rendered with.
+ */
+-(void)presentFrame:(NSArray*)renderers;
+
 /**
  * Update the image filters applied to overlay with new min/max values.
  *
@@ -162,6 +173,22 @@ static const unsigned int KEY_UP_ARROW   = 126;
         self->mSelectionRenderer = [[BADataElementRenderer alloc] initWithSliceSelector:sliceSelector];
         [sliceSelector release];
         
+        // Background image is displayed as is: 8 bit gray is all the screen shows anyway
+        [self->mRenderer setRenderFormat:RENDER_FORMAT_LUMINANCE_8];
+        
+        self->mPrefetcher = [[BARenderPrefetcher alloc] initWithRenderers:[NSArray arrayWithObjects:self->mRenderer,
+                                                                                                    self->mOverlayRenderer,
+                                                                                                    self->mSelectionRenderer,
+                                                                                                    nil]
+                                                                    depth:DEFAULT_PREFETCH_DEPTH];
+        
+        self->mRenderScheduler = [[BARenderScheduler alloc] initWithRenderers:[NSArray arrayWithObjects:self->mRenderer,
+                                                                                                       self->mOverlayRenderer,
+                                                                                                       self->mSelectionRenderer,
+                                                                                                       nil]
+                                                                       target:self
+                                                                       action:@selector(presentFrame:)];
+        
         BAImageFilter* imageFilter = [[BASingleDomainColortableFilter alloc] init];
         [self->mOverlayRenderer setImageFilter:imageFilter];
         [imageFilter release];
@@ -228,12 +255,17 @@ static const unsigned int KEY_UP_ARROW   = 126;
 
 -(void)dealloc
 {
+    // Pending frames must not be presented by a deallocated controller
+    [self->mRenderScheduler cancel];
+    [self->mRenderScheduler release];
+    
     [self->mSelectionRenderer removeObserver:self->mImageView
                                   forKeyPath:OBSERVED_KEYPATH];
     
     if (self->mRenderer != nil) [self->mRenderer release];
     if (self->mOverlayRenderer != nil) [self->mOverlayRenderer release];
     if (self->mSelectionRenderer != nil) [self->mSelectionRenderer release];
+    [self->mPrefetcher release];
         
     [self->mOverlays release];
     
@@ -263,6 +295,7 @@ static const unsigned int KEY_UP_ARROW   = 126;
                 break;
         }
 
+        [self->mPrefetcher cancel];
         [self->mRenderer setTargetOrientation:viewOrientation];
         [self->mOverlayRenderer setTargetOrientation:viewOrientation];
         [self->mSelectionRenderer setTargetOrientation:viewOrientation];
@@ -287,6 +320,7 @@ static const unsigned int KEY_UP_ARROW   = 126;
                     
 //        NSLog(@"Grid size: %2.0f, %2.0f", self->mGridSize.width, self->mGridSize.height);
         
+        [self->mPrefetcher cancel];
         [self->mRenderer setGridSize:self->mGridSize];
         [self->mOverlayRenderer setGridSize:self->mGridSize];
         [self->mSelectionRenderer setGridSize:self->mGridSize];
@@ -304,10 +338,25 @@ static const unsigned int KEY_UP_ARROW   = 126;
     [self->mSelectionRenderer setSlice:sliceNr];
     
     [self updateViewImages];
+    
+    // The next slices in the direction of movement are likely to come up next
+    [self->mPrefetcher sliceChangedTo:[self->mRenderer getCurrentSlice]];
+}
+
+-(void)selectTimestep:(uint)tstep
+{
+    [self->mRenderer setTimestep:tstep];
+    [self->mOverlayRenderer setTimestep:tstep];
+    [self->mSelectionRenderer setTimestep:tstep];
+    
+    [self updateViewImages];
+    
+    [self->mPrefetcher timestepChangedTo:[self->mRenderer getCurrentTimestep]];
 }
 
 -(void)setBackgroundImage:(EDDataElement*)image
 {
+    [self->mPrefetcher cancel];
     [self->mRenderer setData:image];
     
     [self updateViewImages];
@@ -383,14 +432,45 @@ static const unsigned int KEY_UP_ARROW   = 126;
 
 -(void)updateViewImages
 {
-    [self->mImageView setImages:[self->mSelectionRenderer renderImage:NO]
-                             on:[self->mOverlayRenderer renderImage:NO]
-                             on:[self->mRenderer renderImage:NO]];
+    [self->mRenderScheduler requestFrame];
 
     [self updateSliceSelectors];
     [self updateControlEnabledStates];
 }
 
+-(void)presentFrame:(NSArray*)renderers
+{
+    // Raw images are rendered already, only the filters are applied here
+    NSImage* background = [[renderers objectAtIndex:0] renderImage:NO];
+    NSImage* overlay    = [[renderers objectAtIndex:1] renderImage:NO];
+    NSImage* selection  = [[renderers objectAtIndex:2] renderImage:NO];
+    
+    // Unless the settings changed meanwhile (intermediate frames), the frame shows the
+    // current state: the renderers take over its images. The view is set all three images
+    // below, its selection observation would only composite the frame a second time.
+    [self->mRenderer          adoptImage:background renderedBy:[renderers objectAtIndex:0]];
+    [self->mOverlayRenderer   adoptImage:overlay    renderedBy:[renderers objectAtIndex:1]];
+    [self->mSelectionRenderer removeObserver:self->mImageView
+                                  forKeyPath:OBSERVED_KEYPATH];
+    [self->mSelectionRenderer adoptImage:selection  renderedBy:[renderers objectAtIndex:2]];
+    [self->mSelectionRenderer addObserver:self->mImageView
+                               forKeyPath:OBSERVED_KEYPATH
+                                  options:NSKeyValueObservingOptionNew
+                                  context:OBSERVING_SELECTION_CONTEXT];
+    
+    [self->mImageView setAlphas:[[renderers objectAtIndex:2] getCompositeAlpha]
+                             on:[[renderers objectAtIndex:1] getCompositeAlpha]
+                             on:[[renderers objectAtIndex:0] getCompositeAlpha]];
+    [self->mImageView setImages:selection
+                             on:overlay
+                             on:background];
+}
+
+-(NSDictionary*)getRenderStatistics
+{
+    return [self->mRenderScheduler getStatistics];
+}
+
 -(void)updateSliceSelectors
 {
     [self updateSliceTextField];
@@ -7,6 +7,7 @@
 //
 
 #import <Foundation/Foundation.h>
+#import "BAColortableKernels.h"
 
 /**
  * Common superclass for colortable based image filters.
@@ -14,12 +15,24 @@
  */
 @interface BAImageFilter : NSObject {
     
-    /** Wrapped CIFilter. */
+    /** Wrapped CIFilter, created once by BAImageFilter#createFilter. */
     CIFilter* mFilter;
+    /** Parameter revision last passed to mFilter. */
+    NSUInteger mFilterRevision;
+    
+    /** Image mCachedOutput was created from (retained to keep its identity). */
+    CIImage*   mCachedInput;
+    /** Result of the last BAImageFilter#apply:. */
+    CIImage*   mCachedOutput;
+    /** Parameter revision mCachedOutput was created with. */
+    NSUInteger mCachedRevision;
     
     /** Custom parameter map passed to mFilter. */
     NSMutableDictionary* mParams;
     
+    /** Incremented on every parameter change. */
+    NSUInteger mRevision;
+    
 }
 
 /** Getter. */
@@ -27,13 +40,34 @@
 
 /**
  * Applies the wrapped CIFilter to a CIImage object.
+ * Renderers only take this path for filters without a lookup table
+ * (\see{BAImageFilter#fillColortableLUT:}) or if the table could not be allocated.
+ * The CIFilter is created on first use and kept, later calls only pass
+ * changed parameters to it. Applying the filter to the same image object
+ * with unchanged parameters returns the previous result.
  *
  * \param on CIImage to apply the filter to.
  * \return   New CIImage resulting from applying the filter
- *           on the passed image.
+ *           on the passed image (nil if the filter has no CIFilter).
  */
 -(CIImage*)apply:(CIImage*)on;
 
+/**
+ * Creates the CIFilter applied by BAImageFilter#apply:, configured except for
+ * its input image and the parameters named by BAImageFilter#filterParameterKeys.
+ * Meant for subclassing, the default implementation returns nil.
+ *
+ * \return Autoreleased CIFilter.
+ */
+-(CIFilter*)createFilter;
+
+/**
+ * Names of the parameters (\see{BAImageFilter#setValue:forKey:}) passed on
+ * to the CIFilter. Meant for subclassing, the default implementation returns
+ * an empty array.
+ */
+-(NSArray*)filterParameterKeys;
+
 /**
  * Sets a named parameter.
  */
@@ -44,4 +78,26 @@
  */
 -(id)valueForKey:(NSString *)key;
 
+/**
+ * Revision of the parameters, changes with every BAImageFilter#setValue:forKey:.
+ */
+-(NSUInteger)getRevision;
+
+/**
+ * Builds the lookup table mapping normalised voxel values ([0, 1]) to colors
+ * for the current parameters, so the filter can be applied while rendering
+ * (\see{BAColortableMapRow}) instead of on the rendered image.
+ * The default implementation does not support this.
+ *
+ * \param lut Table to fill in.
+ * \return    NO if the filter can only be applied through BAImageFilter#apply:.
+ */
+-(BOOL)fillColortableLUT:(BAColortableLUT*)lut;
+
+/**
+ * Releases the images kept by BAImageFilter#apply:. Called once the filter is
+ * applied through a lookup table, so the last fallback output does not stay alive.
+ */
+-(void)releaseCachedImages;
+
 @end
@@ -18,6 +18,12 @@ static const NSUInteger INITIAL_PARAMS_SIZE = 2;
     if (self = [super init]) {
         self->mFilter = nil;
         self->mParams = [[NSMutableDictionary alloc] initWithCapacity:INITIAL_PARAMS_SIZE];
+        self->mRevision = 0;
+        self->mFilterRevision = 0;
+        
+        self->mCachedInput    = nil;
+        self->mCachedOutput   = nil;
+        self->mCachedRevision = 0;
     }
     
     return self;
@@ -25,6 +31,9 @@ static const NSUInteger INITIAL_PARAMS_SIZE = 2;
 
 -(void)dealloc
 {
+    [self->mCachedInput release];
+    [self->mCachedOutput release];
+    [self->mFilter release];
     [self->mParams release];
     
     [super dealloc];
@@ -36,13 +45,60 @@ static const NSUInteger INITIAL_PARAMS_SIZE = 2;
 }
 
 -(CIImage*)apply:(CIImage*)on
+{
+    if (on == nil) {
+        return nil;
+    }
+    
+    // Same image, same parameters: the previous output is still valid
+    if (on == self->mCachedInput
+        && self->mRevision == self->mCachedRevision
+        && self->mCachedOutput != nil) {
+        return [[self->mCachedOutput retain] autorelease];
+    }
+    
+    BOOL created = NO;
+    if (self->mFilter == nil) {
+        self->mFilter = [[self createFilter] retain];
+        if (self->mFilter == nil) {
+            return nil;
+        }
+        created = YES;
+    }
+    
+    if (created || self->mFilterRevision != self->mRevision) {
+        for (NSString* key in [self filterParameterKeys]) {
+            [self->mFilter setValue:[self valueForKey:key] forKey:key];
+        }
+        self->mFilterRevision = self->mRevision;
+    }
+    
+    [self->mFilter setValue:on forKey:@"inputImage"];
+    CIImage* output = [self->mFilter valueForKey:@"outputImage"];
+    
+    [self->mCachedInput release];
+    [self->mCachedOutput release];
+    self->mCachedInput    = [on retain];
+    self->mCachedOutput   = [output retain];
+    self->mCachedRevision = self->mRevision;
+    
+    return output;
+}
+
+-(CIFilter*)createFilter
 {
     return nil;
 }
 
+-(NSArray*)filterParameterKeys
+{
+    return [NSArray array];
+}
+
 -(void)setValue:(id)value forKey:(NSString *)key
 {
     [self->mParams setValue:value forKey:key];
+    self->mRevision++;
 }
 
 -(id)valueForKey:(NSString *)key
@@ -50,4 +106,22 @@ static const NSUInteger INITIAL_PARAMS_SIZE = 2;
     return [self->mParams valueForKey:key];
 }
 
+-(NSUInteger)getRevision
+{
+    return self->mRevision;
+}
+
+-(BOOL)fillColortableLUT:(BAColortableLUT*)lut
+{
+    return NO;
+}
+
+-(void)releaseCachedImages
+{
+    [self->mCachedInput release];
+    [self->mCachedOutput release];
+    self->mCachedInput  = nil;
+    self->mCachedOutput = nil;
+}
+
 @end
@@ -0,0 +1,117 @@
+//
+//  BARenderCache.h
+//  ImageDataView
+//
+
+#import <Foundation/Foundation.h>
+#include <string.h>
+#import <QuartzCore/QuartzCore.h>
+#import "EDDataElement.h"
+#import "BARenderKernels.h"
+
+/** Default upper bound of the memory used by the rendered images in a BARenderCache. */
+static const size_t DEFAULT_RENDER_CACHE_BYTES = 64 * 1024 * 1024;
+
+/**
+ * Everything the raw rendered image of a BADataElementRenderer depends on.
+ * Construct with BARenderCacheKeyMake so padding bytes are zero (keys are compared bytewise).
+ */
+typedef struct {
+    /** Identity of the EDDataElement (not retained, only compared). */
+    const void*  element;
+    /** Data generation of the EDDataElement. */
+    NSUInteger   generation;
+    enum ImageOrientation orientation;
+    /** Slice (target orientation), ignored for multi slice grids. */
+    uint         slice;
+    uint         timestep;
+    NSUInteger   flipMask;
+    uint         gridWidth;
+    uint         gridHeight;
+    enum BARenderFormat format;
+    /** Only relevant for RENDER_FORMAT_RGBA_FLOAT, set to 0 for other formats. */
+    float        alpha;
+    /** BAColortableLUT hash for RENDER_FORMAT_COLORTABLE_RGBA8, 0 for other formats. */
+    uint64_t     colortable;
+} BARenderCacheKey;
+
+/** Returns a zero initialized key. */
+static inline BARenderCacheKey BARenderCacheKeyMake(void)
+{
+    BARenderCacheKey key;
+    memset(&key, 0, sizeof(key));
+    return key;
+}
+
+/**
+ * Memory-bounded least recently used cache of rendered (unfiltered) images.
+ *
+ * Images are evicted least recently used first as soon as the sum of their
+ * pixel buffer sizes exceeds the byte limit.
+ * All methods are thread safe.
+ */
+@interface BARenderCache : NSObject {
+
+    /** Cached CIImage objects by key (NSData wrapping a BARenderCacheKey). */
+    NSMutableDictionary* mImages;
+    /** Buffer size in bytes (NSNumber) of each cached image by key. */
+    NSMutableDictionary* mImageBytes;
+    /** Keys ordered from least to most recently used. */
+    NSMutableArray*      mUsage;
+
+    /** Upper bound of mBytesUsed. */
+    size_t mByteLimit;
+    /** Sum of the buffer sizes of all cached images. */
+    size_t mBytesUsed;
+
+    /** Counters reported by getStatistics. */
+    unsigned long long mHits;
+    unsigned long long mMisses;
+    unsigned long long mEvictions;
+}
+
+/** Initializer using DEFAULT_RENDER_CACHE_BYTES as byte limit. */
+-(id)init;
+
+/** Initializer.
+ *
+ * \param bytes Upper bound of the memory used by cached images. */
+-(id)initWithByteLimit:(size_t)bytes;
+
+/**
+ * Looks up a rendered image. Counts as hit or miss and marks the image as most recently used.
+ *
+ * \param key Key the image was stored with.
+ * \return    Autoreleased CIImage, nil if it is not cached.
+ */
+-(CIImage*)imageForKey:(BARenderCacheKey)key;
+
+/**
+ * Stores a rendered image, evicting least recently used ones if needed.
+ * Images larger than the byte limit are not cached.
+ *
+ * \param image Rendered image to store (retained by the cache).
+ * \param key   Key to store the image with. An existing image with the same key is replaced.
+ * \param bytes Size of the pixel buffer backing the image.
+ */
+-(void)setImage:(CIImage*)image
+         forKey:(BARenderCacheKey)key
+          bytes:(size_t)bytes;
+
+/**
+ * Sets the upper bound of the memory used by cached images, evicting images if needed.
+ *
+ * \param bytes New byte limit.
+ */
+-(void)setByteLimit:(size_t)bytes;
+
+/** Removes all cached images (counters are kept). */
+-(void)clear;
+
+/**
+ * Returns the cache counters: "hits", "misses", "evictions", "entries",
+ * "bytesUsed" and "byteLimit" (all NSNumber).
+ */
+-(NSDictionary*)getStatistics;
+
+@end
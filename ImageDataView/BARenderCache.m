@@ -0,0 +1,160 @@
+//
+//  BARenderCache.m
+//  ImageDataView
+//
+
+#import "BARenderCache.h"
+
+
+// ###############################
+// # Private method declarations #
+// ###############################
+
+@interface BARenderCache (__privateMethods__)
+
+/** Removes the image stored with key. Must be called while holding the lock on self. */
+-(void)removeImageForKey:(NSData*)key;
+
+/** Evicts least recently used images until at most bytes are in use. Must be called while holding the lock on self. */
+-(void)evictDownTo:(size_t)bytes;
+
+@end
+
+
+// ##################
+// # Implementation #
+// ##################
+
+@implementation BARenderCache
+
+-(id)init
+{
+    return [self initWithByteLimit:DEFAULT_RENDER_CACHE_BYTES];
+}
+
+-(id)initWithByteLimit:(size_t)bytes
+{
+    if (self = [super init]) {
+        self->mImages     = [[NSMutableDictionary alloc] init];
+        self->mImageBytes = [[NSMutableDictionary alloc] init];
+        self->mUsage      = [[NSMutableArray alloc] init];
+
+        self->mByteLimit  = bytes;
+        self->mBytesUsed  = 0;
+
+        self->mHits       = 0;
+        self->mMisses     = 0;
+        self->mEvictions  = 0;
+    }
+
+    return self;
+}
+
+-(void)dealloc
+{
+    [self->mImages release];
+    [self->mImageBytes release];
+    [self->mUsage release];
+
+    [super dealloc];
+}
+
+-(CIImage*)imageForKey:(BARenderCacheKey)key
+{
+    NSData* keyData = [NSData dataWithBytes:&key length:sizeof(key)];
+
+    @synchronized(self) {
+        CIImage* image = [self->mImages objectForKey:keyData];
+        if (image == nil) {
+            self->mMisses++;
+            return nil;
+        }
+
+        self->mHits++;
+        // Move to the most recently used end
+        [self->mUsage removeObject:keyData];
+        [self->mUsage addObject:keyData];
+
+        return [[image retain] autorelease];
+    }
+}
+
+-(void)setImage:(CIImage*)image
+         forKey:(BARenderCacheKey)key
+          bytes:(size_t)bytes
+{
+    if (image == nil) {
+        return;
+    }
+
+    NSData* keyData = [NSData dataWithBytes:&key length:sizeof(key)];
+
+    @synchronized(self) {
+        [self removeImageForKey:keyData];
+        if (bytes > self->mByteLimit) {
+            return;
+        }
+
+        [self evictDownTo:self->mByteLimit - bytes];
+
+        [self->mImages setObject:image forKey:keyData];
+        [self->mImageBytes setObject:[NSNumber numberWithUnsignedLongLong:bytes] forKey:keyData];
+        [self->mUsage addObject:keyData];
+        self->mBytesUsed += bytes;
+    }
+}
+
+-(void)setByteLimit:(size_t)bytes
+{
+    @synchronized(self) {
+        self->mByteLimit = bytes;
+        [self evictDownTo:bytes];
+    }
+}
+
+-(void)clear
+{
+    @synchronized(self) {
+        [self->mImages removeAllObjects];
+        [self->mImageBytes removeAllObjects];
+        [self->mUsage removeAllObjects];
+        self->mBytesUsed = 0;
+    }
+}
+
+-(NSDictionary*)getStatistics
+{
+    @synchronized(self) {
+        return [NSDictionary dictionaryWithObjectsAndKeys:
+                [NSNumber numberWithUnsignedLongLong:self->mHits],         @"hits",
+                [NSNumber numberWithUnsignedLongLong:self->mMisses],       @"misses",
+                [NSNumber numberWithUnsignedLongLong:self->mEvictions],    @"evictions",
+                [NSNumber numberWithUnsignedInteger:[self->mImages count]], @"entries",
+                [NSNumber numberWithUnsignedLongLong:self->mBytesUsed],    @"bytesUsed",
+                [NSNumber numberWithUnsignedLongLong:self->mByteLimit],    @"byteLimit",
+                nil];
+    }
+}
+
+-(void)removeImageForKey:(NSData*)key
+{
+    NSNumber* bytes = [self->mImageBytes objectForKey:key];
+    if (bytes == nil) {
+        return;
+    }
+
+    self->mBytesUsed -= [bytes unsignedLongLongValue];
+    [self->mImages removeObjectForKey:key];
+    [self->mImageBytes removeObjectForKey:key];
+    [self->mUsage removeObject:key];
+}
+
+-(void)evictDownTo:(size_t)bytes
+{
+    while (self->mBytesUsed > bytes && [self->mUsage count] > 0) {
+        [self removeImageForKey:[[[self->mUsage objectAtIndex:0] retain] autorelease]];
+        self->mEvictions++;
+    }
+}
+
+@end
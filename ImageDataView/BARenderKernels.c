@@ -0,0 +1,402 @@
+//
+//  BARenderKernels.c
+//  ImageDataView
+//
+
+#include "BARenderKernels.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BA_RENDER_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BA_RENDER_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BA_RENDER_NEON 1
+#endif
+
+#if BA_RENDER_AVX2 || BA_RENDER_SSE2
+#define BA_RENDER_SSE2_LUMINANCE 1
+#endif
+
+
+void BARenderGrayToRGBAScalar(const float* src, ptrdiff_t srcStride, size_t count,
+                              float* dst, ptrdiff_t dstStride,
+                              float min, float invRange, float alpha)
+{
+    for (size_t i = 0; i < count; i++) {
+        float normalized = (*src - min) * invRange;
+        dst[0] = normalized;
+        dst[1] = normalized;
+        dst[2] = normalized;
+        dst[3] = alpha;
+        src += srcStride;
+        dst += dstStride * 4;
+    }
+}
+
+#if BA_RENDER_AVX2
+
+/** 8 voxels -> 8 pixels. reversed: take src[0], src[-1], ..., src[-7]. */
+static inline void expand8(const float* src, int reversed, float* dst,
+                           __m256 vMin, __m256 vInv, __m256 vAlpha)
+{
+    __m256 v;
+    if (reversed) {
+        v = _mm256_permutevar8x32_ps(_mm256_loadu_ps(src - 7), _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+    } else {
+        v = _mm256_loadu_ps(src);
+    }
+    v = _mm256_mul_ps(_mm256_sub_ps(v, vMin), vInv);
+
+    // (v0 v0 v0 v0 v1 v1 v1 v1), alpha blended into lanes 3 and 7
+    __m256 p0 = _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1));
+    __m256 p1 = _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3));
+    __m256 p2 = _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(4, 4, 4, 4, 5, 5, 5, 5));
+    __m256 p3 = _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(6, 6, 6, 6, 7, 7, 7, 7));
+    _mm256_storeu_ps(dst,      _mm256_blend_ps(p0, vAlpha, 0x88));
+    _mm256_storeu_ps(dst + 8,  _mm256_blend_ps(p1, vAlpha, 0x88));
+    _mm256_storeu_ps(dst + 16, _mm256_blend_ps(p2, vAlpha, 0x88));
+    _mm256_storeu_ps(dst + 24, _mm256_blend_ps(p3, vAlpha, 0x88));
+}
+
+static size_t grayToRGBAContiguous(const float* src, int reversed, size_t count, float* dst,
+                                   float min, float invRange, float alpha)
+{
+    __m256 vMin   = _mm256_set1_ps(min);
+    __m256 vInv   = _mm256_set1_ps(invRange);
+    __m256 vAlpha = _mm256_set1_ps(alpha);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        expand8(reversed ? src - i : src + i, reversed, dst + i * 4, vMin, vInv, vAlpha);
+    }
+    return i;
+}
+
+#elif BA_RENDER_SSE2
+
+static size_t grayToRGBAContiguous(const float* src, int reversed, size_t count, float* dst,
+                                   float min, float invRange, float alpha)
+{
+    __m128 vMin   = _mm_set1_ps(min);
+    __m128 vInv   = _mm_set1_ps(invRange);
+    __m128 vAlpha = _mm_set1_ps(alpha);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 v;
+        if (reversed) {
+            v = _mm_loadu_ps(src - i - 3);
+            v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+        } else {
+            v = _mm_loadu_ps(src + i);
+        }
+        v = _mm_mul_ps(_mm_sub_ps(v, vMin), vInv);
+
+        __m128 lo = _mm_unpacklo_ps(v, vAlpha);   // v0 a v1 a
+        __m128 hi = _mm_unpackhi_ps(v, vAlpha);   // v2 a v3 a
+        float* out = dst + i * 4;
+        _mm_storeu_ps(out,      _mm_shuffle_ps(v, lo, _MM_SHUFFLE(1, 0, 0, 0)));
+        _mm_storeu_ps(out + 4,  _mm_shuffle_ps(v, lo, _MM_SHUFFLE(3, 2, 1, 1)));
+        _mm_storeu_ps(out + 8,  _mm_shuffle_ps(v, hi, _MM_SHUFFLE(1, 0, 2, 2)));
+        _mm_storeu_ps(out + 12, _mm_shuffle_ps(v, hi, _MM_SHUFFLE(3, 2, 3, 3)));
+    }
+    return i;
+}
+
+#elif BA_RENDER_NEON
+
+static size_t grayToRGBAContiguous(const float* src, int reversed, size_t count, float* dst,
+                                   float min, float invRange, float alpha)
+{
+    float32x4_t vMin   = vdupq_n_f32(min);
+    float32x4_t vInv   = vdupq_n_f32(invRange);
+    float32x4_t vAlpha = vdupq_n_f32(alpha);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t v;
+        if (reversed) {
+            v = vrev64q_f32(vld1q_f32(src - i - 3));
+            v = vcombine_f32(vget_high_f32(v), vget_low_f32(v));
+        } else {
+            v = vld1q_f32(src + i);
+        }
+        v = vmulq_f32(vsubq_f32(v, vMin), vInv);
+
+        // interleaving store does the gray -> RGBA expansion
+        float32x4x4_t pixels = { { v, v, v, vAlpha } };
+        vst4q_f32(dst + i * 4, pixels);
+    }
+    return i;
+}
+
+#endif
+
+void BARenderGrayToRGBA(const float* src, ptrdiff_t srcStride, size_t count,
+                        float* dst, ptrdiff_t dstStride,
+                        float min, float invRange, float alpha)
+{
+    size_t done = 0;
+#if BA_RENDER_AVX2 || BA_RENDER_SSE2 || BA_RENDER_NEON
+    if (1 == dstStride && (1 == srcStride || -1 == srcStride)) {
+        done = grayToRGBAContiguous(src, -1 == srcStride, count, dst, min, invRange, alpha);
+    }
+#endif
+    BARenderGrayToRGBAScalar(src + (ptrdiff_t) done * srcStride, srcStride, count - done,
+                             dst + done * dstStride * 4, dstStride,
+                             min, invRange, alpha);
+}
+
+void BARenderFillRGBA(float* dst, ptrdiff_t dstStride, size_t count, float value, float alpha)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[0] = value;
+        dst[1] = value;
+        dst[2] = value;
+        dst[3] = alpha;
+        dst += dstStride * 4;
+    }
+}
+
+size_t BARenderFormatBytesPerPixel(enum BARenderFormat format)
+{
+    switch (format) {
+        case RENDER_FORMAT_LUMINANCE_FLOAT:
+            return sizeof(float);
+        case RENDER_FORMAT_LUMINANCE_16:
+            return sizeof(uint16_t);
+        case RENDER_FORMAT_LUMINANCE_8:
+            return sizeof(uint8_t);
+        case RENDER_FORMAT_COLORTABLE_RGBA8:
+            return sizeof(uint32_t);
+        default:
+            return 4 * sizeof(float);
+    }
+}
+
+#if BA_RENDER_SSE2_LUMINANCE
+
+/** Loads 4 consecutive voxels, in reverse order if reversed (src[0], src[-1], ...). */
+static inline __m128 load4(const float* src, int reversed)
+{
+    if (reversed) {
+        __m128 v = _mm_loadu_ps(src - 3);
+        return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+    }
+    return _mm_loadu_ps(src);
+}
+
+/** Normalised, clamped to [0, 1] and scaled to [0, scale], rounded to the nearest integer. */
+static inline __m128i quantize4(const float* src, int reversed,
+                                __m128 vMin, __m128 vInv, __m128 vScale)
+{
+    __m128 v = _mm_mul_ps(_mm_sub_ps(load4(src, reversed), vMin), vInv);
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, vScale), _mm_set1_ps(0.5f)));
+}
+
+#elif BA_RENDER_NEON
+
+static inline float32x4_t load4(const float* src, int reversed)
+{
+    if (reversed) {
+        float32x4_t v = vrev64q_f32(vld1q_f32(src - 3));
+        return vcombine_f32(vget_high_f32(v), vget_low_f32(v));
+    }
+    return vld1q_f32(src);
+}
+
+static inline uint32x4_t quantize4(const float* src, int reversed,
+                                   float32x4_t vMin, float32x4_t vInv, float32x4_t vScale)
+{
+    float32x4_t v = vmulq_f32(vsubq_f32(load4(src, reversed), vMin), vInv);
+    v = vminq_f32(vmaxq_f32(v, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+    return vcvtq_u32_f32(vaddq_f32(vmulq_f32(v, vScale), vdupq_n_f32(0.5f)));
+}
+
+#endif
+
+static inline float normalize(float val, float min, float invRange)
+{
+    return (val - min) * invRange;
+}
+
+static inline unsigned int quantize(float val, float min, float invRange, float scale)
+{
+    float normalized = normalize(val, min, invRange);
+    normalized = (normalized > 0.0f) ? normalized : 0.0f;
+    normalized = (normalized < 1.0f) ? normalized : 1.0f;
+    return (unsigned int) (normalized * scale + 0.5f);
+}
+
+void BARenderGrayToLuminanceF(const float* src, ptrdiff_t srcStride, size_t count,
+                              float* dst, ptrdiff_t dstStride,
+                              float min, float invRange)
+{
+    size_t i = 0;
+    if (1 == dstStride && (1 == srcStride || -1 == srcStride)) {
+        int reversed = (-1 == srcStride);
+#if BA_RENDER_SSE2_LUMINANCE
+        __m128 vMin = _mm_set1_ps(min);
+        __m128 vInv = _mm_set1_ps(invRange);
+        for (; i + 4 <= count; i += 4) {
+            __m128 v = load4(reversed ? src - i : src + i, reversed);
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_sub_ps(v, vMin), vInv));
+        }
+#elif BA_RENDER_NEON
+        float32x4_t vMin = vdupq_n_f32(min);
+        float32x4_t vInv = vdupq_n_f32(invRange);
+        for (; i + 4 <= count; i += 4) {
+            float32x4_t v = load4(reversed ? src - i : src + i, reversed);
+            vst1q_f32(dst + i, vmulq_f32(vsubq_f32(v, vMin), vInv));
+        }
+#endif
+        (void) reversed;
+    }
+    for (; i < count; i++) {
+        dst[(ptrdiff_t) i * dstStride] = normalize(src[(ptrdiff_t) i * srcStride], min, invRange);
+    }
+}
+
+void BARenderGrayToLuminance16(const float* src, ptrdiff_t srcStride, size_t count,
+                               uint16_t* dst, ptrdiff_t dstStride,
+                               float min, float invRange)
+{
+    size_t i = 0;
+    if (1 == dstStride && (1 == srcStride || -1 == srcStride)) {
+        int reversed = (-1 == srcStride);
+#if BA_RENDER_SSE2_LUMINANCE
+        __m128 vMin   = _mm_set1_ps(min);
+        __m128 vInv   = _mm_set1_ps(invRange);
+        __m128 vScale = _mm_set1_ps(65535.0f);
+        // SSE2 only packs with signed saturation: shift into the int16 range and back
+        __m128i vBias32 = _mm_set1_epi32(32768);
+        __m128i vBias16 = _mm_set1_epi16((short) 0x8000);
+        for (; i + 8 <= count; i += 8) {
+            __m128i lo = quantize4(reversed ? src - i : src + i, reversed, vMin, vInv, vScale);
+            __m128i hi = quantize4(reversed ? src - i - 4 : src + i + 4, reversed, vMin, vInv, vScale);
+            __m128i packed = _mm_packs_epi32(_mm_sub_epi32(lo, vBias32), _mm_sub_epi32(hi, vBias32));
+            _mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(packed, vBias16));
+        }
+#elif BA_RENDER_NEON
+        float32x4_t vMin   = vdupq_n_f32(min);
+        float32x4_t vInv   = vdupq_n_f32(invRange);
+        float32x4_t vScale = vdupq_n_f32(65535.0f);
+        for (; i + 8 <= count; i += 8) {
+            uint32x4_t lo = quantize4(reversed ? src - i : src + i, reversed, vMin, vInv, vScale);
+            uint32x4_t hi = quantize4(reversed ? src - i - 4 : src + i + 4, reversed, vMin, vInv, vScale);
+            vst1q_u16(dst + i, vcombine_u16(vmovn_u32(lo), vmovn_u32(hi)));
+        }
+#endif
+        (void) reversed;
+    }
+    for (; i < count; i++) {
+        dst[(ptrdiff_t) i * dstStride] = (uint16_t) quantize(src[(ptrdiff_t) i * srcStride], min, invRange, 65535.0f);
+    }
+}
+
+void BARenderGrayToLuminance8(const float* src, ptrdiff_t srcStride, size_t count,
+                              uint8_t* dst, ptrdiff_t dstStride,
+                              float min, float invRange)
+{
+    size_t i = 0;
+    if (1 == dstStride && (1 == srcStride || -1 == srcStride)) {
+        int reversed = (-1 == srcStride);
+#if BA_RENDER_SSE2_LUMINANCE
+        __m128 vMin   = _mm_set1_ps(min);
+        __m128 vInv   = _mm_set1_ps(invRange);
+        __m128 vScale = _mm_set1_ps(255.0f);
+        for (; i + 16 <= count; i += 16) {
+            const float* s = reversed ? src - i : src + i;
+            ptrdiff_t step = reversed ? -4 : 4;
+            __m128i q0 = quantize4(s,            reversed, vMin, vInv, vScale);
+            __m128i q1 = quantize4(s + step,     reversed, vMin, vInv, vScale);
+            __m128i q2 = quantize4(s + 2 * step, reversed, vMin, vInv, vScale);
+            __m128i q3 = quantize4(s + 3 * step, reversed, vMin, vInv, vScale);
+            // values are within [0, 255] already, saturation never kicks in
+            __m128i packed = _mm_packus_epi16(_mm_packs_epi32(q0, q1), _mm_packs_epi32(q2, q3));
+            _mm_storeu_si128((__m128i*) (dst + i), packed);
+        }
+#elif BA_RENDER_NEON
+        float32x4_t vMin   = vdupq_n_f32(min);
+        float32x4_t vInv   = vdupq_n_f32(invRange);
+        float32x4_t vScale = vdupq_n_f32(255.0f);
+        for (; i + 8 <= count; i += 8) {
+            uint32x4_t lo = quantize4(reversed ? src - i : src + i, reversed, vMin, vInv, vScale);
+            uint32x4_t hi = quantize4(reversed ? src - i - 4 : src + i + 4, reversed, vMin, vInv, vScale);
+            vst1_u8(dst + i, vmovn_u16(vcombine_u16(vmovn_u32(lo), vmovn_u32(hi))));
+        }
+#endif
+        (void) reversed;
+    }
+    for (; i < count; i++) {
+        dst[(ptrdiff_t) i * dstStride] = (uint8_t) quantize(src[(ptrdiff_t) i * srcStride], min, invRange, 255.0f);
+    }
+}
+
+void BARenderRow(const BARenderTarget* target, size_t pixel, ptrdiff_t dstStride,
+                 const float* src, ptrdiff_t srcStride, size_t count,
+                 float min, float invRange)
+{
+    switch (target->format) {
+        case RENDER_FORMAT_LUMINANCE_FLOAT:
+            BARenderGrayToLuminanceF(src, srcStride, count, (float*) target->data + pixel, dstStride, min, invRange);
+            break;
+        case RENDER_FORMAT_LUMINANCE_16:
+            BARenderGrayToLuminance16(src, srcStride, count, (uint16_t*) target->data + pixel, dstStride, min, invRange);
+            break;
+        case RENDER_FORMAT_LUMINANCE_8:
+            BARenderGrayToLuminance8(src, srcStride, count, (uint8_t*) target->data + pixel, dstStride, min, invRange);
+            break;
+        case RENDER_FORMAT_COLORTABLE_RGBA8:
+            BAColortableMapRow(target->lut, src, srcStride, count, (uint32_t*) target->data + pixel, dstStride, min, invRange);
+            break;
+        default:
+            BARenderGrayToRGBA(src, srcStride, count, (float*) target->data + pixel * 4, dstStride,
+                               min, invRange, target->alpha);
+            break;
+    }
+}
+
+// Voxels converted per step by BARenderTypedRow (on the stack).
+#define BA_RENDER_TYPED_BLOCK 256
+
+void BARenderTypedRow(const BARenderTarget* target, size_t pixel, ptrdiff_t dstStride,
+                      const void* src, enum EDVoxelType type, ptrdiff_t srcStride, size_t count,
+                      float min, float invRange)
+{
+    if (ED_VOXEL_FLOAT == type) {
+        BARenderRow(target, pixel, dstStride, (const float*) src, srcStride, count, min, invRange);
+        return;
+    }
+    
+    float block[BA_RENDER_TYPED_BLOCK];
+    for (size_t i = 0; i < count; i += BA_RENDER_TYPED_BLOCK) {
+        size_t n = (count - i < BA_RENDER_TYPED_BLOCK) ? count - i : BA_RENDER_TYPED_BLOCK;
+        EDTypedToFloat(EDTypedVoxelAt(src, type, (ptrdiff_t) i * srcStride), type, srcStride, n, block);
+        // converted block is dense, the vectorised path of the kernels applies
+        BARenderRow(target, pixel + i * (size_t) dstStride, dstStride, block, 1, n, min, invRange);
+    }
+}
+
+void BARenderFillRow(const BARenderTarget* target, size_t pixel, ptrdiff_t dstStride, size_t count)
+{
+    size_t bytesPerPixel = BARenderFormatBytesPerPixel(target->format);
+    if (RENDER_FORMAT_RGBA_FLOAT == target->format) {
+        BARenderFillRGBA((float*) target->data + pixel * 4, dstStride, count, 0.0f, target->alpha);
+    } else if (RENDER_FORMAT_COLORTABLE_RGBA8 == target->format) {
+        // Black is the lowest value, i.e. whatever the colortable maps 0 to
+        uint32_t* dst = (uint32_t*) target->data + pixel;
+        for (size_t i = 0; i < count; i++) {
+            dst[(ptrdiff_t) i * dstStride] = target->lut->entries[0];
+        }
+    } else {
+        uint8_t* dst = (uint8_t*) target->data + pixel * bytesPerPixel;
+        for (size_t i = 0; i < count; i++) {
+            // all bits zero is 0 in every luminance format
+            memset(dst + (ptrdiff_t) i * dstStride * (ptrdiff_t) bytesPerPixel, 0, bytesPerPixel);
+        }
+    }
+}
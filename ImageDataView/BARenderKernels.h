@@ -0,0 +1,122 @@
+//
+//  BARenderKernels.h
+//  ImageDataView
+//
+
+#ifndef ImageDataView_BARenderKernels_h
+#define ImageDataView_BARenderKernels_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "BAColortableKernels.h"
+#include "EDTypedVolume.h"
+
+/** Pixel layout of a render target buffer. */
+enum BARenderFormat {
+    /** 4 floats per pixel (gray, gray, gray, alpha) - kCIFormatRGBAf. */
+      RENDER_FORMAT_RGBA_FLOAT
+    /** 1 float per pixel, alpha is applied when compositing. */
+    , RENDER_FORMAT_LUMINANCE_FLOAT
+    /** 1 uint16_t per pixel, [0, 1] mapped to [0, 65535]. */
+    , RENDER_FORMAT_LUMINANCE_16
+    /** 1 uint8_t per pixel, [0, 1] mapped to [0, 255]. */
+    , RENDER_FORMAT_LUMINANCE_8
+    /** Premultiplied RGBA8 pixels looked up in a BAColortableLUT (colortable already applied). */
+    , RENDER_FORMAT_COLORTABLE_RGBA8
+};
+
+/** Frame buffer written by BARenderRow/BARenderFillRow. */
+typedef struct {
+    /** Pixel data, layout according to format. */
+    void* data;
+    enum BARenderFormat format;
+    /** Only stored in the pixels for RENDER_FORMAT_RGBA_FLOAT. */
+    float alpha;
+    /** Colortable for RENDER_FORMAT_COLORTABLE_RGBA8, NULL for other formats. */
+    const BAColortableLUT* lut;
+} BARenderTarget;
+
+/** Number of bytes a single pixel of the given format occupies. */
+size_t BARenderFormatBytesPerPixel(enum BARenderFormat format);
+
+/** Normalises count voxels and expands them to gray RGBA float pixels.
+ *
+ * For i in [0, count): v = (src[i * srcStride] - min) * invRange,
+ * pixel dst[i * dstStride] = (v, v, v, alpha).
+ *
+ * A negative srcStride walks the source backwards (flipped rows/cols).
+ * The case srcStride == +/-1 and dstStride == 1 is vectorised
+ * (AVX2, SSE2 or NEON - whatever the target is compiled for), everything else
+ * runs through the scalar loop.
+ *
+ * \param src       Pointer to the first source voxel to read.
+ * \param srcStride Distance between consecutive source voxels (in floats).
+ * \param count     Number of voxels/pixels.
+ * \param dst       Target pixel buffer (4 floats per pixel).
+ * \param dstStride Distance between consecutive target pixels (in pixels).
+ * \param min       Value mapped to 0.
+ * \param invRange  1 / (max - min), precomputed by the caller.
+ * \param alpha     Alpha value of every pixel.
+ */
+void BARenderGrayToRGBA(const float* src, ptrdiff_t srcStride, size_t count,
+                        float* dst, ptrdiff_t dstStride,
+                        float min, float invRange, float alpha);
+
+/** Plain C reference implementation of BARenderGrayToRGBA (no SIMD). */
+void BARenderGrayToRGBAScalar(const float* src, ptrdiff_t srcStride, size_t count,
+                              float* dst, ptrdiff_t dstStride,
+                              float min, float invRange, float alpha);
+
+/** Sets count pixels (dstStride apart) to (value, value, value, alpha). */
+void BARenderFillRGBA(float* dst, ptrdiff_t dstStride, size_t count, float value, float alpha);
+
+/** Normalises count voxels to single channel float pixels: dst[i * dstStride] = v.
+ *  Same parameters as BARenderGrayToRGBA except for alpha. */
+void BARenderGrayToLuminanceF(const float* src, ptrdiff_t srcStride, size_t count,
+                              float* dst, ptrdiff_t dstStride,
+                              float min, float invRange);
+
+/** Normalises count voxels to 16 bit luminance pixels (v clamped to [0, 1], rounded). */
+void BARenderGrayToLuminance16(const float* src, ptrdiff_t srcStride, size_t count,
+                               uint16_t* dst, ptrdiff_t dstStride,
+                               float min, float invRange);
+
+/** Normalises count voxels to 8 bit luminance pixels (v clamped to [0, 1], rounded). */
+void BARenderGrayToLuminance8(const float* src, ptrdiff_t srcStride, size_t count,
+                              uint8_t* dst, ptrdiff_t dstStride,
+                              float min, float invRange);
+
+/** Renders count voxels into target, starting at pixel index pixel, using the kernel matching target->format.
+ *
+ * \param target    Render target.
+ * \param pixel     Index (in pixels) of the first pixel to write.
+ * \param dstStride Distance between consecutive target pixels (in pixels).
+ * \param src       Pointer to the first source voxel to read.
+ * \param srcStride Distance between consecutive source voxels (in floats).
+ * \param count     Number of voxels/pixels.
+ * \param min       Value mapped to 0.
+ * \param invRange  1 / (max - min), precomputed by the caller.
+ */
+void BARenderRow(const BARenderTarget* target, size_t pixel, ptrdiff_t dstStride,
+                 const float* src, ptrdiff_t srcStride, size_t count,
+                 float min, float invRange);
+
+/** BARenderRow for source voxels of any EDVoxelType (see EDTypedVolume.h).
+ *
+ * Non-float voxels are converted in blocks on the stack right before rendering,
+ * so native (int16, uint8, ...) data never needs a float copy of its own.
+ *
+ * \param src       Pointer to the first source voxel to read.
+ * \param type      Type of the source voxels.
+ * \param srcStride Distance between consecutive source voxels (in voxels).
+ * \see BARenderRow for the other parameters.
+ */
+void BARenderTypedRow(const BARenderTarget* target, size_t pixel, ptrdiff_t dstStride,
+                      const void* src, enum EDVoxelType type, ptrdiff_t srcStride, size_t count,
+                      float min, float invRange);
+
+/** Sets count pixels of target (starting at pixel index pixel, dstStride apart) to black. */
+void BARenderFillRow(const BARenderTarget* target, size_t pixel, ptrdiff_t dstStride, size_t count);
+
+#endif
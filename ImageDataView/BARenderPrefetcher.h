@@ -0,0 +1,68 @@
+//
+//  BARenderPrefetcher.h
+//  ImageDataView
+//
+
+#import <Foundation/Foundation.h>
+
+@class BADataElementRenderer;
+
+/** Default number of slices/timesteps rendered ahead. */
+static const NSUInteger DEFAULT_PREFETCH_DEPTH = 4;
+
+/**
+ * Renders the slices/timesteps a user is likely to look at next in the background.
+ *
+ * The prefetcher watches the direction in which slice or timestep change and renders
+ * the next N of them for all its renderers into their rendered image caches
+ * (\see{BADataElementRenderer#copyForPrefetching}), so scrubbing through a volume
+ * finds already rendered frames.
+ * Every new request cancels the running prefetch, in particular when the direction changes.
+ *
+ * All methods are meant to be called from the main thread.
+ */
+@interface BARenderPrefetcher : NSObject {
+
+    /** Renderers whose next frames are prefetched. */
+    NSArray*         mRenderers;
+    /** Number of slices/timesteps to render ahead. */
+    NSUInteger       mDepth;
+
+    /** Serial queue the prefetch jobs run on. */
+    dispatch_queue_t mQueue;
+    /** Incremented by every request, running jobs stop as soon as it differs from their own. */
+    volatile int64_t mEpoch;
+
+    /** Last observed slice. The direction of movement is derived from it. */
+    uint             mLastSlice;
+    /** Last observed timestep. The direction of movement is derived from it. */
+    uint             mLastTimestep;
+}
+
+/** Initializer.
+ *
+ * \param renderers Array of BADataElementRenderer objects to prefetch for.
+ * \param depth     Number of slices/timesteps to render ahead. */
+-(id)initWithRenderers:(NSArray*)renderers
+                 depth:(NSUInteger)depth;
+
+/**
+ * Tells the prefetcher that the renderers were set to a new slice.
+ * Starts prefetching the following slices in the direction of movement.
+ *
+ * \param sliceNr Slice the renderers are at now.
+ */
+-(void)sliceChangedTo:(uint)sliceNr;
+
+/**
+ * Tells the prefetcher that the renderers were set to a new timestep.
+ * Starts prefetching the following timesteps in the direction of movement.
+ *
+ * \param tstep Timestep the renderers are at now.
+ */
+-(void)timestepChangedTo:(uint)tstep;
+
+/** Stops any running prefetch (e.g. after orientation, grid size or data changes). */
+-(void)cancel;
+
+@end
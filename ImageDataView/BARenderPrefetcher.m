@@ -0,0 +1,158 @@
+//
+//  BARenderPrefetcher.m
+//  ImageDataView
+//
+
+#import "BARenderPrefetcher.h"
+
+#import <libkern/OSAtomic.h>
+#import "BADataElementRenderer.h"
+
+
+// ###############################
+// # Private method declarations #
+// ###############################
+
+@interface BARenderPrefetcher (__privateMethods__)
+
+/**
+ * Cancels the running prefetch and starts a new one.
+ *
+ * \param from      Current slice/timestep (already rendered).
+ * \param direction -1 or +1.
+ * \param timesteps YES to step through timesteps, NO for slices.
+ */
+-(void)prefetchFrom:(uint)from
+          direction:(NSInteger)direction
+          timesteps:(BOOL)timesteps;
+
+@end
+
+
+// ##################
+// # Implementation #
+// ##################
+
+@implementation BARenderPrefetcher
+
+-(id)initWithRenderers:(NSArray*)renderers
+                 depth:(NSUInteger)depth
+{
+    if (self = [super init]) {
+        self->mRenderers = [renderers copy];
+        self->mDepth     = depth;
+        self->mQueue     = dispatch_queue_create("de.cbs.mpg.bart.ImageDataView.renderPrefetcher", NULL);
+        self->mEpoch     = 0;
+
+        self->mLastSlice    = 0;
+        self->mLastTimestep = 0;
+    }
+
+    return self;
+}
+
+-(void)dealloc
+{
+    [self cancel];
+    // Wait for the running job (it retains the renderer copies, not self)
+    dispatch_sync(self->mQueue, ^{});
+    dispatch_release(self->mQueue);
+    [self->mRenderers release];
+
+    [super dealloc];
+}
+
+-(void)sliceChangedTo:(uint)sliceNr
+{
+    NSInteger direction = (sliceNr > self->mLastSlice) ? 1 : ((sliceNr < self->mLastSlice) ? -1 : 0);
+    self->mLastSlice = sliceNr;
+    if (direction == 0) {
+        return;
+    }
+
+    [self prefetchFrom:sliceNr direction:direction timesteps:NO];
+}
+
+-(void)timestepChangedTo:(uint)tstep
+{
+    NSInteger direction = (tstep > self->mLastTimestep) ? 1 : ((tstep < self->mLastTimestep) ? -1 : 0);
+    self->mLastTimestep = tstep;
+    if (direction == 0) {
+        return;
+    }
+
+    [self prefetchFrom:tstep direction:direction timesteps:YES];
+}
+
+-(void)cancel
+{
+    OSAtomicIncrement64Barrier(&self->mEpoch);
+}
+
+-(void)prefetchFrom:(uint)from
+          direction:(NSInteger)direction
+          timesteps:(BOOL)timesteps
+{
+    int64_t epoch = OSAtomicIncrement64Barrier(&self->mEpoch);
+
+    // Snapshot the renderers' current state on this thread, the job only touches the copies.
+    // A copy renders the slices of the timestep it was made at: the same copies step through
+    // the slices, every timestep takes copies of its own.
+    NSMutableArray* sliceCopies = nil;
+    if (!timesteps) {
+        sliceCopies = [NSMutableArray arrayWithCapacity:[self->mRenderers count]];
+        for (BADataElementRenderer* renderer in self->mRenderers) {
+            BADataElementRenderer* copy = [renderer copyForPrefetching];
+            [sliceCopies addObject:copy];
+            [copy release];
+        }
+    }
+
+    NSMutableArray* steps = [NSMutableArray arrayWithCapacity:self->mDepth];
+    for (NSUInteger step = 1; step <= self->mDepth; step++) {
+        NSInteger next = (NSInteger) from + direction * (NSInteger) step;
+        if (next < 0) {
+            break;
+        }
+        NSMutableArray* copies = [NSMutableArray arrayWithCapacity:[self->mRenderers count]];
+        for (NSUInteger i = 0; i < [self->mRenderers count]; i++) {
+            BADataElementRenderer* renderer = [self->mRenderers objectAtIndex:i];
+            // Renderers might differ in size (e.g. overlay vs. background)
+            size_t available = (timesteps) ? [renderer getTimestepCount] : [renderer getSliceCount];
+            if ([renderer getDataElement] == nil || (size_t) next >= available) {
+                continue;
+            }
+            if (timesteps) {
+                BADataElementRenderer* copy = [renderer copyForPrefetchingAtTimestep:(uint) next];
+                [copies addObject:copy];
+                [copy release];
+            } else {
+                [copies addObject:[sliceCopies objectAtIndex:i]];
+            }
+        }
+        [steps addObject:copies];
+    }
+    if ([steps count] == 0) {
+        return;
+    }
+
+    volatile int64_t* currentEpoch = &self->mEpoch;
+    dispatch_async(self->mQueue, ^{
+        for (NSUInteger step = 0; step < [steps count]; step++) {
+            uint next = (uint) ((NSInteger) from + direction * (NSInteger) (step + 1));
+            for (BADataElementRenderer* copy in [steps objectAtIndex:step]) {
+                if (*currentEpoch != epoch) {
+                    return;
+                }
+                NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+                if (!timesteps) {
+                    [copy setSlice:next];
+                }
+                [copy prerender];
+                [pool drain];
+            }
+        }
+    });
+}
+
+@end
@@ -0,0 +1,83 @@
+//
+//  BARenderScheduler.h
+//  ImageDataView
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Renders the frames of a view on a background queue, off the main thread.
+ *
+ * Each frame request snapshots the renderers (\see{BADataElementRenderer#copyForPrefetching})
+ * and renders their raw images in the background. Requests are coalesced: a request still
+ * waiting when a newer one arrives is dropped, so a burst of slider events only renders
+ * the latest frame.
+ * Finished frames are presented on the main thread by sending the action to the target
+ * with the snapshot copies the frame was rendered with. Their renderImage:NO only applies
+ * the image filters to the raw images rendered in the background. For the latest frame
+ * the copies match the scheduler's renderers, which can take the images over
+ * (\see{BADataElementRenderer#adoptImage:renderedBy:}). Frames superseded by newer
+ * requests are presented as well, so continuous input still shows intermediate frames.
+ *
+ * All methods are meant to be called from the main thread.
+ */
+@interface BARenderScheduler : NSObject {
+
+    /** Renderers whose images make up a frame. */
+    NSArray*         mRenderers;
+    /** Object presenting the frames (not retained). */
+    id               mTarget;
+    /** Method of mTarget taking the NSArray of renderers to present the frame from. */
+    SEL              mAction;
+
+    /** Serial queue the frames are rendered on. */
+    dispatch_queue_t mQueue;
+    /** Number of the latest request, frames of older requests are skipped or presented as intermediate. */
+    volatile int64_t mLatestRequest;
+    /** Requests up to this number were cancelled, their frames are not presented. */
+    int64_t          mCancelledUpTo;
+
+    /** Time (mach_absolute_time) of the oldest input not presented yet, 0 if none. */
+    uint64_t         mPendingSince;
+
+    /** Counters reported by getStatistics. */
+    unsigned long long mRequests;
+    volatile int64_t   mCoalesced;
+    unsigned long long mFrames;
+    unsigned long long mIntermediateFrames;
+    uint64_t           mTotalLatency;
+    uint64_t           mMaxLatency;
+    uint64_t           mLastLatency;
+}
+
+/** Initializer.
+ *
+ * \param renderers Array of BADataElementRenderer objects making up a frame.
+ * \param target    Object presenting the frames (not retained, call cancel before it goes away).
+ * \param action    Selector of a method taking one NSArray argument: the renderers to present
+ *                  the frame from, in the order of renderers.
+ */
+-(id)initWithRenderers:(NSArray*)renderers
+                target:(id)target
+                action:(SEL)action;
+
+/**
+ * Requests a new frame for the current state of the renderers.
+ * The frame is presented asynchronously, unless a newer request supersedes it before
+ * its rendering starts.
+ */
+-(void)requestFrame;
+
+/** Drops all pending frames. The target is not sent the action for them anymore. */
+-(void)cancel;
+
+/**
+ * Returns the frame counters: "requests", "coalesced" (requests never rendered),
+ * "frames" (latest frames presented), "intermediateFrames" and the input-to-pixel latency
+ * "meanLatencyMs", "maxLatencyMs" and "lastLatencyMs" (all NSNumber).
+ * The latency is measured from the oldest input not shown yet to the return of the
+ * target's action for the latest frame.
+ */
+-(NSDictionary*)getStatistics;
+
+@end
@@ -0,0 +1,165 @@
+//
+//  BARenderScheduler.m
+//  ImageDataView
+//
+
+#import "BARenderScheduler.h"
+
+#import <libkern/OSAtomic.h>
+#import <mach/mach_time.h>
+#import "BADataElementRenderer.h"
+
+
+// ###############################
+// # Private method declarations #
+// ###############################
+
+@interface BARenderScheduler (__privateMethods__)
+
+/**
+ * Presents a rendered frame on the main thread and records the latency.
+ *
+ * \param request Number of the request the frame was rendered for.
+ * \param copies  Snapshot renderers the frame was rendered with.
+ */
+-(void)presentFrame:(int64_t)request
+               from:(NSArray*)copies;
+
+@end
+
+
+// ##################
+// # Implementation #
+// ##################
+
+@implementation BARenderScheduler
+
+-(id)initWithRenderers:(NSArray*)renderers
+                target:(id)target
+                action:(SEL)action
+{
+    if (self = [super init]) {
+        self->mRenderers     = [renderers copy];
+        self->mTarget        = target;
+        self->mAction        = action;
+        self->mQueue         = dispatch_queue_create("de.cbs.mpg.bart.ImageDataView.renderScheduler", NULL);
+        // Frames the user waits for go before prefetching
+        dispatch_set_target_queue(self->mQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0));
+        self->mLatestRequest = 0;
+        self->mCancelledUpTo = 0;
+        self->mPendingSince  = 0;
+
+        self->mRequests           = 0;
+        self->mCoalesced          = 0;
+        self->mFrames             = 0;
+        self->mIntermediateFrames = 0;
+        self->mTotalLatency       = 0;
+        self->mMaxLatency         = 0;
+        self->mLastLatency        = 0;
+    }
+
+    return self;
+}
+
+-(void)dealloc
+{
+    // Every queued job holds a reference, so none is left on mQueue here
+    dispatch_release(self->mQueue);
+    [self->mRenderers release];
+
+    [super dealloc];
+}
+
+-(void)requestFrame
+{
+    if (self->mPendingSince == 0) {
+        self->mPendingSince = mach_absolute_time();
+    }
+    self->mRequests++;
+    int64_t request = OSAtomicIncrement64Barrier(&self->mLatestRequest);
+
+    // Snapshot the renderers' current state on this thread, the job only touches the copies
+    NSMutableArray* copies = [NSMutableArray arrayWithCapacity:[self->mRenderers count]];
+    for (BADataElementRenderer* renderer in self->mRenderers) {
+        BADataElementRenderer* copy = [renderer copyForPrefetching];
+        [copies addObject:copy];
+        [copy release];
+    }
+
+    // The job keeps the scheduler alive until its frame is presented. It is released on
+    // the main queue only - were the last release on mQueue, dealloc would run there.
+    __block BARenderScheduler* scheduler = [self retain];
+    dispatch_async(self->mQueue, ^{
+        if (scheduler->mLatestRequest != request) {
+            // A newer request renders the frame instead
+            OSAtomicIncrement64(&scheduler->mCoalesced);
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [scheduler release];
+            });
+            return;
+        }
+
+        for (BADataElementRenderer* copy in copies) {
+            NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+            [copy prerender];
+            [pool drain];
+        }
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [scheduler presentFrame:request from:copies];
+            [scheduler release];
+        });
+    });
+}
+
+-(void)cancel
+{
+    self->mCancelledUpTo = OSAtomicIncrement64Barrier(&self->mLatestRequest);
+    self->mPendingSince  = 0;
+}
+
+-(void)presentFrame:(int64_t)request
+               from:(NSArray*)copies
+{
+    if (request <= self->mCancelledUpTo) {
+        return;
+    }
+
+    if (request != self->mLatestRequest) {
+        // Newer input is being rendered already, show what is there meanwhile
+        [self->mTarget performSelector:self->mAction withObject:copies];
+        self->mIntermediateFrames++;
+        return;
+    }
+
+    [self->mTarget performSelector:self->mAction withObject:copies];
+
+    uint64_t latency = mach_absolute_time() - self->mPendingSince;
+    self->mPendingSince = 0;
+    self->mFrames++;
+    self->mTotalLatency += latency;
+    self->mLastLatency   = latency;
+    if (latency > self->mMaxLatency) {
+        self->mMaxLatency = latency;
+    }
+}
+
+-(NSDictionary*)getStatistics
+{
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    double toMs = (double) timebase.numer / (double) timebase.denom / 1.0e6;
+    double n    = (self->mFrames > 0) ? (double) self->mFrames : 1.0;
+
+    return [NSDictionary dictionaryWithObjectsAndKeys:
+            [NSNumber numberWithUnsignedLongLong:self->mRequests],                     @"requests",
+            [NSNumber numberWithUnsignedLongLong:(unsigned long long) self->mCoalesced], @"coalesced",
+            [NSNumber numberWithUnsignedLongLong:self->mFrames],                       @"frames",
+            [NSNumber numberWithUnsignedLongLong:self->mIntermediateFrames],           @"intermediateFrames",
+            [NSNumber numberWithDouble:self->mTotalLatency * toMs / n],                @"meanLatencyMs",
+            [NSNumber numberWithDouble:self->mMaxLatency * toMs],                      @"maxLatencyMs",
+            [NSNumber numberWithDouble:self->mLastLatency * toMs],                     @"lastLatencyMs",
+            nil];
+}
+
+@end
@@ -0,0 +1,130 @@
+//
+//  BAReorientedVolumeCache.h
+//  ImageDataView
+//
+
+#import <Foundation/Foundation.h>
+#import "EDDataElement.h"
+
+/**
+ * Enum indicating how a volume is transposed so that each slice of a
+ * target orientation differing from the main orientation becomes one contiguous plane.
+ * Named after the render methods of BADataElementRenderer that would otherwise gather the data.
+ *
+ * Plane layouts in source dimensions (plane, plane row, plane column):
+ */
+enum ReorientedLayout {
+    /** (row, slice, column) */
+      REORIENT_TURN_UP
+    /** (column, slice, row) */
+    , REORIENT_TURN_LEFT_ROTATE_RIGHT
+    /** (column, row, slice) */
+    , REORIENT_TURN_LEFT
+    /** (row, column, slice) */
+    , REORIENT_TURN_UP_ROTATE_RIGHT
+    , REORIENT_LAYOUT_COUNT
+};
+
+/**
+ * Slice views (with their tokens) and data generation of one timestep of an element.
+ * Taken on the thread the element is used on, so whoever reads it later - the cache queue,
+ * a renderer copy in the background - only reads memory pinned by the tokens and never
+ * calls into the element.
+ */
+@interface BAReorientedVolumeSource : NSObject {
+@public
+    EDDataElement*    element;
+    NSUInteger        generation;
+    uint              timestep;
+    size_t            cols;
+    size_t            rows;
+    size_t            slices;
+    EDTypedSliceView* views;
+}
+
+/** \return nil if tstep is out of range or a slice can not be viewed. */
+-(id)initWithElement:(EDDataElement*)elem
+          atTimestep:(uint)tstep;
+
+@end
+
+
+/**
+ * Cache of transposed copies of one timestep of an EDDataElement, one per ReorientedLayout.
+ *
+ * Rendering a view orthogonal to the main orientation directly from the element touches
+ * every source slice for each rendered slice. With a transposed copy it is a single
+ * contiguous plane read, i.e. scrolling through slices is O(slice) instead of O(volume).
+ *
+ * Copies are built lazily on first request or in the background
+ * (\see{BAReorientedVolumeCache#prepareVolumeOf:atTimestep:layout:}).
+ * They are keyed by element, data generation and timestep, so any change of the
+ * element's data invalidates them.
+ * The element is only asked for its generation and slice views on the calling thread
+ * (the thread its data is used on), the copies are built from these views - whose tokens
+ * keep the data alive - without calling into the element.
+ * All methods are thread safe.
+ */
+@interface BAReorientedVolumeCache : NSObject {
+
+    /** Serial queue all cache state is accessed on. */
+    dispatch_queue_t mQueue;
+
+    /** Element the cached copies were built from. */
+    EDDataElement* mElement;
+    /** Data generation of mElement the cached copies were built at. */
+    NSUInteger     mGeneration;
+    /** Timestep of mElement the cached copies were built from. */
+    uint           mTimestep;
+
+    /** Transposed copies, nil if not (yet) built. */
+    NSData*        mPlanes[REORIENT_LAYOUT_COUNT];
+    /** Geometry of the transposed copies (planes are the slices). */
+    EDFloatVolume  mPlaneVolumes[REORIENT_LAYOUT_COUNT];
+}
+
+/**
+ * Returns the transposed copy of a timestep of elem, building it if necessary.
+ *
+ * \param volume Filled with the geometry of the copy: its slices are the planes,
+ *               columns/rows the plane columns/rows of the requested layout.
+ * \param elem   EDDataElement to transpose.
+ * \param tstep  Timestep of elem.
+ * \param layout Requested layout.
+ * \return       Autoreleased token keeping the data of volume alive,
+ *               nil if the element could not be read. The data must not be written to.
+ */
+-(id)getVolume:(EDFloatVolume*)volume
+            of:(EDDataElement*)elem
+    atTimestep:(uint)tstep
+        layout:(enum ReorientedLayout)layout;
+
+/**
+ * Same as BAReorientedVolumeCache#getVolume:of:atTimestep:layout: for a timestep
+ * snapshotted before. Does not call into the element, may be called on any thread.
+ *
+ * \param volume Filled with the geometry of the copy.
+ * \param source Slice views of the timestep to transpose.
+ * \param layout Requested layout.
+ * \return       Autoreleased token keeping the data of volume alive, nil on failure.
+ */
+-(id)getVolume:(EDFloatVolume*)volume
+          from:(BAReorientedVolumeSource*)source
+        layout:(enum ReorientedLayout)layout;
+
+/**
+ * Builds the transposed copy of a timestep of elem in the background
+ * (if it is not cached already). Returns immediately.
+ *
+ * \param elem   EDDataElement to transpose.
+ * \param tstep  Timestep of elem.
+ * \param layout Layout to build.
+ */
+-(void)prepareVolumeOf:(EDDataElement*)elem
+            atTimestep:(uint)tstep
+                layout:(enum ReorientedLayout)layout;
+
+/** Releases all cached copies. */
+-(void)clear;
+
+@end
@@ -0,0 +1,294 @@
+//
+//  BAReorientedVolumeCache.m
+//  ImageDataView
+//
+
+#import "BAReorientedVolumeCache.h"
+
+
+// ###############################
+// # Private method declarations #
+// ###############################
+
+@interface BAReorientedVolumeCache (__privateMethods__)
+
+/**
+ * Drops all cached copies if they were not built from elem at generation and tstep.
+ * Must be called on mQueue.
+ */
+-(void)validateFor:(EDDataElement*)elem
+        generation:(NSUInteger)generation
+        atTimestep:(uint)tstep;
+
+/**
+ * Builds the transposed copy for layout from source unless it is cached already.
+ * Must be called on mQueue, after validateFor:generation:atTimestep: with the source's values.
+ *
+ * \return NO if the copy could not be allocated.
+ */
+-(BOOL)buildVolumeFrom:(BAReorientedVolumeSource*)source
+                layout:(enum ReorientedLayout)layout;
+
+@end
+
+
+// ##################
+// # Implementation #
+// ##################
+
+@implementation BAReorientedVolumeSource
+
+-(id)initWithElement:(EDDataElement*)elem
+          atTimestep:(uint)tstep
+{
+    if (self = [super init]) {
+        // Generation first: a change while the views are taken invalidates the copy built from them
+        self->generation = [elem getGeneration];
+        self->element    = [elem retain];
+        self->timestep   = tstep;
+
+        BARTImageSize* size = [elem getImageSize];
+        self->cols   = size.columns;
+        self->rows   = size.rows;
+        self->slices = 0;
+        self->views  = NULL;
+        if (tstep >= size.timesteps || size.columns * size.rows * size.slices == 0) {
+            [self release];
+            return nil;
+        }
+
+        self->views = malloc(size.slices * sizeof(EDTypedSliceView));
+        if (self->views == NULL) {
+            [self release];
+            return nil;
+        }
+        for (size_t slice = 0; slice < size.slices; slice++) {
+            EDTypedSliceView view = [elem getTypedSliceView:(uint) slice atTimestep:tstep];
+            if (view.data == NULL) {
+                [self release];
+                return nil;
+            }
+            [view.token retain];
+            self->views[slice] = view;
+            self->slices++;
+        }
+    }
+
+    return self;
+}
+
+-(void)dealloc
+{
+    for (size_t slice = 0; slice < self->slices; slice++) {
+        [self->views[slice].token release];
+    }
+    free(self->views);
+    [self->element release];
+
+    [super dealloc];
+}
+
+@end
+
+
+@implementation BAReorientedVolumeCache
+
+-(id)init
+{
+    if (self = [super init]) {
+        self->mQueue      = dispatch_queue_create("de.cbs.mpg.bart.ImageDataView.reorientedVolumeCache", NULL);
+        self->mElement    = nil;
+        self->mGeneration = 0;
+        self->mTimestep   = 0;
+        for (int layout = 0; layout < REORIENT_LAYOUT_COUNT; layout++) {
+            self->mPlanes[layout] = nil;
+        }
+    }
+
+    return self;
+}
+
+-(void)dealloc
+{
+    [self clear];
+    dispatch_release(self->mQueue);
+
+    [super dealloc];
+}
+
+-(id)getVolume:(EDFloatVolume*)volume
+            of:(EDDataElement*)elem
+    atTimestep:(uint)tstep
+        layout:(enum ReorientedLayout)layout
+{
+    if (elem == nil || layout >= REORIENT_LAYOUT_COUNT) {
+        return nil;
+    }
+
+    NSUInteger generation = [elem getGeneration];
+    __block NSData* planes = nil;
+    dispatch_sync(self->mQueue, ^{
+        [self validateFor:elem generation:generation atTimestep:tstep];
+        if (self->mPlanes[layout] != nil) {
+            planes  = [self->mPlanes[layout] retain];
+            *volume = self->mPlaneVolumes[layout];
+        }
+    });
+    if (planes != nil) {
+        return [planes autorelease];
+    }
+
+    BAReorientedVolumeSource* source = [[BAReorientedVolumeSource alloc] initWithElement:elem atTimestep:tstep];
+    id token = [self getVolume:volume from:source layout:layout];
+    [source release];
+
+    return token;
+}
+
+-(id)getVolume:(EDFloatVolume*)volume
+          from:(BAReorientedVolumeSource*)source
+        layout:(enum ReorientedLayout)layout
+{
+    if (source == nil || layout >= REORIENT_LAYOUT_COUNT) {
+        return nil;
+    }
+
+    __block NSData* planes = nil;
+    dispatch_sync(self->mQueue, ^{
+        [self validateFor:source->element generation:source->generation atTimestep:source->timestep];
+        if ([self buildVolumeFrom:source layout:layout]) {
+            planes  = [self->mPlanes[layout] retain];
+            *volume = self->mPlaneVolumes[layout];
+        }
+    });
+
+    return [planes autorelease];
+}
+
+-(void)prepareVolumeOf:(EDDataElement*)elem
+            atTimestep:(uint)tstep
+                layout:(enum ReorientedLayout)layout
+{
+    if (elem == nil || layout >= REORIENT_LAYOUT_COUNT) {
+        return;
+    }
+
+    // Views only (no voxel copied), the transposition runs in the background
+    BAReorientedVolumeSource* source = [[BAReorientedVolumeSource alloc] initWithElement:elem atTimestep:tstep];
+    if (source == nil) {
+        return;
+    }
+    dispatch_async(self->mQueue, ^{
+        NSAutoreleasePool* pool = [[NSAutoreleasePool alloc] init];
+        [self validateFor:source->element generation:source->generation atTimestep:source->timestep];
+        [self buildVolumeFrom:source layout:layout];
+        [source release];
+        [pool drain];
+    });
+}
+
+-(void)clear
+{
+    dispatch_sync(self->mQueue, ^{
+        for (int layout = 0; layout < REORIENT_LAYOUT_COUNT; layout++) {
+            [self->mPlanes[layout] release];
+            self->mPlanes[layout] = nil;
+        }
+        [self->mElement release];
+        self->mElement = nil;
+    });
+}
+
+-(void)validateFor:(EDDataElement*)elem
+        generation:(NSUInteger)generation
+        atTimestep:(uint)tstep
+{
+    if (elem == self->mElement
+        && generation == self->mGeneration
+        && tstep == self->mTimestep) {
+        return;
+    }
+
+    for (int layout = 0; layout < REORIENT_LAYOUT_COUNT; layout++) {
+        [self->mPlanes[layout] release];
+        self->mPlanes[layout] = nil;
+    }
+    [self->mElement release];
+    self->mElement    = [elem retain];
+    self->mGeneration = generation;
+    self->mTimestep   = tstep;
+}
+
+-(BOOL)buildVolumeFrom:(BAReorientedVolumeSource*)source
+                layout:(enum ReorientedLayout)layout
+{
+    if (self->mPlanes[layout] != nil) {
+        return YES;
+    }
+
+    size_t cols   = source->cols;
+    size_t rows   = source->rows;
+    size_t slices = source->slices;
+
+    // Offsets of a source column/row/slice step in the transposed copy
+    size_t planeCount, planeRows, planeCols;
+    size_t colStep, rowStep, sliceStep;
+    switch (layout) {
+        case REORIENT_TURN_UP:
+            planeCount = rows; planeRows = slices; planeCols = cols;
+            colStep = 1; sliceStep = cols; rowStep = slices * cols;
+            break;
+        case REORIENT_TURN_LEFT_ROTATE_RIGHT:
+            planeCount = cols; planeRows = slices; planeCols = rows;
+            rowStep = 1; sliceStep = rows; colStep = slices * rows;
+            break;
+        case REORIENT_TURN_LEFT:
+            planeCount = cols; planeRows = rows; planeCols = slices;
+            sliceStep = 1; rowStep = slices; colStep = rows * slices;
+            break;
+        default:
+            // REORIENT_TURN_UP_ROTATE_RIGHT
+            planeCount = rows; planeRows = cols; planeCols = slices;
+            sliceStep = 1; colStep = slices; rowStep = cols * slices;
+            break;
+    }
+
+    float* data = malloc(cols * rows * slices * sizeof(float));
+    if (data == NULL) {
+        NSLog(@"BAReorientedVolumeCache: could not allocate %ld bytes", cols * rows * slices * sizeof(float));
+        return NO;
+    }
+
+    // Source rows are read sequentially (converted to float if stored natively),
+    // the (strided) writes go to a single buffer
+    float* srcRow = malloc(cols * sizeof(float));
+    if (srcRow == NULL) {
+        free(data);
+        return NO;
+    }
+    for (size_t slice = 0; slice < slices; slice++) {
+        const EDTypedSliceView* view = &source->views[slice];
+        for (size_t row = 0; row < rows; row++) {
+            const void* viewRow = EDTypedVoxelAt(view->data, view->type, (ptrdiff_t) (row * view->rowStride));
+            const float* src = (const float*) viewRow;
+            if (view->type != ED_VOXEL_FLOAT) {
+                EDTypedToFloat(viewRow, view->type, 1, cols, srcRow);
+                src = srcRow;
+            }
+            float* dst = data + slice * sliceStep + row * rowStep;
+            for (size_t col = 0; col < cols; col++) {
+                dst[col * colStep] = src[col];
+            }
+        }
+    }
+    free(srcRow);
+
+    self->mPlanes[layout] = [[NSData alloc] initWithBytesNoCopy:data
+                                                         length:cols * rows * slices * sizeof(float)
+                                                   freeWhenDone:YES];
+    EDFloatVolumeInitSliceMajor(&self->mPlaneVolumes[layout], data, planeCols, planeRows, planeCount, 1);
+
+    return YES;
+}
+
+@end
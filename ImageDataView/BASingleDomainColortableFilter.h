@@ -18,6 +18,21 @@
      * in the colortable. */
     CIImage* mColortable;
     
+    /** RGBA float colors mColortable was created from (used for lookup tables). */
+    NSData*  mColortableData;
+    
 }
 
+/**
+ * Builds the lookup table for mColortableData and the "minimum"/"maximum"
+ * ("minimum2"/"maximum2") parameters using a mapping mode of the colortable kernels.
+ * Subclasses choose their mode in BAImageFilter#fillColortableLUT:.
+ *
+ * \param lut  Table to fill in.
+ * \param mode Mapping of the CIKernel the filter applies in BAImageFilter#apply:.
+ * \return     YES.
+ */
+-(BOOL)fillColortableLUT:(BAColortableLUT*)lut
+                    mode:(enum BAColortableMode)mode;
+
 @end
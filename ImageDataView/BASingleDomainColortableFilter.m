@@ -18,7 +18,8 @@ extern CIFormat kCIFormatRGBAf;
 -(id)init
 {
     if (self = [super init]) {
-        self->mColortable = nil;
+        self->mColortable     = nil;
+        self->mColortableData = nil;
         
         [self setValue:[NSNumber numberWithFloat:0.0f] forKey:@"minimum"];
         [self setValue:[NSNumber numberWithFloat:1.0f] forKey:@"maximum"];
@@ -45,8 +46,10 @@ extern CIFormat kCIFormatRGBAf;
             colorTableData[(_ctIndex + 256) * 4 + 3] = 1.0;
         }
         
+        self->mColortableData = [[NSData alloc] initWithBytes:colorTableData length:512 * sizeof(float) * NUMBER_OF_CHANNELS];
+        
         CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
-        self->mColortable = [[CIImage alloc] initWithBitmapData:[NSData dataWithBytes:colorTableData length:512 * sizeof(float) * NUMBER_OF_CHANNELS]
+        self->mColortable = [[CIImage alloc] initWithBitmapData:self->mColortableData
                                                     bytesPerRow:512 * sizeof(float) * NUMBER_OF_CHANNELS
                                                            size:ctSize 
                                                          format:kCIFormatRGBAf 
@@ -65,29 +68,50 @@ extern CIFormat kCIFormatRGBAf;
 {
     if (self->mColortable != nil) 
         [self->mColortable release];
+    [self->mColortableData release];
     
     [super dealloc];
 }
 
--(CIImage*)apply:(CIImage*)on
+-(CIFilter*)createFilter
 {
     [ColorMappingFilter class];
-        
-    self->mFilter = [CIFilter filterWithName: @"ColorMappingFilter"
-                               keysAndValues: @"inputImage", on,
-                                              @"colorTable", self->mColortable, nil];
+    
+    CIFilter* filter = [CIFilter filterWithName: @"ColorMappingFilter"
+                                  keysAndValues: @"colorTable", self->mColortable, nil];
     
     int colortableMappingType = 2;
-    [(ColorMappingFilter*) self->mFilter setKernelToUse: colortableMappingType];
+    [(ColorMappingFilter*) filter setKernelToUse: colortableMappingType];
+    
+    return filter;
+}
+
+-(NSArray*)filterParameterKeys
+{
+    return [NSArray arrayWithObjects:@"minimum", @"maximum", nil];
+}
+
+-(BOOL)fillColortableLUT:(BAColortableLUT*)lut
+{
+    // Same mapping as kernel 2 used by createFilter
+    return [self fillColortableLUT:lut mode:COLORTABLE_MODE_THRESHOLD];
+}
+
+-(BOOL)fillColortableLUT:(BAColortableLUT*)lut
+                    mode:(enum BAColortableMode)mode
+{
+    BAColortableParams params;
+    params.mode       = mode;
+    params.colors     = [self->mColortableData bytes];
+    params.colorCount = [self->mColortableData length] / (sizeof(float) * NUMBER_OF_CHANNELS);
+    params.min        = [[self valueForKey:@"minimum"]  floatValue];
+    params.max        = [[self valueForKey:@"maximum"]  floatValue];
+    params.min2       = [[self valueForKey:@"minimum2"] floatValue];
+    params.max2       = [[self valueForKey:@"maximum2"] floatValue];
     
-//    float    filterMinimum = 0.0;
-//    float    filterMaximum = 255.0;
-    [self->mFilter setValue: [self valueForKey:@"minimum"]
-                          forKey: @"minimum"];
-    [self->mFilter setValue: [self valueForKey:@"maximum"]
-                          forKey: @"maximum"];
+    BAColortableBuildLUT(lut, &params);
     
-    return [self->mFilter valueForKey:@"outputImage"];
+    return YES;
 }
 
 @end
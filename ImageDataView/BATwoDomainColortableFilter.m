@@ -28,29 +28,28 @@ extern CIFormat kCIFormatRGBAf;
     [super dealloc];
 }
 
--(CIImage*)apply:(CIImage*)on
+-(CIFilter*)createFilter
 {
     [ColorMappingFilter class];
     
-    self->mFilter = [CIFilter filterWithName: @"ColorMappingFilterTwoDomains"
-                               keysAndValues: @"inputImage", on,
-                                              @"colorTable", self->mColortable, nil];
+    CIFilter* filter = [CIFilter filterWithName: @"ColorMappingFilterTwoDomains"
+                                  keysAndValues: @"colorTable", self->mColortable, nil];
     
     int colortableMappingType = 3;
-    [(ColorMappingFilter*) self->mFilter setKernelToUse: colortableMappingType];
+    [(ColorMappingFilter*) filter setKernelToUse: colortableMappingType];
     
-    //    float    filterMinimum = 0.0;
-    //    float    filterMaximum = 255.0;
-    [self->mFilter setValue: [self valueForKey:@"minimum"]
-                     forKey: @"minimum"];
-    [self->mFilter setValue: [self valueForKey:@"maximum"]
-                     forKey: @"maximum"];
-    [self->mFilter setValue: [self valueForKey:@"minimum2"]
-                     forKey: @"minimum2"];
-    [self->mFilter setValue: [self valueForKey:@"maximum2"]
-                     forKey: @"maximum2"];
-    
-    return [self->mFilter valueForKey:@"outputImage"];
+    return filter;
+}
+
+-(NSArray*)filterParameterKeys
+{
+    return [NSArray arrayWithObjects:@"minimum", @"maximum", @"minimum2", @"maximum2", nil];
+}
+
+-(BOOL)fillColortableLUT:(BAColortableLUT*)lut
+{
+    // Same mapping as kernel 3 used by createFilter
+    return [self fillColortableLUT:lut mode:COLORTABLE_MODE_TWO_DOMAINS];
 }
 
 
@@ -0,0 +1,375 @@
+//
+//  BAConnectedComponents.c
+//  ImageDataView
+//
+
+#include "BAConnectedComponents.h"
+
+#include <dispatch/dispatch.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Neighbour position relative to a voxel. */
+typedef struct {
+    int       dc;
+    int       dr;
+    int       ds;
+    /** Distance of the neighbour in the label array. */
+    ptrdiff_t delta;
+} BAOffset;
+
+/** Largest number of neighbours (26-connectivity). */
+#define MAX_NEIGHBOURS 26
+
+/**
+ * Fills in the neighbours of the connectivity, only those visited before the voxel
+ * in memory order if backwardOnly is set.
+ *
+ * \return Number of offsets (6/18/26, or 3/9/13 backward).
+ */
+static size_t neighbourOffsets(enum BAConnectivity connectivity, int backwardOnly,
+                               size_t cols, size_t rows, BAOffset* offsets)
+{
+    int maxDistance = (connectivity == CONNECTIVITY_6) ? 1 : ((connectivity == CONNECTIVITY_18) ? 2 : 3);
+    size_t count = 0;
+    for (int ds = -1; ds <= 1; ds++) {
+        for (int dr = -1; dr <= 1; dr++) {
+            for (int dc = -1; dc <= 1; dc++) {
+                int distance = abs(dc) + abs(dr) + abs(ds);
+                int before   = ds < 0 || (ds == 0 && (dr < 0 || (dr == 0 && dc < 0)));
+                if (distance == 0 || distance > maxDistance || (backwardOnly && !before)) {
+                    continue;
+                }
+                offsets[count].dc    = dc;
+                offsets[count].dr    = dr;
+                offsets[count].ds    = ds;
+                offsets[count].delta = dc + (ptrdiff_t) cols * (dr + (ptrdiff_t) rows * ds);
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+/** Whether the neighbour at offset of voxel (c, r, s) lies within columns/rows and slices [firstSlice, slices). */
+static inline int neighbourInside(const BAOffset* offset, size_t c, size_t r, size_t s,
+                                  size_t cols, size_t rows, size_t firstSlice, size_t slices)
+{
+    return (offset->dc >= 0 || c > 0) && (offset->dc <= 0 || c + 1 < cols)
+        && (offset->dr >= 0 || r > 0) && (offset->dr <= 0 || r + 1 < rows)
+        && (offset->ds >= 0 || s > firstSlice) && (offset->ds <= 0 || s + 1 < slices);
+}
+
+
+// ##############
+// # Union-find #
+// ##############
+
+// labels[i] holds parent index + 1 while labeling (0: background). Parents always have
+// a lower index than their children, so roots are the first voxel of their tree in memory order.
+
+static inline uint32_t findRoot(uint32_t* labels, uint32_t i)
+{
+    while (labels[i] - 1 != i) {
+        // Path halving
+        labels[i] = labels[labels[i] - 1];
+        i = labels[i] - 1;
+    }
+    return i;
+}
+
+static inline void unite(uint32_t* labels, uint32_t a, uint32_t b)
+{
+    a = findRoot(labels, a);
+    b = findRoot(labels, b);
+    if (a < b) {
+        labels[b] = a + 1;
+    } else if (b < a) {
+        labels[a] = b + 1;
+    }
+}
+
+
+// ##############
+// # Statistics #
+// ##############
+
+static void addVoxel(BACluster* cluster, float value, size_t c, size_t r, size_t s)
+{
+    if (cluster->voxelCount == 0) {
+        cluster->peakValue  = value;
+        cluster->peakColumn = cluster->minColumn = cluster->maxColumn = c;
+        cluster->peakRow    = cluster->minRow    = cluster->maxRow    = r;
+        cluster->peakSlice  = cluster->minSlice  = cluster->maxSlice  = s;
+    } else {
+        if (fabsf(value) > fabsf(cluster->peakValue)) {
+            cluster->peakValue  = value;
+            cluster->peakColumn = c;
+            cluster->peakRow    = r;
+            cluster->peakSlice  = s;
+        }
+        if (c < cluster->minColumn) cluster->minColumn = c;
+        if (c > cluster->maxColumn) cluster->maxColumn = c;
+        if (r < cluster->minRow)    cluster->minRow    = r;
+        if (r > cluster->maxRow)    cluster->maxRow    = r;
+        // Slices are visited in ascending order
+        cluster->maxSlice = s;
+    }
+    cluster->voxelCount++;
+    cluster->sum += value;
+}
+
+/** Appends an empty cluster, growing the array on demand. Returns NULL if that failed. */
+static BACluster* appendCluster(BACluster** clusters, size_t* count, size_t* capacity)
+{
+    if (*count == *capacity) {
+        size_t newCapacity = (*capacity == 0) ? 64 : 2 * *capacity;
+        BACluster* grown = realloc(*clusters, newCapacity * sizeof(BACluster));
+        if (grown == NULL) {
+            return NULL;
+        }
+        *clusters = grown;
+        *capacity = newCapacity;
+    }
+    BACluster* cluster = &(*clusters)[*count];
+    memset(cluster, 0, sizeof(BACluster));
+    (*count)++;
+    cluster->label = (uint32_t) *count;
+    return cluster;
+}
+
+
+// ############
+// # Labeling #
+// ############
+
+/** Shared state of the slab jobs. */
+typedef struct {
+    const EDTypedVolume* volume;
+    float                min;
+    float                max;
+    uint32_t*            labels;
+    BAOffset             offsets[MAX_NEIGHBOURS];
+    size_t               offsetCount;
+    size_t               slicesPerBlock;
+} BALabelJob;
+
+/** Labels the slices of one slab, only touching labels of that slab. */
+static void labelSlab(void* context, size_t block)
+{
+    const BALabelJob* job = context;
+    const EDTypedVolume* volume = job->volume;
+    size_t cols   = volume->columns;
+    size_t rows   = volume->rows;
+    size_t first  = block * job->slicesPerBlock;
+    size_t last   = first + job->slicesPerBlock;
+    if (last > volume->slices) {
+        last = volume->slices;
+    }
+    uint32_t* labels = job->labels;
+
+    for (size_t s = first; s < last; s++) {
+        for (size_t r = 0; r < rows; r++) {
+            const void* line = EDTypedVoxelAt(volume->data, volume->type, EDTypedVolumeOffset(volume, 0, r, s, 0));
+            uint32_t i = (uint32_t) ((s * rows + r) * cols);
+            for (size_t c = 0; c < cols; c++, i++) {
+                float value = EDTypedLoad(line, volume->type, (ptrdiff_t) c * volume->colStride);
+                if (!(value >= job->min && value <= job->max)) {
+                    labels[i] = 0;
+                    continue;
+                }
+                labels[i] = i + 1;
+                for (size_t n = 0; n < job->offsetCount; n++) {
+                    const BAOffset* offset = &job->offsets[n];
+                    if (neighbourInside(offset, c, r, s, cols, rows, first, last)) {
+                        uint32_t j = (uint32_t) ((ptrdiff_t) i + offset->delta);
+                        if (labels[j] != 0) {
+                            unite(labels, i, j);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/** Merges the trees of slice s with the ones of slice s - 1. */
+static void mergeSlabBorder(const BALabelJob* job, size_t s)
+{
+    const EDTypedVolume* volume = job->volume;
+    size_t cols = volume->columns;
+    size_t rows = volume->rows;
+    uint32_t* labels = job->labels;
+
+    for (size_t r = 0; r < rows; r++) {
+        uint32_t i = (uint32_t) ((s * rows + r) * cols);
+        for (size_t c = 0; c < cols; c++, i++) {
+            if (labels[i] == 0) {
+                continue;
+            }
+            for (size_t n = 0; n < job->offsetCount; n++) {
+                const BAOffset* offset = &job->offsets[n];
+                if (offset->ds < 0 && neighbourInside(offset, c, r, s, cols, rows, 0, volume->slices)) {
+                    uint32_t j = (uint32_t) ((ptrdiff_t) i + offset->delta);
+                    if (labels[j] != 0) {
+                        unite(labels, i, j);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int BALabelComponents(const EDTypedVolume* volume, float min, float max,
+                      enum BAConnectivity connectivity, size_t blocks,
+                      uint32_t* labels, BACluster** clusters, size_t* clusterCount)
+{
+    size_t cols   = volume->columns;
+    size_t rows   = volume->rows;
+    size_t slices = volume->slices;
+    size_t voxels = cols * rows * slices;
+    *clusters     = NULL;
+    *clusterCount = 0;
+    if (voxels >= UINT32_MAX) {
+        return 0;
+    }
+    if (voxels == 0) {
+        return 1;
+    }
+
+    if (blocks == 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        blocks = (processors > 0) ? (size_t) processors : 1;
+    }
+    if (blocks > slices) {
+        blocks = slices;
+    }
+
+    BALabelJob job;
+    job.volume         = volume;
+    job.min            = min;
+    job.max            = max;
+    job.labels         = labels;
+    job.offsetCount    = neighbourOffsets(connectivity, 1, cols, rows, job.offsets);
+    job.slicesPerBlock = (slices + blocks - 1) / blocks;
+    blocks             = (slices + job.slicesPerBlock - 1) / job.slicesPerBlock;
+
+    dispatch_apply_f(blocks, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), &job, labelSlab);
+
+    for (size_t block = 1; block < blocks; block++) {
+        mergeSlabBorder(&job, block * job.slicesPerBlock);
+    }
+
+    // Roots come first in memory order: a single pass turns parent links into labels
+    size_t capacity = 0;
+    uint32_t i = 0;
+    for (size_t s = 0; s < slices; s++) {
+        for (size_t r = 0; r < rows; r++) {
+            const void* line = EDTypedVoxelAt(volume->data, volume->type, EDTypedVolumeOffset(volume, 0, r, s, 0));
+            for (size_t c = 0; c < cols; c++, i++) {
+                if (labels[i] == 0) {
+                    continue;
+                }
+                uint32_t parent = labels[i] - 1;
+                if (parent == i) {
+                    BACluster* cluster = appendCluster(clusters, clusterCount, &capacity);
+                    if (cluster == NULL) {
+                        free(*clusters);
+                        *clusters     = NULL;
+                        *clusterCount = 0;
+                        return 0;
+                    }
+                    labels[i] = cluster->label;
+                } else {
+                    labels[i] = labels[parent];
+                }
+                addVoxel(&(*clusters)[labels[i] - 1], EDTypedLoad(line, volume->type, (ptrdiff_t) c * volume->colStride), c, r, s);
+            }
+        }
+    }
+
+    return 1;
+}
+
+int BALabelComponentsScalar(const EDFloatVolume* volume, float min, float max,
+                            enum BAConnectivity connectivity,
+                            uint32_t* labels, BACluster** clusters, size_t* clusterCount)
+{
+    size_t cols   = volume->columns;
+    size_t rows   = volume->rows;
+    size_t slices = volume->slices;
+    size_t voxels = cols * rows * slices;
+    *clusters     = NULL;
+    *clusterCount = 0;
+    if (voxels >= UINT32_MAX) {
+        return 0;
+    }
+
+    BAOffset offsets[MAX_NEIGHBOURS];
+    size_t offsetCount = neighbourOffsets(connectivity, 0, cols, rows, offsets);
+
+    uint32_t* queue = malloc((voxels > 0 ? voxels : 1) * sizeof(uint32_t));
+    if (queue == NULL) {
+        return 0;
+    }
+    memset(labels, 0, voxels * sizeof(uint32_t));
+
+    uint32_t next = 0;
+    for (uint32_t seed = 0; seed < voxels; seed++) {
+        size_t c = seed % cols;
+        size_t r = (seed / cols) % rows;
+        size_t s = seed / (cols * rows);
+        float value = EDFloatVolumeGet(volume, c, r, s, 0);
+        if (labels[seed] != 0 || !(value >= min && value <= max)) {
+            continue;
+        }
+
+        next++;
+        labels[seed] = next;
+        size_t head = 0;
+        size_t tail = 0;
+        queue[tail++] = seed;
+        while (head < tail) {
+            uint32_t i = queue[head++];
+            c = i % cols;
+            r = (i / cols) % rows;
+            s = i / (cols * rows);
+            for (size_t n = 0; n < offsetCount; n++) {
+                if (!neighbourInside(&offsets[n], c, r, s, cols, rows, 0, slices)) {
+                    continue;
+                }
+                uint32_t j = (uint32_t) ((ptrdiff_t) i + offsets[n].delta);
+                float neighbour = EDFloatVolumeGet(volume, c + offsets[n].dc, r + offsets[n].dr, s + offsets[n].ds, 0);
+                if (labels[j] == 0 && neighbour >= min && neighbour <= max) {
+                    labels[j] = next;
+                    queue[tail++] = j;
+                }
+            }
+        }
+    }
+    free(queue);
+
+    size_t capacity = 0;
+    for (uint32_t n = 0; n < next; n++) {
+        if (appendCluster(clusters, clusterCount, &capacity) == NULL) {
+            free(*clusters);
+            *clusters     = NULL;
+            *clusterCount = 0;
+            return 0;
+        }
+    }
+    uint32_t i = 0;
+    for (size_t s = 0; s < slices; s++) {
+        for (size_t r = 0; r < rows; r++) {
+            for (size_t c = 0; c < cols; c++, i++) {
+                if (labels[i] != 0) {
+                    addVoxel(&(*clusters)[labels[i] - 1], EDFloatVolumeGet(volume, c, r, s, 0), c, r, s);
+                }
+            }
+        }
+    }
+
+    return 1;
+}
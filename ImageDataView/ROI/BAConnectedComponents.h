@@ -0,0 +1,79 @@
+//
+//  BAConnectedComponents.h
+//  ImageDataView
+//
+
+#ifndef ImageDataView_BAConnectedComponents_h
+#define ImageDataView_BAConnectedComponents_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "EDFloatVolume.h"
+#include "EDTypedVolume.h"
+
+/** Neighbourhoods of a voxel for connected component labeling. */
+enum BAConnectivity {
+    /** Voxels sharing a face. */
+    CONNECTIVITY_6  = 6,
+    /** Voxels sharing a face or an edge. */
+    CONNECTIVITY_18 = 18,
+    /** Voxels sharing a face, an edge or a corner. */
+    CONNECTIVITY_26 = 26
+};
+
+/** Summary of one connected component (cluster). */
+typedef struct {
+    /** Value of the cluster voxels in the label volume (1, 2, ...). */
+    uint32_t label;
+    /** Number of voxels. */
+    size_t   voxelCount;
+    /** Sum of the voxel values (mean = sum / voxelCount). */
+    double   sum;
+    /** Value with the largest magnitude and its voxel (first one in memory order on ties). */
+    float    peakValue;
+    size_t   peakColumn;
+    size_t   peakRow;
+    size_t   peakSlice;
+    /** Bounding box (inclusive). */
+    size_t   minColumn;
+    size_t   minRow;
+    size_t   minSlice;
+    size_t   maxColumn;
+    size_t   maxRow;
+    size_t   maxSlice;
+} BACluster;
+
+/**
+ * Labels the connected components (clusters) of all voxels of volume (first timestep)
+ * with values within [min, max].
+ *
+ * Runs block-parallel: slabs of slices are labeled concurrently with a union-find forest
+ * stored in labels itself, the slab borders are merged afterwards. Labels are numbered
+ * in memory order of the first voxel of each cluster (column fastest, then row, slice)
+ * and do not depend on the number of blocks.
+ *
+ * \param volume       Volume to label, of any voxel type (native stores are read as they are).
+ * \param min          Lowest value belonging to a cluster.
+ * \param max          Highest value belonging to a cluster.
+ * \param connectivity Neighbourhood connecting two voxels.
+ * \param blocks       Number of slabs to label concurrently (0: one per slice group
+ *                     of the available processors).
+ * \param labels       Output, columns * rows * slices labels (column fastest, then row,
+ *                     slice), 0 for voxels outside of [min, max].
+ * \param clusters     Output, malloc'ed array of the cluster summaries in label order
+ *                     (clusters[i].label == i + 1) - free() it. NULL if there are none.
+ * \param clusterCount Output, number of clusters.
+ * \return             0 if the volume has 2^32 voxels or more or memory could not be
+ *                     allocated, 1 otherwise.
+ */
+int BALabelComponents(const EDTypedVolume* volume, float min, float max,
+                      enum BAConnectivity connectivity, size_t blocks,
+                      uint32_t* labels, BACluster** clusters, size_t* clusterCount);
+
+/** Plain reference implementation of BALabelComponents (sequential breadth-first search). */
+int BALabelComponentsScalar(const EDFloatVolume* volume, float min, float max,
+                            enum BAConnectivity connectivity,
+                            uint32_t* labels, BACluster** clusters, size_t* clusterCount);
+
+#endif
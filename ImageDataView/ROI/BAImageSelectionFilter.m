@@ -41,9 +41,12 @@ extern CIFormat kCIFormatRGBAf;
         colorTableData[i++] = 0.0;
         colorTableData[i++] = 0.0;
         
+        [self->mColortableData release];
+        self->mColortableData = [[NSData alloc] initWithBytes:colorTableData length:2 * sizeof(float) * NUMBER_OF_CHANNELS];
+        
         CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
         [self->mColortable release];
-        self->mColortable = [[CIImage alloc] initWithBitmapData:[NSData dataWithBytes:colorTableData length:2 * sizeof(float) * NUMBER_OF_CHANNELS]
+        self->mColortable = [[CIImage alloc] initWithBitmapData:self->mColortableData
                                                     bytesPerRow:2 * sizeof(float) * NUMBER_OF_CHANNELS
                                                            size:ctSize
                                                          format:kCIFormatRGBAf
@@ -61,23 +64,23 @@ extern CIFormat kCIFormatRGBAf;
     [super dealloc];
 }
 
--(CIImage*)apply:(CIImage*)on
+-(CIFilter*)createFilter
 {
     [ColorMappingFilter class];
     
-    self->mFilter = [CIFilter filterWithName: @"ColorMappingFilter"
-                               keysAndValues: @"inputImage", on,
-                     @"colorTable", self->mColortable, nil];
+    CIFilter* filter = [CIFilter filterWithName: @"ColorMappingFilter"
+                                  keysAndValues: @"colorTable", self->mColortable, nil];
     
     int colortableMappingType = 4;
-    [(ColorMappingFilter*) self->mFilter setKernelToUse: colortableMappingType];
-    
-    [self->mFilter setValue: [self valueForKey:@"minimum"]
-                     forKey: @"minimum"];
-    [self->mFilter setValue: [self valueForKey:@"maximum"]
-                     forKey: @"maximum"];
+    [(ColorMappingFilter*) filter setKernelToUse: colortableMappingType];
     
-    return [self->mFilter valueForKey:@"outputImage"];
+    return filter;
+}
+
+-(BOOL)fillColortableLUT:(BAColortableLUT*)lut
+{
+    // Same mapping as kernel 4 used by createFilter
+    return [self fillColortableLUT:lut mode:COLORTABLE_MODE_SELECTION];
 }
 
 @end
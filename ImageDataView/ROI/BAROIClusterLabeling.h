@@ -0,0 +1,70 @@
+//
+//  BAROIClusterLabeling.h
+//  ImageDataView
+//
+
+#import <Foundation/Foundation.h>
+
+#import "BAROISelection.h"
+#import "BAConnectedComponents.h"
+
+/**
+ * Finds all clusters (connected components) of voxels within a value range
+ * of an EDDataElement at once, e.g. every supra-threshold cluster of a
+ * statistical map (\see{BALabelComponents}).
+ * The clusters are available as a label volume and as BAROIClusterSelection
+ * objects that can be added to a ROI.
+ */
+@interface BAROIClusterLabeling : NSObject {
+
+    /** Data the clusters were found in. */
+    EDDataElement* mReference;
+    uint           mTimestep;
+
+    /** Label volume (uint32_t per voxel, column fastest). */
+    NSData*        mLabels;
+    size_t         mColumns;
+    size_t         mRows;
+    size_t         mSlices;
+
+    /** Cluster summaries in label order. */
+    BACluster*     mClusters;
+    size_t         mClusterCount;
+
+}
+
+/** Initializer. Labels the clusters right away.
+ *
+ * \param data         EDDataElement to find the clusters in.
+ * \param tstep        Timestep of data to use.
+ * \param min          Lowest voxel value belonging to a cluster.
+ * \param max          Highest voxel value belonging to a cluster.
+ * \param connectivity Neighbourhood connecting two voxels of a cluster.
+ * \return             Nil if data is nil, tstep is out of range or the labeling failed.
+ */
+-(id)initWithReference:(EDDataElement*)data
+            atTimestep:(uint)tstep
+               inRange:(float)min
+                   and:(float)max
+          connectivity:(enum BAConnectivity)connectivity;
+
+/** Number of clusters found. */
+-(size_t)clusterCount;
+
+/**
+ * Creates one selection per cluster.
+ *
+ * \param m ROISelectionMode of the selections.
+ * \return  Array of BAROIClusterSelection objects, largest cluster first.
+ */
+-(NSArray*)clusterSelectionsWithMode:(enum ROISelectionMode)m;
+
+/**
+ * Converts the label volume to an EDDataElement (one timestep, voxel value
+ * = cluster label, 0 outside of all clusters).
+ *
+ * \return Autoreleased EDDataElement in the space of the reference data.
+ */
+-(EDDataElement*)labelVolume;
+
+@end
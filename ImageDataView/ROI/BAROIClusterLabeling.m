@@ -0,0 +1,184 @@
+//
+//  BAROIClusterLabeling.m
+//  ImageDataView
+//
+
+#import "BAROIClusterLabeling.h"
+#import "BAROIClusterSelection.h"
+#import "EDDataElement.h"
+
+@interface BAROIClusterLabeling (__privateMethods__)
+
+/**
+ * Gets the volume of the reference data at mTimestep, float or native type. Data without
+ * a volume store is copied slice by slice into a temporary float buffer.
+ *
+ * \param volume Volume description to fill in.
+ * \return       Object keeping the volume data alive (autoreleased), nil on failure.
+ */
+-(id)referenceVolume:(EDTypedVolume*)volume;
+
+@end
+
+
+@implementation BAROIClusterLabeling
+
+-(id)initWithReference:(EDDataElement*)data
+            atTimestep:(uint)tstep
+               inRange:(float)min
+                   and:(float)max
+          connectivity:(enum BAConnectivity)connectivity
+{
+    if (self = [super init]) {
+        self->mReference    = [data retain];
+        self->mTimestep     = tstep;
+        self->mLabels       = nil;
+        self->mClusters     = NULL;
+        self->mClusterCount = 0;
+
+        EDTypedVolume volume;
+        if (data == nil || [self referenceVolume:&volume] == nil) {
+            [self release];
+            return nil;
+        }
+        self->mColumns = volume.columns;
+        self->mRows    = volume.rows;
+        self->mSlices  = volume.slices;
+
+        size_t voxels = volume.columns * volume.rows * volume.slices;
+        uint32_t* labels = malloc((voxels > 0 ? voxels : 1) * sizeof(uint32_t));
+        if (labels == NULL
+            || !BALabelComponents(&volume, min, max, connectivity, 0,
+                                  labels, &self->mClusters, &self->mClusterCount)) {
+            NSLog(@"BAROIClusterLabeling: could not label %ld voxels", voxels);
+            free(labels);
+            [self release];
+            return nil;
+        }
+
+        self->mLabels = [[NSData alloc] initWithBytesNoCopy:labels
+                                                     length:voxels * sizeof(uint32_t)
+                                               freeWhenDone:YES];
+    }
+
+    return self;
+}
+
+-(void)dealloc
+{
+    [self->mReference release];
+    [self->mLabels release];
+    free(self->mClusters);
+
+    [super dealloc];
+}
+
+-(id)referenceVolume:(EDTypedVolume*)volume
+{
+    id token;
+    if ([self->mReference getTypedVolume:volume atTimestep:self->mTimestep token:&token]) {
+        return (token != nil) ? token : self->mReference;
+    }
+
+    BARTImageSize* size = [self->mReference getImageSize];
+    if (self->mTimestep >= size.timesteps) {
+        return nil;
+    }
+
+    size_t cols   = size.columns;
+    size_t rows   = size.rows;
+    size_t slices = size.slices;
+    float* data = malloc((cols * rows * slices > 0 ? cols * rows * slices : 1) * sizeof(float));
+    if (data == NULL) {
+        return nil;
+    }
+    for (size_t slice = 0; slice < slices; slice++) {
+        EDSliceView view = [self->mReference getSliceView:(uint) slice atTimestep:self->mTimestep];
+        if (view.data == NULL) {
+            free(data);
+            return nil;
+        }
+        for (size_t row = 0; row < rows; row++) {
+            memcpy(data + (slice * rows + row) * cols, view.data + row * view.rowStride, cols * sizeof(float));
+        }
+    }
+
+    EDTypedVolumeInitSliceMajor(volume, data, ED_VOXEL_FLOAT, cols, rows, slices, 1);
+    return [[[NSData alloc] initWithBytesNoCopy:data
+                                         length:cols * rows * slices * sizeof(float)
+                                   freeWhenDone:YES] autorelease];
+}
+
+-(size_t)clusterCount
+{
+    return self->mClusterCount;
+}
+
+-(NSArray*)clusterSelectionsWithMode:(enum ROISelectionMode)m
+{
+    NSMutableArray* selections = [NSMutableArray arrayWithCapacity:self->mClusterCount];
+    for (size_t i = 0; i < self->mClusterCount; i++) {
+        BAROIClusterSelection* selection = [[BAROIClusterSelection alloc] initWithLabels:self->mLabels
+                                                                                 columns:self->mColumns
+                                                                                    rows:self->mRows
+                                                                                  slices:self->mSlices
+                                                                                 cluster:&self->mClusters[i]
+                                                                                timestep:self->mTimestep
+                                                                                    mode:m];
+        [selections addObject:selection];
+        [selection release];
+    }
+
+    [selections sortUsingComparator:^NSComparisonResult(BAROIClusterSelection* a, BAROIClusterSelection* b) {
+        size_t countA = [a voxelCount];
+        size_t countB = [b voxelCount];
+        if (countA != countB) {
+            return (countA > countB) ? NSOrderedAscending : NSOrderedDescending;
+        }
+        return ([a label] < [b label]) ? NSOrderedAscending : NSOrderedDescending;
+    }];
+
+    return selections;
+}
+
+-(EDDataElement*)labelVolume
+{
+    BARTImageSize* size = [[BARTImageSize alloc] initWithRows:self->mRows
+                                                      andCols:self->mColumns
+                                                    andSlices:self->mSlices
+                                                 andTimesteps:1];
+    EDDataElement* labelVolume = [[[EDDataElement alloc] initEmptyWithSize:size
+                                                               ofImageType:self->mReference.mImageType
+                                                       withOrientationFrom:self->mReference] autorelease];
+    [size release];
+
+    const uint32_t* labels = [self->mLabels bytes];
+    EDFloatVolume volume;
+    BOOL direct = [labelVolume getFloatVolume:&volume atTimestep:0];
+    for (size_t s = 0; s < self->mSlices; s++) {
+        for (size_t r = 0; r < self->mRows; r++) {
+            const uint32_t* line = labels + (s * self->mRows + r) * self->mColumns;
+            for (size_t c = 0; c < self->mColumns; c++) {
+                if (line[c] == 0) {
+                    continue;
+                }
+                if (direct) {
+                    EDFloatVolumeSet(&volume, c, r, s, 0, (float) line[c]);
+                } else {
+                    [labelVolume setVoxelValue:[NSNumber numberWithFloat:(float) line[c]]
+                                         atRow:r
+                                           col:c
+                                         slice:s
+                                      timestep:0];
+                }
+            }
+        }
+    }
+    if (direct) {
+        [labelVolume invalidateStatisticsOfTimestep:0];
+    }
+
+    return labelVolume;
+}
+
+@end
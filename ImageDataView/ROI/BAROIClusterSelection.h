@@ -0,0 +1,67 @@
+//
+//  BAROIClusterSelection.h
+//  ImageDataView
+//
+
+#import <Foundation/Foundation.h>
+
+#import "BAROISelection.h"
+#import "BAConnectedComponents.h"
+
+@class BADataVoxel;
+
+/**
+ * ROI selection of one cluster (connected component) found by
+ * BAROIClusterLabeling. Selects all voxels carrying the cluster's label.
+ */
+@interface BAROIClusterSelection : BAROISelection {
+
+    /** Label volume (uint32_t per voxel) shared by all clusters of a labeling. */
+    NSData*   mLabels;
+    size_t    mColumns;
+    size_t    mRows;
+    size_t    mSlices;
+
+    /** Summary of the selected cluster. */
+    BACluster mCluster;
+
+    /** Voxel of the peak value. */
+    BADataVoxel* mPeak;
+
+}
+
+/** Initializer.
+ *
+ * \param labels   Label volume (columns * rows * slices uint32_t values, column fastest).
+ * \param columns  Number of columns of the label volume.
+ * \param rows     Number of rows of the label volume.
+ * \param slices   Number of slices of the label volume.
+ * \param cluster  Summary of the cluster to select (label, bounding box, ...).
+ * \param timestep Timestep the labels were computed for (timestep of the peak voxel).
+ * \param m        ROISelectionMode indicating whether the selection should be
+ *                 added or subtracted.
+ */
+-(id)initWithLabels:(NSData*)labels
+            columns:(size_t)columns
+               rows:(size_t)rows
+             slices:(size_t)slices
+            cluster:(const BACluster*)cluster
+           timestep:(NSUInteger)timestep
+               mode:(enum ROISelectionMode)m;
+
+/** Label of the cluster in the label volume. */
+-(uint32_t)label;
+
+/** Number of voxels of the cluster. */
+-(size_t)voxelCount;
+
+/** Mean of the voxel values. */
+-(float)meanValue;
+
+/** Voxel value with the largest magnitude. */
+-(float)peakValue;
+
+/** Voxel of the peak value. */
+-(BADataVoxel*)peak;
+
+@end
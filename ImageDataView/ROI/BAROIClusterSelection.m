@@ -0,0 +1,139 @@
+//
+//  BAROIClusterSelection.m
+//  ImageDataView
+//
+
+#import "BAROIClusterSelection.h"
+#import "BADataVoxel.h"
+#import "EDDataElement.h"
+#import "BAROIMask.h"
+
+@implementation BAROIClusterSelection
+
+-(id)initWithLabels:(NSData*)labels
+            columns:(size_t)columns
+               rows:(size_t)rows
+             slices:(size_t)slices
+            cluster:(const BACluster*)cluster
+           timestep:(NSUInteger)timestep
+               mode:(enum ROISelectionMode)m
+{
+    if (self = [super initWithMode:m]) {
+        self->mLabels  = [labels retain];
+        self->mColumns = columns;
+        self->mRows    = rows;
+        self->mSlices  = slices;
+        self->mCluster = *cluster;
+        self->mPeak    = [[BADataVoxel alloc] initWithColumn:cluster->peakColumn
+                                                         row:cluster->peakRow
+                                                       slice:cluster->peakSlice
+                                                    timestep:timestep];
+    }
+
+    return self;
+}
+
+-(void)dealloc
+{
+    [self->mLabels release];
+    [self->mPeak release];
+
+    [super dealloc];
+}
+
+-(uint32_t)label
+{
+    return self->mCluster.label;
+}
+
+-(size_t)voxelCount
+{
+    return self->mCluster.voxelCount;
+}
+
+-(float)meanValue
+{
+    if (self->mCluster.voxelCount == 0) {
+        return 0.0f;
+    }
+    return (float) (self->mCluster.sum / self->mCluster.voxelCount);
+}
+
+-(float)peakValue
+{
+    return self->mCluster.peakValue;
+}
+
+-(BADataVoxel*)peak
+{
+    return self->mPeak;
+}
+
+-(BAROIMask*)regionLike:(BAROIMask*)space
+{
+    if (self->mColumns != [space columns] || self->mRows != [space rows] || self->mSlices != [space slices]) {
+        return nil;
+    }
+    
+    // Only the bounding box can contain voxels of the cluster
+    size_t box[6] = {
+        self->mCluster.minColumn, self->mCluster.maxColumn,
+        self->mCluster.minRow,    self->mCluster.maxRow,
+        self->mCluster.minSlice,  self->mCluster.maxSlice
+    };
+    return [[[BAROIMask alloc] initWithLabels:[self->mLabels bytes]
+                                        label:self->mCluster.label
+                                      columns:self->mColumns
+                                         rows:self->mRows
+                                       slices:self->mSlices
+                                       within:box] autorelease];
+}
+
+-(EDDataElement*)addToBinaryMask:(EDDataElement*)mask
+{
+    float value = (self->mMode == ADD) ? 1.0f : 0.0f;
+    if (mask != nil) {
+        const uint32_t* labels = [self->mLabels bytes];
+        uint32_t label = self->mCluster.label;
+
+        EDTypedVolume volume;
+        BOOL direct = [mask getTypedVolume:&volume atTimestep:0];
+        BARTImageSize* maskSize = [mask getImageSize];
+
+        // Only the bounding box can contain voxels of the cluster
+        for (size_t s = self->mCluster.minSlice; s <= self->mCluster.maxSlice && s < maskSize.slices; s++) {
+            for (size_t r = self->mCluster.minRow; r <= self->mCluster.maxRow && r < maskSize.rows; r++) {
+                const uint32_t* line = labels + (s * self->mRows + r) * self->mColumns;
+                for (size_t c = self->mCluster.minColumn; c <= self->mCluster.maxColumn && c < maskSize.columns; c++) {
+                    if (line[c] != label) {
+                        continue;
+                    }
+                    if (direct) {
+                        EDTypedVolumeSet(&volume, c, r, s, 0, value);
+                    } else {
+                        [mask setVoxelValue:[NSNumber numberWithFloat:value]
+                                      atRow:r
+                                        col:c
+                                      slice:s
+                                   timestep:0];
+                    }
+                }
+            }
+        }
+
+        if (direct) {
+            // Mask data was written directly
+            [mask invalidateStatisticsOfTimestep:0];
+        }
+    }
+
+    [super addToBinaryMask:mask];
+    return mask;
+}
+
+-(NSString*)description {
+    return [NSString stringWithFormat:@"BAROIClusterSelection(label=%u, voxels=%ld, peak=%@, peakValue=%f)",
+            self->mCluster.label, self->mCluster.voxelCount, self->mPeak, self->mCluster.peakValue];
+}
+
+@end
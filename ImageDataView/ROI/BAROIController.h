@@ -10,6 +10,7 @@
 
 #import "BADataClickHandling.h"
 #import "BAROISelection.h"
+#import "BAConnectedComponents.h"
 
 @class BADataElementRenderer;
 
@@ -25,8 +26,13 @@
     
     /** Key: ROI name, value: BAROISelection */
     NSMutableDictionary* mROISelections;
-    /** Key: ROI name, value: rendered mask (EDDataElement) */
+    /** Key: ROI name, value: composed selection (BAROIMask) */
     NSMutableDictionary* mROIMasks;
+    /** Key: ROI name, value: EDDataElement defining the image space of the ROI's mask */
+    NSMutableDictionary* mROISpaces;
+    
+    /** Float mask (EDDataElement) the selected ROI is drawn on for the renderer. */
+    EDDataElement* mDisplayMask;
     
     enum ROISelectionMode mMode;
     float mThreshold;
@@ -84,4 +90,22 @@
  */
 -(EDDataElement*)roiAsBinaryMask:(NSString*)roiLabel;
 
+/** Finds all clusters of voxels within a value range (\see{BAROIClusterLabeling})
+ *  and adds each of them as a selection to the currently selected ROI
+ *  (using the current add/remove mode).
+ *
+ * \param data         EDDataElement to find the clusters in.
+ * \param tstep        Timestep of data to use.
+ * \param min          Float minimum voxel value of data that should be selected.
+ * \param max          Float maximum voxel value of data that should be selected.
+ * \param connectivity Neighbourhood connecting two voxels of a cluster.
+ * \return             Array of the added BAROIClusterSelection objects (largest cluster first).
+ *                     Nil if there is no ROI or the labeling failed.
+ */
+-(NSArray*)addClustersOf:(EDDataElement*)data
+              atTimestep:(uint)tstep
+                 inRange:(float)min
+                     and:(float)max
+            connectivity:(enum BAConnectivity)connectivity;
+
 @end
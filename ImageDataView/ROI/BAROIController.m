@@ -10,6 +10,8 @@
 #import "EDDataElement.h"
 #import "BADataVoxel.h"
 #import "BAROIPointRangeSelection.h"
+#import "BAROIClusterLabeling.h"
+#import "BAROIMask.h"
 #import "BADataElementRenderer.h"
 
 
@@ -57,6 +59,23 @@ static NSString* DEFAULT_ROI_TEXT = @"No ROI available";
                             inRange:(float)min
                                 and:(float)max;
 
+/** Returns the mask of a ROI, replacing it by an empty one if it does not
+ *  match the image space of data.
+ *
+ * \param roiLabel NSString name of the ROI.
+ * \param data     EDDataElement defining the image space.
+ * \return         BAROIMask of the ROI.
+ */
+-(BAROIMask*)maskOf:(NSString*)roiLabel
+      compatibleWith:(EDDataElement*)data;
+
+/** Draws the mask of a ROI on the display mask and passes it to the renderer.
+ *  The display mask is only recreated if the image space changed.
+ *
+ * \param roiLabel NSString name of the ROI to show.
+ */
+-(void)showMask:(NSString*)roiLabel;
+
 @end
 
 
@@ -76,6 +95,8 @@ static NSString* DEFAULT_ROI_TEXT = @"No ROI available";
         self->mROISelectionRenderer = nil;
         self->mROISelections = [[NSMutableDictionary alloc] init];
         self->mROIMasks      = [[NSMutableDictionary alloc] init];
+        self->mROISpaces     = [[NSMutableDictionary alloc] init];
+        self->mDisplayMask   = nil;
         self->mMode = ADD;
         self->mThreshold = 0.0f;
     }
@@ -104,6 +125,8 @@ static NSString* DEFAULT_ROI_TEXT = @"No ROI available";
     [self->mROISelectionRenderer release];
     [self->mROISelections release];
     [self->mROIMasks release];
+    [self->mROISpaces release];
+    [self->mDisplayMask release];
     
     [super dealloc];
 }
@@ -141,8 +164,7 @@ static NSString* DEFAULT_ROI_TEXT = @"No ROI available";
 -(IBAction)setROI:(id)sender
 {
     NSString* currentROI = [[self->mROISelect selectedItem] title];
-    [self->mROISelectionRenderer setData:[self->mROIMasks valueForKey:currentROI]];
-    [self->mROISelectionRenderer renderImage:NO];
+    [self showMask:currentROI];
 }
 
 -(void)updateViewStates
@@ -173,6 +195,7 @@ static NSString* DEFAULT_ROI_TEXT = @"No ROI available";
         BAROISelection* roiSelection = [[BAROISelection alloc] init];
         [self->mROISelections setValue:roiSelection forKey:label];
         [self->mROIMasks      setValue:nil          forKey:label];
+        [self->mROISpaces     setValue:nil          forKey:label];
         [self->mROISelect addItemWithTitle:label];
         [roiSelection release];
         
@@ -184,6 +207,7 @@ static NSString* DEFAULT_ROI_TEXT = @"No ROI available";
 {
     [self->mROISelections removeObjectForKey:label];
     [self->mROIMasks      removeObjectForKey:label];
+    [self->mROISpaces     removeObjectForKey:label];
     
     if ([self->mROISelections count] == 0) {
         [self->mROISelect removeAllItems];
@@ -197,8 +221,11 @@ static NSString* DEFAULT_ROI_TEXT = @"No ROI available";
 
 -(EDDataElement*)roiAsBinaryMask:(NSString*)roiLabel
 {
-    EDDataElement* maskCache = [self->mROIMasks valueForKey:roiLabel];
-    return [[self->mROISelections valueForKey:roiLabel] addToBinaryMask:maskCache];
+    BAROIMask* mask = [self->mROIMasks valueForKey:roiLabel];
+    if (mask == nil) {
+        return nil;
+    }
+    return [mask asDataElementLike:[self->mROISpaces valueForKey:roiLabel]];
 }
 
 -(BOOL)isCompatible:(EDDataElement*)data
@@ -241,6 +268,96 @@ static NSString* DEFAULT_ROI_TEXT = @"No ROI available";
     return selection;
 }
 
+-(BAROIMask*)maskOf:(NSString*)roiLabel
+      compatibleWith:(EDDataElement*)data
+{
+    BAROIMask* currentMask = [self->mROIMasks valueForKey:roiLabel];
+    if (currentMask == nil || ![self isCompatible:[self->mROISpaces valueForKey:roiLabel] with:data]) {
+        if (![self isCompatible:self->mDisplayMask with:data]) {
+            BARTImageSize* maskSize = [[data getImageSize] copy];
+            maskSize.timesteps = 1;
+            EDDataElement* newMask = [[EDDataElement alloc] initEmptyWithSize:maskSize
+                                                                  ofImageType:data.mImageType
+                                                          withOrientationFrom:data];
+            [maskSize release];
+            
+            [self->mDisplayMask release];
+            self->mDisplayMask = newMask;
+            
+            // (min, max) of the mask is refetched by the renderer as soon as the selection changes the mask
+            [self->mROISelectionRenderer setData:newMask];
+        }
+        
+        BARTImageSize* size = [data getImageSize];
+        currentMask = [[BAROIMask alloc] initEmptyWithColumns:size.columns
+                                                         rows:size.rows
+                                                       slices:size.slices];
+        [self->mROIMasks  setValue:currentMask        forKey:roiLabel];
+        [self->mROISpaces setValue:self->mDisplayMask forKey:roiLabel];
+        [currentMask release];
+    }
+    
+    return currentMask;
+}
+
+-(void)showMask:(NSString*)roiLabel
+{
+    BAROIMask* mask = [self->mROIMasks valueForKey:roiLabel];
+    if (mask == nil) {
+        [self->mROISelectionRenderer setData:nil];
+        [self->mROISelectionRenderer renderImage:NO];
+        return;
+    }
+    
+    EDDataElement* space = [self->mROISpaces valueForKey:roiLabel];
+    if (![self isCompatible:self->mDisplayMask with:space]) {
+        [self->mDisplayMask release];
+        self->mDisplayMask = [[mask asDataElementLike:space] retain];
+    } else {
+        [mask drawOn:self->mDisplayMask];
+    }
+    [self->mROISelectionRenderer setData:self->mDisplayMask];
+    
+    // Force rerender since the mask has changed
+    [self->mROISelectionRenderer renderImage:YES];
+}
+
+-(NSArray*)addClustersOf:(EDDataElement*)data
+              atTimestep:(uint)tstep
+                 inRange:(float)min
+                     and:(float)max
+            connectivity:(enum BAConnectivity)connectivity
+{
+    if (data == nil || [self->mROISelections count] == 0) {
+        return nil;
+    }
+    
+    BAROIClusterLabeling* labeling = [[BAROIClusterLabeling alloc] initWithReference:data
+                                                                          atTimestep:tstep
+                                                                             inRange:min
+                                                                                 and:max
+                                                                        connectivity:connectivity];
+    if (labeling == nil) {
+        return nil;
+    }
+    NSArray* selections = [labeling clusterSelectionsWithMode:self->mMode];
+    [labeling release];
+    
+    NSString* currentROI = [[self->mROISelect selectedItem] title];
+    BAROIMask* currentMask = [self maskOf:currentROI compatibleWith:data];
+    BAROISelection* parentSelection = [self->mROISelections valueForKey:currentROI];
+    for (BAROISelection* selection in selections) {
+        [parentSelection addChild:selection];
+        currentMask = [selection applyToMask:currentMask];
+    }
+    [self->mROIMasks setValue:currentMask forKey:currentROI];
+    NSLog(@"Current ROI (%@): added %ld clusters, %@", currentROI, [selections count], currentMask);
+    
+    [self showMask:currentROI];
+    
+    return selections;
+}
+
 // ############################
 // # Protocol implementations #
 // ############################
@@ -259,42 +376,18 @@ static NSString* DEFAULT_ROI_TEXT = @"No ROI available";
         NSString* currentROI = [[self->mROISelect selectedItem] title];
         NSLog(@"selected ROI: %@", currentROI);
         
-        EDDataElement* currentMask = [self->mROIMasks valueForKey:currentROI];
-        if (![self isCompatible:currentMask with:data]) {
-            BARTImageSize* maskSize = [data getImageSize];
-            maskSize.timesteps = 1;
-            EDDataElement* newMask = [[EDDataElement alloc] initEmptyWithSize:maskSize
-                                                                  ofImageType:data.mImageType
-                                                          withOrientationFrom:data];
-            
-            [self->mROIMasks setValue:newMask forKey:currentROI];
-            
-            // Small hack: before setting the mask to the renderer
-            // Set one value to 1.0 so (min, max) is (0.0, 1.0) instead of (0.0, 0.0)
-            // The renderer only checks for (min, max) once: when the data is set
-            // If (min, max) change later due to changes to the data, it is not recognized!
-            [newMask setVoxelValue:[NSNumber numberWithFloat:1.0f] atRow:0 col:0 slice:0 timestep:0];
-            NSLog(@"MinMax mask: %@", [newMask getMinMaxOfDataElement]);
-            [self->mROISelectionRenderer setData:newMask];
-            [newMask setVoxelValue:[NSNumber numberWithFloat:0.0f] atRow:0 col:0 slice:0 timestep:0]; // revert
-            
-            NSLog(@"data orient: %d, mask orient: %d", [data getMainOrientation], [newMask getMainOrientation]);
-            currentMask = newMask;
-            
-            [newMask release];
-        }
+        BAROIMask* currentMask = [self maskOf:currentROI compatibleWith:data];
         
         BAROISelection* selection = [self makeSelectionFrom:data at:p inRange:min and:max];
         if (selection != nil) {
             BAROISelection* parentSelection = [self->mROISelections valueForKey:currentROI];
             [parentSelection addChild:selection];
             NSLog(@"Current ROI (%@) selection: %@", currentROI, selection);
-            [selection addToBinaryMask:currentMask];
+            [self->mROIMasks setValue:[selection applyToMask:currentMask] forKey:currentROI];
             [selection release];
         }
         
-        // Force rerender since original DataElement has changed
-        [self->mROISelectionRenderer renderImage:YES];
+        [self showMask:currentROI];
     }
 }
 
@@ -0,0 +1,122 @@
+//
+//  BAROIMask.h
+//  ImageDataView
+//
+
+#import <Foundation/Foundation.h>
+
+#import "BARunLengthMask.h"
+
+@class EDDataElement;
+
+/**
+ * Immutable binary ROI mask stored run-length encoded per row (\see{BARunLengthMask}).
+ * Set operations create new masks, conversion to a float EDDataElement
+ * (voxel values 0.0 and 1.0) happens on demand for writing and display.
+ */
+@interface BAROIMask : NSObject {
+
+    BARunLengthMask mMask;
+
+}
+
+/** Initializer for a mask without any voxel.
+ *
+ * \param columns Number of columns.
+ * \param rows    Number of rows.
+ * \param slices  Number of slices.
+ * \return        Nil if memory could not be allocated.
+ */
+-(id)initEmptyWithColumns:(size_t)columns
+                     rows:(size_t)rows
+                   slices:(size_t)slices;
+
+/** Initializer for a mask of all voxels different from 0.0.
+ *
+ * \param data  EDDataElement to convert (e.g. a binary mask).
+ * \param tstep Timestep of data to use.
+ * \return      Nil if tstep is out of range or memory could not be allocated.
+ */
+-(id)initWithDataElement:(EDDataElement*)data
+              atTimestep:(uint)tstep;
+
+/** Initializer for a mask of all set bits of a bitmap (\see{BARegionGrow}).
+ *
+ * \param bitmap  Bit per voxel (bit index = voxel index, column fastest).
+ * \param columns Number of columns.
+ * \param rows    Number of rows.
+ * \param slices  Number of slices.
+ * \return        Nil if memory could not be allocated.
+ */
+-(id)initWithBitmap:(const uint64_t*)bitmap
+            columns:(size_t)columns
+               rows:(size_t)rows
+             slices:(size_t)slices;
+
+/** Initializer for a mask of all voxels of a label volume carrying a label
+ *  (\see{BALabelComponents}).
+ *
+ * \param labels  Label per voxel (column fastest).
+ * \param label   Label to select.
+ * \param columns Number of columns.
+ * \param rows    Number of rows.
+ * \param slices  Number of slices.
+ * \param box     Inclusive bounds (minColumn, maxColumn, minRow, maxRow, minSlice,
+ *                maxSlice) of the voxels to look at, NULL for all voxels.
+ * \return        Nil if memory could not be allocated.
+ */
+-(id)initWithLabels:(const uint32_t*)labels
+              label:(uint32_t)label
+            columns:(size_t)columns
+               rows:(size_t)rows
+             slices:(size_t)slices
+             within:(const size_t*)box;
+
+/** Dimensions. */
+-(size_t)columns;
+-(size_t)rows;
+-(size_t)slices;
+
+/** Number of selected voxels. */
+-(size_t)voxelCount;
+
+/** Bytes used for the mask data. */
+-(size_t)memorySize;
+
+/** Whether a voxel is selected. */
+-(BOOL)containsColumn:(size_t)column
+                  row:(size_t)row
+                slice:(size_t)slice;
+
+/** Whether other has the same dimensions (a precondition of the set operations). */
+-(BOOL)isCompatibleWith:(BAROIMask*)other;
+
+/**
+ * Set operations. Each one runs a single merge pass over the runs of both masks.
+ *
+ * \param other Mask of the same dimensions.
+ * \return      New autoreleased mask, nil if the dimensions differ or memory
+ *              could not be allocated.
+ */
+-(BAROIMask*)unionWith:(BAROIMask*)other;
+-(BAROIMask*)differenceWith:(BAROIMask*)other;
+-(BAROIMask*)intersectionWith:(BAROIMask*)other;
+
+/**
+ * Writes the mask into the first timestep of an EDDataElement:
+ * 1.0 for selected voxels, 0.0 for all others.
+ *
+ * \param data EDDataElement of (at least) the mask's dimensions.
+ */
+-(void)drawOn:(EDDataElement*)data;
+
+/**
+ * Converts the mask to a new binary mask EDDataElement (one timestep,
+ * voxel values of 0.0 and 1.0).
+ *
+ * \param reference EDDataElement whose orientation and image type to use.
+ * \return          Autoreleased EDDataElement.
+ */
+-(EDDataElement*)asDataElementLike:(EDDataElement*)reference;
+
+@end
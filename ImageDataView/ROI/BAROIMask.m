@@ -0,0 +1,235 @@
+//
+//  BAROIMask.m
+//  ImageDataView
+//
+
+#import "BAROIMask.h"
+#import "EDDataElement.h"
+
+@interface BAROIMask (__privateMethods__)
+
+/** Creates result = self <op> other. */
+-(BAROIMask*)combineWith:(BAROIMask*)other
+               operation:(enum BAMaskOperation)op;
+
+@end
+
+
+@implementation BAROIMask
+
+-(id)initEmptyWithColumns:(size_t)columns
+                     rows:(size_t)rows
+                   slices:(size_t)slices
+{
+    if (self = [super init]) {
+        if (!BARunLengthMaskInitEmpty(&self->mMask, columns, rows, slices)) {
+            [self release];
+            return nil;
+        }
+    }
+
+    return self;
+}
+
+-(id)initWithDataElement:(EDDataElement*)data
+              atTimestep:(uint)tstep
+{
+    if (self = [super init]) {
+        memset(&self->mMask, 0, sizeof(BARunLengthMask));
+
+        EDTypedVolume volume;
+        id token;
+        BOOL ok = NO;
+        if ([data getTypedVolume:&volume atTimestep:tstep token:&token]) {
+            ok = BARunLengthMaskInitFromVolume(&self->mMask, &volume);
+        } else {
+            // Go through a temporary copy of the slices
+            BARTImageSize* size = [data getImageSize];
+            size_t sliceSize = size.columns * size.rows;
+            float* copy = (tstep < size.timesteps) ? malloc((sliceSize * size.slices + 1) * sizeof(float)) : NULL;
+            ok = copy != NULL;
+            for (size_t slice = 0; ok && slice < size.slices; slice++) {
+                EDSliceView view = [data getSliceView:(uint) slice atTimestep:tstep];
+                ok = view.data != NULL;
+                for (size_t row = 0; ok && row < size.rows; row++) {
+                    memcpy(copy + slice * sliceSize + row * size.columns,
+                           view.data + row * view.rowStride,
+                           size.columns * sizeof(float));
+                }
+            }
+            if (ok) {
+                EDTypedVolumeInitSliceMajor(&volume, copy, ED_VOXEL_FLOAT, size.columns, size.rows, size.slices, 1);
+                ok = BARunLengthMaskInitFromVolume(&self->mMask, &volume);
+            }
+            free(copy);
+        }
+
+        if (!ok) {
+            [self release];
+            return nil;
+        }
+    }
+
+    return self;
+}
+
+-(id)initWithBitmap:(const uint64_t*)bitmap
+            columns:(size_t)columns
+               rows:(size_t)rows
+             slices:(size_t)slices
+{
+    if (self = [super init]) {
+        if (!BARunLengthMaskInitFromBitmap(&self->mMask, bitmap, columns, rows, slices)) {
+            [self release];
+            return nil;
+        }
+    }
+
+    return self;
+}
+
+-(id)initWithLabels:(const uint32_t*)labels
+              label:(uint32_t)label
+            columns:(size_t)columns
+               rows:(size_t)rows
+             slices:(size_t)slices
+             within:(const size_t*)box
+{
+    if (self = [super init]) {
+        if (!BARunLengthMaskInitFromLabels(&self->mMask, labels, label, columns, rows, slices, box)) {
+            [self release];
+            return nil;
+        }
+    }
+
+    return self;
+}
+
+-(void)dealloc
+{
+    BARunLengthMaskFree(&self->mMask);
+
+    [super dealloc];
+}
+
+-(size_t)columns
+{
+    return self->mMask.columns;
+}
+
+-(size_t)rows
+{
+    return self->mMask.rows;
+}
+
+-(size_t)slices
+{
+    return self->mMask.slices;
+}
+
+-(size_t)voxelCount
+{
+    return BARunLengthMaskVoxelCount(&self->mMask);
+}
+
+-(size_t)memorySize
+{
+    return (self->mMask.rows * self->mMask.slices + 1) * sizeof(uint32_t)
+         + self->mMask.runCapacity * sizeof(BAMaskRun);
+}
+
+-(BOOL)containsColumn:(size_t)column
+                  row:(size_t)row
+                slice:(size_t)slice
+{
+    return BARunLengthMaskContains(&self->mMask, column, row, slice) ? YES : NO;
+}
+
+-(BOOL)isCompatibleWith:(BAROIMask*)other
+{
+    return other != nil
+        && self->mMask.columns == other->mMask.columns
+        && self->mMask.rows    == other->mMask.rows
+        && self->mMask.slices  == other->mMask.slices;
+}
+
+-(BAROIMask*)combineWith:(BAROIMask*)other
+               operation:(enum BAMaskOperation)op
+{
+    if (![self isCompatibleWith:other]) {
+        return nil;
+    }
+
+    BAROIMask* result = [[[BAROIMask alloc] init] autorelease];
+    if (!BARunLengthMaskInitCombined(&result->mMask, &self->mMask, &other->mMask, op)) {
+        NSLog(@"BAROIMask: could not allocate the result of a set operation");
+        return nil;
+    }
+
+    return result;
+}
+
+-(BAROIMask*)unionWith:(BAROIMask*)other
+{
+    return [self combineWith:other operation:MASK_UNION];
+}
+
+-(BAROIMask*)differenceWith:(BAROIMask*)other
+{
+    return [self combineWith:other operation:MASK_DIFFERENCE];
+}
+
+-(BAROIMask*)intersectionWith:(BAROIMask*)other
+{
+    return [self combineWith:other operation:MASK_INTERSECTION];
+}
+
+-(void)drawOn:(EDDataElement*)data
+{
+    EDTypedVolume volume;
+    if ([data getTypedVolume:&volume atTimestep:0]) {
+        BARunLengthMaskToVolume(&self->mMask, &volume, 1.0f, 0.0f);
+        // Data was written directly
+        [data invalidateStatisticsOfTimestep:0];
+        return;
+    }
+
+    BARTImageSize* size = [data getImageSize];
+    NSNumber* inside  = [NSNumber numberWithFloat:1.0f];
+    NSNumber* outside = [NSNumber numberWithFloat:0.0f];
+    for (size_t s = 0; s < size.slices && s < self->mMask.slices; s++) {
+        for (size_t r = 0; r < size.rows && r < self->mMask.rows; r++) {
+            for (size_t c = 0; c < size.columns && c < self->mMask.columns; c++) {
+                [data setVoxelValue:BARunLengthMaskContains(&self->mMask, c, r, s) ? inside : outside
+                              atRow:r
+                                col:c
+                              slice:s
+                           timestep:0];
+            }
+        }
+    }
+}
+
+-(EDDataElement*)asDataElementLike:(EDDataElement*)reference
+{
+    BARTImageSize* size = [[BARTImageSize alloc] initWithRows:self->mMask.rows
+                                                      andCols:self->mMask.columns
+                                                    andSlices:self->mMask.slices
+                                                 andTimesteps:1];
+    EDDataElement* data = [[[EDDataElement alloc] initEmptyWithSize:size
+                                                        ofImageType:reference.mImageType
+                                                withOrientationFrom:reference] autorelease];
+    [size release];
+
+    [self drawOn:data];
+
+    return data;
+}
+
+-(NSString*)description {
+    return [NSString stringWithFormat:@"BAROIMask(%ldx%ldx%ld, voxels=%ld, runs=%ld)",
+            self->mMask.columns, self->mMask.rows, self->mMask.slices,
+            [self voxelCount], self->mMask.runCount];
+}
+
+@end
@@ -35,4 +35,9 @@
                   mode:(enum ROISelectionMode)m
           andThreshold:(float)thres;
 
+/** Upper bound of the voxel values to select.
+ *  No bound (HUGE_VALF) here, subclasses selecting a range override it.
+ */
+-(float)upperBound;
+
 @end
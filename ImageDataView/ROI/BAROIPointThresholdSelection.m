@@ -8,9 +8,36 @@
 
 #import "BAROIPointThresholdSelection.h"
 #import "BADataVoxel.h"
+#import "BARegionGrowing.h"
+#import "BAROIMask.h"
+
+#include <math.h>
 
 static const enum ImageOrientation DEFAULT_ORIENTATION = ORIENT_AXIAL;
 
+@interface BAROIPointThresholdSelection (__privateMethods__)
+
+/**
+ * Grows the region on the raw data (float or native type) of reference and mask
+ * (\see{BARegionGrow}).
+ *
+ * \param mask  Binary mask to draw the selection on.
+ * \param value Mask value of selected voxels.
+ * \return      NO if the data of reference or mask is not accessible as a volume
+ *              (nothing done).
+ */
+-(BOOL)growRegionOn:(EDDataElement*)mask
+          withValue:(float)value;
+
+/**
+ * Voxel-wise flood fill through the EDDataElement accessors.
+ * Fallback for data without a volume store.
+ */
+-(void)floodFill:(EDDataElement*)mask
+       withValue:(float)value;
+
+@end
+
 @implementation BAROIPointThresholdSelection
 
 @synthesize point = mPoint;
@@ -59,85 +86,170 @@ static const enum ImageOrientation DEFAULT_ORIENTATION = ORIENT_AXIAL;
     return mask;
 }
 
+-(float)upperBound
+{
+    return HUGE_VALF;
+}
+
+-(BAROIMask*)regionLike:(BAROIMask*)space
+{
+    uint tstep = (uint) self->mPoint.timestep;
+    
+    EDTypedVolume reference;
+    id token;
+    if ([self->mReference getTypedVolume:&reference atTimestep:tstep token:&token]) {
+        if (reference.columns != [space columns] || reference.rows != [space rows] || reference.slices != [space slices]) {
+            return nil;
+        }
+        
+        // Grow into a bitmap only, the mask itself is composed afterwards
+        uint64_t* visited = calloc(BARegionGrowBitmapWords(reference.columns * reference.rows * reference.slices) + 1,
+                                   sizeof(uint64_t));
+        if (visited == NULL
+            || !BARegionGrow(&reference, NULL,
+                             self->mPoint.column, self->mPoint.row, self->mPoint.slice,
+                             self->mThreshold, [self upperBound], 1.0f, visited, NULL)) {
+            NSLog(@"BAROIPointThresholdSelection: could not allocate region growing buffers, selection may be incomplete");
+        }
+        if (visited == NULL) {
+            return nil;
+        }
+        
+        BAROIMask* region = [[[BAROIMask alloc] initWithBitmap:visited
+                                                       columns:reference.columns
+                                                          rows:reference.rows
+                                                        slices:reference.slices] autorelease];
+        free(visited);
+        return region;
+    }
+    
+    // Fallback: flood fill an empty temporary mask
+    BAROIMask* empty = [[BAROIMask alloc] initEmptyWithColumns:[space columns]
+                                                          rows:[space rows]
+                                                        slices:[space slices]];
+    EDDataElement* mask = [empty asDataElementLike:self->mReference];
+    [empty release];
+    [self floodFill:mask withValue:1.0f];
+    
+    return [[[BAROIMask alloc] initWithDataElement:mask atTimestep:0] autorelease];
+}
+
 -(EDDataElement*)addToBinaryMask:(EDDataElement*)mask
 {
     float value = (self->mMode == ADD) ? 1.0f : 0.0f;
     if (mask != nil) {
-        BARTImageSize* refSize  = [self->mReference getImageSize];
-        BARTImageSize* maskSize = [mask getImageSize];
-        NSMutableArray* stack = [[NSMutableArray alloc] initWithCapacity:64];
-        [stack addObject:self->mPoint];
-        while ([stack count] > 0) {
-            BADataVoxel* p = [[stack lastObject] retain];
-            [stack removeLastObject];
-            
-            if (p.column < refSize.columns && p.column < maskSize.columns
-                && p.row < refSize.rows && p.row < maskSize.rows
-                && p.slice < refSize.slices && p.slice < maskSize.rows
-                && p.timestep < refSize.timesteps && p.timestep < maskSize.timesteps) {
-                float refVal = [self->mReference getFloatVoxelValueAtRow:p.row
-                                                                     col:p.column
-                                                                   slice:p.slice
-                                                                timestep:p.timestep];
-                float maskVal = [mask getFloatVoxelValueAtRow:p.row
-                                                          col:p.column
-                                                        slice:p.slice
-                                                     timestep:p.timestep];
-                if (refVal >= self->mThreshold && maskVal != value) {
-//                    NSLog(@"Set point: %@", p);
-                    [mask setVoxelValue:[NSNumber numberWithFloat:value]
-                                  atRow:p.row
-                                    col:p.column
-                                  slice:p.slice
-                               timestep:p.timestep];
-                    BADataVoxel* newP;
-                    newP = [[BADataVoxel alloc] initWithColumn:p.column + 1
-                                                           row:p.row
-                                                         slice:p.slice
-                                                      timestep:p.timestep];
-                    [stack addObject:newP];
-                    [newP release];
-                    newP = [[BADataVoxel alloc] initWithColumn:p.column - 1
-                                                           row:p.row
-                                                         slice:p.slice
-                                                      timestep:p.timestep];
-                    [stack addObject:newP];
-                    [newP release];
-                    newP = [[BADataVoxel alloc] initWithColumn:p.column
-                                                           row:p.row + 1
-                                                         slice:p.slice
-                                                      timestep:p.timestep];
-                    [stack addObject:newP];
-                    [newP release];
-                    newP = [[BADataVoxel alloc] initWithColumn:p.column
-                                                           row:p.row - 1
-                                                         slice:p.slice
-                                                      timestep:p.timestep];
-                    [stack addObject:newP];
-                    [newP release];
-                    newP = [[BADataVoxel alloc] initWithColumn:p.column
-                                                           row:p.row
-                                                         slice:p.slice + 1
-                                                      timestep:p.timestep];
-                    [stack addObject:newP];
-                    [newP release];
-                    newP = [[BADataVoxel alloc] initWithColumn:p.column
-                                                           row:p.row
-                                                         slice:p.slice - 1
-                                                      timestep:p.timestep];
-                    [stack addObject:newP];
-                    [newP release];
-                }
-                [p release];
-            }
+        if (![self growRegionOn:mask withValue:value]) {
+            [self floodFill:mask withValue:value];
         }
-        [stack release];
     }
     
     [super addToBinaryMask:mask];
     return mask;
 }
 
+-(BOOL)growRegionOn:(EDDataElement*)mask
+          withValue:(float)value
+{
+    uint tstep = (uint) self->mPoint.timestep;
+    
+    EDTypedVolume reference;
+    EDTypedVolume maskVolume;
+    id token;
+    if (![self->mReference getTypedVolume:&reference atTimestep:tstep token:&token]
+        || ![mask getTypedVolume:&maskVolume atTimestep:tstep]) {
+        return NO;
+    }
+    
+    size_t filled = 0;
+    if (!BARegionGrow(&reference, &maskVolume,
+                      self->mPoint.column, self->mPoint.row, self->mPoint.slice,
+                      self->mThreshold, [self upperBound], value, NULL, &filled)) {
+        NSLog(@"BAROIPointThresholdSelection: could not allocate region growing buffers, selection may be incomplete");
+    }
+    
+    // Mask data was written directly
+    if (filled > 0) {
+        [mask invalidateStatisticsOfTimestep:tstep];
+    }
+    
+    return YES;
+}
+
+-(void)floodFill:(EDDataElement*)mask
+       withValue:(float)value
+{
+    BARTImageSize* refSize  = [self->mReference getImageSize];
+    BARTImageSize* maskSize = [mask getImageSize];
+    float max = [self upperBound];
+    NSMutableArray* stack = [[NSMutableArray alloc] initWithCapacity:64];
+    [stack addObject:self->mPoint];
+    while ([stack count] > 0) {
+        BADataVoxel* p = [[stack lastObject] retain];
+        [stack removeLastObject];
+        
+        if (p.column < refSize.columns && p.column < maskSize.columns
+            && p.row < refSize.rows && p.row < maskSize.rows
+            && p.slice < refSize.slices && p.slice < maskSize.slices
+            && p.timestep < refSize.timesteps && p.timestep < maskSize.timesteps) {
+            float refVal = [self->mReference getFloatVoxelValueAtRow:p.row
+                                                                 col:p.column
+                                                               slice:p.slice
+                                                            timestep:p.timestep];
+            float maskVal = [mask getFloatVoxelValueAtRow:p.row
+                                                      col:p.column
+                                                    slice:p.slice
+                                                 timestep:p.timestep];
+            if (refVal >= self->mThreshold && refVal <= max && maskVal != value) {
+//                    NSLog(@"Set point: %@", p);
+                [mask setVoxelValue:[NSNumber numberWithFloat:value]
+                              atRow:p.row
+                                col:p.column
+                              slice:p.slice
+                           timestep:p.timestep];
+                BADataVoxel* newP;
+                newP = [[BADataVoxel alloc] initWithColumn:p.column + 1
+                                                       row:p.row
+                                                     slice:p.slice
+                                                  timestep:p.timestep];
+                [stack addObject:newP];
+                [newP release];
+                newP = [[BADataVoxel alloc] initWithColumn:p.column - 1
+                                                       row:p.row
+                                                     slice:p.slice
+                                                  timestep:p.timestep];
+                [stack addObject:newP];
+                [newP release];
+                newP = [[BADataVoxel alloc] initWithColumn:p.column
+                                                       row:p.row + 1
+                                                     slice:p.slice
+                                                  timestep:p.timestep];
+                [stack addObject:newP];
+                [newP release];
+                newP = [[BADataVoxel alloc] initWithColumn:p.column
+                                                       row:p.row - 1
+                                                     slice:p.slice
+                                                  timestep:p.timestep];
+                [stack addObject:newP];
+                [newP release];
+                newP = [[BADataVoxel alloc] initWithColumn:p.column
+                                                       row:p.row
+                                                     slice:p.slice + 1
+                                                  timestep:p.timestep];
+                [stack addObject:newP];
+                [newP release];
+                newP = [[BADataVoxel alloc] initWithColumn:p.column
+                                                       row:p.row
+                                                     slice:p.slice - 1
+                                                  timestep:p.timestep];
+                [stack addObject:newP];
+                [newP release];
+            }
+        }
+        [p release];
+    }
+    [stack release];
+}
+
 -(NSString*)description {
     return [NSString stringWithFormat:@"BAROIPointThresholdSelection(point=%@, thres=%f)", self->mPoint, self->mThreshold];
 }
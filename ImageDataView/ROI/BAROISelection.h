@@ -9,6 +9,7 @@
 #import <Foundation/Foundation.h>
 
 @class EDDataElement;
+@class BAROIMask;
 
 /**
  * Enum describing whether to add or to remove a ROI selection from
@@ -74,6 +75,26 @@ enum ROISelectionMode {
  */
 -(EDDataElement*)addToBinaryMask:(EDDataElement*)mask;
 
+/**
+ * The voxels selected by this selection alone (without its children).
+ * The base class selects nothing.
+ *
+ * \param space Mask defining the image dimensions of the result.
+ * \return      Autoreleased BAROIMask of the same dimensions as space.
+ *              Nil if the selection does not select any voxel in this space.
+ */
+-(BAROIMask*)regionLike:(BAROIMask*)space;
+
+/**
+ * Composes the selection with an existing mask: the own region (\see{regionLike:})
+ * is united with mask (ADD) or subtracted from it (REMOVE), then all
+ * children are applied in order.
+ *
+ * \param mask BAROIMask of the selection so far.
+ * \return     Resulting BAROIMask (autoreleased, possibly mask itself).
+ */
+-(BAROIMask*)applyToMask:(BAROIMask*)mask;
+
 //-(NSArray*)asPointSet;
 
 @end
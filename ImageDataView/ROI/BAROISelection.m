@@ -7,6 +7,7 @@
 //
 
 #import "BAROISelection.h"
+#import "BAROIMask.h"
 
 @interface BAROISelection (PrivateMutators)
 
@@ -95,6 +96,29 @@
     return mask;
 }
 
+-(BAROIMask*)regionLike:(BAROIMask*)space
+{
+    return nil;
+}
+
+-(BAROIMask*)applyToMask:(BAROIMask*)mask
+{
+    BAROIMask* region = [self regionLike:mask];
+    if (region != nil) {
+        BAROIMask* result = (self->mMode == ADD) ? [mask unionWith:region] : [mask differenceWith:region];
+        if (result != nil) {
+            mask = result;
+        } else {
+            NSLog(@"BAROISelection: could not compose %@, selection ignored", self);
+        }
+    }
+    
+    for (BAROISelection* sel in self->mChildren) {
+        mask = [sel applyToMask:mask];
+    }
+    return mask;
+}
+
 -(NSString*)description {
     return [NSString stringWithFormat: @"BAROISelection(parent=%@, #children=%ld)", self->mParent, [self->mChildren count]];
 }
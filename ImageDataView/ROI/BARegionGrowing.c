@@ -0,0 +1,245 @@
+//
+//  BARegionGrowing.c
+//  ImageDataView
+//
+
+#include "BARegionGrowing.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** Bits per coordinate of a packed stack entry (column | row << 21 | slice << 42). */
+#define COORD_BITS 21
+#define COORD_MASK ((1ULL << COORD_BITS) - 1)
+
+static inline uint64_t pack(size_t c, size_t r, size_t s)
+{
+    return (uint64_t) c | ((uint64_t) r << COORD_BITS) | ((uint64_t) s << (2 * COORD_BITS));
+}
+
+/** Stack of packed voxel coordinates (or linear indices), grown on demand. */
+typedef struct {
+    uint64_t* entries;
+    size_t    count;
+    size_t    capacity;
+} BAIndexStack;
+
+static int stackInit(BAIndexStack* stack, size_t capacity)
+{
+    stack->entries  = malloc(capacity * sizeof(uint64_t));
+    stack->count    = 0;
+    stack->capacity = capacity;
+    return stack->entries != NULL;
+}
+
+static inline int stackPush(BAIndexStack* stack, uint64_t entry)
+{
+    if (stack->count == stack->capacity) {
+        uint64_t* entries = realloc(stack->entries, 2 * stack->capacity * sizeof(uint64_t));
+        if (entries == NULL) {
+            return 0;
+        }
+        stack->entries   = entries;
+        stack->capacity *= 2;
+    }
+    stack->entries[stack->count++] = entry;
+    return 1;
+}
+
+static inline int testBit(const uint64_t* bitmap, size_t index)
+{
+    return (int) ((bitmap[index >> 6] >> (index & 63)) & 1);
+}
+
+static inline void setBit(uint64_t* bitmap, size_t index)
+{
+    bitmap[index >> 6] |= (uint64_t) 1 << (index & 63);
+}
+
+/** State shared by the span helpers. */
+typedef struct {
+    const EDTypedVolume* reference;
+    EDTypedVolume*       mask;
+    uint64_t*            visited;
+    float                min;
+    float                max;
+    float                value;
+} BAGrowContext;
+
+static inline int fillable(const BAGrowContext* ctx, size_t index, size_t c, size_t r, size_t s)
+{
+    if (testBit(ctx->visited, index)) {
+        return 0;
+    }
+    float val = EDTypedVolumeGet(ctx->reference, c, r, s, 0);
+    return val >= ctx->min && val <= ctx->max
+        && (ctx->mask == NULL || EDTypedVolumeGet(ctx->mask, c, r, s, 0) != ctx->value);
+}
+
+/** Pushes one entry per run of fillable voxels in columns [left, right] of line (r, s). */
+static int pushRuns(const BAGrowContext* ctx, BAIndexStack* stack,
+                    size_t left, size_t right, size_t r, size_t s)
+{
+    const EDTypedVolume* ref = ctx->reference;
+    size_t lineStart = (s * ref->rows + r) * ref->columns;
+    int inRun = 0;
+    for (size_t c = left; c <= right; c++) {
+        int f = fillable(ctx, lineStart + c, c, r, s);
+        if (f && !inRun && !stackPush(stack, pack(c, r, s))) {
+            return 0;
+        }
+        inRun = f;
+    }
+    return 1;
+}
+
+int BARegionGrow(const EDTypedVolume* reference, EDTypedVolume* mask,
+                 size_t column, size_t row, size_t slice,
+                 float min, float max, float value,
+                 uint64_t* visited, size_t* filled)
+{
+    size_t cols   = reference->columns;
+    size_t rows   = reference->rows;
+    size_t slices = reference->slices;
+    size_t count  = 0;
+    if (filled != NULL) {
+        *filled = 0;
+    }
+    if (mask != NULL) {
+        if (mask->columns < cols) cols = mask->columns;
+        if (mask->rows < rows) rows = mask->rows;
+        if (mask->slices < slices) slices = mask->slices;
+    }
+    if (column >= cols || row >= rows || slice >= slices) {
+        return 1;
+    }
+    if (cols > COORD_MASK || rows > COORD_MASK || slices > COORD_MASK) {
+        return 0;
+    }
+
+    // Index the bitmap with the reference dimensions, the caller sized it that way
+    size_t refCols = reference->columns;
+    size_t refRows = reference->rows;
+
+    uint64_t* bitmap = visited;
+    if (bitmap == NULL) {
+        bitmap = calloc(BARegionGrowBitmapWords(refCols * refRows * reference->slices), sizeof(uint64_t));
+        if (bitmap == NULL) {
+            return 0;
+        }
+    }
+
+    // A span fill rarely holds more than a few entries per line
+    BAIndexStack stack;
+    if (!stackInit(&stack, 2 * rows * slices + 16)) {
+        if (visited == NULL) free(bitmap);
+        return 0;
+    }
+
+    BAGrowContext ctx = { reference, mask, bitmap, min, max, value };
+    int ok = stackPush(&stack, pack(column, row, slice));
+
+    while (ok && stack.count > 0) {
+        uint64_t entry = stack.entries[--stack.count];
+        size_t c = (size_t) (entry & COORD_MASK);
+        size_t r = (size_t) ((entry >> COORD_BITS) & COORD_MASK);
+        size_t s = (size_t) (entry >> (2 * COORD_BITS));
+        size_t lineStart = (s * refRows + r) * refCols;
+        size_t index = lineStart + c;
+
+        if (!fillable(&ctx, index, c, r, s)) {
+            // Reached through another run meanwhile
+            continue;
+        }
+
+        size_t left  = c;
+        size_t right = c;
+        while (left > 0 && fillable(&ctx, lineStart + left - 1, left - 1, r, s)) {
+            left--;
+        }
+        while (right + 1 < cols && fillable(&ctx, lineStart + right + 1, right + 1, r, s)) {
+            right++;
+        }
+
+        for (size_t x = left; x <= right; x++) {
+            setBit(bitmap, lineStart + x);
+        }
+        if (mask != NULL) {
+            void* maskLine = (void*) EDTypedVoxelAt(mask->data, mask->type, EDTypedVolumeOffset(mask, 0, r, s, 0));
+            if (mask->type == ED_VOXEL_FLOAT) {
+                for (size_t x = left; x <= right; x++) {
+                    ((float*) maskLine)[(ptrdiff_t) x * mask->colStride] = value;
+                }
+            } else {
+                for (size_t x = left; x <= right; x++) {
+                    EDTypedStore(maskLine, mask->type, (ptrdiff_t) x * mask->colStride, value);
+                }
+            }
+        }
+        count += right - left + 1;
+
+        if (r > 0)          ok = ok && pushRuns(&ctx, &stack, left, right, r - 1, s);
+        if (r + 1 < rows)   ok = ok && pushRuns(&ctx, &stack, left, right, r + 1, s);
+        if (s > 0)          ok = ok && pushRuns(&ctx, &stack, left, right, r, s - 1);
+        if (s + 1 < slices) ok = ok && pushRuns(&ctx, &stack, left, right, r, s + 1);
+    }
+
+    free(stack.entries);
+    if (visited == NULL) {
+        free(bitmap);
+    }
+    if (filled != NULL) {
+        *filled = count;
+    }
+
+    return ok;
+}
+
+int BARegionGrowScalar(const EDFloatVolume* reference, EDFloatVolume* mask,
+                       size_t column, size_t row, size_t slice,
+                       float min, float max, float value,
+                       size_t* filled)
+{
+    size_t cols   = (reference->columns < mask->columns) ? reference->columns : mask->columns;
+    size_t rows   = (reference->rows < mask->rows) ? reference->rows : mask->rows;
+    size_t slices = (reference->slices < mask->slices) ? reference->slices : mask->slices;
+    size_t count  = 0;
+
+    BAIndexStack stack;
+    if (!stackInit(&stack, 64)) {
+        return 0;
+    }
+
+    int ok = 1;
+    if (column < cols && row < rows && slice < slices) {
+        ok = stackPush(&stack, (slice * rows + row) * cols + column);
+    }
+
+    while (ok && stack.count > 0) {
+        size_t index = stack.entries[--stack.count];
+        size_t c = index % cols;
+        size_t r = (index / cols) % rows;
+        size_t s = index / (cols * rows);
+
+        float val = EDFloatVolumeGet(reference, c, r, s, 0);
+        if (val >= min && val <= max
+            && EDFloatVolumeGet(mask, c, r, s, 0) != value) {
+            EDFloatVolumeSet(mask, c, r, s, 0, value);
+            count++;
+
+            if (c + 1 < cols)   ok = ok && stackPush(&stack, index + 1);
+            if (c > 0)          ok = ok && stackPush(&stack, index - 1);
+            if (r + 1 < rows)   ok = ok && stackPush(&stack, index + cols);
+            if (r > 0)          ok = ok && stackPush(&stack, index - cols);
+            if (s + 1 < slices) ok = ok && stackPush(&stack, index + cols * rows);
+            if (s > 0)          ok = ok && stackPush(&stack, index - cols * rows);
+        }
+    }
+
+    free(stack.entries);
+    if (filled != NULL) {
+        *filled = count;
+    }
+
+    return ok;
+}
@@ -0,0 +1,64 @@
+//
+//  BARegionGrowing.h
+//  ImageDataView
+//
+
+#ifndef ImageDataView_BARegionGrowing_h
+#define ImageDataView_BARegionGrowing_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "EDFloatVolume.h"
+#include "EDTypedVolume.h"
+
+/** Number of 64 bit words of a visited bitmap for a volume of voxelCount voxels. */
+static inline size_t BARegionGrowBitmapWords(size_t voxelCount)
+{
+    return (voxelCount + 63) / 64;
+}
+
+/**
+ * 6-connected region growing (flood fill) on the first timestep of raw volumes.
+ *
+ * Starting at the seed voxel, every voxel connected to it whose reference value is
+ * within [min, max] is set to value in mask. Mask voxels that already hold value
+ * stop the growth (same result as the former per-voxel flood fill of
+ * BAROIPointThresholdSelection/BAROIPointRangeSelection).
+ *
+ * Works span-wise: each stack entry is expanded to the whole run of matching
+ * voxels along the column axis, then one entry per run in the four neighbouring
+ * lines (row +/- 1, slice +/- 1) is pushed. Stack entries are packed voxel
+ * coordinates (64 bit, at most 2^21 voxels per dimension), filled voxels are
+ * tracked in a bitmap (1 bit per voxel).
+ *
+ * \param reference Volume the threshold is applied to, of any voxel type (native stores of
+ *                  EDDataElement#getTypedVolume:atTimestep: are read as they are).
+ * \param mask      Volume to write value to (any voxel type, value is rounded to it), same
+ *                  size as reference (extra voxels are ignored).
+ *                  NULL to only collect the region in visited (no voxel stops the growth then).
+ * \param column    Seed column.
+ * \param row       Seed row.
+ * \param slice     Seed slice.
+ * \param min       Minimum reference value of a voxel to be added.
+ * \param max       Maximum reference value of a voxel to be added (HUGE_VALF for none).
+ * \param value     Value written to mask for each added voxel.
+ * \param visited   Optional bitmap of BARegionGrowBitmapWords(columns * rows * slices) zeroed
+ *                  words, receives the added voxels (bit index = linear index with column
+ *                  fastest). NULL to use a temporary one.
+ * \param filled    Optional, receives the number of voxels added.
+ * \return          0 if buffers could not be allocated (the region may then be incomplete),
+ *                  1 otherwise.
+ */
+int BARegionGrow(const EDTypedVolume* reference, EDTypedVolume* mask,
+                 size_t column, size_t row, size_t slice,
+                 float min, float max, float value,
+                 uint64_t* visited, size_t* filled);
+
+/** Plain reference implementation of BARegionGrow (voxel-wise queue, no spans, no bitmap). */
+int BARegionGrowScalar(const EDFloatVolume* reference, EDFloatVolume* mask,
+                       size_t column, size_t row, size_t slice,
+                       float min, float max, float value,
+                       size_t* filled);
+
+#endif
@@ -0,0 +1,364 @@
+//
+//  BARunLengthMask.c
+//  ImageDataView
+//
+
+#include "BARunLengthMask.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial number of runs allocated for a mask. */
+static const size_t INITIAL_RUN_CAPACITY = 256;
+
+
+// ############
+// # Building #
+// ############
+
+static int initStorage(BARunLengthMask* mask, size_t columns, size_t rows, size_t slices)
+{
+    memset(mask, 0, sizeof(BARunLengthMask));
+    if (columns * rows * slices >= UINT32_MAX) {
+        return 0;
+    }
+    mask->columns     = columns;
+    mask->rows        = rows;
+    mask->slices      = slices;
+    mask->lineRuns    = calloc(rows * slices + 1, sizeof(uint32_t));
+    mask->runs        = malloc(INITIAL_RUN_CAPACITY * sizeof(BAMaskRun));
+    mask->runCapacity = INITIAL_RUN_CAPACITY;
+    if (mask->lineRuns == NULL || mask->runs == NULL) {
+        BARunLengthMaskFree(mask);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Appends run [start, end) to the line currently built (which started at run lineStart),
+ * merging it with the previous run of the line if they touch. Runs are appended in order.
+ */
+static inline int appendRun(BARunLengthMask* mask, size_t lineStart, uint32_t start, uint32_t end)
+{
+    if (mask->runCount > lineStart && mask->runs[mask->runCount - 1].end >= start) {
+        if (end > mask->runs[mask->runCount - 1].end) {
+            mask->runs[mask->runCount - 1].end = end;
+        }
+        return 1;
+    }
+    if (mask->runCount == mask->runCapacity) {
+        BAMaskRun* runs = realloc(mask->runs, 2 * mask->runCapacity * sizeof(BAMaskRun));
+        if (runs == NULL) {
+            return 0;
+        }
+        mask->runs         = runs;
+        mask->runCapacity *= 2;
+    }
+    mask->runs[mask->runCount].start = start;
+    mask->runs[mask->runCount].end   = end;
+    mask->runCount++;
+    return 1;
+}
+
+/** Closes line and returns the first run index of the next one. */
+static inline size_t finishLine(BARunLengthMask* mask, size_t line)
+{
+    mask->lineRuns[line + 1] = (uint32_t) mask->runCount;
+    return mask->runCount;
+}
+
+/** Bails out of a builder after an allocation failure. */
+static int fail(BARunLengthMask* mask)
+{
+    BARunLengthMaskFree(mask);
+    return 0;
+}
+
+int BARunLengthMaskInitEmpty(BARunLengthMask* mask, size_t columns, size_t rows, size_t slices)
+{
+    return initStorage(mask, columns, rows, slices);
+}
+
+int BARunLengthMaskInitFromVolume(BARunLengthMask* mask, const EDTypedVolume* volume)
+{
+    if (!initStorage(mask, volume->columns, volume->rows, volume->slices)) {
+        return 0;
+    }
+
+    size_t line = 0;
+    size_t lineStart = 0;
+    for (size_t s = 0; s < volume->slices; s++) {
+        for (size_t r = 0; r < volume->rows; r++, line++) {
+            const void* data = EDTypedVoxelAt(volume->data, volume->type, EDTypedVolumeOffset(volume, 0, r, s, 0));
+            size_t c = 0;
+            while (c < volume->columns) {
+                while (c < volume->columns && EDTypedLoad(data, volume->type, (ptrdiff_t) c * volume->colStride) == 0.0f) {
+                    c++;
+                }
+                size_t start = c;
+                while (c < volume->columns && EDTypedLoad(data, volume->type, (ptrdiff_t) c * volume->colStride) != 0.0f) {
+                    c++;
+                }
+                if (c > start && !appendRun(mask, lineStart, (uint32_t) start, (uint32_t) c)) {
+                    return fail(mask);
+                }
+            }
+            lineStart = finishLine(mask, line);
+        }
+    }
+    return 1;
+}
+
+int BARunLengthMaskInitFromBitmap(BARunLengthMask* mask, const uint64_t* bitmap,
+                                  size_t columns, size_t rows, size_t slices)
+{
+    if (!initStorage(mask, columns, rows, slices)) {
+        return 0;
+    }
+
+    size_t lines = rows * slices;
+    size_t lineStart = 0;
+    for (size_t line = 0; line < lines; line++) {
+        size_t first = line * columns;
+        size_t c = 0;
+        while (c < columns) {
+            size_t index = first + c;
+            uint64_t word = bitmap[index >> 6] >> (index & 63);
+            if (word == 0) {
+                // Skip the rest of the word at once
+                c += 64 - (index & 63);
+                continue;
+            }
+            if ((word & 1) == 0) {
+                // Jump to the next set bit of the word
+                c += (size_t) __builtin_ctzll(word);
+                continue;
+            }
+            size_t start = c;
+            while (c < columns && ((bitmap[(first + c) >> 6] >> ((first + c) & 63)) & 1)) {
+                c++;
+            }
+            if (!appendRun(mask, lineStart, (uint32_t) start, (uint32_t) c)) {
+                return fail(mask);
+            }
+        }
+        lineStart = finishLine(mask, line);
+    }
+    return 1;
+}
+
+int BARunLengthMaskInitFromLabels(BARunLengthMask* mask, const uint32_t* labels, uint32_t label,
+                                  size_t columns, size_t rows, size_t slices, const size_t* box)
+{
+    if (!initStorage(mask, columns, rows, slices)) {
+        return 0;
+    }
+
+    size_t minC = 0, maxC = columns, minR = 0, maxR = rows, minS = 0, maxS = slices;
+    if (box != NULL) {
+        minC = box[0]; maxC = (box[1] < columns) ? box[1] + 1 : columns;
+        minR = box[2]; maxR = (box[3] < rows)    ? box[3] + 1 : rows;
+        minS = box[4]; maxS = (box[5] < slices)  ? box[5] + 1 : slices;
+    }
+
+    size_t lineStart = 0;
+    for (size_t s = 0; s < slices; s++) {
+        for (size_t r = 0; r < rows; r++) {
+            size_t line = s * rows + r;
+            if (s >= minS && s < maxS && r >= minR && r < maxR) {
+                const uint32_t* data = labels + line * columns;
+                size_t c = minC;
+                while (c < maxC) {
+                    while (c < maxC && data[c] != label) {
+                        c++;
+                    }
+                    size_t start = c;
+                    while (c < maxC && data[c] == label) {
+                        c++;
+                    }
+                    if (c > start && !appendRun(mask, lineStart, (uint32_t) start, (uint32_t) c)) {
+                        return fail(mask);
+                    }
+                }
+            }
+            lineStart = finishLine(mask, line);
+        }
+    }
+    return 1;
+}
+
+
+// ##################
+// # Set operations #
+// ##################
+
+static int unionLine(BARunLengthMask* result, size_t lineStart,
+                     const BAMaskRun* a, size_t na, const BAMaskRun* b, size_t nb)
+{
+    size_t i = 0;
+    size_t j = 0;
+    while (i < na || j < nb) {
+        // Runs in order of their start, appendRun merges overlapping/touching ones
+        const BAMaskRun* next = (j >= nb || (i < na && a[i].start <= b[j].start)) ? &a[i++] : &b[j++];
+        if (!appendRun(result, lineStart, next->start, next->end)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int differenceLine(BARunLengthMask* result, size_t lineStart,
+                          const BAMaskRun* a, size_t na, const BAMaskRun* b, size_t nb)
+{
+    size_t j = 0;
+    for (size_t i = 0; i < na; i++) {
+        uint32_t start = a[i].start;
+        while (j < nb && b[j].end <= start) {
+            j++;
+        }
+        for (size_t k = j; k < nb && b[k].start < a[i].end; k++) {
+            if (b[k].start > start && !appendRun(result, lineStart, start, b[k].start)) {
+                return 0;
+            }
+            if (b[k].end > start) {
+                start = b[k].end;
+            }
+        }
+        if (start < a[i].end && !appendRun(result, lineStart, start, a[i].end)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int intersectionLine(BARunLengthMask* result, size_t lineStart,
+                            const BAMaskRun* a, size_t na, const BAMaskRun* b, size_t nb)
+{
+    size_t i = 0;
+    size_t j = 0;
+    while (i < na && j < nb) {
+        uint32_t start = (a[i].start > b[j].start) ? a[i].start : b[j].start;
+        uint32_t end   = (a[i].end < b[j].end) ? a[i].end : b[j].end;
+        if (start < end && !appendRun(result, lineStart, start, end)) {
+            return 0;
+        }
+        if (a[i].end < b[j].end) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+    return 1;
+}
+
+int BARunLengthMaskInitCombined(BARunLengthMask* result,
+                                const BARunLengthMask* a, const BARunLengthMask* b,
+                                enum BAMaskOperation op)
+{
+    if (a->columns != b->columns || a->rows != b->rows || a->slices != b->slices) {
+        memset(result, 0, sizeof(BARunLengthMask));
+        return 0;
+    }
+    if (!initStorage(result, a->columns, a->rows, a->slices)) {
+        return 0;
+    }
+
+    size_t lines = a->rows * a->slices;
+    size_t lineStart = 0;
+    for (size_t line = 0; line < lines; line++) {
+        const BAMaskRun* runsA = a->runs + a->lineRuns[line];
+        const BAMaskRun* runsB = b->runs + b->lineRuns[line];
+        size_t na = a->lineRuns[line + 1] - a->lineRuns[line];
+        size_t nb = b->lineRuns[line + 1] - b->lineRuns[line];
+
+        int ok;
+        switch (op) {
+            case MASK_UNION:
+                ok = unionLine(result, lineStart, runsA, na, runsB, nb);
+                break;
+            case MASK_DIFFERENCE:
+                ok = differenceLine(result, lineStart, runsA, na, runsB, nb);
+                break;
+            default:
+                ok = intersectionLine(result, lineStart, runsA, na, runsB, nb);
+                break;
+        }
+        if (!ok) {
+            return fail(result);
+        }
+        lineStart = finishLine(result, line);
+    }
+    return 1;
+}
+
+void BARunLengthMaskFree(BARunLengthMask* mask)
+{
+    free(mask->lineRuns);
+    free(mask->runs);
+    mask->lineRuns    = NULL;
+    mask->runs        = NULL;
+    mask->runCount    = 0;
+    mask->runCapacity = 0;
+}
+
+
+// ###########
+// # Queries #
+// ###########
+
+size_t BARunLengthMaskVoxelCount(const BARunLengthMask* mask)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < mask->runCount; i++) {
+        count += mask->runs[i].end - mask->runs[i].start;
+    }
+    return count;
+}
+
+int BARunLengthMaskContains(const BARunLengthMask* mask, size_t column, size_t row, size_t slice)
+{
+    if (column >= mask->columns || row >= mask->rows || slice >= mask->slices) {
+        return 0;
+    }
+
+    size_t line = slice * mask->rows + row;
+    size_t lo = mask->lineRuns[line];
+    size_t hi = mask->lineRuns[line + 1];
+    // Binary search for the last run starting at or before column
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mask->runs[mid].start <= column) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo > mask->lineRuns[line] && column < mask->runs[lo - 1].end;
+}
+
+void BARunLengthMaskToVolume(const BARunLengthMask* mask, EDTypedVolume* volume,
+                             float inside, float outside)
+{
+    size_t cols   = (mask->columns < volume->columns) ? mask->columns : volume->columns;
+    size_t rows   = (mask->rows < volume->rows) ? mask->rows : volume->rows;
+    size_t slices = (mask->slices < volume->slices) ? mask->slices : volume->slices;
+
+    for (size_t s = 0; s < slices; s++) {
+        for (size_t r = 0; r < rows; r++) {
+            void* data = (void*) EDTypedVoxelAt(volume->data, volume->type, EDTypedVolumeOffset(volume, 0, r, s, 0));
+            ptrdiff_t stride = volume->colStride;
+            for (size_t c = 0; c < cols; c++) {
+                EDTypedStore(data, volume->type, (ptrdiff_t) c * stride, outside);
+            }
+
+            size_t line = s * mask->rows + r;
+            for (size_t i = mask->lineRuns[line]; i < mask->lineRuns[line + 1]; i++) {
+                size_t end = (mask->runs[i].end < cols) ? mask->runs[i].end : cols;
+                for (size_t c = mask->runs[i].start; c < end; c++) {
+                    EDTypedStore(data, volume->type, (ptrdiff_t) c * stride, inside);
+                }
+            }
+        }
+    }
+}
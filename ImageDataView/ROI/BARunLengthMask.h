@@ -0,0 +1,94 @@
+//
+//  BARunLengthMask.h
+//  ImageDataView
+//
+
+#ifndef ImageDataView_BARunLengthMask_h
+#define ImageDataView_BARunLengthMask_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "EDFloatVolume.h"
+#include "EDTypedVolume.h"
+
+/** Columns [start, end) of a line that belong to a mask. */
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+} BAMaskRun;
+
+/**
+ * Binary 3D mask stored as runs of selected voxels per line (row of a slice).
+ * Runs of a line are sorted, disjoint and never touch each other.
+ * Costs 8 bytes per run plus 4 bytes per line instead of 4 bytes per voxel.
+ */
+typedef struct {
+    size_t     columns;
+    size_t     rows;
+    size_t     slices;
+    /** rows * slices + 1 entries: line l (= slice * rows + row) owns runs[lineRuns[l]] .. runs[lineRuns[l + 1] - 1]. */
+    uint32_t*  lineRuns;
+    BAMaskRun* runs;
+    size_t     runCount;
+    size_t     runCapacity;
+} BARunLengthMask;
+
+/** Set operations of BARunLengthMaskCombine. */
+enum BAMaskOperation {
+    /** Voxels of a or b. */
+      MASK_UNION
+    /** Voxels of a but not of b. */
+    , MASK_DIFFERENCE
+    /** Voxels of a and b. */
+    , MASK_INTERSECTION
+};
+
+// All functions creating a mask initialize the passed struct themselves.
+// They return 0 (mask left empty and freed) if memory could not be allocated
+// or the mask has 2^32 voxels or more, 1 otherwise.
+
+/** Creates a mask without any voxel. */
+int BARunLengthMaskInitEmpty(BARunLengthMask* mask, size_t columns, size_t rows, size_t slices);
+
+/** Creates a mask of all voxels of volume (first timestep, any voxel type) different from 0. */
+int BARunLengthMaskInitFromVolume(BARunLengthMask* mask, const EDTypedVolume* volume);
+
+/** Creates a mask of all set bits of bitmap (bit index = voxel index, column fastest). */
+int BARunLengthMaskInitFromBitmap(BARunLengthMask* mask, const uint64_t* bitmap,
+                                  size_t columns, size_t rows, size_t slices);
+
+/**
+ * Creates a mask of all voxels of a label volume (column fastest) equal to label.
+ * box (inclusive minColumn, maxColumn, minRow, maxRow, minSlice, maxSlice) limits
+ * the voxels looked at, e.g. to the bounding box of a BACluster. NULL for all voxels.
+ */
+int BARunLengthMaskInitFromLabels(BARunLengthMask* mask, const uint32_t* labels, uint32_t label,
+                                  size_t columns, size_t rows, size_t slices, const size_t* box);
+
+/**
+ * Creates result = a <op> b, line by line in a single merge pass over both run lists.
+ * a and b must have the same dimensions (returns 0 otherwise).
+ */
+int BARunLengthMaskInitCombined(BARunLengthMask* result,
+                                const BARunLengthMask* a, const BARunLengthMask* b,
+                                enum BAMaskOperation op);
+
+/** Releases the memory of a mask. */
+void BARunLengthMaskFree(BARunLengthMask* mask);
+
+/** Number of voxels of the mask. */
+size_t BARunLengthMaskVoxelCount(const BARunLengthMask* mask);
+
+/** Whether voxel (column, row, slice) belongs to the mask. */
+int BARunLengthMaskContains(const BARunLengthMask* mask, size_t column, size_t row, size_t slice);
+
+/**
+ * Writes inside to all voxels of the mask and outside to all others
+ * (first timestep of volume, as far as it is covered by the mask).
+ * Values are rounded/saturated to the voxel type of volume.
+ */
+void BARunLengthMaskToVolume(const BARunLengthMask* mask, EDTypedVolume* volume,
+                             float inside, float outside);
+
+#endif
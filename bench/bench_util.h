@@ -0,0 +1,81 @@
+//
+//  bench_util.h
+//  ImageDataView
+//
+
+#ifndef ImageDataView_bench_util_h
+#define ImageDataView_bench_util_h
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/** Function measured by benchBestTime, arg is passed through. */
+typedef void (*BenchFunction)(void* arg);
+
+/** Monotonic time in seconds. */
+static inline double benchNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/** Time of a single call of fn(arg) in seconds.
+ *
+ * fn is called in batches until a batch takes at least minSeconds, the best mean
+ * time per call of rounds such batches is returned (first call warms the caches).
+ */
+static inline double benchBestTime(BenchFunction fn, void* arg, double minSeconds, int rounds)
+{
+    size_t calls = 1;
+    fn(arg);
+    for (;;) {
+        double start = benchNow();
+        for (size_t i = 0; i < calls; i++) {
+            fn(arg);
+        }
+        if (benchNow() - start >= minSeconds) {
+            break;
+        }
+        calls *= 2;
+    }
+
+    double best = 0.0;
+    for (int r = 0; r < rounds; r++) {
+        double start = benchNow();
+        for (size_t i = 0; i < calls; i++) {
+            fn(arg);
+        }
+        double perCall = (benchNow() - start) / (double) calls;
+        if (r == 0 || perCall < best) {
+            best = perCall;
+        }
+    }
+    return best;
+}
+
+/** malloc that exits on failure, 64 byte aligned. */
+static inline void* benchAlloc(size_t bytes)
+{
+    void* p = NULL;
+    if (posix_memalign(&p, 64, bytes ? bytes : 1) != 0) {
+        fprintf(stderr, "out of memory (%zu bytes)\n", bytes);
+        exit(1);
+    }
+    return p;
+}
+
+/** Deterministic pseudo random numbers (xorshift32) for reproducible inputs. */
+static inline unsigned int benchRandom(unsigned int* state)
+{
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+#endif
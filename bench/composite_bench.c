@@ -0,0 +1,163 @@
+//
+//  composite_bench.c
+//  ImageDataView
+//
+//  Single pass compositing (BACompositeLayers) against the former two-step
+//  approach of BABrainImageView: each step copies the lower image to a new one
+//  of the target size, scales the upper image to the target size and draws it
+//  over the copy (source over) - background + overlay, then the result + ROI
+//  selection. The two-step variant is measured with the scalar and the SIMD
+//  row blend, so the gain of the single pass itself is visible.
+//
+//  Layers: background at target size, colortable mapped overlay at half the
+//  resolution (scaled), ROI selection at target size.
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "BACompositeKernels.h"
+#include "bench_util.h"
+
+typedef void (*RowOver)(const uint8_t* src, size_t count, unsigned int alpha, uint8_t* dst);
+
+/** A premultiplied RGBA8 image. */
+typedef struct {
+    uint8_t* pixels;
+    size_t   width;
+    size_t   height;
+} Image;
+
+typedef struct {
+    Image   background;
+    Image   overlay;
+    Image   selection;
+    float   overlayAlpha;
+    float   selectionAlpha;
+    size_t  width;
+    size_t  height;
+    /** Result of the benchmarked variant. */
+    uint8_t* result;
+    /** Intermediate images of the two-step variant. */
+    uint8_t* stepCopy;
+    uint8_t* scaled;
+    RowOver  rowOver;
+} CompositeJob;
+
+/** Nearest neighbour scaling of src to width x height. */
+static void scaleImage(const Image* src, uint8_t* dst, size_t width, size_t height)
+{
+    for (size_t y = 0; y < height; y++) {
+        const uint8_t* srcRow = src->pixels + (y * src->height / height) * src->width * 4;
+        uint8_t* dstRow = dst + y * width * 4;
+        if (src->width == width) {
+            memcpy(dstRow, srcRow, width * 4);
+            continue;
+        }
+        for (size_t x = 0; x < width; x++) {
+            memcpy(dstRow + x * 4, srcRow + (x * src->width / width) * 4, 4);
+        }
+    }
+}
+
+/** One step of the former approach: dst = lower (copied, resized) with upper drawn over it. */
+static void compositeStep(const CompositeJob* job, const Image* lower, const Image* upper, float alpha, uint8_t* dst)
+{
+    scaleImage(lower, dst, job->width, job->height);
+    scaleImage(upper, job->scaled, job->width, job->height);
+    unsigned int a = (unsigned int) (alpha * 255.0f + 0.5f);
+    for (size_t y = 0; y < job->height; y++) {
+        job->rowOver(job->scaled + y * job->width * 4, job->width, a, dst + y * job->width * 4);
+    }
+}
+
+static void compositeTwoStep(void* arg)
+{
+    CompositeJob* job = arg;
+    compositeStep(job, &job->background, &job->overlay, job->overlayAlpha, job->stepCopy);
+    Image intermediate = { job->stepCopy, job->width, job->height };
+    compositeStep(job, &intermediate, &job->selection, job->selectionAlpha, job->result);
+}
+
+static void compositeSinglePass(void* arg)
+{
+    CompositeJob* job = arg;
+    BACompositeLayer layers[3] = {
+        { job->background.pixels, job->background.width, job->background.height, job->background.width * 4, 1.0f },
+        { job->overlay.pixels,    job->overlay.width,    job->overlay.height,    job->overlay.width * 4,    job->overlayAlpha },
+        { job->selection.pixels,  job->selection.width,  job->selection.height,  job->selection.width * 4,  job->selectionAlpha },
+    };
+    BACompositeLayers(layers, 3, job->result, job->width, job->height, job->width * 4);
+}
+
+/** Random premultiplied pixels, opaque for the background, partly transparent otherwise. */
+static Image makeImage(size_t width, size_t height, int opaque, unsigned int* seed)
+{
+    Image image = { benchAlloc(width * height * 4), width, height };
+    for (size_t i = 0; i < width * height; i++) {
+        unsigned int r = benchRandom(seed);
+        unsigned int a = opaque ? 255 : (((r >> 24) & 1) ? (r >> 16) & 0xff : 0);
+        image.pixels[i * 4 + 0] = (uint8_t) ((r & 0xff) * a / 255);
+        image.pixels[i * 4 + 1] = (uint8_t) (((r >> 8) & 0xff) * a / 255);
+        image.pixels[i * 4 + 2] = (uint8_t) (((r >> 12) & 0xff) * a / 255);
+        image.pixels[i * 4 + 3] = (uint8_t) a;
+    }
+    return image;
+}
+
+int main(void)
+{
+    static const size_t sizes[] = { 256, 512, 1024 };
+
+#if defined(__SSE2__)
+    const char* isa = "SSE2";
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const char* isa = "NEON";
+#else
+    const char* isa = "scalar";
+#endif
+    printf("Compositing background + overlay (half resolution) + ROI selection, ms per frame (compiled for %s)\n\n", isa);
+    printf("%-12s%22s%22s%14s%10s%10s\n", "target", "two-step scalar blend", "two-step SIMD blend", "single pass", "speedup", "same");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t width  = sizes[s];
+        size_t height = sizes[s];
+        unsigned int seed = 2011;
+
+        CompositeJob job;
+        job.background     = makeImage(width, height, 1, &seed);
+        job.overlay        = makeImage(width / 2, height / 2, 0, &seed);
+        job.selection      = makeImage(width, height, 0, &seed);
+        job.overlayAlpha   = 0.8f;
+        job.selectionAlpha = 0.5f;
+        job.width          = width;
+        job.height         = height;
+        job.result         = benchAlloc(width * height * 4);
+        job.stepCopy       = benchAlloc(width * height * 4);
+        job.scaled         = benchAlloc(width * height * 4);
+        uint8_t* reference = benchAlloc(width * height * 4);
+
+        job.rowOver = BACompositeRowOverScalar;
+        double twoStepScalar = benchBestTime(compositeTwoStep, &job, 0.1, 5);
+        job.rowOver = BACompositeRowOver;
+        double twoStepSIMD = benchBestTime(compositeTwoStep, &job, 0.1, 5);
+        memcpy(reference, job.result, width * height * 4);
+        double singlePass = benchBestTime(compositeSinglePass, &job, 0.1, 5);
+        int same = (memcmp(reference, job.result, width * height * 4) == 0);
+
+        char header[32];
+        snprintf(header, sizeof(header), "%zux%zu", width, height);
+        printf("%-12s%22.3f%22.3f%14.3f%9.2fx%10s\n", header,
+               twoStepScalar * 1e3, twoStepSIMD * 1e3, singlePass * 1e3, twoStepSIMD / singlePass, same ? "yes" : "NO");
+
+        free(reference);
+        free(job.scaled);
+        free(job.stepCopy);
+        free(job.result);
+        free(job.selection.pixels);
+        free(job.overlay.pixels);
+        free(job.background.pixels);
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+//
+//  grid_render_bench.c
+//  ImageDataView
+//
+//  Speedup of the multi slice grid rendering with the number of threads.
+//  Mirrors the identical-orientation grid path of BADataElementRenderer: one job
+//  per grid tile renders its slice row by row into a disjoint region of a shared
+//  RGBA float target. The jobs are handed out like dispatch_apply does (each
+//  worker takes the next tile), by a pthread pool kept alive across renders.
+//
+//  Usage: grid_render_bench [max threads] (default: 2 x online CPUs, at least 8)
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "BARenderKernels.h"
+#include "bench_util.h"
+
+/** A grid render: gridWidth x gridHeight tiles of cols x rows voxels. */
+typedef struct {
+    const int16_t* volume;
+    size_t         cols;
+    size_t         rows;
+    size_t         gridWidth;
+    size_t         tileCount;
+    BARenderTarget target;
+    /** Next tile to render, shared by the workers. */
+    size_t         nextTile;
+} GridJob;
+
+/** Worker threads kept alive across renders, like the threads of a GCD queue. */
+typedef struct {
+    pthread_t       threads[64];
+    size_t          threadCount;
+    pthread_mutex_t lock;
+    pthread_cond_t  start;
+    pthread_cond_t  done;
+    unsigned long   generation;
+    size_t          busy;
+    int             stop;
+    GridJob*        job;
+} Pool;
+
+static void renderTile(const GridJob* job, size_t tile)
+{
+    size_t sliceOffset = (tile / job->gridWidth) * job->gridWidth * job->cols * job->rows + (tile % job->gridWidth) * job->cols;
+    const int16_t* slice = job->volume + tile * job->cols * job->rows;
+    for (size_t row = 0; row < job->rows; row++) {
+        // flipped vertically, as the renderer does for the default orientation
+        const int16_t* srcRow = slice + (job->rows - row - 1) * job->cols;
+        BARenderTypedRow(&job->target, sliceOffset + row * job->gridWidth * job->cols, 1,
+                         srcRow, ED_VOXEL_INT16, 1, job->cols, 0.0f, 1.0f / 4095.0f);
+    }
+}
+
+static void renderTiles(GridJob* job)
+{
+    for (;;) {
+        size_t tile = __atomic_fetch_add(&job->nextTile, 1, __ATOMIC_RELAXED);
+        if (tile >= job->tileCount) {
+            return;
+        }
+        renderTile(job, tile);
+    }
+}
+
+static void* worker(void* arg)
+{
+    Pool* pool = arg;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->stop) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stop) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        renderTiles(pool->job);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/** Starts threads - 1 workers, the calling thread is the last one (as with dispatch_apply). */
+static void poolStart(Pool* pool, size_t threads)
+{
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->threadCount = threads - 1;
+    pool->generation  = 0;
+    pool->busy        = 0;
+    pool->stop        = 0;
+    pool->job         = NULL;
+    for (size_t t = 0; t < pool->threadCount; t++) {
+        if (pthread_create(&pool->threads[t], NULL, worker, pool) != 0) {
+            fprintf(stderr, "could not start thread %zu\n", t);
+            exit(1);
+        }
+    }
+}
+
+static void poolStop(Pool* pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t t = 0; t < pool->threadCount; t++) {
+        pthread_join(pool->threads[t], NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+static void renderGrid(void* arg)
+{
+    Pool* pool = arg;
+    pool->job->nextTile = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->generation++;
+    pool->busy = pool->threadCount;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    renderTiles(pool->job);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int main(int argc, char** argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t maxThreads = (argc > 1) ? (size_t) atol(argv[1]) : (size_t) (cpus > 4 ? 2 * cpus : 8);
+    if (maxThreads < 1) {
+        maxThreads = 1;
+    }
+    if (maxThreads > 64) {
+        maxThreads = 64;
+    }
+
+    // 6 x 6 grid, the most tiles the view shows
+    static const size_t tileSizes[] = { 64, 128, 256 };
+    const size_t gridWidth = 6;
+    const size_t tileCount = gridWidth * gridWidth;
+
+    printf("Grid rendering (%zu tiles of int16 slices to RGBA float), %ld CPUs online\n\n", tileCount, cpus);
+    printf("%8s", "threads");
+    for (size_t s = 0; s < sizeof(tileSizes) / sizeof(tileSizes[0]); s++) {
+        char header[32];
+        snprintf(header, sizeof(header), "%zux%zu ms", tileSizes[s], tileSizes[s]);
+        printf("%14s%9s", header, "speedup");
+    }
+    printf("\n");
+
+    double single[sizeof(tileSizes) / sizeof(tileSizes[0])];
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        printf("%8zu", threads);
+        for (size_t s = 0; s < sizeof(tileSizes) / sizeof(tileSizes[0]); s++) {
+            size_t n = tileSizes[s] * tileSizes[s];
+            int16_t* volume = benchAlloc(tileCount * n * sizeof(int16_t));
+            float*   pixels = benchAlloc(tileCount * n * 4 * sizeof(float));
+            unsigned int seed = 4711;
+            for (size_t i = 0; i < tileCount * n; i++) {
+                volume[i] = (int16_t) (benchRandom(&seed) % 4096);
+            }
+
+            GridJob job = { volume, tileSizes[s], tileSizes[s], gridWidth, tileCount,
+                            { pixels, RENDER_FORMAT_RGBA_FLOAT, 1.0f, NULL }, 0 };
+            Pool pool;
+            poolStart(&pool, threads);
+            pool.job = &job;
+            double seconds = benchBestTime(renderGrid, &pool, 0.1, 5);
+            poolStop(&pool);
+            if (threads == 1) {
+                single[s] = seconds;
+            }
+            printf("%14.3f%9.2f", seconds * 1e3, single[s] / seconds);
+
+            free(pixels);
+            free(volume);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+//
+//  region_growing_bench.c
+//  ImageDataView
+//
+//  BARegionGrow (span-wise, visited bitmap, packed coordinate stack) against the
+//  voxel-wise reference BARegionGrowScalar on 256³ volumes, i.e. a threshold ROI
+//  selection ("magic cluster" click) on a large blob. The mask is reset before each
+//  run, only the growing itself is timed. "same" also checks that growing on an int16
+//  copy of the reference (a native store) selects the same region.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "BARegionGrowing.h"
+#include "bench_util.h"
+
+#define SIZE 256
+
+typedef int (*GrowFunction)(const EDFloatVolume* reference, EDFloatVolume* mask,
+                            size_t column, size_t row, size_t slice,
+                            float min, float max, float value, size_t* filled);
+
+static int growSpans(const EDFloatVolume* reference, EDFloatVolume* mask,
+                     size_t column, size_t row, size_t slice,
+                     float min, float max, float value, size_t* filled)
+{
+    EDTypedVolume typedReference, typedMask;
+    EDTypedVolumeFromFloat(&typedReference, reference);
+    EDTypedVolumeFromFloat(&typedMask, mask);
+    return BARegionGrow(&typedReference, &typedMask, column, row, slice, min, max, value, NULL, filled);
+}
+
+/** Best of runs single runs in seconds, filled receives the region size. */
+static double timeGrow(GrowFunction grow, const EDFloatVolume* reference, EDFloatVolume* mask,
+                       float min, float max, size_t* filled, int runs)
+{
+    double best = 0.0;
+    for (int r = 0; r < runs; r++) {
+        memset(mask->data, 0, SIZE * SIZE * SIZE * sizeof(float));
+        double start = benchNow();
+        if (!grow(reference, mask, SIZE / 2, SIZE / 2, SIZE / 2, min, max, 1.0f, filled)) {
+            fprintf(stderr, "region growing ran out of memory\n");
+            exit(1);
+        }
+        double seconds = benchNow() - start;
+        if (r == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+int main(void)
+{
+    size_t voxels = (size_t) SIZE * SIZE * SIZE;
+    float* reference = benchAlloc(voxels * sizeof(float));
+    float* mask      = benchAlloc(voxels * sizeof(float));
+    float* check     = benchAlloc(voxels * sizeof(float));
+    int16_t* native  = benchAlloc(voxels * sizeof(int16_t));
+    EDFloatVolume referenceVolume, maskVolume;
+    EDFloatVolumeInitSliceMajor(&referenceVolume, reference, SIZE, SIZE, SIZE, 1);
+    EDFloatVolumeInitSliceMajor(&maskVolume, mask, SIZE, SIZE, SIZE, 1);
+
+    printf("Region growing on %dx%dx%d volumes (seed in the centre), best of 3 runs\n\n", SIZE, SIZE, SIZE);
+    printf("%-34s%12s%16s%14s%10s%8s\n", "volume", "voxels", "voxel-wise ms", "span-wise ms", "speedup", "same");
+
+    for (int scenario = 0; scenario < 3; scenario++) {
+        const char* name = NULL;
+        unsigned int seed = 815;
+        for (size_t s = 0; s < SIZE; s++) {
+            for (size_t r = 0; r < SIZE; r++) {
+                for (size_t c = 0; c < SIZE; c++) {
+                    float dc = (float) c - SIZE / 2, dr = (float) r - SIZE / 2, ds = (float) s - SIZE / 2;
+                    float distance = sqrtf(dc * dc + dr * dr + ds * ds);
+                    float noise = (float) (benchRandom(&seed) % 1000) / 1000.0f;
+                    float value = 0.0f;
+                    switch (scenario) {
+                        case 0:
+                            // solid blob, radius 3/8 of the volume
+                            name  = "solid sphere r=96";
+                            value = (distance < 96.0f) ? 1.0f : 0.0f;
+                            break;
+                        case 1:
+                            // the same blob with holes: ~70 % of its voxels pass, ragged spans
+                            name  = "noisy sphere r=96 (70 % pass)";
+                            value = (distance < 96.0f && noise < 0.7f) ? 1.0f : 0.0f;
+                            break;
+                        default:
+                            name  = "whole volume";
+                            value = 1.0f;
+                            break;
+                    }
+                    reference[(s * SIZE + r) * SIZE + c] = value;
+                }
+            }
+        }
+        // the seed has to be part of the region
+        reference[((size_t) SIZE / 2 * SIZE + SIZE / 2) * SIZE + SIZE / 2] = 1.0f;
+
+        size_t filledScalar = 0, filledSpans = 0;
+        double scalar = timeGrow(BARegionGrowScalar, &referenceVolume, &maskVolume, 0.5f, HUGE_VALF, &filledScalar, 3);
+        memcpy(check, mask, voxels * sizeof(float));
+        double spans = timeGrow(growSpans, &referenceVolume, &maskVolume, 0.5f, HUGE_VALF, &filledSpans, 3);
+        int same = (filledScalar == filledSpans && memcmp(check, mask, voxels * sizeof(float)) == 0);
+
+        EDTypedVolume nativeVolume, typedMask;
+        size_t filledNative = 0;
+        for (size_t i = 0; i < voxels; i++) {
+            native[i] = (int16_t) reference[i];
+        }
+        EDTypedVolumeInitSliceMajor(&nativeVolume, native, ED_VOXEL_INT16, SIZE, SIZE, SIZE, 1);
+        EDTypedVolumeFromFloat(&typedMask, &maskVolume);
+        memset(mask, 0, voxels * sizeof(float));
+        if (!BARegionGrow(&nativeVolume, &typedMask, SIZE / 2, SIZE / 2, SIZE / 2, 0.5f, HUGE_VALF, 1.0f, NULL, &filledNative)) {
+            fprintf(stderr, "region growing ran out of memory\n");
+            exit(1);
+        }
+        same = same && filledNative == filledSpans && memcmp(check, mask, voxels * sizeof(float)) == 0;
+
+        printf("%-34s%12zu%16.1f%14.1f%9.1fx%8s\n", name, filledSpans, scalar * 1e3, spans * 1e3, scalar / spans, same ? "yes" : "NO");
+    }
+
+    free(native);
+    free(check);
+    free(mask);
+    free(reference);
+    return 0;
+}
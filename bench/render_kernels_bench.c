@@ -0,0 +1,240 @@
+//
+//  render_kernels_bench.c
+//  ImageDataView
+//
+//  Throughput of the BARenderKernels row kernels on 64², 256² and 512² slices.
+//  Each slice is rendered row by row, like BADataElementRenderer does. GB/s count
+//  the bytes read from the slice plus the bytes written to the render target.
+//  Before timing, every kernel's output is byte-compared against a plain C
+//  reference (BARenderGrayToRGBAScalar, or the documented formula for the
+//  luminance formats); the "same" column reports the result for all sizes.
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "BARenderKernels.h"
+#include "bench_util.h"
+
+/** One slice render job. */
+typedef struct {
+    size_t        size;
+    const float*  src;
+    const int16_t* typedSrc;
+    void*         dst;
+    /** -1 renders every row right to left (flipped). */
+    ptrdiff_t     srcStride;
+    float         min;
+    float         invRange;
+} SliceJob;
+
+/** Start of row r of the source for the direction of job. */
+static const float* rowStart(const SliceJob* job, size_t r)
+{
+    const float* row = job->src + r * job->size;
+    return (job->srcStride < 0) ? row + job->size - 1 : row;
+}
+
+static void renderRGBAScalar(void* arg)
+{
+    const SliceJob* job = arg;
+    for (size_t r = 0; r < job->size; r++) {
+        BARenderGrayToRGBAScalar(rowStart(job, r), job->srcStride, job->size,
+                                 (float*) job->dst + 4 * r * job->size, 1, job->min, job->invRange, 1.0f);
+    }
+}
+
+static void renderRGBA(void* arg)
+{
+    const SliceJob* job = arg;
+    for (size_t r = 0; r < job->size; r++) {
+        BARenderGrayToRGBA(rowStart(job, r), job->srcStride, job->size,
+                           (float*) job->dst + 4 * r * job->size, 1, job->min, job->invRange, 1.0f);
+    }
+}
+
+static void renderLuminanceF(void* arg)
+{
+    const SliceJob* job = arg;
+    for (size_t r = 0; r < job->size; r++) {
+        BARenderGrayToLuminanceF(rowStart(job, r), job->srcStride, job->size,
+                                 (float*) job->dst + r * job->size, 1, job->min, job->invRange);
+    }
+}
+
+static void renderLuminance16(void* arg)
+{
+    const SliceJob* job = arg;
+    for (size_t r = 0; r < job->size; r++) {
+        BARenderGrayToLuminance16(rowStart(job, r), job->srcStride, job->size,
+                                  (uint16_t*) job->dst + r * job->size, 1, job->min, job->invRange);
+    }
+}
+
+static void renderLuminance8(void* arg)
+{
+    const SliceJob* job = arg;
+    for (size_t r = 0; r < job->size; r++) {
+        BARenderGrayToLuminance8(rowStart(job, r), job->srcStride, job->size,
+                                 (uint8_t*) job->dst + r * job->size, 1, job->min, job->invRange);
+    }
+}
+
+/** (v clamped to [0, 1]) * scale, rounded - what the luminance 16/8 kernels are documented to write. */
+static unsigned int quantizeScalar(float val, float min, float invRange, float scale)
+{
+    float v = (val - min) * invRange;
+    v = (v > 0.0f) ? v : 0.0f;
+    v = (v < 1.0f) ? v : 1.0f;
+    return (unsigned int) (v * scale + 0.5f);
+}
+
+static void renderLuminanceFScalar(void* arg)
+{
+    const SliceJob* job = arg;
+    for (size_t r = 0; r < job->size; r++) {
+        const float* row = rowStart(job, r);
+        float* out = (float*) job->dst + r * job->size;
+        for (size_t c = 0; c < job->size; c++) {
+            out[c] = (row[(ptrdiff_t) c * job->srcStride] - job->min) * job->invRange;
+        }
+    }
+}
+
+static void renderLuminance16Scalar(void* arg)
+{
+    const SliceJob* job = arg;
+    for (size_t r = 0; r < job->size; r++) {
+        const float* row = rowStart(job, r);
+        uint16_t* out = (uint16_t*) job->dst + r * job->size;
+        for (size_t c = 0; c < job->size; c++) {
+            out[c] = (uint16_t) quantizeScalar(row[(ptrdiff_t) c * job->srcStride], job->min, job->invRange, 65535.0f);
+        }
+    }
+}
+
+static void renderLuminance8Scalar(void* arg)
+{
+    const SliceJob* job = arg;
+    for (size_t r = 0; r < job->size; r++) {
+        const float* row = rowStart(job, r);
+        uint8_t* out = (uint8_t*) job->dst + r * job->size;
+        for (size_t c = 0; c < job->size; c++) {
+            out[c] = (uint8_t) quantizeScalar(row[(ptrdiff_t) c * job->srcStride], job->min, job->invRange, 255.0f);
+        }
+    }
+}
+
+static void renderTypedInt16(void* arg)
+{
+    const SliceJob* job = arg;
+    BARenderTarget target = { job->dst, RENDER_FORMAT_RGBA_FLOAT, 1.0f, NULL };
+    for (size_t r = 0; r < job->size; r++) {
+        BARenderTypedRow(&target, r * job->size, 1, job->typedSrc + r * job->size, ED_VOXEL_INT16, 1,
+                         job->size, job->min, job->invRange);
+    }
+}
+
+/** A benchmarked kernel. */
+typedef struct {
+    const char*   name;
+    BenchFunction fn;
+    /** Plain C kernel writing the output fn must reproduce byte for byte
+     *  (int16 sources are rendered from their float copy). */
+    BenchFunction reference;
+    ptrdiff_t     srcStride;
+    size_t        srcBytesPerVoxel;
+    size_t        dstBytesPerPixel;
+} Kernel;
+
+static const Kernel kernels[] = {
+    { "GrayToRGBA (scalar reference)", renderRGBAScalar,  renderRGBAScalar,         1, sizeof(float),   4 * sizeof(float) },
+    { "GrayToRGBA",                    renderRGBA,        renderRGBAScalar,         1, sizeof(float),   4 * sizeof(float) },
+    { "GrayToRGBA flipped",            renderRGBA,        renderRGBAScalar,        -1, sizeof(float),   4 * sizeof(float) },
+    { "GrayToLuminanceF",              renderLuminanceF,  renderLuminanceFScalar,   1, sizeof(float),   sizeof(float) },
+    { "GrayToLuminance16",             renderLuminance16, renderLuminance16Scalar,  1, sizeof(float),   sizeof(uint16_t) },
+    { "GrayToLuminance8",              renderLuminance8,  renderLuminance8Scalar,   1, sizeof(float),   sizeof(uint8_t) },
+    { "TypedRow int16 -> RGBA",        renderTypedInt16,  renderRGBAScalar,         1, sizeof(int16_t), 4 * sizeof(float) },
+};
+
+static const size_t sizes[] = { 64, 256, 512 };
+
+int main(void)
+{
+    const size_t kernelCount = sizeof(kernels) / sizeof(kernels[0]);
+    const size_t sizeCount   = sizeof(sizes) / sizeof(sizes[0]);
+
+#if defined(__AVX2__)
+    const char* isa = "AVX2";
+#elif defined(__SSE2__)
+    const char* isa = "SSE2";
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const char* isa = "NEON";
+#else
+    const char* isa = "scalar";
+#endif
+    printf("BARenderKernels throughput in GB/s (compiled for %s)\n\n", isa);
+    printf("%-32s", "kernel");
+    for (size_t s = 0; s < sizeCount; s++) {
+        char header[16];
+        snprintf(header, sizeof(header), "%zux%zu", sizes[s], sizes[s]);
+        printf("%10s", header);
+    }
+    printf("%10s\n", "same");
+
+    double results[sizeof(kernels) / sizeof(kernels[0])][sizeof(sizes) / sizeof(sizes[0])];
+    int same[sizeof(kernels) / sizeof(kernels[0])];
+    for (size_t k = 0; k < kernelCount; k++) {
+        same[k] = 1;
+    }
+    for (size_t s = 0; s < sizeCount; s++) {
+        size_t n = sizes[s] * sizes[s];
+        float*   src      = benchAlloc(n * sizeof(float));
+        int16_t* typedSrc = benchAlloc(n * sizeof(int16_t));
+        void*    dst      = benchAlloc(n * 4 * sizeof(float));
+        void*    expected = benchAlloc(n * 4 * sizeof(float));
+        unsigned int seed = 12345;
+        for (size_t i = 0; i < n; i++) {
+            typedSrc[i] = (int16_t) (benchRandom(&seed) % 4096);
+            src[i] = (float) typedSrc[i];
+        }
+
+        for (size_t k = 0; k < kernelCount; k++) {
+            SliceJob job = { sizes[s], src, typedSrc, dst, kernels[k].srcStride, 0.0f, 1.0f / 4095.0f };
+
+            // poison both buffers differently, so an unwritten pixel cannot compare equal
+            size_t dstBytes = n * kernels[k].dstBytesPerPixel;
+            memset(dst, 0xa5, dstBytes);
+            memset(expected, 0x5a, dstBytes);
+            kernels[k].fn(&job);
+            SliceJob referenceJob = job;
+            referenceJob.dst = expected;
+            kernels[k].reference(&referenceJob);
+            if (memcmp(expected, dst, dstBytes) != 0) {
+                same[k] = 0;
+            }
+
+            double seconds = benchBestTime(kernels[k].fn, &job, 0.05, 5);
+            double bytes = (double) n * (double) (kernels[k].srcBytesPerVoxel + kernels[k].dstBytesPerPixel);
+            results[k][s] = bytes / seconds * 1e-9;
+        }
+
+        free(expected);
+        free(dst);
+        free(typedSrc);
+        free(src);
+    }
+
+    int mismatches = 0;
+    for (size_t k = 0; k < kernelCount; k++) {
+        printf("%-32s", kernels[k].name);
+        for (size_t s = 0; s < sizeCount; s++) {
+            printf("%10.2f", results[k][s]);
+        }
+        printf("%10s\n", same[k] ? "yes" : "NO");
+        mismatches += !same[k];
+    }
+    return (mismatches > 0) ? 1 : 0;
+}
@@ -0,0 +1,269 @@
+//
+//  nifti_header_check.c
+//  BARTApplication
+//
+//  EDNiftiWriteHeader -> EDNiftiReadHeader round trip, reading of foreign units
+//  and of qform/sform orientations, and the size checks of both functions:
+//  truncated files, data not fitting into the file, sizes not fitting into
+//  the header.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "EDNifti.h"
+
+static int failures = 0;
+
+static void check(int condition, const char* what)
+{
+    if (!condition) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static int near(float a, float b)
+{
+    return fabsf(a - b) <= 1.e-4f * (1.0f + fabsf(b));
+}
+
+static size_t dataSize(const EDNiftiHeader* hdr)
+{
+    return hdr->columns * hdr->rows * hdr->slices * hdr->timesteps * EDNiftiBytesPerVoxel(hdr->datatype);
+}
+
+/** A header as EDDataElementWriter fills it: oblique sform, mm and ms. */
+static EDNiftiHeader exampleHeader(int datatype)
+{
+    EDNiftiHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.columns        = 7;
+    hdr.rows           = 5;
+    hdr.slices         = 3;
+    hdr.timesteps      = 4;
+    hdr.datatype       = datatype;
+    hdr.voxelSize[0]   = 3.0f;
+    hdr.voxelSize[1]   = 3.5f;
+    hdr.voxelSize[2]   = 4.25f;
+    hdr.repetitionTime = 2000.0f;
+    float m[3][4] = {
+        { 2.9f,  0.1f, -0.3f, -90.5f},
+        {-0.2f,  3.4f,  0.5f, 126.0f},
+        { 0.4f, -0.6f,  4.2f, -72.25f}
+    };
+    memcpy(hdr.indexToScanner, m, sizeof(m));
+    return hdr;
+}
+
+/** Header plus zeroed voxel data of hdr, extra bytes appended. */
+static unsigned char* writeFile(const EDNiftiHeader* hdr, size_t extra, size_t* length)
+{
+    *length = ED_NIFTI_DATA_OFFSET + dataSize(hdr) + extra;
+    unsigned char* bytes = calloc(*length, 1);
+    check(EDNiftiWriteHeader(hdr, bytes), "writing a valid header");
+    return bytes;
+}
+
+static void checkRoundTrip(int datatype, const char* name)
+{
+    EDNiftiHeader written = exampleHeader(datatype);
+    size_t length;
+    unsigned char* bytes = writeFile(&written, 0, &length);
+
+    EDNiftiHeader read;
+    if (!EDNiftiReadHeader(bytes, length, &read)) {
+        fprintf(stderr, "FAILED: %s: written header is not read back\n", name);
+        failures++;
+        free(bytes);
+        return;
+    }
+    check(read.columns == written.columns && read.rows == written.rows
+          && read.slices == written.slices && read.timesteps == written.timesteps, name);
+    check(read.datatype == datatype, name);
+    check(read.bytesPerVoxel == EDNiftiBytesPerVoxel(datatype), name);
+    check(read.voxOffset == ED_NIFTI_DATA_OFFSET, name);
+    check(read.slope == 0.0f && read.inter == 0.0f, name);
+    for (int i = 0; i < 3; i++) {
+        check(read.voxelSize[i] == written.voxelSize[i], name);
+    }
+    check(read.repetitionTime == written.repetitionTime, name);
+    check(0 == memcmp(read.indexToScanner, written.indexToScanner, sizeof(read.indexToScanner)), name);
+
+    // the timestep count is patched in place while streaming
+    int16_t tsteps = EDNiftiShortAt(bytes, ED_NIFTI_TIMESTEPS_OFFSET);
+    check(tsteps == (int16_t) written.timesteps, "timesteps at ED_NIFTI_TIMESTEPS_OFFSET");
+    free(bytes);
+}
+
+static void checkUnits(void)
+{
+    EDNiftiHeader written = exampleHeader(ED_NIFTI_FLOAT32);
+    size_t length;
+    unsigned char* bytes = writeFile(&written, 0, &length);
+    EDNiftiHeader read;
+
+    // metres and seconds
+    bytes[123] = 1 | 8;
+    EDNiftiPutFloat(bytes, 80, 0.003f);
+    EDNiftiPutFloat(bytes, 92, 2.0f);
+    EDNiftiPutFloat(bytes, 280 + 12, -0.0905f);
+    check(EDNiftiReadHeader(bytes, length, &read), "metres/seconds header");
+    check(near(read.voxelSize[0], 3.0f), "voxel size in metres");
+    check(near(read.repetitionTime, 2000.0f), "repetition time in seconds");
+    check(near(read.indexToScanner[0][3], -90.5f), "sform in metres");
+
+    // micrometres and microseconds
+    bytes[123] = 3 | 24;
+    EDNiftiPutFloat(bytes, 80, 3000.0f);
+    EDNiftiPutFloat(bytes, 92, 2000000.0f);
+    EDNiftiPutFloat(bytes, 280 + 12, -90500.0f);
+    check(EDNiftiReadHeader(bytes, length, &read), "micrometres/microseconds header");
+    check(near(read.voxelSize[0], 3.0f), "voxel size in micrometres");
+    check(near(read.repetitionTime, 2000.0f), "repetition time in microseconds");
+    check(near(read.indexToScanner[0][3], -90.5f), "sform in micrometres");
+
+    // unknown units are taken as mm and seconds
+    bytes[123] = 0;
+    EDNiftiPutFloat(bytes, 80, 3.0f);
+    EDNiftiPutFloat(bytes, 92, 2.0f);
+    check(EDNiftiReadHeader(bytes, length, &read), "header without units");
+    check(near(read.voxelSize[0], 3.0f) && near(read.repetitionTime, 2000.0f), "default units");
+    free(bytes);
+}
+
+static void checkOrientations(void)
+{
+    EDNiftiHeader written = exampleHeader(ED_NIFTI_INT16);
+    size_t length;
+    unsigned char* bytes = writeFile(&written, 0, &length);
+    EDNiftiHeader read;
+
+    // qform only: 90 degrees about z (b = c = 0, d = sin 45), qfac -1
+    EDNiftiPutShort(bytes, 254, 0);
+    EDNiftiPutShort(bytes, 252, 1);
+    EDNiftiPutFloat(bytes, 76, -1.0f);
+    EDNiftiPutFloat(bytes, 256, 0.0f);
+    EDNiftiPutFloat(bytes, 260, 0.0f);
+    EDNiftiPutFloat(bytes, 264, (float) sqrt(0.5));
+    EDNiftiPutFloat(bytes, 268, 10.0f);
+    EDNiftiPutFloat(bytes, 272, -20.0f);
+    EDNiftiPutFloat(bytes, 276, 30.0f);
+    check(EDNiftiReadHeader(bytes, length, &read), "qform header");
+    float expected[3][4] = {
+        {0.0f, -3.5f,  0.0f,   10.0f},
+        {3.0f,  0.0f,  0.0f,  -20.0f},
+        {0.0f,  0.0f, -4.25f,  30.0f}
+    };
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            if (!near(read.indexToScanner[r][c], expected[r][c])) {
+                fprintf(stderr, "FAILED: qform [%d][%d] is %g, expected %g\n",
+                        r, c, read.indexToScanner[r][c], expected[r][c]);
+                failures++;
+            }
+        }
+    }
+
+    // sform wins over qform
+    EDNiftiPutShort(bytes, 254, 2);
+    check(EDNiftiReadHeader(bytes, length, &read), "qform and sform header");
+    check(0 == memcmp(read.indexToScanner, written.indexToScanner, sizeof(read.indexToScanner)), "sform preferred");
+
+    // neither: plain voxel grid
+    EDNiftiPutShort(bytes, 254, 0);
+    EDNiftiPutShort(bytes, 252, 0);
+    check(EDNiftiReadHeader(bytes, length, &read), "header without orientation");
+    check(read.indexToScanner[0][0] == 3.0f && read.indexToScanner[1][1] == 3.5f
+          && read.indexToScanner[2][2] == 4.25f && read.indexToScanner[0][1] == 0.0f
+          && read.indexToScanner[2][3] == 0.0f, "voxel grid without orientation");
+    free(bytes);
+}
+
+static void checkSizes(void)
+{
+    EDNiftiHeader written = exampleHeader(ED_NIFTI_INT16);
+    size_t length;
+    unsigned char* bytes = writeFile(&written, 16, &length);
+    EDNiftiHeader read;
+
+    // trailing bytes don't matter, missing ones do
+    check(EDNiftiReadHeader(bytes, length, &read), "file longer than its data");
+    check(EDNiftiReadHeader(bytes, length - 16, &read), "file ending with its data");
+    check(!EDNiftiReadHeader(bytes, length - 17, &read), "file missing the last byte");
+    check(!EDNiftiReadHeader(bytes, ED_NIFTI_DATA_OFFSET, &read), "file without data");
+    check(!EDNiftiReadHeader(bytes, ED_NIFTI_HEADER_SIZE, &read), "file shorter than the header");
+    check(!EDNiftiReadHeader(bytes, 0, &read), "empty file");
+
+    // data claimed to be larger than the file
+    EDNiftiPutShort(bytes, 42, 32767);
+    EDNiftiPutShort(bytes, 44, 32767);
+    check(!EDNiftiReadHeader(bytes, length, &read), "data larger than the file");
+    EDNiftiPutShort(bytes, 42, (int16_t) written.columns);
+    EDNiftiPutShort(bytes, 44, (int16_t) written.rows);
+    check(EDNiftiReadHeader(bytes, length, &read), "restored header");
+
+    // vox_offset pointing into the header or not aligned to the voxel size
+    EDNiftiPutFloat(bytes, 108, 300.0f);
+    check(!EDNiftiReadHeader(bytes, length, &read), "vox_offset inside the header");
+    EDNiftiPutFloat(bytes, 108, 353.0f);
+    check(!EDNiftiReadHeader(bytes, length, &read), "unaligned vox_offset");
+    EDNiftiPutFloat(bytes, 108, 352.0f);
+
+    // dimensions
+    EDNiftiPutShort(bytes, 40, 5);
+    check(!EDNiftiReadHeader(bytes, length, &read), "5 dimensions");
+    EDNiftiPutShort(bytes, 40, 4);
+    EDNiftiPutShort(bytes, 46, 0);
+    check(!EDNiftiReadHeader(bytes, length, &read), "empty dimension");
+    EDNiftiPutShort(bytes, 46, -3);
+    check(!EDNiftiReadHeader(bytes, length, &read), "negative dimension");
+    EDNiftiPutShort(bytes, 46, (int16_t) written.slices);
+
+    // datatype, magic and header size
+    EDNiftiPutShort(bytes, 70, 128);
+    check(!EDNiftiReadHeader(bytes, length, &read), "unsupported datatype (RGB)");
+    EDNiftiPutShort(bytes, 70, ED_NIFTI_INT16);
+    memcpy(bytes + 344, "ni1", 4);
+    check(!EDNiftiReadHeader(bytes, length, &read), "header/image pair magic");
+    memcpy(bytes + 344, "n+1", 4);
+    int32_t swapped = 0x5C010000;
+    memcpy(bytes, &swapped, sizeof(swapped));
+    check(!EDNiftiReadHeader(bytes, length, &read), "foreign byte order");
+    free(bytes);
+
+    // sizes not fitting into the header
+    unsigned char header[ED_NIFTI_DATA_OFFSET];
+    EDNiftiHeader big = exampleHeader(ED_NIFTI_FLOAT32);
+    big.columns = 32767;
+    check(EDNiftiWriteHeader(&big, header), "32767 columns");
+    big.columns = 32768;
+    check(!EDNiftiWriteHeader(&big, header), "32768 columns");
+    big.columns   = 7;
+    big.timesteps = 0;
+    check(!EDNiftiWriteHeader(&big, header), "no timesteps");
+    big.timesteps = 4;
+    big.datatype  = 128;
+    check(!EDNiftiWriteHeader(&big, header), "unsupported datatype written");
+}
+
+int main(void)
+{
+    checkRoundTrip(ED_NIFTI_UINT8, "uint8 round trip");
+    checkRoundTrip(ED_NIFTI_INT16, "int16 round trip");
+    checkRoundTrip(ED_NIFTI_FLOAT32, "float32 round trip");
+    checkRoundTrip(ED_NIFTI_FLOAT64, "float64 round trip");
+    checkUnits();
+    checkOrientations();
+    checkSizes();
+
+    if (failures > 0) {
+        fprintf(stderr, "nifti_header_check: %d failures\n", failures);
+        return 1;
+    }
+    printf("nifti_header_check: ok\n");
+    return 0;
+}
@@ -0,0 +1,206 @@
+//
+//  stage_counters_check.c
+//  BARTApplication
+//
+//  Runs a receive -> classify -> append pipeline on three threads the way
+//  EDDataElementRealTimeLoader does, each stage accounting its volumes with
+//  EDStageRecord/EDStageSetBlockedTime, while another thread keeps taking
+//  snapshots (EDStageSnapshot, as getStageStatistics). Stage times are
+//  synthetic and fixed per stage, so every consistent snapshot satisfies
+//  exact relations - a torn or stale read shows up as a failure.
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "EDStageCounters.h"
+
+enum { STAGE_RECEIVE, STAGE_CLASSIFY, STAGE_APPEND, STAGE_COUNT };
+
+#define VOLUMES         200000
+#define QUEUE_CAPACITY  16
+
+/** Processing time and latency of a volume leaving each stage (synthetic time units). */
+static const uint64_t PROCESSING[STAGE_COUNT] = { 3, 5, 7 };
+static const uint64_t LATENCY[STAGE_COUNT]    = { 3, 8, 15 };
+
+/** Bounded queue between two stages, volume numbers only. -1 ends the stream. */
+typedef struct {
+    long            items[QUEUE_CAPACITY];
+    size_t          head;
+    size_t          count;
+    uint64_t        blocked;
+    pthread_mutex_t lock;
+    pthread_cond_t  changed;
+} Queue;
+
+static void queueInit(Queue* queue)
+{
+    queue->head    = 0;
+    queue->count   = 0;
+    queue->blocked = 0;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+}
+
+static void queuePush(Queue* queue, long item)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == QUEUE_CAPACITY) {
+        queue->blocked++;
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    queue->items[(queue->head + queue->count) % QUEUE_CAPACITY] = item;
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static long queuePop(Queue* queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    long item = queue->items[queue->head];
+    queue->head = (queue->head + 1) % QUEUE_CAPACITY;
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return item;
+}
+
+static uint64_t queueBlocked(Queue* queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    uint64_t blocked = queue->blocked;
+    pthread_mutex_unlock(&queue->lock);
+    return blocked;
+}
+
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+static EDStageCounters counters[STAGE_COUNT];
+static Queue received;
+static Queue classified;
+static volatile int pipelineDone = 0;
+
+/** Volume v enters stage at time 100 * v + LATENCY[stage - 1] (1 unit of queue wait). */
+static void record(int stage, long v)
+{
+    uint64_t receivedAt = 100 * (uint64_t) v;
+    uint64_t end        = receivedAt + LATENCY[stage];
+    uint64_t start      = end - PROCESSING[stage];
+    uint64_t enqueuedAt = (stage == STAGE_RECEIVE) ? start : start - 1;
+    EDStageRecord(&statsLock, &counters[stage], enqueuedAt, start, end, receivedAt);
+}
+
+static void* classifyStage(void* unused)
+{
+    (void) unused;
+    for (;;) {
+        long v = queuePop(&received);
+        if (v >= 0) {
+            record(STAGE_CLASSIFY, v);
+        }
+        queuePush(&classified, v);
+        EDStageSetBlockedTime(&statsLock, &counters[STAGE_CLASSIFY], queueBlocked(&classified));
+        if (v < 0) {
+            return NULL;
+        }
+    }
+}
+
+static void* appendStage(void* unused)
+{
+    (void) unused;
+    // volumes arrive in order
+    long v = 0;
+    while (queuePop(&classified) >= 0) {
+        record(STAGE_APPEND, v++);
+    }
+    return NULL;
+}
+
+static int failures = 0;
+
+static void check(int condition, const char* what, const EDStageCounters* snapshot)
+{
+    if (!condition && failures++ < 10) {
+        fprintf(stderr, "FAILED: %s (volumes %llu/%llu/%llu)\n", what,
+                (unsigned long long) snapshot[STAGE_RECEIVE].volumes,
+                (unsigned long long) snapshot[STAGE_CLASSIFY].volumes,
+                (unsigned long long) snapshot[STAGE_APPEND].volumes);
+    }
+}
+
+static void checkSnapshot(const EDStageCounters* s)
+{
+    check(s[STAGE_RECEIVE].volumes >= s[STAGE_CLASSIFY].volumes
+          && s[STAGE_CLASSIFY].volumes >= s[STAGE_APPEND].volumes,
+          "volumes decrease along the pipeline", s);
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        const EDStageCounters* c = &s[stage];
+        uint64_t n = c->volumes;
+        check(c->processingTime == n * PROCESSING[stage], "processing time matches the volume count", s);
+        check(c->totalLatency == n * LATENCY[stage], "latency matches the volume count", s);
+        check(c->queueTime == ((stage == STAGE_RECEIVE) ? 0 : n), "queue wait matches the volume count", s);
+        check(n == 0 || (c->maxProcessingTime == PROCESSING[stage] && c->maxTotalLatency == LATENCY[stage]),
+              "maxima", s);
+    }
+}
+
+static void* reader(void* snapshots)
+{
+    EDStageCounters snapshot[STAGE_COUNT];
+    while (!pipelineDone) {
+        EDStageSnapshot(&statsLock, counters, STAGE_COUNT, snapshot);
+        checkSnapshot(snapshot);
+        (*(long*) snapshots)++;
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    EDStageReset(&statsLock, counters, STAGE_COUNT);
+    queueInit(&received);
+    queueInit(&classified);
+
+    long snapshots = 0;
+    pthread_t classifyThread, appendThread, readerThread;
+    pthread_create(&classifyThread, NULL, classifyStage, NULL);
+    pthread_create(&appendThread, NULL, appendStage, NULL);
+    pthread_create(&readerThread, NULL, reader, &snapshots);
+
+    // receive stage on the main thread, as startRealTimeInputOfImageType
+    for (long v = 0; v < VOLUMES; v++) {
+        record(STAGE_RECEIVE, v);
+        queuePush(&received, v);
+        EDStageSetBlockedTime(&statsLock, &counters[STAGE_RECEIVE], queueBlocked(&received));
+    }
+    queuePush(&received, -1);
+    EDStageSetBlockedTime(&statsLock, &counters[STAGE_RECEIVE], queueBlocked(&received));
+
+    pthread_join(classifyThread, NULL);
+    pthread_join(appendThread, NULL);
+    pipelineDone = 1;
+    pthread_join(readerThread, NULL);
+
+    EDStageCounters final[STAGE_COUNT];
+    EDStageSnapshot(&statsLock, counters, STAGE_COUNT, final);
+    checkSnapshot(final);
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        check(final[stage].volumes == VOLUMES, "all volumes passed every stage", final);
+    }
+    check(final[STAGE_RECEIVE].blockedTime == queueBlocked(&received), "receive blocked time", final);
+    check(final[STAGE_CLASSIFY].blockedTime == queueBlocked(&classified), "classify blocked time", final);
+
+    if (failures > 0) {
+        fprintf(stderr, "stage_counters_check: %d failures\n", failures);
+        return 1;
+    }
+    printf("stage_counters_check: ok (%d volumes, %ld snapshots)\n", VOLUMES, snapshots);
+    return 0;
+}
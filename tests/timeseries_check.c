@@ -0,0 +1,201 @@
+//
+//  timeseries_check.c
+//  BARTApplication
+//
+//  EDSelectNth and EDMedianOf against sorting, EDGatherTimeseries and
+//  EDGatherTypedTimeseries against reading every voxel directly - for slice
+//  and time major stores, voxel and time major outputs and timestep ranges
+//  not starting at 0.
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "EDTimeseries.h"
+
+static int failures = 0;
+
+static void check(int condition, const char* what)
+{
+    if (!condition) {
+        if (failures < 10) {
+            fprintf(stderr, "FAILED: %s\n", what);
+        }
+        failures++;
+    }
+}
+
+static unsigned int nextRandom(unsigned int* state)
+{
+    *state = *state * 1103515245u + 12345u;
+    return (*state >> 16) & 0x7fff;
+}
+
+static int compareFloats(const void* a, const void* b)
+{
+    float x = *(const float*) a;
+    float y = *(const float*) b;
+    return (x > y) - (x < y);
+}
+
+/** Fills values with one of several patterns (random, few distinct values, sorted, reversed, constant). */
+static void fillValues(float* values, size_t n, int pattern, unsigned int* state)
+{
+    for (size_t i = 0; i < n; i++) {
+        switch (pattern) {
+            case 0:  values[i] = (float) nextRandom(state) / 64.0f - 200.0f; break;
+            case 1:  values[i] = (float) (nextRandom(state) % 4);            break;
+            case 2:  values[i] = (float) i;                                  break;
+            case 3:  values[i] = (float) (n - i);                            break;
+            default: values[i] = 7.0f;                                       break;
+        }
+    }
+}
+
+static void checkSelection(void)
+{
+    unsigned int state = 4711;
+    float values[97], sorted[97], work[97];
+    for (int pattern = 0; pattern < 5; pattern++) {
+        for (size_t n = 1; n <= 97; n++) {
+            fillValues(values, n, pattern, &state);
+            memcpy(sorted, values, n * sizeof(float));
+            qsort(sorted, n, sizeof(float), compareFloats);
+
+            for (size_t k = 0; k < n; k++) {
+                memcpy(work, values, n * sizeof(float));
+                float nth = EDSelectNth(work, n, k);
+                check(nth == sorted[k], "EDSelectNth returns the k-th smallest value");
+                // EDMedianOf relies on the partition around k
+                for (size_t i = 0; i < n; i++) {
+                    check((i < k) ? work[i] <= nth : work[i] >= nth, "EDSelectNth partitions around k");
+                }
+                qsort(work, n, sizeof(float), compareFloats);
+                check(0 == memcmp(work, sorted, n * sizeof(float)), "EDSelectNth only reorders");
+            }
+
+            memcpy(work, values, n * sizeof(float));
+            float median = EDMedianOf(work, n);
+            float expected = (n % 2 == 1) ? sorted[n / 2] : 0.5f * (sorted[n / 2 - 1] + sorted[n / 2]);
+            if (median != expected) {
+                fprintf(stderr, "FAILED: EDMedianOf of %zu values (pattern %d) is %g, expected %g\n",
+                        n, pattern, median, expected);
+                failures++;
+            }
+        }
+    }
+    check(0.0f == EDMedianOf(values, 0), "median of nothing");
+}
+
+/** Value of voxel (c, r, s) at timestep t, unique and exactly representable in int16 and float. */
+static float voxelValue(size_t c, size_t r, size_t s, size_t t)
+{
+    return (float) ((int) (t * 1000 + s * 100 + r * 10 + c) - 5000);
+}
+
+static void checkGather(const EDFloatVolume* volume, const EDTypedVolume* typed, const char* name)
+{
+    // every third voxel, backwards, so the offsets are neither sorted nor dense
+    size_t voxels = volume->columns * volume->rows * volume->slices;
+    size_t n = 0;
+    size_t coords[64][3];
+    ptrdiff_t offsets[64], typedOffsets[64];
+    for (size_t v = voxels; v-- > 0 && n < 64; ) {
+        if (v % 3 != 0) {
+            continue;
+        }
+        size_t c = v % volume->columns;
+        size_t r = (v / volume->columns) % volume->rows;
+        size_t s = v / (volume->columns * volume->rows);
+        coords[n][0] = c;
+        coords[n][1] = r;
+        coords[n][2] = s;
+        offsets[n]      = EDFloatVolumeOffset(volume, c, r, s, 0);
+        typedOffsets[n] = EDTypedVolumeOffset(typed, c, r, s, 0);
+        n++;
+    }
+
+    size_t ranges[3][2] = { {0, volume->timesteps}, {2, 3}, {volume->timesteps - 1, 1} };
+    float* out = malloc(n * volume->timesteps * sizeof(float));
+    for (int range = 0; range < 3; range++) {
+        size_t tstart = ranges[range][0];
+        size_t nt     = ranges[range][1];
+        for (int layout = 0; layout < 2; layout++) {
+            // voxel major (one time course after the other) or time major (one volume after the other)
+            ptrdiff_t voxelStride = (layout == 0) ? (ptrdiff_t) nt : 1;
+            ptrdiff_t timeStride  = (layout == 0) ? 1 : (ptrdiff_t) n;
+            for (int source = 0; source < 2; source++) {
+                memset(out, 0xff, n * nt * sizeof(float));
+                if (source == 0) {
+                    EDGatherTimeseries(volume, offsets, n, tstart, nt, out, voxelStride, timeStride);
+                } else {
+                    EDGatherTypedTimeseries(typed, typedOffsets, n, tstart, nt, out, voxelStride, timeStride);
+                }
+                for (size_t i = 0; i < n; i++) {
+                    for (size_t t = 0; t < nt; t++) {
+                        float expected = EDFloatVolumeGet(volume, coords[i][0], coords[i][1], coords[i][2], tstart + t);
+                        float gathered = out[(ptrdiff_t) i * voxelStride + (ptrdiff_t) t * timeStride];
+                        if (gathered != expected) {
+                            if (failures < 10) {
+                                fprintf(stderr, "FAILED: %s %s, timesteps %zu+%zu, %s output: voxel %zu at %zu is %g, expected %g\n",
+                                        name, (source == 0) ? "float" : "typed", tstart, nt,
+                                        (layout == 0) ? "voxel major" : "time major", i, t, gathered, expected);
+                            }
+                            failures++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    free(out);
+}
+
+static void checkGathers(void)
+{
+    const size_t cols = 6, rows = 5, slices = 4, timesteps = 7;
+    size_t count = cols * rows * slices * timesteps;
+    float* sliceMajor = malloc(count * sizeof(float));
+    float* timeMajor  = malloc(count * sizeof(float));
+    int16_t* native   = malloc(count * sizeof(int16_t));
+
+    EDFloatVolume sliceMajorVolume, timeMajorVolume;
+    EDTypedVolume nativeVolume, timeMajorTyped;
+    EDFloatVolumeInitSliceMajor(&sliceMajorVolume, sliceMajor, cols, rows, slices, timesteps);
+    EDFloatVolumeInitTimeMajor(&timeMajorVolume, timeMajor, cols, rows, slices, timesteps);
+    EDTypedVolumeInitSliceMajor(&nativeVolume, native, ED_VOXEL_INT16, cols, rows, slices, timesteps);
+    EDTypedVolumeFromFloat(&timeMajorTyped, &timeMajorVolume);
+    for (size_t t = 0; t < timesteps; t++) {
+        for (size_t s = 0; s < slices; s++) {
+            for (size_t r = 0; r < rows; r++) {
+                for (size_t c = 0; c < cols; c++) {
+                    EDFloatVolumeSet(&sliceMajorVolume, c, r, s, t, voxelValue(c, r, s, t));
+                    EDFloatVolumeSet(&timeMajorVolume, c, r, s, t, voxelValue(c, r, s, t));
+                    EDTypedVolumeSet(&nativeVolume, c, r, s, t, voxelValue(c, r, s, t));
+                }
+            }
+        }
+    }
+
+    checkGather(&sliceMajorVolume, &nativeVolume, "slice major");
+    checkGather(&timeMajorVolume, &timeMajorTyped, "time major");
+
+    free(native);
+    free(timeMajor);
+    free(sliceMajor);
+}
+
+int main(void)
+{
+    checkSelection();
+    checkGathers();
+
+    if (failures > 0) {
+        fprintf(stderr, "timeseries_check: %d failures\n", failures);
+        return 1;
+    }
+    printf("timeseries_check: ok\n");
+    return 0;
+}
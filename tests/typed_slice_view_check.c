@@ -0,0 +1,93 @@
+//
+//  typed_slice_view_check.c
+//  BARTApplication
+//
+//  Reads rows of a native int16 volume through a float slice view the way
+//  EDDataElementIsis getSliceView:atTimestep: builds it for native stores: a
+//  converted copy of the slice (EDTypedVolumeSliceToFloat) and the row stride
+//  of that copy. Non-zero rows have to come out unchanged.
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "EDTypedVolume.h"
+
+/** Float view of a slice - data and rowStride of EDSliceView. */
+typedef struct {
+    const float* data;
+    ptrdiff_t    rowStride;
+} SliceView;
+
+static int failures = 0;
+
+static void check(int condition, const char* what)
+{
+    if (!condition) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+/** Voxel value at (c, r, s, t), never 0. */
+static int16_t voxelValue(size_t c, size_t r, size_t s, size_t t)
+{
+    return (int16_t) (1000 * t + 100 * s + 10 * r + c + 1) * ((r % 2) ? -1 : 1);
+}
+
+static void checkVolume(EDTypedVolume* volume, const char* name)
+{
+    for (size_t t = 0; t < volume->timesteps; t++) {
+        for (size_t s = 0; s < volume->slices; s++) {
+            for (size_t r = 0; r < volume->rows; r++) {
+                for (size_t c = 0; c < volume->columns; c++) {
+                    EDTypedVolumeSet(volume, c, r, s, t, voxelValue(c, r, s, t));
+                }
+            }
+        }
+    }
+
+    for (size_t t = 0; t < volume->timesteps; t++) {
+        for (size_t s = 0; s < volume->slices; s++) {
+            float* copy = malloc(volume->columns * volume->rows * sizeof(float));
+            SliceView view = { copy, EDTypedVolumeSliceToFloat(volume, s, t, copy) };
+            check(view.rowStride == (ptrdiff_t) volume->columns, name);
+
+            for (size_t r = 0; r < volume->rows; r++) {
+                const float* row = view.data + (ptrdiff_t) r * view.rowStride;
+                for (size_t c = 0; c < volume->columns; c++) {
+                    if (row[c] != (float) voxelValue(c, r, s, t)) {
+                        fprintf(stderr, "%s: voxel (%zu, %zu, %zu, %zu) is %g, expected %d\n",
+                                name, c, r, s, t, row[c], voxelValue(c, r, s, t));
+                        failures++;
+                    }
+                }
+            }
+            free(copy);
+        }
+    }
+}
+
+int main(void)
+{
+    const size_t cols = 7, rows = 5, slices = 3, timesteps = 2;
+    int16_t* data = calloc(cols * rows * slices * timesteps, sizeof(int16_t));
+
+    EDTypedVolume volume;
+    EDTypedVolumeInitSliceMajor(&volume, data, ED_VOXEL_INT16, cols, rows, slices, timesteps);
+    checkVolume(&volume, "slice major int16");
+
+    // time major store: voxels of a time series are adjacent
+    volume.timeStride  = 1;
+    volume.colStride   = (ptrdiff_t) timesteps;
+    volume.rowStride   = (ptrdiff_t) (timesteps * cols);
+    volume.sliceStride = (ptrdiff_t) (timesteps * cols * rows);
+    checkVolume(&volume, "time major int16");
+
+    free(data);
+    if (failures == 0) {
+        printf("typed_slice_view_check: ok\n");
+    }
+    return failures == 0 ? 0 : 1;
+}